@@ -0,0 +1,35 @@
+"""Builds the _sslm extension module and installs sslm.py.
+
+    python setup.py build_ext --inplace
+
+The engine is compiled from the sources of the program, so the
+extension does not need sslmlib.dll at run time.
+"""
+import os
+import sys
+
+from setuptools import setup, Extension
+
+here = os.path.dirname(os.path.abspath(__file__))
+srcdir = os.path.join("..", "sslmarcpyvs2017", "sourcecode")
+engine = ["ascgrid.cpp", "cdfindex.cpp", "curvefile.cpp", "engine.cpp", "gridstream.cpp", "histogram.cpp", "lorenz.cpp", "lwli.cpp", "message.cpp", "simplify.cpp", "sslmapi.cpp", "textout.cpp", "trace.cpp"]
+
+if sys.platform == "win32":
+    compile_args = ["/O2", "/EHsc"]
+else:
+    compile_args = ["-O2", "-std=c++11", "-pthread"]
+
+os.chdir(here)
+setup(
+    name="sslm",
+    version="1.0",
+    description="Source sink landscape model engine",
+    py_modules=["sslm"],
+    ext_modules=[Extension(
+        "_sslm",
+        sources=["sslmmodule.cpp"] + [os.path.join(srcdir, f) for f in engine],
+        include_dirs=[srcdir],
+        extra_compile_args=compile_args,
+        extra_link_args=[] if sys.platform == "win32" else ["-pthread"],
+        language="c++")],
+)
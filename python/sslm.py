@@ -0,0 +1,172 @@
+"""Source sink landscape model engine for Python.
+
+Calculates the lorenz curve areas of the source and sink land uses
+in process, from NumPy arrays, instead of writing the grids as ascii
+files, running SSLM.exe and reading its text outputs back:
+
+    import arcpy, sslm
+    lu = arcpy.RasterToNumPyArray("luws")
+    dem = arcpy.RasterToNumPyArray("demws")
+    dist = arcpy.RasterToNumPyArray("distws")
+    slope = arcpy.RasterToNumPyArray("slopews")
+    res = sslm.compute([1, 2], [3, 4], lu, dem, dist, slope)
+    res.area            # (nlus, 3) elevation, distance, slope
+    res.curve(1, sslm.ELEVATION)
+    res.quantile(1, sslm.ELEVATION, 0.9)   # 90th percentile elevation
+    res.lwli({1: 0.5, 2: 1.0, 3: 0.8, 4: 1.2})
+
+The cells are selected as in SSLM.exe: every cell whose land use is
+listed is used, so the terrain arrays should have data wherever the
+listed land uses are. The areas are the same as the ones in
+LurenzCurveAreas.txt.
+
+int32 land uses and float32 terrain arrays are read in place, other
+types are converted in blocks of rows. Needs ArcGIS Pro (Python 3).
+"""
+import json
+import os
+
+import numpy as np
+
+import _sslm
+
+ELEVATION = 0
+DISTANCE = 1
+SLOPE = 2
+
+FACTOR_NAMES = ("elev", "dist", "slp")
+
+
+class LorenzResult(object):
+    """Results of one compute() call, sources first, then sinks."""
+
+    def __init__(self, raw):
+        self.luno = np.frombuffer(raw["luno"], dtype=np.int32)
+        self.is_source = np.frombuffer(raw["is_source"], dtype=np.int32).astype(bool)
+        self.ncells = np.frombuffer(raw["ncells"], dtype=np.int64)
+        self.area_perc = np.frombuffer(raw["area_perc"], dtype=np.float64)
+        self.area = np.frombuffer(raw["area"], dtype=np.float64).reshape(-1, 3)
+        self.curves = [(np.frombuffer(v, dtype=np.float64), np.frombuffer(p, dtype=np.float64))
+                       for v, p in raw["curves"]]
+
+    def index(self, luno):
+        """Row of land use luno in the result arrays."""
+        found = np.nonzero(self.luno == luno)[0]
+        if len(found) == 0:
+            raise KeyError("Land use %d is not a source or sink" % luno)
+        return int(found[0])
+
+    def curve(self, luno, factor):
+        """Values and percentages of the points of the lorenz curve."""
+        if not self.curves:
+            raise ValueError("compute() was called with curves=False")
+        return self.curves[self.index(luno) * 3 + factor]
+
+    def lwli(self, weights, threads=0):
+        """Location weighted landscape index as Step09_CalculateLWLI.
+
+        weights is a dict {luno: weight} of every source and sink, an
+        array of nlus weights in the order of luno, or an array of
+        shape (nsets, nlus) of many weight sets. Returns the elevation,
+        distance, slope and combined index, shape (4,) or (nsets, 4).
+        """
+        if isinstance(weights, dict):
+            missing = [int(l) for l in self.luno if int(l) not in weights]
+            if missing:
+                raise KeyError("No weight for land use %s" % missing)
+            weights = [weights[int(l)] for l in self.luno]
+        w = np.ascontiguousarray(weights, dtype=np.float64)
+        if w.shape[-1:] != (len(self.luno),) or w.ndim > 2:
+            raise ValueError("weights must have %d values per set" % len(self.luno))
+        raw = _sslm.lwli(np.ascontiguousarray(self.is_source, dtype=np.int32),
+                         np.ascontiguousarray(self.area_perc), np.ascontiguousarray(self.area),
+                         w, threads=threads)
+        out = np.frombuffer(raw, dtype=np.float64)
+        return out if w.ndim == 1 else out.reshape(-1, 4)
+
+    def cdf(self, luno, factor, x, threads=0):
+        """Share of the cells of land use luno with a value <= x.
+
+        x is a number or an array, the answer has its shape. NaN for
+        a land use without cells.
+        """
+        return self._query(_sslm.cdf, luno, factor, x, threads)
+
+    def quantile(self, luno, factor, q, threads=0):
+        """Smallest value with a share of the cells >= q (0..1).
+
+        The inverse of cdf(): quantile(luno, ELEVATION, 0.9) is the
+        90th percentile elevation of the land use.
+        """
+        return self._query(_sslm.quantile, luno, factor, q, threads)
+
+    def _query(self, func, luno, factor, x, threads):
+        values, percents = self.curve(luno, factor)
+        x = np.asarray(x, dtype=np.float64)
+        if len(values) == 0 or x.size == 0:
+            out = np.full(x.shape, np.nan)
+        else:
+            raw = func(values, percents, int(self.ncells[self.index(luno)]),
+                       np.ascontiguousarray(x.ravel()), threads=threads)
+            out = np.frombuffer(raw, dtype=np.float64).reshape(x.shape)
+        return out if out.ndim > 0 else float(out)
+
+    def write_outputs(self, prefix=""):
+        """Writes LurenzCurveAreas.txt and luareaperc.txt as SSLM.exe does."""
+        with open(prefix + "LurenzCurveAreas.txt", "w") as f:
+            f.write("Area under lorenz curve\n")
+            f.write("Landuse, Area_Elevation, Area_Distance, Area_Slope\n")
+            for luno, area in zip(self.luno, self.area):
+                f.write("Landuse_%d, %f, %f, %f\n" % (luno, area[0], area[1], area[2]))
+
+        with open(prefix + "luareaperc.txt", "w") as f:
+            f.write("Percentage of area for each land use over watershed area\n")
+            f.write("Landuse, Total_cells, Percentage\n")
+            for source, name in ((False, "Sink"), (True, "Source")):
+                for i in np.nonzero(self.is_source == source)[0]:
+                    f.write("%s_%d, %d, %f\n" % (name, self.luno[i], self.ncells[i], self.area_perc[i]))
+
+
+def compute(srclus, sinklus, lu, elev, dist, slope, threads=0, curves=True, quantum=None):
+    """Lorenz curve areas of the source and sink land uses.
+
+    lu, elev, dist and slope are 2D arrays of the same shape. threads
+    is the number of threads, 0 for all cores. The interpreter lock
+    is released during the calculation.
+
+    quantum gives the step of the values of elevation, distance and
+    slope, e.g. (0.01, 1, 0.1): the values are counted in histograms
+    instead of sorted, with the same results. 0 sorts a factor. A
+    value that is not a multiple of its quantum raises ValueError.
+    """
+    grids = [np.ascontiguousarray(g) for g in (lu, elev, dist, slope)]
+    raw = _sslm.compute([int(x) for x in srclus], [int(x) for x in sinklus],
+                        grids[0], grids[1], grids[2], grids[3],
+                        threads=threads, curves=curves, quantum=quantum)
+    return LorenzResult(raw)
+
+
+def load_curves(prefix=""):
+    """Curves written with -curves npy (see curvefile.h).
+
+    Returns {(luno, factor): (values, percents)}. The arrays are
+    views of memory mapped files, nothing is read until used.
+    """
+    with open(prefix + "dataperc_index.json") as f:
+        index = json.load(f)
+    folder = os.path.dirname(prefix + "dataperc_index.json")
+    arrays = [np.load(os.path.join(folder, index["files"][name]), mmap_mode="r")
+              for name in FACTOR_NAMES]
+    curves = {}
+    for lu in index["landuses"]:
+        for factor, name in enumerate(FACTOR_NAMES):
+            offset, count = lu[name]
+            points = arrays[factor][:, offset:offset + count]
+            curves[(lu["luno"], factor)] = (points[0], points[1])
+    return curves
+
+
+def read_lu_list(filename):
+    """Land use numbers of srclus.txt or sinklus.txt."""
+    with open(filename) as f:
+        return [int(x) for x in f.read().split()]
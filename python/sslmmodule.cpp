@@ -0,0 +1,540 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Python extension module _sslm on top of the C interface of the
+** library. The grids are taken through the buffer protocol, so
+** NumPy arrays (for example from arcpy.RasterToNumPyArray) are
+** read in place. int32 land uses and float32 terrain values are
+** pushed to the engine without a copy, other types are converted a
+** block of rows at a time. The interpreter lock is released while
+** the rows are pushed and the curves are calculated.
+**
+** The results come back as bytes objects, sslm.py turns them into
+** NumPy arrays with numpy.frombuffer().
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "sslmapi.h"
+
+using namespace std;
+
+// Rows converted and pushed at a time
+#define BLOCK_ROWS 256
+
+
+// Kind of the values of a buffer from its struct format
+enum ValueKind { KIND_BAD, KIND_SIGNED, KIND_UNSIGNED, KIND_FLOAT };
+
+static ValueKind valueKind(const char *format)
+{
+	if (format == NULL) { return KIND_UNSIGNED; }
+	if (*format == '@' || *format == '=' || *format == '<') { format++; }
+	if (strlen(format) != 1) { return KIND_BAD; }
+
+	switch (*format)
+	{
+	case 'b': case 'h': case 'i': case 'l': case 'q': return KIND_SIGNED;
+	case 'B': case 'H': case 'I': case 'L': case 'Q': case '?': return KIND_UNSIGNED;
+	case 'f': case 'd': return KIND_FLOAT;
+	default: return KIND_BAD;
+	}
+}
+
+
+static double valueAt(const Py_buffer *view, ValueKind kind, Py_ssize_t index)
+{
+	const char *p = (const char *)view->buf + index*view->itemsize;
+
+	if (kind == KIND_FLOAT)
+	{
+		if (view->itemsize == 4) { return *(const float *)p; }
+		return *(const double *)p;
+	}
+	switch (view->itemsize)
+	{
+	case 1: return (kind == KIND_SIGNED) ? *(const signed char *)p : *(const unsigned char *)p;
+	case 2: return (kind == KIND_SIGNED) ? *(const short *)p : *(const unsigned short *)p;
+	case 4: return (kind == KIND_SIGNED) ? *(const int *)p : *(const unsigned int *)p;
+	default: return (kind == KIND_SIGNED) ? (double)*(const long long *)p : (double)*(const unsigned long long *)p;
+	}
+}
+
+
+// One grid argument and the block it is converted into
+typedef struct GridArg
+{
+	Py_buffer view;
+	ValueKind kind;
+	bool direct;
+	vector<int> intBlock;
+	vector<float> floatBlock;
+} GridArg;
+
+
+static bool getGrid(PyObject *obj, const char *name, bool isLu, GridArg *grid, int *rows, int *cols)
+{
+	if (PyObject_GetBuffer(obj, &grid->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+	{
+		return false;
+	}
+
+	Py_buffer *view = &grid->view;
+	grid->kind = valueKind(view->format);
+	if (view->ndim != 2 || grid->kind == KIND_BAD || (isLu && grid->kind == KIND_FLOAT))
+	{
+		PyErr_Format(PyExc_TypeError, "%s must be a 2D array of %s", name, isLu ? "integers" : "numbers");
+		PyBuffer_Release(view);
+		return false;
+	}
+	if (*rows < 0)
+	{
+		*rows = (int)view->shape[0];
+		*cols = (int)view->shape[1];
+	}
+	else if (view->shape[0] != *rows || view->shape[1] != *cols)
+	{
+		PyErr_Format(PyExc_ValueError, "%s does not have the shape of lu", name);
+		PyBuffer_Release(view);
+		return false;
+	}
+
+	if (isLu)
+	{
+		grid->direct = (grid->kind == KIND_SIGNED && view->itemsize == sizeof(int));
+	}
+	else
+	{
+		grid->direct = (grid->kind == KIND_FLOAT && view->itemsize == sizeof(float));
+	}
+	return true;
+}
+
+
+// Pointer to the values of rows [row, row + nrows), converted if needed
+static const void *gridBlock(GridArg *grid, bool isLu, int row, int nrows, int cols)
+{
+	Py_ssize_t start = (Py_ssize_t)row*cols;
+	Py_ssize_t n = (Py_ssize_t)nrows*cols;
+
+	if (grid->direct)
+	{
+		return (const char *)grid->view.buf + start*grid->view.itemsize;
+	}
+	if (isLu)
+	{
+		grid->intBlock.resize(n);
+		for (Py_ssize_t i = 0; i < n; i++) { grid->intBlock[i] = (int)valueAt(&grid->view, grid->kind, start + i); }
+		return grid->intBlock.data();
+	}
+	grid->floatBlock.resize(n);
+	for (Py_ssize_t i = 0; i < n; i++) { grid->floatBlock[i] = (float)valueAt(&grid->view, grid->kind, start + i); }
+	return grid->floatBlock.data();
+}
+
+
+static bool getLuList(PyObject *obj, const char *name, vector<int> &lus)
+{
+	PyObject *seq = PySequence_Fast(obj, name);
+	if (seq == NULL) { return false; }
+
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+	for (Py_ssize_t i = 0; i < n; i++)
+	{
+		long v = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+		if (v == -1 && PyErr_Occurred()) { Py_DECREF(seq); return false; }
+		lus.push_back((int)v);
+	}
+	Py_DECREF(seq);
+	return true;
+}
+
+
+static PyObject *raiseSslmError(int rc, sslm_handle h)
+{
+	PyObject *type = PyExc_RuntimeError;
+	if (rc == SSLM_ERROR_ARGUMENT) { type = PyExc_ValueError; }
+	else if (rc == SSLM_ERROR_MEMORY) { type = PyExc_MemoryError; }
+
+	PyErr_SetString(type, sslm_last_error(h));
+	return NULL;
+}
+
+
+static PyObject *bytesOf(const void *data, size_t size)
+{
+	return PyBytes_FromStringAndSize((const char *)data, (Py_ssize_t)size);
+}
+
+
+// Results of the handle as a dict of bytes objects
+static PyObject *buildResults(sslm_handle h, bool withCurves)
+{
+	int nlus = sslm_num_lus(h);
+	vector<int> luno(nlus), isSource(nlus);
+	vector<long long> ncells(nlus);
+	vector<double> areaPerc(nlus), area(nlus*3);
+
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		sslm_lu_result r;
+		sslm_get_result(h, luidx, &r);
+		luno[luidx] = r.luno;
+		isSource[luidx] = r.is_source;
+		ncells[luidx] = r.ncells;
+		areaPerc[luidx] = r.area_perc;
+		for (int f = 0; f < 3; f++) { area[luidx*3 + f] = r.area[f]; }
+	}
+
+	PyObject *curves = PyList_New(0);
+	for (int t = 0; withCurves && curves != NULL && t < nlus*3; t++)
+	{
+		const double *values, *percents;
+		long long npoints;
+		sslm_get_curve(h, t / 3, t % 3, &values, &percents, &npoints);
+
+		PyObject *item = Py_BuildValue("(NN)",
+			bytesOf(values, sizeof(double)*npoints),
+			bytesOf(percents, sizeof(double)*npoints));
+		if (item == NULL || PyList_Append(curves, item) < 0)
+		{
+			Py_XDECREF(item);
+			Py_CLEAR(curves);
+			break;
+		}
+		Py_DECREF(item);
+	}
+	if (curves == NULL) { return NULL; }
+
+	return Py_BuildValue("{s:N,s:N,s:N,s:N,s:N,s:N}",
+		"luno", bytesOf(luno.data(), sizeof(int)*nlus),
+		"is_source", bytesOf(isSource.data(), sizeof(int)*nlus),
+		"ncells", bytesOf(ncells.data(), sizeof(long long)*nlus),
+		"area_perc", bytesOf(areaPerc.data(), sizeof(double)*nlus),
+		"area", bytesOf(area.data(), sizeof(double)*nlus*3),
+		"curves", curves);
+}
+
+
+// Quantum of elevation, distance and slope, None for 0 0 0
+static bool getQuantum(PyObject *obj, double *quantum)
+{
+	for (int f = 0; f < 3; f++) { quantum[f] = 0.0; }
+	if (obj == NULL || obj == Py_None) { return true; }
+
+	PyObject *seq = PySequence_Fast(obj, "quantum must be a sequence of 3 numbers");
+	if (seq == NULL) { return false; }
+	bool ok = (PySequence_Fast_GET_SIZE(seq) == 3);
+	for (int f = 0; ok && f < 3; f++)
+	{
+		quantum[f] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, f));
+		ok = !(quantum[f] == -1.0 && PyErr_Occurred()) && quantum[f] >= 0.0;
+	}
+	Py_DECREF(seq);
+	if (!ok)
+	{
+		PyErr_Clear();
+		PyErr_SetString(PyExc_ValueError, "quantum must be a sequence of 3 numbers of 0 or more");
+	}
+	return ok;
+}
+
+
+/*
+** compute(srclus, sinklus, lu, elev, dist, slope, threads=0, curves=True, quantum=None)
+*/
+static PyObject *sslm_compute_py(PyObject *, PyObject *args, PyObject *kwds)
+{
+	static const char *kwlist[] = { "srclus", "sinklus", "lu", "elev", "dist", "slope", "threads", "curves", "quantum", NULL };
+	PyObject *srcobj, *sinkobj, *objs[4];
+	PyObject *quantumobj = NULL;
+	int nthreads = 0;
+	int withCurves = 1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOOO|ipO", (char **)kwlist,
+		&srcobj, &sinkobj, &objs[0], &objs[1], &objs[2], &objs[3], &nthreads, &withCurves, &quantumobj))
+	{
+		return NULL;
+	}
+
+	double quantum[3];
+	if (!getQuantum(quantumobj, quantum)) { return NULL; }
+
+	vector<int> srclus, sinklus;
+	if (!getLuList(srcobj, "srclus must be a sequence", srclus)) { return NULL; }
+	if (!getLuList(sinkobj, "sinklus must be a sequence", sinklus)) { return NULL; }
+
+	static const char *names[4] = { "lu", "elev", "dist", "slope" };
+	GridArg grids[4];
+	int rows = -1, cols = -1;
+	int ngrids = 0;
+	for (; ngrids < 4; ngrids++)
+	{
+		if (!getGrid(objs[ngrids], names[ngrids], ngrids == 0, &grids[ngrids], &rows, &cols)) { break; }
+	}
+	if (ngrids < 4)
+	{
+		for (int g = 0; g < ngrids; g++) { PyBuffer_Release(&grids[g].view); }
+		return NULL;
+	}
+
+	sslm_handle h = sslm_create();
+	if (h == NULL)
+	{
+		for (int g = 0; g < 4; g++) { PyBuffer_Release(&grids[g].view); }
+		return PyErr_NoMemory();
+	}
+
+	int rc = SSLM_OK;
+	Py_BEGIN_ALLOW_THREADS
+	try
+	{
+		rc = sslm_set_classes(h, srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+		if (rc == SSLM_OK) { rc = sslm_set_grid(h, rows, cols); }
+		if (rc == SSLM_OK) { rc = sslm_set_threads(h, nthreads); }
+		for (int f = 0; rc == SSLM_OK && f < 3; f++) { rc = sslm_set_quantum(h, f, quantum[f]); }
+		for (int row = 0; rc == SSLM_OK && row < rows; row += BLOCK_ROWS)
+		{
+			int nrows = (rows - row < BLOCK_ROWS) ? rows - row : BLOCK_ROWS;
+			rc = sslm_push_rows(h, nrows,
+				(const int *)gridBlock(&grids[0], true, row, nrows, cols),
+				(const float *)gridBlock(&grids[1], false, row, nrows, cols),
+				(const float *)gridBlock(&grids[2], false, row, nrows, cols),
+				(const float *)gridBlock(&grids[3], false, row, nrows, cols));
+		}
+		if (rc == SSLM_OK) { rc = sslm_compute(h); }
+	}
+	catch (const bad_alloc &)
+	{
+		rc = -1;
+	}
+	Py_END_ALLOW_THREADS
+
+	for (int g = 0; g < 4; g++) { PyBuffer_Release(&grids[g].view); }
+
+	PyObject *result;
+	if (rc == -1) { result = PyErr_NoMemory(); }
+	else if (rc != SSLM_OK) { result = raiseSslmError(rc, h); }
+	else { result = buildResults(h, withCurves != 0); }
+
+	sslm_destroy(h);
+	return result;
+}
+
+
+// C-contiguous buffer of float64 ('d') or int32 ('i') values.
+// The length has to be a multiple of n.
+static bool getVector(PyObject *obj, const char *name, char format, Py_ssize_t n, Py_buffer *view)
+{
+	if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) { return false; }
+
+	ValueKind kind = valueKind(view->format);
+	bool ok = (format == 'd') ? (kind == KIND_FLOAT && view->itemsize == 8) : (kind == KIND_SIGNED && view->itemsize == 4);
+	Py_ssize_t len = view->len / view->itemsize;
+	if (!ok || len == 0 || len % n != 0)
+	{
+		PyErr_Format(PyExc_ValueError, "%s must be %s, a multiple of %zd values", name,
+			(format == 'd') ? "float64" : "int32", n);
+		PyBuffer_Release(view);
+		return false;
+	}
+	return true;
+}
+
+
+/*
+** lwli(is_source, area_perc, area, weights, threads=0)
+*/
+static PyObject *sslm_lwli_py(PyObject *, PyObject *args, PyObject *kwds)
+{
+	static const char *kwlist[] = { "is_source", "area_perc", "area", "weights", "threads", NULL };
+	static const char *names[4] = { "is_source", "area_perc", "area", "weights" };
+	PyObject *objs[4];
+	int nthreads = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOO|i", (char **)kwlist,
+		&objs[0], &objs[1], &objs[2], &objs[3], &nthreads))
+	{
+		return NULL;
+	}
+
+	// The number of land uses comes from is_source
+	Py_buffer views[4];
+	Py_ssize_t nlus = 1;
+	int nviews = 0;
+	for (; nviews < 4; nviews++)
+	{
+		if (!getVector(objs[nviews], names[nviews], (nviews == 0) ? 'i' : 'd', nlus, &views[nviews])) { break; }
+		if (nviews == 0) { nlus = views[0].len / views[0].itemsize; }
+	}
+	if (nviews == 4 && (views[1].len / 8 != nlus || views[2].len / 8 != nlus*3))
+	{
+		PyErr_SetString(PyExc_ValueError, "area_perc and area must have 1 and 3 values per land use");
+	}
+	if (PyErr_Occurred())
+	{
+		for (int v = 0; v < nviews; v++) { PyBuffer_Release(&views[v]); }
+		return NULL;
+	}
+	long long nsets = (long long)(views[3].len / 8 / nlus);
+
+	sslm_handle h = sslm_create();
+	PyObject *out = (h != NULL) ? PyBytes_FromStringAndSize(NULL, (Py_ssize_t)(nsets*4*sizeof(double))) : NULL;
+	if (out == NULL)
+	{
+		for (int v = 0; v < 4; v++) { PyBuffer_Release(&views[v]); }
+		if (h != NULL) { sslm_destroy(h); }
+		return PyErr_NoMemory();
+	}
+
+	int rc;
+	Py_BEGIN_ALLOW_THREADS
+	rc = sslm_set_threads(h, nthreads);
+	if (rc == SSLM_OK)
+	{
+		rc = sslm_lwli_from_areas(h, (int)nlus, (const int *)views[0].buf, (const double *)views[1].buf,
+			(const double *)views[2].buf, (const double *)views[3].buf, nsets, (double *)PyBytes_AS_STRING(out));
+	}
+	Py_END_ALLOW_THREADS
+
+	for (int v = 0; v < 4; v++) { PyBuffer_Release(&views[v]); }
+	if (rc != SSLM_OK)
+	{
+		Py_DECREF(out);
+		out = raiseSslmError(rc, h);
+	}
+	sslm_destroy(h);
+	return out;
+}
+
+
+/*
+** cdf(values, percents, ncells, x, threads=0)
+** quantile(values, percents, ncells, q, threads=0)
+*/
+static PyObject *curveQuery(PyObject *args, PyObject *kwds, bool inverse)
+{
+	static const char *kwlist[] = { "values", "percents", "ncells", "x", "threads", NULL };
+	static const char *names[3] = { "values", "percents", "x" };
+	PyObject *objs[3];
+	long long ncells;
+	int nthreads = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOLO|i", (char **)kwlist,
+		&objs[0], &objs[1], &ncells, &objs[2], &nthreads))
+	{
+		return NULL;
+	}
+
+	Py_buffer views[3];
+	int nviews = 0;
+	for (; nviews < 3; nviews++)
+	{
+		if (!getVector(objs[nviews], names[nviews], 'd', 1, &views[nviews])) { break; }
+	}
+	if (nviews == 3 && views[0].len != views[1].len)
+	{
+		PyErr_SetString(PyExc_ValueError, "values and percents must have the same length");
+	}
+	if (PyErr_Occurred())
+	{
+		for (int v = 0; v < nviews; v++) { PyBuffer_Release(&views[v]); }
+		return NULL;
+	}
+	long long npoints = (long long)(views[0].len / 8);
+	long long n = (long long)(views[2].len / 8);
+
+	sslm_handle h = sslm_create();
+	PyObject *out = (h != NULL) ? PyBytes_FromStringAndSize(NULL, (Py_ssize_t)(n*sizeof(double))) : NULL;
+	if (out == NULL)
+	{
+		for (int v = 0; v < 3; v++) { PyBuffer_Release(&views[v]); }
+		if (h != NULL) { sslm_destroy(h); }
+		return PyErr_NoMemory();
+	}
+
+	int rc;
+	Py_BEGIN_ALLOW_THREADS
+	rc = sslm_set_threads(h, nthreads);
+	if (rc == SSLM_OK)
+	{
+		const double *values = (const double *)views[0].buf;
+		const double *percents = (const double *)views[1].buf;
+		const double *x = (const double *)views[2].buf;
+		double *answers = (double *)PyBytes_AS_STRING(out);
+		rc = inverse ?
+			sslm_quantile_from_curve(h, values, percents, npoints, ncells, x, n, answers) :
+			sslm_cdf_from_curve(h, values, percents, npoints, ncells, x, n, answers);
+	}
+	Py_END_ALLOW_THREADS
+
+	for (int v = 0; v < 3; v++) { PyBuffer_Release(&views[v]); }
+	if (rc != SSLM_OK)
+	{
+		Py_DECREF(out);
+		out = raiseSslmError(rc, h);
+	}
+	sslm_destroy(h);
+	return out;
+}
+
+
+static PyObject *sslm_cdf_py(PyObject *, PyObject *args, PyObject *kwds)
+{
+	return curveQuery(args, kwds, false);
+}
+
+
+static PyObject *sslm_quantile_py(PyObject *, PyObject *args, PyObject *kwds)
+{
+	return curveQuery(args, kwds, true);
+}
+
+
+static PyMethodDef sslmMethods[] =
+{
+	{ "compute", (PyCFunction)(void(*)(void))sslm_compute_py, METH_VARARGS | METH_KEYWORDS,
+	  "compute(srclus, sinklus, lu, elev, dist, slope, threads=0, curves=True, quantum=None)\n\n"
+	  "Lorenz curve areas of the source and sink land uses of 2D grids.\n"
+	  "Returns a dict of bytes objects, see sslm.py." },
+	{ "lwli", (PyCFunction)(void(*)(void))sslm_lwli_py, METH_VARARGS | METH_KEYWORDS,
+	  "lwli(is_source, area_perc, area, weights, threads=0)\n\n"
+	  "Location weighted landscape index of rows of weights, 4 float64\n"
+	  "values per row (elevation, distance, slope, combined) as bytes." },
+	{ "cdf", (PyCFunction)(void(*)(void))sslm_cdf_py, METH_VARARGS | METH_KEYWORDS,
+	  "cdf(values, percents, ncells, x, threads=0)\n\n"
+	  "Share of the ncells cells of a curve with a value <= each x,\n"
+	  "float64 as bytes." },
+	{ "quantile", (PyCFunction)(void(*)(void))sslm_quantile_py, METH_VARARGS | METH_KEYWORDS,
+	  "quantile(values, percents, ncells, q, threads=0)\n\n"
+	  "Smallest value of a curve whose share of the cells is >= each\n"
+	  "q (0..1), float64 as bytes." },
+	{ NULL, NULL, 0, NULL }
+};
+
+
+static struct PyModuleDef sslmModule =
+{
+	PyModuleDef_HEAD_INIT, "_sslm", "Source sink landscape model engine.", -1, sslmMethods
+};
+
+
+PyMODINIT_FUNC PyInit__sslm(void)
+{
+	PyObject *m = PyModule_Create(&sslmModule);
+	if (m == NULL) { return NULL; }
+	PyModule_AddIntConstant(m, "API_VERSION", sslm_api_version());
+	return m;
+}
@@ -1,1311 +1,1571 @@
-﻿/*
--------------------------------------------------------------------------------------------------------------
-**
-** Location weighted landscape index calculation program.
-**
-** This class was developed to do the calculation of landscape index.
-** The inputs include :
-** 1. land use map(should be reclassifed to include intended sink
-** and source classes).
-** 2. dem : defines the elevation
-** 3. slope : calculated from the DEM
-** 4. distance : calculated with the path distance tool with
-** dem as surface factor in ArcGIS.
-**
-** Qingyu Feng
-** qingyufeng@outlook.com
-** Department of Agricultural & Biological Engineering
-** Purdue University
-** West Lafayette, Indiana
-**
-** Jan 2018
-**
-**
--------------------------------------------------------------------------------------------------------------
-*/
-
-
-// ------------------------------------------------------------------------------------------------------------
-// Including standard and customized header files:
-#include <stdio.h>
-#include <cstdlib>
-#include <string.h>
-#include <vector>
-#include <iostream>
-#include <sstream>
-#include <cfloat>
-#include <algorithm>
-
-
-using namespace std;
-
-#include "app.h"
-#include "message.h"
-
-
-void fatalError(const char *msg)
-{
-	char longMsg[1024];
-
-	sprintf_s(longMsg, 1024, "The TOPAZ to WEPP translator program has encountered an error\nand can not continue. The error is:\n\n%s", msg);
-
-	fprintf(stdout, "%s %s\n", longMsg, "Error calculating LWLI");
-	_exit(-1);
-
-}
-
-
-/*
-** App()
-** Constructor for the main App object that drives everything.
-*/
-App::App()
-{
-	rows = cols = 0;
-	ascelev = NULL;
-	ascslope = NULL;
-	ascdist = NULL;
-	asclu = NULL;
-	srclunums = NULL;
-	sinklunums = NULL;
-	allsrcsinklus = NULL;
-	rawludata = NULL;
-	perludata = NULL;
-	lwlis = NULL;
-
-}
-
-
-/*
-** ~App()
-**
-** Destrcutor for the main application object. Main task is to free the memory.
-*/
-
-App::~App()
-{
-	if (ascelev) delete ascelev;
-	if (ascslope) delete ascslope;
-	if (ascdist) delete (ascdist);
-	if (asclu) delete (asclu);
-	if (srclunums) delete (srclunums);
-	if (sinklunums) delete (sinklunums);
-	if (allsrcsinklus) delete (allsrcsinklus);
-	if (rawludata) delete (rawludata);
-	if (perludata) delete (perludata);
-	if (lwlis) delete (lwlis);
-
-}
-
-
-/*
-** cleanMemory()
-**
-** Free all the dynamically allocated memory that was used.
-**
-*/
-void App::cleanMemory()
-{
-	if (ascelev) delete ascelev;
-	if (ascslope) delete ascslope;
-	if (ascdist) delete (ascdist);
-	if (asclu) delete (asclu);
-	if (srclunums) delete (srclunums);
-	if (sinklunums) delete (sinklunums);
-	if (allsrcsinklus) delete (allsrcsinklus);
-	if (rawludata) delete (rawludata);
-	if (perludata) delete (perludata);
-	if (lwlis) delete (lwlis);
-
-	ascelev = NULL;
-	ascslope = NULL;
-	ascdist = NULL;
-	asclu = NULL;
-	srclunums = NULL;
-	sinklunums = NULL;
-	allsrcsinklus = NULL;
-	rawludata = NULL;
-	perludata = NULL;
-	lwlis = NULL;
-
-}
-
-
-int *App::readTextInttoArray(const char * file)
-{
-	FILE *fp = fopen(file, "r");
-	char buf[512];
-	int *data;
-
-	if (fp)
-	{
-		// Define the variable after the file is opened successfully.
-		data = new int[MAX_LUIDS];
-		if (data == NULL)
-		{
-			fatalError("Out of memory in readTextInttoArray()");
-		}
-		memset(data, 0, sizeof(int)*MAX_LUIDS);
-		int val;
-		int k = 0;
-
-		while (fgets(buf, 256, fp) != NULL)
-		{
-			sscanf(buf, "%d", &val);
-			data[k] = val;
-			++k;
-
-		}
-		fclose(fp);
-	}
-	else {
-		perror("Error opening file");
-	}
-
-	return data;
-}
-
-
-/*
-** combinesrcsinklus()
-**
-** combines sink and source array into one array.
-**
-*/
-int *App::combineSrcSinklus()
-{
-	// Declaring variables
-	int *data;
-
-	// Start reading datalines
-	// initiate the container data	
-	data = new int[MAX_LUIDS];
-	if (data == NULL)
-	{
-		fatalError("Out of memory in readArcviewInt()");
-	}
-
-	memset(data, 0, sizeof(int)*MAX_LUIDS);
-
-	// Start geting the data and put them into the data
-	int index = 0;
-
-	for (int i = 0; i < MAX_LUIDS; i++)
-	{
-		if (srclunums[i] == 0)
-		{
-			break;
-		}
-		else
-		{
-			data[index] = srclunums[i];
-			index++;
-		}
-	}
-
-	for (int j = 0; j < MAX_LUIDS; j++)
-	{
-		if (sinklunums[j] == 0)
-		{
-			break;
-		}
-		else
-		{
-			data[index] = sinklunums[j];
-			index++;
-		}
-	}
-	return data;
-}
-
-
-
-
-
-/*
-** readArcviewInt()
-**
-** Reads an arcview grid file and stores it into an integer array.
-**
-*/
-int *App::readArcviewInt(const char *file)
-{
-	// Declaring variables
-	FILE *fp = fopen(file, "r");
-	char buf2[512];
-	char *buf;
-	char ebuf[256];
-	int i;
-	int *data;
-
-	// Initiate variables
-	buf = NULL;
-	rows = cols = 0;
-
-	sprintf(buf2, "Reading grid: %s ...\n", file);
-	DisplayMessage(buf2);
-
-	if (fp)
-	{
-		// reading the first 6 lines
-		for (i = 0; i < 6; i++)
-		{
-			fgets(buf2, 256, fp);
-			if (!strncmp(buf2, "nrows", 5))
-			{
-				// sscanf: read data from s and stores
-				// them according to parameter formats
-				// into the locations given by the additional
-				// arguments: here &rows.
-				sscanf(&buf2[6], "%d", &rows);
-			}
-			else if (!strncmp(buf2, "ncols", 5))
-			{
-				sscanf(&buf2[6], "%d", &cols);
-			}
-			else if (!strncmp(buf2, "cellsize", 8))
-			{
-				sscanf(&buf2[9], "%f", &cellsize);
-			}
-			else if (!strncmp(buf2, "NODATA_value", 6))
-			{
-				sscanf(&buf2[13], "%d", &noDataLu);
-			}
-		}
-
-		// Start reading datalines
-		// initiate the container data	
-		data = new int[rows*cols];
-		if (data == NULL)
-		{
-			fatalError("Out of memory in readArcviewInt()");
-		}
-		buf = new char[MAX_COL_BYTES + 1];
-		if (buf == NULL)
-		{
-			fatalError("Out of memory in readArcviewInt()");
-		}
-		// memset(void *ptr, int value, std::size_t num);
-		// sets the first num bytes of the block of memory pointed
-		// by prt to the specified value
-		// sizeof (int): return size in bytes of the object representation of type;
-		// sizeof expression: return size in bytes of the object
-		// representation of the type that would be returned by
-		// expression. 
-		//memset(data, 0, sizeof(int)*rows*cols);
-		// data is a one dimension array. The total number of elements
-		// is rows*cols
-		memset(data, 0, sizeof(int)*rows*cols);
-
-		// Start geting the data and put them into the data
-		int k;
-		int index = 0;
-		int val;
-		bool rowHasData;
-
-		for (i = 0; i<rows; i++)
-		{
-			// i is the row number, each row has cols number of columns.
-			index = i*cols;
-			if (fgets(buf, MAX_COL_BYTES, fp) != NULL)
-			{
-				if ((i == 0) && (strlen(buf) >= MAX_COL_BYTES))
-				{
-					delete(buf);
-					fatalError("Line too long from grid file, max is 50000 bytes");
-				}
-
-				// At this time, all validRows value is still all 1s.
-				if (validRows[i])
-				{
-					rowHasData = false;
-					k = 0;
-					while (buf[k] == ' ') { k++; }
-					// Start working with columns.
-					// Here later, the columns might be masked by the 
-					// subnoinfield.
-					for (int j = 0; j < cols; j++)
-					{
-						sscanf(&buf[k], "%d", &val);
-						// Originally, the program uses the value of bounds
-						// from the outputs of Topaz. Here, we do not have a bounds
-						// output from TauDEM, but we have an array of subarea numbers
-						// to help determine whether the row is valid row.
-						for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-						{
-							// The value of subarea no will be three situations:
-							// 1. no data value
-							// 2. subarea no in the no data value
-							// 3. subarea no not in the data value
-							// If it is in field, assign, Else, other values are all 0s.
-							// Data is a pointer of int. Originally, it is all 0s. 
-							// now , if we have data, value is assigned to here.
-							// subarea no in subnoifld, if yes, assign the values.
-							if (allsrcsinklus[luidx] == 0)
-							{
-								break;
-							}
-							else if (allsrcsinklus[luidx] == val)
-							{
-								data[index] = val;
-								rowHasData = true;
-							}
-						}
-						//printf("Reading int..%d..%d..%d..%d..\n", i, j, index, data[index]);
-						while ((buf[k] != ' ') && (buf[k] != '\n')) { k++; }
-						while (buf[k] == ' ') { k++; }
-						index++;
-					}
-					if (rowHasData == false)
-					{
-						validRows[i] = 0;
-					}
-				}
-			}
-		}
-		delete(buf);
-		fclose(fp);
-	}
-	else
-	{
-		sprintf(ebuf, "Can't find %s\n", file);
-		fatalError(ebuf);
-	}
-
-	sprintf(buf2, "Done Reading Grid: %s...\n", file);
-	DisplayMessage(buf2);
-
-	return data;
-
-}
-
-
-
-/*
-** readArcviewFloat()
-**
-** Reads and ArcView grid file of float values and stores them into a floating
-** point array.
-**
-*/
-float *App::readArcviewFloat(const char *file)
-{
-	// Declaring variables
-	FILE *fp = fopen(file, "r");
-	char buf2[512];
-	char *buf;
-	char ebuf[256];
-	int i;
-	float *data;
-
-	// Initiate variables
-	buf = NULL;
-	rows = cols = 0;
-	//int noData;
-
-	sprintf(buf2, "Reading grid: %s ...\n", file);
-	DisplayMessage(buf2);
-
-	if (fp)
-	{
-		// reading the first 6 lines
-		for (i = 0; i < 6; i++)
-		{
-			fgets(buf2, 256, fp);
-			if (!strncmp(buf2, "nrows", 5))
-			{
-				// sscanf: read data from s and stores
-				// them according to parameter formats
-				// into the locations given by the additional
-				// arguments: here &rows.
-				sscanf(&buf2[6], "%d", &rows);
-			}
-			else if (!strncmp(buf2, "ncols", 5))
-			{
-				sscanf(&buf2[6], "%d", &cols);
-			}
-			else if (!strncmp(buf2, "cellsize", 8))
-			{
-				sscanf(&buf2[9], "%f", &cellsize);
-			}
-			else if (!strncmp(buf2, "NODATA_value", 6))
-			{
-				sscanf(&buf2[13], "%d", &noData);
-			}
-		}
-
-		// Start reading datalines
-		// initiate the container data	
-		data = new float[rows*cols];
-		if (data == NULL)
-		{
-			fatalError("Out of memory in readArcviewFloat()");
-		}
-		buf = new char[MAX_COL_BYTES + 1];
-		if (buf == NULL)
-		{
-			fatalError("Out of memory in readArcviewFloat()");
-		}
-		// memset(void *ptr, int value, std::size_t num);
-		// sets the first num bytes of the block of memory pointed
-		// by prt to the specified value
-		// sizeof (int): return size in bytes of the object representation of type;
-		// sizeof expression: return size in bytes of the object
-		// representation of the type that would be returned by
-		// expression. 
-		//memset(data, 0, sizeof(int)*rows*cols);
-		// data is a one dimension array. The total number of elements
-		// is rows*cols
-		memset(data, 0, sizeof(float)*rows*cols);
-		// Start geting the data and put them into the data
-		int k;
-		int index = 0;
-		float val;
-
-		for (i = 0; i<rows; i++)
-		{
-			// i is the row number, each row has cols number of columns.
-			index = i*cols;
-			if (fgets(buf, MAX_COL_BYTES, fp) != NULL)
-			{
-				if ((i == 0) && (strlen(buf) >= MAX_COL_BYTES))
-				{
-					delete(buf);
-					fatalError("Line too long from grid file, max is 50000 bytes");
-				}
-				// At this time, all validRows value is still all 1s.
-				if (validRows[i])
-				{
-					k = 0;
-					while (buf[k] == ' ') { k++; }
-					// Start working with columns.
-					// Here later, the columns might be masked by the 
-					// subnoinfield.
-					for (int j = 0; j<cols; j++)
-					{
-
-						sscanf(&buf[k], "%f", &val);
-						// Originally, the program uses the value of bounds
-						// from the outputs of Topaz. Here, we do not have a bounds
-						// output from TauDEM. For the last program, we got the 
-						// array of subwta. If subwta not in the list, 
-						// the value is assigned to 0. We will do the 
-						// same thing here. 
-						if (asclu[index] != 0)
-						{
-							data[index] = val;
-						}
-						// Skipping the spaces
-						while ((buf[k] != ' ') && (buf[k] != '\n')) { k++; }
-						while (buf[k] == ' ') { k++; }
-						index++;
-					}
-				}
-			}
-		}
-
-		delete(buf);
-		fclose(fp);
-	}
-	else
-	{
-		sprintf(ebuf, "Can't find %s\n", file);
-		fatalError(ebuf);
-	}
-
-	sprintf(buf2, "Done Reading Grid: %s...\n", file);
-	DisplayMessage(buf2);
-
-	return data;
-
-}
-
-/*
-** asc2ludata()
-**
-** This function put the data read from the ASC files into
-** the corresponding array of land use data.
-**
-*/
-App::Ludata *App::asc2ludata()
-{
-	char buf2[512];
-	sprintf(buf2, "Putting ascii data into corresponding land use data arrays!!\n");
-	DisplayMessage(buf2);
-
-	//Ludataarray psinksrc;
-	Ludata *templudata = new Ludata;
-	
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		// Initialize the array
-		if (allsrcsinklus[luidx] == 0) { break; }
-		else
-		{
-			templudata->elevarray[luidx] = new double[rows*cols];
-			memset(templudata->elevarray[luidx], 0.0, sizeof(double)*rows*cols);
-			templudata->slopearray[luidx] = new double[rows*cols];
-			memset(templudata->slopearray[luidx], 0.0, sizeof(double)*rows*cols);
-			templudata->distarray[luidx] = new double[rows*cols];
-			memset(templudata->distarray[luidx], 0.0, sizeof(double)*rows*cols);
-		}
-
-		// Initialize the counter
-		templudata->ludtctrarray[luidx] = 0;
-		templudata->finaldistctr[luidx] = 0;
-		templudata->finalelevctr[luidx] = 0;
-		templudata->finalslpctr[luidx] = 0;
-
-		// Initialize the luno
-		templudata->luno = allsrcsinklus[luidx];
-	}
-
-
-	for (int index = 0; index<rows*cols; index++)
-	{
-		for (int luidx=0; luidx<MAX_LUIDS;luidx++)
-		{ 
-			if (allsrcsinklus[luidx] == 0) { break; }
-			else if (asclu[index] == allsrcsinklus[luidx])
-			{
-				templudata->elevarray[luidx][templudata->ludtctrarray[luidx]] = ascelev[index];
-				templudata->slopearray[luidx][templudata->ludtctrarray[luidx]] = ascslope[index];
-				templudata->distarray[luidx][templudata->ludtctrarray[luidx]] = ascdist[index];
-				templudata->ludtctrarray[luidx]++;
-			}
-			templudata->finaldistctr[luidx] = templudata->ludtctrarray[luidx];
-			templudata->finalelevctr[luidx] = templudata->ludtctrarray[luidx];
-			templudata->finalslpctr[luidx] = templudata->ludtctrarray[luidx];
-		}
-	}
-
-	sprintf(buf2, "Finished putting ascii data into corresponding land use data arrays!!\n");
-	DisplayMessage(buf2);
-
-
-	return templudata;
-}
-
-
-
-/*
-** sortludata()
-**
-** This function sort the ludatas.
-**
-*/
-void App::sortludata()
-{
-	char buf2[512];
-	sprintf(buf2, "Sorting distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		if (allsrcsinklus[luidx] != 0)
-		{
-
-			// In the same loop, do the sorting:
-			// Sort method is working;
-			sort(rawludata->elevarray[luidx], 
-				rawludata->elevarray[luidx]+rawludata->ludtctrarray[luidx]);
-			sort(rawludata->slopearray[luidx],
-				rawludata->slopearray[luidx] + rawludata->ludtctrarray[luidx]);
-			sort(rawludata->distarray[luidx],
-				rawludata->distarray[luidx] + rawludata->ludtctrarray[luidx]);
-
-
-		}
-		else { break; }
-	}
-
-	sprintf(buf2, "Finished sorting distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-
-}
-
-
-/*
-** calperludata()
-**
-** This function calculate the percent of the ludatas.
-**
-*/
-App::Ludata *App::calperludata()
-{
-	char buf2[512];
-	sprintf(buf2, "Calculating percentage of distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-
-	//Ludataarray psinksrc;
-	Ludata *templudata = new Ludata;
-
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		// Initialize the array
-		if (allsrcsinklus[luidx] == 0) { break; }
-		else
-		{
-			// To reduce the memory use, here, we will use the total number
-			// of values
-			templudata->elevarray[luidx] = new double[rawludata->ludtctrarray[luidx]];
-			memset(templudata->elevarray[luidx], 0.0, sizeof(double)*rawludata->ludtctrarray[luidx]);
-			templudata->slopearray[luidx] = new double[rawludata->ludtctrarray[luidx]];
-			memset(templudata->slopearray[luidx], 0.0, sizeof(double)*rawludata->ludtctrarray[luidx]);
-			templudata->distarray[luidx] = new double[rawludata->ludtctrarray[luidx]];
-			memset(templudata->distarray[luidx], 0.0, sizeof(double)*rawludata->ludtctrarray[luidx]);
-		}
-
-		// Initialize the counter
-		templudata->ludtctrarray[luidx] = rawludata->ludtctrarray[luidx];
-		templudata->finaldistctr[luidx] = rawludata->ludtctrarray[luidx];
-		templudata->finalelevctr[luidx] = rawludata->ludtctrarray[luidx];
-		templudata->finalslpctr[luidx] = rawludata->ludtctrarray[luidx];
-
-		// Initialize the luno
-		templudata->luno = allsrcsinklus[luidx];
-	}
-
-	
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		if (allsrcsinklus[luidx] != 0)
-		{
-			for (int index = 0; index < rawludata->ludtctrarray[luidx]; index++)
-			{
-				templudata->slopearray[luidx][index] = (double)index * (double)100. / (double)rawludata->ludtctrarray[luidx];
-				templudata->distarray[luidx][index] = (double)index * (double)100. / (double)rawludata->ludtctrarray[luidx];
-				templudata->elevarray[luidx][index] = (double)index * (double)100. / (double)rawludata->ludtctrarray[luidx];
-			}
-		}
-		else { break; }
-	}
-
-	sprintf(buf2, "Finished calculating percentage of distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-	return templudata;
-}
-
-
-
-/*
-** removeDuplicates()
-**
-** This function remove duplicates in the array.
-** Two arrays are taking here, dataarray stands for the ordar array.
-** dataarray2 is for the percent, since the corresponding
-** percentage value of the data need to be removed when the 
-** value was removed.
-**
-*/
-void App::removeDuplicates()
-{
-
-	char buf2[512];
-	sprintf(buf2, "Removing duplicates in distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		if (allsrcsinklus[luidx] != 0)
-		{
-			for (int idx = 0; idx < rawludata->ludtctrarray[luidx]-1; idx++)
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-			{
-				if(rawludata->elevarray[luidx][idx] == rawludata->elevarray[luidx][idx+1])
-				{
-					rawludata->elevarray[luidx][idx] = 9999999999999999;
-					perludata->elevarray[luidx][idx] = 9999999999999999;
-					perludata->finalelevctr[luidx]--;
-				}
-
-				if (rawludata->distarray[luidx][idx] == rawludata->distarray[luidx][idx + 1])
-				{
-					rawludata->distarray[luidx][idx] = 9999999999999999;
-					perludata->distarray[luidx][idx] = 9999999999999999;
-					perludata->finaldistctr[luidx]--;
-				}
-
-				if (rawludata->slopearray[luidx][idx] == rawludata->slopearray[luidx][idx + 1])
-				{
-					rawludata->slopearray[luidx][idx] = 9999999999999999;
-					perludata->slopearray[luidx][idx] = 9999999999999999;
-					perludata->finalslpctr[luidx]--;
-				}
-
-			}
-			sort(rawludata->elevarray[luidx],
-				rawludata->elevarray[luidx] + rawludata->ludtctrarray[luidx]);
-			sort(rawludata->slopearray[luidx],
-				rawludata->slopearray[luidx] + rawludata->ludtctrarray[luidx]);
-			sort(rawludata->distarray[luidx],
-				rawludata->distarray[luidx] + rawludata->ludtctrarray[luidx]);
-
-			sort(perludata->elevarray[luidx],
-				perludata->elevarray[luidx] + perludata->ludtctrarray[luidx]);
-			sort(perludata->slopearray[luidx],
-				perludata->slopearray[luidx] + perludata->ludtctrarray[luidx]);
-			sort(perludata->distarray[luidx],
-				perludata->distarray[luidx] + perludata->ludtctrarray[luidx]);
-
-
-
-		}
-		else { break; }
-	}
-
-	sprintf(buf2, "Finished removing duplicates in distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-}
-
-
-
-/*
-** caltrapzarea()
-**
-** Calculates the area of a trapozoid shape.
-** Four inputs are required. In this application:
-** 1. the x axis value (elevation, distance or slope), 
-**    will be used as height of the shape.
-** 2. the y axis value (percentage calculated)
-**    will be used as the top (x) and bottom (x+1).
-*/
-double App::caltrapzarea(double olu1, double olu2, double perlu1, double perlu2)
-{
-	double traparea = (olu2 - olu1)*(perlu1 + perlu2) / (double)2;
-	return traparea;
-}
-
-
-
-
-/*
-** callwli()
-**
-** This function calculates the lorenz curve data, incluging the 
-** data points and the area under each curve.
-**
-*/
-App::Ludata *App::callwli()
-{
-
-	char buf2[512];
-	sprintf(buf2, "Calculating curve areas for distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-	
-	//Ludataarray;
-	// Here, the elevation array will only have one value for one 
-	// land use, which will be the lwli value. It will be accumulated
-	// during the loop.
-	Ludata *templudata = new Ludata;
-
-	
-
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		// Initialize the array
-		if (allsrcsinklus[luidx] == 0) { break; }
-		else
-		{
-			templudata->elevarray[luidx] = new double;
-			memset(templudata->elevarray[luidx], 0.0, sizeof(double) * 1);
-			templudata->slopearray[luidx] = new double;
-			memset(templudata->slopearray[luidx], 0.0, sizeof(double) * 1);
-			templudata->distarray[luidx] = new double;
-			memset(templudata->distarray[luidx], 0.0, sizeof(double) * 1);
-		}
-
-		// Initialize the counter
-		templudata->ludtctrarray[luidx] = 1;
-		templudata->finaldistctr[luidx] = templudata->ludtctrarray[luidx];
-		templudata->finalelevctr[luidx] = templudata->ludtctrarray[luidx];
-		templudata->finalslpctr[luidx] = templudata->ludtctrarray[luidx];
-
-		// Initialize the luno
-		templudata->luno = allsrcsinklus[luidx];
-	}
-
-
-	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-	{
-		if (allsrcsinklus[luidx] != 0)
-		{
-
-			// Here, we use the final counter from the perludata.
-			// This has been updated during the removal of duplicates.
-			for (int index = 0; index < perludata->finalelevctr[luidx]-1; index++)
-			{
-				// Here, we are looping through each value in the array 
-				// (elevation, distance, slope) for each land use.
-				// We need a function to calculate the area for each step.
-				// check the final value numbers
-				templudata->elevarray[luidx][0] = templudata->elevarray[luidx][0]+ caltrapzarea(
-									rawludata->elevarray[luidx][index],
-									rawludata->elevarray[luidx][index + 1],
-									perludata->elevarray[luidx][index],
-									perludata->elevarray[luidx][index + 1]);
-			}
-
-			for (int index = 0; index < perludata->finaldistctr[luidx] - 1; index++)
-			{
-				// Here, we are looping through each value in the array 
-				// (elevation, distance, slope) for each land use.
-				// We need a function to calculate the area for each step.
-				// check the final value numbers
-				templudata->distarray[luidx][0] += caltrapzarea(
-					rawludata->distarray[luidx][index],
-					rawludata->distarray[luidx][index + 1],
-					perludata->distarray[luidx][index],
-					perludata->distarray[luidx][index + 1]);
-			}
-
-			for (int index = 0; index < perludata->finalslpctr[luidx] - 1; index++)
-			{
-				// Here, we are looping through each value in the array 
-				// (elevation, distance, slope) for each land use.
-				// We need a function to calculate the area for each step.
-				// check the final value numbers
-				templudata->slopearray[luidx][0] += caltrapzarea(
-					rawludata->slopearray[luidx][index],
-					rawludata->slopearray[luidx][index + 1],
-					perludata->slopearray[luidx][index],
-					perludata->slopearray[luidx][index + 1]);
-
-			
-			}
-
-		}
-		else { break; }
-	}
-
-	sprintf(buf2, "Finished calculating curve areas for distance, elevation and slope data!!\n");
-	DisplayMessage(buf2);
-
-	return templudata;
-}
-
-
-/*
-** writeElevData()
-**
-** Write output files.
-**
-*/
-void App::writeElevData(const char *file)
-{
-	char buf2[512];
-	sprintf(buf2, "Writing output data for elevation!!\n");
-	DisplayMessage(buf2);
-
-	FILE *fp = fopen(file, "w");
-	
-	if (fp)
-	{
-		fprintf(fp, "No duplicated data for %s\n", file);
-		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-		{
-			if (allsrcsinklus[luidx] != 0)
-			{
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Value for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finalelevctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", rawludata->elevarray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", rawludata->elevarray[luidx][perludata->finalelevctr[luidx]-1]);
-
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Percentage for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finalelevctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", perludata->elevarray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", perludata->elevarray[luidx][perludata->finalelevctr[luidx]-1]);
-			}
-			else { break; }
-		}
-	}
-	
-	fclose(fp);
-
-	sprintf(buf2, "Finished writing output data for elevation!!\n");
-	DisplayMessage(buf2);
-
-}
-
-/*
-** writeDistData()
-**
-** Write output files.
-**
-*/
-void App::writeDistData(const char *file)
-{
-	char buf2[512];
-	sprintf(buf2, "Writing output data for Distance!!\n");
-	DisplayMessage(buf2);
-
-	FILE *fp = fopen(file, "w");
-
-	if (fp)
-	{
-		fprintf(fp, "No duplicated data for %s\n", file);
-		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-		{
-			if (allsrcsinklus[luidx] != 0)
-			{
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Value for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finaldistctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", rawludata->distarray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", rawludata->distarray[luidx][perludata->finaldistctr[luidx] - 2]);
-
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Percentage for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finaldistctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", perludata->distarray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", perludata->distarray[luidx][perludata->finaldistctr[luidx] - 2]);
-			}
-			else { break; }
-		}
-	}
-
-	fclose(fp);
-
-	sprintf(buf2, "Finished writing output data for Distance!!\n");
-	DisplayMessage(buf2);
-}
-
-
-/*
-** writeSlpData()
-**
-** Write output files.
-**
-*/
-void App::writeSlpData(const char *file)
-{
-	char buf2[512];
-	sprintf(buf2, "Writing output data for Slope!!\n");
-	DisplayMessage(buf2);
-
-
-	FILE *fp = fopen(file, "w");
-
-	if (fp)
-	{
-		fprintf(fp, "No duplicated data for %s\n", file);
-		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-		{
-			if (allsrcsinklus[luidx] != 0)
-			{
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Value for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finalslpctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", rawludata->slopearray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", rawludata->slopearray[luidx][perludata->finalslpctr[luidx] - 2]);
-
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Percentage for land use NO: %d\n", allsrcsinklus[luidx]);
-				for (int index = 0; index < perludata->finalslpctr[luidx] - 2; index++)
-				{
-					fprintf(fp, "%f,", perludata->slopearray[luidx][index]);
-				}
-				fprintf(fp, "%f\n", perludata->slopearray[luidx][perludata->finalslpctr[luidx] - 2]);
-			}
-			else { break; }
-		}
-	}
-
-	fclose(fp);
-
-	sprintf(buf2, "Finished writing output data for Slope!!\n");
-	DisplayMessage(buf2);
-
-}
-
-
-/*
-** writeLwliData()
-**
-** Write Lwli files.
-**
-*/
-void App::writeLwliData(const char *file)
-{
-	char buf2[512];
-	sprintf(buf2, "Writing output data for Lorenz curve!!\n");
-	DisplayMessage(buf2);
-
-	FILE *fp = fopen(file, "w");
-
-	if (fp)
-	{
-		fprintf(fp, "Area under lorenz curve\n");
-		fprintf(fp, "Landuse, Area_Elevation, Area_Distance, Area_Slope\n");
-		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-		{
-			if (allsrcsinklus[luidx] != 0)
-			{
-				// Here, we use the final counter from the perludata.
-				// This has been updated during the removal of duplicates.
-				fprintf(fp, "Landuse_%d, ", allsrcsinklus[luidx]);
-				fprintf(fp, "%f, %f, %f\n", 
-							lwlis->elevarray[luidx][0],
-							lwlis->distarray[luidx][0],
-							lwlis->slopearray[luidx][0]);
-
-			}
-			else { break; }
-		}
-	}
-
-	fclose(fp);
-
-	sprintf(buf2, "Finished writing output data for Lorenz curve!!\n");
-	DisplayMessage(buf2);
-}
-
-
-
-/*
-** writeOutputs()
-**
-** Write output files.
-**
-*/
-void App::writeOutputs()
-{
-	// Write elevation outputs
-	writeElevData("elev_dataperc.txt");
-	writeDistData("dist_dataperc.txt");
-	writeSlpData("slp_dataperc.txt");
-
-	writeLwliData("LurenzCurveAreas.txt");
-
-}
-
-
-
-
-/*
-** calAreaPercOverws()
-**
-** This function calculates the area of each land use
-** over the watershed area. This will be achieved by
-** count the total number of cells in the watershed
-** and those in each of the sink and source landuse.
-**
-*/
-
-void App::calAreaPercOverws()
-{
-	
-	// input for this function will be
-	// sinklunums
-	// srclunums
-	// asclu
-	// Three counters will be needed:
-	int *sinkluctr;
-	int *srcluctr;
-	int totalluctr;
-
-	totalluctr = 0;
-
-	// Initiate the counter values
-	sinkluctr = new int[MAX_LUIDS];
-	if (sinkluctr == NULL)
-	{
-		fatalError("Out of memory in calAreaPercOverws()");
-	}
-	memset(sinkluctr, 0, sizeof(int)*MAX_LUIDS);
-
-	srcluctr = new int[MAX_LUIDS];
-	if (srcluctr == NULL)
-	{
-		fatalError("Out of memory in calAreaPercOverws()");
-	}
-	memset(srcluctr, 0, sizeof(int)*MAX_LUIDS);
-
-	for (int index = 0; index<rows*cols; index++)
-	{
-		
-		if (asclu[index] != 0)
-		{
-			//printf("Reading int%d..\n", asclu[index]);
-			totalluctr = totalluctr + 1;
-		}
-
-		for (int i = 0; i < MAX_LUIDS; i++)
-		{
-			if (srclunums[i] == 0)
-			{
-				break;
-			}
-			else if (asclu[index] == srclunums[i])
-			{
-				srcluctr[i] = srcluctr[i] +1;
-			}
-		}
-
-		for (int j = 0; j < MAX_LUIDS; j++)
-		{
-			if (sinklunums[j] == 0)
-			{
-				break;
-			}
-			else if (asclu[index] == sinklunums[j])
-			{
-				sinkluctr[j] = sinkluctr[j] + 1;
-			}
-		}
-	}
-
-
-
-	// Then these will be written into a file
-	char buf2[512];
-	sprintf(buf2, "Writing percentage of area for each land use over watershed area!\n");
-	DisplayMessage(buf2);
-
-	FILE *fp = fopen("luareaperc.txt", "w");
-
-	if (fp)
-	{
-		fprintf(fp, "Percentage of area for each land use over watershed area\n");
-		fprintf(fp, "Landuse, Total_cells, Percentage\n");
-
-		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
-		{
-			if (sinklunums[luidx] == 0)
-			{
-				break;
-			}
-			else
-			{
-				fprintf(fp, "Sink_%d, %d, %f\n", 
-					sinklunums[luidx],
-					sinkluctr[luidx],
-					(double)sinkluctr[luidx]/(double)totalluctr);
-			}
-		}
-
-		for (int luidx2 = 0; luidx2 < MAX_LUIDS; luidx2++)
-		{
-			if (srclunums[luidx2] == 0)
-			{
-				break;
-			}
-			else
-			{
-				fprintf(fp, "Source_%d, %d, %f\n",
-					srclunums[luidx2],
-					srcluctr[luidx2],
-					(double)srcluctr[luidx2] / (double)totalluctr);
-			}
-		}
-	}
-
-	fclose(fp);
-
-	sprintf(buf2, "Finished writing percentage of area for each land use over watershed area!\n");
-	DisplayMessage(buf2);
-}
-
-
-
-
-
-/*
-** readGisAsciiFiles()
-**
-** Reads in the grid files that are required. 
-**
-*/
-void App::readGisAsciiFiles()
-{
-	for (int i = 0; i<MAX_ROWS; i++)
-	{
-		validRows[i] = 1;
-	}
-
-	// Get the land use numbers for sink and source
-	srclunums = readTextInttoArray("srclus.txt");
-	sinklunums = readTextInttoArray("sinklus.txt");
-
-	allsrcsinklus = combineSrcSinklus();
-
-	// Read in the ascii files
-	asclu = readArcviewInt("luws.txt");
-	ascelev = readArcviewFloat("demws.txt");
-	ascslope = readArcviewFloat("slopews.txt");
-	ascdist = readArcviewFloat("distws.txt");
-
-	// put the value into corresponding lu
-	rawludata = asc2ludata();
-}
-
-
-/*
-** SortCalpercent()
-**
-** Sort rawdata and calculate the percent of the datas.
-**
-*/
-void App::SortCalpercent()
-{
-
-	// Sort the data, will be stored in the orderludata
-	sortludata();
-
-	// Percent will be put into the perludata
-	perludata = calperludata();
-
-	// Remove duplicates 
-	removeDuplicates();
-}
-
-
-
-void App::CalLWLI()
-{
-	// After processing the data, the next step is to 
-	// calculate the Trapezoidal area of the data.
-	// The equation is:
-	// f(x) = delta x/2(y0 + 2*y1 + 2*y2 + ... + 2*yn-1 + yn)
-	// C++ does not have a function to make the graphs.
-	// I will use python to create the graphs.
-
-	// Required:
-	// Array of the data: orderludata, perludata.
-	lwlis = callwli();
-	
-	// After calculation, it is time to write the 
-	// output into text files.
-	// Outputs to be written:
-	// 1. elevation (lu1 orvalue, lu1 pertvalue, ...)
-	// 2. distance (lu1 orvalue, lu1 pertvalue, ...)
-	// 3. slope (lu1 orvalue, lu1 pertvalue, ...)
-	// 4. Final Lwli values
-	writeOutputs();
-
-}
-
-
+﻿/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+** This class was developed to do the calculation of landscape index.
+** The inputs include :
+** 1. land use map(should be reclassifed to include intended sink
+** and source classes).
+** 2. dem : defines the elevation
+** 3. slope : calculated from the DEM
+** 4. distance : calculated with the path distance tool with
+** dem as surface factor in ArcGIS.
+**
+** Qingyu Feng
+** qingyufeng@outlook.com
+** Department of Agricultural & Biological Engineering
+** Purdue University
+** West Lafayette, Indiana
+**
+** Jan 2018
+**
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <cfloat>
+#include <algorithm>
+
+
+using namespace std;
+
+#include "app.h"
+#include "message.h"
+#include "curvefile.h"
+#include "gridstream.h"
+#include "checkpoint.h"
+#include "engine.h"
+#include "trace.h"
+
+
+/*
+** App()
+** Constructor for the main App object that drives everything.
+*/
+App::App()
+{
+	rows = cols = 0;
+	for (int f = 0; f < MAX_FACTORS; f++) { ascfactors[f] = NULL; }
+	asclu = NULL;
+	srclunums = NULL;
+	sinklunums = NULL;
+	allsrcsinklus = NULL;
+	rawludata = NULL;
+	perludata = NULL;
+	lwlis = NULL;
+
+	srcluFile = "srclus.txt";
+	sinkluFile = "sinklus.txt";
+	luFile = "luws.txt";
+	demFile = "demws.txt";
+	slopeFile = "slopews.txt";
+	distFile = "distws.txt";
+	curveFormat = CURVES_TEXT;
+	simplify.mode = SIMPLIFY_NONE;
+	simplify.tolerance = 0.0;
+	simplify.npoints = 0;
+	curveText = defaultTextOptions();
+
+	wsmask = NULL;
+	wsrows = wscols = 0;
+
+	checkpointDir = NULL;
+	checkpoint = NULL;
+	resumedStage = CHECKPOINT_NONE;
+}
+
+
+/*
+** ~App()
+**
+** Destrcutor for the main application object. Main task is to free the memory.
+*/
+
+App::~App()
+{
+	// The checkpoint thread may still write the arrays
+	if (checkpoint) delete (checkpoint);
+	for (int f = 0; f < MAX_FACTORS; f++)
+	{
+		if (ascfactors[f]) delete (ascfactors[f]);
+	}
+	if (asclu) delete (asclu);
+	if (srclunums) delete (srclunums);
+	if (sinklunums) delete (sinklunums);
+	if (allsrcsinklus) delete (allsrcsinklus);
+	if (rawludata) delete (rawludata);
+	if (perludata) delete (perludata);
+	if (lwlis) delete (lwlis);
+
+}
+
+
+/*
+** cleanMemory()
+**
+** Free all the dynamically allocated memory that was used.
+**
+*/
+void App::cleanMemory()
+{
+	if (checkpoint) delete (checkpoint);
+	checkpoint = NULL;
+	for (int f = 0; f < MAX_FACTORS; f++)
+	{
+		if (ascfactors[f]) delete (ascfactors[f]);
+		ascfactors[f] = NULL;
+	}
+	if (asclu) delete (asclu);
+	if (srclunums) delete (srclunums);
+	if (sinklunums) delete (sinklunums);
+	if (allsrcsinklus) delete (allsrcsinklus);
+	if (rawludata) delete (rawludata);
+	if (perludata) delete (perludata);
+	if (lwlis) delete (lwlis);
+
+	asclu = NULL;
+	srclunums = NULL;
+	sinklunums = NULL;
+	allsrcsinklus = NULL;
+	rawludata = NULL;
+	perludata = NULL;
+	lwlis = NULL;
+
+}
+
+
+int *App::readTextInttoArray(const char * file)
+{
+	FILE *fp = fopen(file, "r");
+	char buf[512];
+	int *data;
+
+	if (fp)
+	{
+		// Define the variable after the file is opened successfully.
+		data = new int[MAX_LUIDS];
+		if (data == NULL)
+		{
+			fatalError("Out of memory in readTextInttoArray()");
+		}
+		memset(data, 0, sizeof(int)*MAX_LUIDS);
+		int val;
+		int k = 0;
+
+		while (fgets(buf, 256, fp) != NULL)
+		{
+			sscanf(buf, "%d", &val);
+			data[k] = val;
+			++k;
+
+		}
+		fclose(fp);
+	}
+	else {
+		perror("Error opening file");
+	}
+
+	return data;
+}
+
+
+/*
+** combinesrcsinklus()
+**
+** combines sink and source array into one array.
+**
+*/
+int *App::combineSrcSinklus()
+{
+	// Declaring variables
+	int *data;
+
+	// Start reading datalines
+	// initiate the container data	
+	data = new int[MAX_LUIDS];
+	if (data == NULL)
+	{
+		fatalError("Out of memory in readArcviewInt()");
+	}
+
+	memset(data, 0, sizeof(int)*MAX_LUIDS);
+
+	// Start geting the data and put them into the data
+	int index = 0;
+
+	for (int i = 0; i < MAX_LUIDS; i++)
+	{
+		if (srclunums[i] == 0)
+		{
+			break;
+		}
+		else
+		{
+			data[index] = srclunums[i];
+			index++;
+		}
+	}
+
+	for (int j = 0; j < MAX_LUIDS; j++)
+	{
+		if (sinklunums[j] == 0)
+		{
+			break;
+		}
+		else
+		{
+			data[index] = sinklunums[j];
+			index++;
+		}
+	}
+	return data;
+}
+
+
+
+
+
+/*
+** readArcviewInt()
+**
+** Reads an arcview grid file and stores it into an integer array.
+**
+*/
+int *App::readArcviewInt(const char *file)
+{
+	// Declaring variables
+	GridStream *fp = openGridStream(file);
+	char buf2[512];
+	char *buf;
+	char ebuf[256];
+	int i;
+	int *data;
+
+	// Initiate variables
+	buf = NULL;
+	rows = cols = 0;
+
+	sprintf(buf2, "Reading grid: %s ...\n", file);
+	DisplayMessage(buf2);
+
+	if (fp)
+	{
+		// reading the first 6 lines
+		for (i = 0; i < 6; i++)
+		{
+			gridGets(buf2, 256, fp);
+			if (!strncmp(buf2, "nrows", 5))
+			{
+				// sscanf: read data from s and stores
+				// them according to parameter formats
+				// into the locations given by the additional
+				// arguments: here &rows.
+				sscanf(&buf2[6], "%d", &rows);
+			}
+			else if (!strncmp(buf2, "ncols", 5))
+			{
+				sscanf(&buf2[6], "%d", &cols);
+			}
+			else if (!strncmp(buf2, "cellsize", 8))
+			{
+				sscanf(&buf2[9], "%f", &cellsize);
+			}
+			else if (!strncmp(buf2, "NODATA_value", 6))
+			{
+				sscanf(&buf2[13], "%d", &noDataLu);
+			}
+		}
+
+		if (wsmask && (rows != wsrows || cols != wscols))
+		{
+			sprintf(ebuf, "Size of %s does not match the DEM used for the watershed\n", file);
+			fatalError(ebuf);
+		}
+
+		// Start reading datalines
+		// initiate the container data	
+		data = new int[rows*cols];
+		if (data == NULL)
+		{
+			fatalError("Out of memory in readArcviewInt()");
+		}
+		buf = new char[MAX_COL_BYTES + 1];
+		if (buf == NULL)
+		{
+			fatalError("Out of memory in readArcviewInt()");
+		}
+		// memset(void *ptr, int value, std::size_t num);
+		// sets the first num bytes of the block of memory pointed
+		// by prt to the specified value
+		// sizeof (int): return size in bytes of the object representation of type;
+		// sizeof expression: return size in bytes of the object
+		// representation of the type that would be returned by
+		// expression. 
+		//memset(data, 0, sizeof(int)*rows*cols);
+		// data is a one dimension array. The total number of elements
+		// is rows*cols
+		memset(data, 0, sizeof(int)*rows*cols);
+
+		// Start geting the data and put them into the data
+		int k;
+		int index = 0;
+		int val;
+		bool rowHasData;
+
+		for (i = 0; i<rows; i++)
+		{
+			// i is the row number, each row has cols number of columns.
+			index = i*cols;
+			if (gridGets(buf, MAX_COL_BYTES, fp) != NULL)
+			{
+				if ((i == 0) && (strlen(buf) >= MAX_COL_BYTES))
+				{
+					delete(buf);
+					fatalError("Line too long from grid file, max is 50000 bytes");
+				}
+
+				// At this time, all validRows value is still all 1s.
+				if (validRows[i])
+				{
+					rowHasData = false;
+					k = 0;
+					while (buf[k] == ' ') { k++; }
+					// Start working with columns.
+					// Here later, the columns might be masked by the 
+					// subnoinfield.
+					for (int j = 0; j < cols; j++)
+					{
+						sscanf(&buf[k], "%d", &val);
+						// Originally, the program uses the value of bounds
+						// from the outputs of Topaz. Here, we do not have a bounds
+						// output from TauDEM, but we have an array of subarea numbers
+						// to help determine whether the row is valid row.
+						for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+						{
+							// The value of subarea no will be three situations:
+							// 1. no data value
+							// 2. subarea no in the no data value
+							// 3. subarea no not in the data value
+							// If it is in field, assign, Else, other values are all 0s.
+							// Data is a pointer of int. Originally, it is all 0s. 
+							// now , if we have data, value is assigned to here.
+							// subarea no in subnoifld, if yes, assign the values.
+							if (allsrcsinklus[luidx] == 0)
+							{
+								break;
+							}
+							else if (allsrcsinklus[luidx] == val &&
+								(wsmask == NULL || wsmask[index]))
+							{
+								data[index] = val;
+								rowHasData = true;
+							}
+						}
+						//printf("Reading int..%d..%d..%d..%d..\n", i, j, index, data[index]);
+						while ((buf[k] != ' ') && (buf[k] != '\n')) { k++; }
+						while (buf[k] == ' ') { k++; }
+						index++;
+					}
+					if (rowHasData == false)
+					{
+						validRows[i] = 0;
+					}
+				}
+			}
+		}
+		delete(buf);
+		closeGridStream(fp);
+	}
+	else
+	{
+		sprintf(ebuf, "Can't find %s\n", file);
+		fatalError(ebuf);
+	}
+
+	sprintf(buf2, "Done Reading Grid: %s...\n", file);
+	DisplayMessage(buf2);
+
+	return data;
+
+}
+
+
+
+/*
+** readArcviewFloat()
+**
+** Reads and ArcView grid file of float values and stores them into a floating
+** point array.
+**
+*/
+float *App::readArcviewFloat(const char *file)
+{
+	// Declaring variables
+	GridStream *fp = openGridStream(file);
+	char buf2[512];
+	char *buf;
+	char ebuf[256];
+	int i;
+	float *data;
+
+	// Initiate variables
+	buf = NULL;
+	rows = cols = 0;
+	//int noData;
+
+	sprintf(buf2, "Reading grid: %s ...\n", file);
+	DisplayMessage(buf2);
+
+	if (fp)
+	{
+		// reading the first 6 lines
+		for (i = 0; i < 6; i++)
+		{
+			gridGets(buf2, 256, fp);
+			if (!strncmp(buf2, "nrows", 5))
+			{
+				// sscanf: read data from s and stores
+				// them according to parameter formats
+				// into the locations given by the additional
+				// arguments: here &rows.
+				sscanf(&buf2[6], "%d", &rows);
+			}
+			else if (!strncmp(buf2, "ncols", 5))
+			{
+				sscanf(&buf2[6], "%d", &cols);
+			}
+			else if (!strncmp(buf2, "cellsize", 8))
+			{
+				sscanf(&buf2[9], "%f", &cellsize);
+			}
+			else if (!strncmp(buf2, "NODATA_value", 6))
+			{
+				sscanf(&buf2[13], "%d", &noData);
+			}
+		}
+
+		// Start reading datalines
+		// initiate the container data	
+		data = new float[rows*cols];
+		if (data == NULL)
+		{
+			fatalError("Out of memory in readArcviewFloat()");
+		}
+		buf = new char[MAX_COL_BYTES + 1];
+		if (buf == NULL)
+		{
+			fatalError("Out of memory in readArcviewFloat()");
+		}
+		// memset(void *ptr, int value, std::size_t num);
+		// sets the first num bytes of the block of memory pointed
+		// by prt to the specified value
+		// sizeof (int): return size in bytes of the object representation of type;
+		// sizeof expression: return size in bytes of the object
+		// representation of the type that would be returned by
+		// expression. 
+		//memset(data, 0, sizeof(int)*rows*cols);
+		// data is a one dimension array. The total number of elements
+		// is rows*cols
+		memset(data, 0, sizeof(float)*rows*cols);
+		// Start geting the data and put them into the data
+		int k;
+		int index = 0;
+		float val;
+
+		for (i = 0; i<rows; i++)
+		{
+			// i is the row number, each row has cols number of columns.
+			index = i*cols;
+			if (gridGets(buf, MAX_COL_BYTES, fp) != NULL)
+			{
+				if ((i == 0) && (strlen(buf) >= MAX_COL_BYTES))
+				{
+					delete(buf);
+					fatalError("Line too long from grid file, max is 50000 bytes");
+				}
+				// At this time, all validRows value is still all 1s.
+				if (validRows[i])
+				{
+					k = 0;
+					while (buf[k] == ' ') { k++; }
+					// Start working with columns.
+					// Here later, the columns might be masked by the 
+					// subnoinfield.
+					for (int j = 0; j<cols; j++)
+					{
+
+						sscanf(&buf[k], "%f", &val);
+						// Originally, the program uses the value of bounds
+						// from the outputs of Topaz. Here, we do not have a bounds
+						// output from TauDEM. For the last program, we got the 
+						// array of subwta. If subwta not in the list, 
+						// the value is assigned to 0. We will do the 
+						// same thing here. 
+						if (asclu[index] != 0)
+						{
+							data[index] = val;
+						}
+						// Skipping the spaces
+						while ((buf[k] != ' ') && (buf[k] != '\n')) { k++; }
+						while (buf[k] == ' ') { k++; }
+						index++;
+					}
+				}
+			}
+		}
+
+		delete(buf);
+		closeGridStream(fp);
+	}
+	else
+	{
+		sprintf(ebuf, "Can't find %s\n", file);
+		fatalError(ebuf);
+	}
+
+	sprintf(buf2, "Done Reading Grid: %s...\n", file);
+	DisplayMessage(buf2);
+
+	return data;
+
+}
+
+/*
+** asc2ludata()
+**
+** This function put the data read from the ASC files into
+** the corresponding array of land use data.
+**
+*/
+App::Ludata *App::asc2ludata()
+{
+	char buf2[512];
+	sprintf(buf2, "Putting ascii data into corresponding land use data arrays!!\n");
+	DisplayMessage(buf2);
+
+	//Ludataarray psinksrc;
+	Ludata *templudata = new Ludata;
+	int nfactors = getNumFactors();
+	
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		// Initialize the array
+		if (allsrcsinklus[luidx] == 0) { break; }
+		else
+		{
+			for (int f = 0; f < nfactors; f++)
+			{
+				templudata->factorarray[f][luidx] = new double[rows*cols];
+				memset(templudata->factorarray[f][luidx], 0.0, sizeof(double)*rows*cols);
+			}
+		}
+
+		// Initialize the counter
+		templudata->ludtctrarray[luidx] = 0;
+		for (int f = 0; f < nfactors; f++) { templudata->finalctr[f][luidx] = 0; }
+
+		// Initialize the luno
+		templudata->luno = allsrcsinklus[luidx];
+	}
+
+
+	// All the factors of a cell are put into place in the same
+	// pass over the land use grid
+	for (int index = 0; index<rows*cols; index++)
+	{
+		for (int luidx=0; luidx<MAX_LUIDS;luidx++)
+		{ 
+			if (allsrcsinklus[luidx] == 0) { break; }
+			else if (asclu[index] == allsrcsinklus[luidx])
+			{
+				for (int f = 0; f < nfactors; f++)
+				{
+					templudata->factorarray[f][luidx][templudata->ludtctrarray[luidx]] = ascfactors[f][index];
+				}
+				templudata->ludtctrarray[luidx]++;
+			}
+		}
+	}
+	for (int luidx = 0; luidx < MAX_LUIDS && allsrcsinklus[luidx] != 0; luidx++)
+	{
+		for (int f = 0; f < nfactors; f++) { templudata->finalctr[f][luidx] = templudata->ludtctrarray[luidx]; }
+	}
+
+	sprintf(buf2, "Finished putting ascii data into corresponding land use data arrays!!\n");
+	DisplayMessage(buf2);
+
+
+	return templudata;
+}
+
+
+
+/*
+** sortludata()
+**
+** This function sort the ludatas.
+**
+*/
+void App::sortludata()
+{
+	char buf2[512];
+	sprintf(buf2, "Sorting distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		if (allsrcsinklus[luidx] != 0)
+		{
+			TraceSpan span("app", "sort");
+			span.arg("lu", allsrcsinklus[luidx]);
+			span.arg("values", rawludata->ludtctrarray[luidx]);
+
+			// The checkpoint of the scatter may still be writing it
+			if (checkpoint) { checkpoint->waitWritten(luidx); }
+
+			// In the same loop, do the sorting:
+			// Sort method is working;
+			for (int f = 0; f < getNumFactors(); f++)
+			{
+				sort(rawludata->factorarray[f][luidx],
+					rawludata->factorarray[f][luidx] + rawludata->ludtctrarray[luidx]);
+			}
+
+
+		}
+		else { break; }
+	}
+
+	sprintf(buf2, "Finished sorting distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+
+}
+
+
+/*
+** calperludata()
+**
+** This function calculate the percent of the ludatas.
+**
+*/
+App::Ludata *App::calperludata()
+{
+	char buf2[512];
+	sprintf(buf2, "Calculating percentage of distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+
+	//Ludataarray psinksrc;
+	Ludata *templudata = new Ludata;
+	int nfactors = getNumFactors();
+
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		// Initialize the array
+		if (allsrcsinklus[luidx] == 0) { break; }
+		else
+		{
+			// To reduce the memory use, here, we will use the total number
+			// of values
+			for (int f = 0; f < nfactors; f++)
+			{
+				templudata->factorarray[f][luidx] = new double[rawludata->ludtctrarray[luidx]];
+				memset(templudata->factorarray[f][luidx], 0.0, sizeof(double)*rawludata->ludtctrarray[luidx]);
+			}
+		}
+
+		// Initialize the counter
+		templudata->ludtctrarray[luidx] = rawludata->ludtctrarray[luidx];
+		for (int f = 0; f < nfactors; f++) { templudata->finalctr[f][luidx] = rawludata->ludtctrarray[luidx]; }
+
+		// Initialize the luno
+		templudata->luno = allsrcsinklus[luidx];
+	}
+
+	
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		if (allsrcsinklus[luidx] != 0)
+		{
+			for (int index = 0; index < rawludata->ludtctrarray[luidx]; index++)
+			{
+				double percent = (double)index * (double)100. / (double)rawludata->ludtctrarray[luidx];
+				for (int f = 0; f < nfactors; f++) { templudata->factorarray[f][luidx][index] = percent; }
+			}
+		}
+		else { break; }
+	}
+
+	sprintf(buf2, "Finished calculating percentage of distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+	return templudata;
+}
+
+
+
+/*
+** removeDuplicates()
+**
+** This function remove duplicates in the array.
+** Two arrays are taking here, dataarray stands for the ordar array.
+** dataarray2 is for the percent, since the corresponding
+** percentage value of the data need to be removed when the 
+** value was removed.
+**
+*/
+void App::removeDuplicates()
+{
+
+	char buf2[512];
+	sprintf(buf2, "Removing duplicates in distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		if (allsrcsinklus[luidx] != 0)
+		{
+			TraceSpan span("app", "dedup");
+			span.arg("lu", allsrcsinklus[luidx]);
+			if (checkpoint) { checkpoint->waitWritten(luidx); }
+			for (int f = 0; f < getNumFactors(); f++)
+			{
+				double *values = rawludata->factorarray[f][luidx];
+				double *percents = perludata->factorarray[f][luidx];
+				for (int idx = 0; idx < rawludata->ludtctrarray[luidx]-1; idx++)
+					// Here, we use the final counter from the perludata.
+					// This has been updated during the removal of duplicates.
+				{
+					if (values[idx] == values[idx + 1])
+					{
+						values[idx] = 9999999999999999;
+						percents[idx] = 9999999999999999;
+						perludata->finalctr[f][luidx]--;
+					}
+				}
+				sort(values, values + rawludata->ludtctrarray[luidx]);
+				sort(percents, percents + perludata->ludtctrarray[luidx]);
+			}
+
+
+		}
+		else { break; }
+	}
+
+	sprintf(buf2, "Finished removing duplicates in distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+}
+
+
+
+/*
+** caltrapzarea()
+**
+** Calculates the area of a trapozoid shape.
+** Four inputs are required. In this application:
+** 1. the x axis value (elevation, distance or slope), 
+**    will be used as height of the shape.
+** 2. the y axis value (percentage calculated)
+**    will be used as the top (x) and bottom (x+1).
+*/
+double App::caltrapzarea(double olu1, double olu2, double perlu1, double perlu2)
+{
+	double traparea = (olu2 - olu1)*(perlu1 + perlu2) / (double)2;
+	return traparea;
+}
+
+
+
+
+/*
+** callwli()
+**
+** This function calculates the lorenz curve data, incluging the 
+** data points and the area under each curve.
+**
+*/
+App::Ludata *App::callwli()
+{
+
+	char buf2[512];
+	sprintf(buf2, "Calculating curve areas for distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+	
+	//Ludataarray;
+	// Here, the elevation array will only have one value for one 
+	// land use, which will be the lwli value. It will be accumulated
+	// during the loop.
+	Ludata *templudata = new Ludata;
+	int nfactors = getNumFactors();
+
+	
+
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		// Initialize the array
+		if (allsrcsinklus[luidx] == 0) { break; }
+		else
+		{
+			for (int f = 0; f < nfactors; f++)
+			{
+				templudata->factorarray[f][luidx] = new double;
+				memset(templudata->factorarray[f][luidx], 0.0, sizeof(double) * 1);
+			}
+		}
+
+		// Initialize the counter
+		templudata->ludtctrarray[luidx] = 1;
+		for (int f = 0; f < nfactors; f++) { templudata->finalctr[f][luidx] = templudata->ludtctrarray[luidx]; }
+
+		// Initialize the luno
+		templudata->luno = allsrcsinklus[luidx];
+	}
+
+
+	for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+	{
+		if (allsrcsinklus[luidx] != 0)
+		{
+
+			// Here, we use the final counter from the perludata.
+			// This has been updated during the removal of duplicates.
+			for (int f = 0; f < nfactors; f++)
+			{
+				for (int index = 0; index < perludata->finalctr[f][luidx] - 1; index++)
+				{
+					// Here, we are looping through each value in the array 
+					// of the factor for each land use.
+					// We need a function to calculate the area for each step.
+					templudata->factorarray[f][luidx][0] += caltrapzarea(
+						rawludata->factorarray[f][luidx][index],
+						rawludata->factorarray[f][luidx][index + 1],
+						perludata->factorarray[f][luidx][index],
+						perludata->factorarray[f][luidx][index + 1]);
+				}
+			}
+
+		}
+		else { break; }
+	}
+
+	sprintf(buf2, "Finished calculating curve areas for distance, elevation and slope data!!\n");
+	DisplayMessage(buf2);
+
+	return templudata;
+}
+
+
+/*
+** writeFactorData()
+**
+** Write output files.
+**
+*/
+void App::writeFactorData(int factor, const char *file)
+{
+	static const char *names[NUM_FACTORS] = { "elevation", "Distance", "Slope" };
+	const char *name = (factor < NUM_FACTORS) ? names[factor] : extraFactors[factor - NUM_FACTORS].name.c_str();
+
+	char buf2[512];
+	sprintf(buf2, "Writing output data for %s!!\n", name);
+	DisplayMessage(buf2);
+
+	// Here, we use the final counter from the perludata.
+	// This has been updated during the removal of duplicates.
+	std::vector<CurveSpan> spans;
+	getCurveSpans(spans, false);
+	int nfactors = getNumFactors();
+	writeCurveTextFile("", file, spans.data() + factor, nfactors, allsrcsinklus, (int)spans.size() / nfactors, curveText);
+
+	sprintf(buf2, "Finished writing output data for %s!!\n", name);
+	DisplayMessage(buf2);
+}
+
+
+/*
+** getCurveSpans()
+**
+** The elevation curve leaves out the point before the last one and
+** distance and slope write the point before the last one instead of
+** the last one, see curveSpan(). The extra factors write all the
+** points of their curves. getNumFactors() spans per land use.
+**
+*/
+void App::getCurveSpans(std::vector<CurveSpan> &spans, bool full)
+{
+	int nlus = 0;
+	while (nlus < MAX_LUIDS && allsrcsinklus[nlus] != 0) { nlus++; }
+
+	int nfactors = getNumFactors();
+	spans.resize(nlus*nfactors);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = 0; f < nfactors; f++)
+		{
+			double *values = rawludata->factorarray[f][luidx];
+			double *percents = perludata->factorarray[f][luidx];
+			int count = perludata->finalctr[f][luidx];
+			spans[luidx*nfactors + f] = (full || f >= NUM_FACTORS) ? fullCurveSpan(values, percents, count) :
+				curveSpan(values, percents, count, f);
+		}
+	}
+}
+
+
+// Names of the extra factors for the curve files
+void App::getExtraNames(std::vector<const char *> &names)
+{
+	names.clear();
+	for (size_t e = 0; e < extraFactors.size(); e++) { names.push_back(extraFactors[e].name.c_str()); }
+}
+
+
+/*
+** writeBinaryCurves()
+**
+** Same points as writeFactorData() of all the factors in the NPY
+** files of curvefile.h.
+**
+*/
+void App::writeBinaryCurves()
+{
+	char buf2[512];
+	sprintf(buf2, "Writing binary output data for the curves!!\n");
+	DisplayMessage(buf2);
+
+	int nsrclus = 0;
+	while (nsrclus < MAX_LUIDS && srclunums[nsrclus] != 0) { nsrclus++; }
+
+	std::vector<CurveSpan> spans;
+	std::vector<const char *> names;
+	getCurveSpans(spans, false);
+	getExtraNames(names);
+	int nfactors = getNumFactors();
+	writeCurveFiles("", spans.data(), allsrcsinklus, nsrclus, (int)spans.size() / nfactors, nfactors, names.data());
+
+	sprintf(buf2, "Finished writing binary output data for the curves!!\n");
+	DisplayMessage(buf2);
+}
+
+
+/*
+** writeSimplifiedData()
+**
+** Simplified curves instead of all the points, see simplify.h, of
+** the extra factors as well.
+**
+*/
+void App::writeSimplifiedData()
+{
+	char buf2[512];
+	sprintf(buf2, "Writing simplified output data for the curves!!\n");
+	DisplayMessage(buf2);
+
+	std::vector<LuResult> results;
+	int nsrclus = getLuResults(results);
+	int nlus = (int)results.size();
+
+	std::vector<CurveSpan> curves;
+	std::vector<const char *> names;
+	std::vector<double> extraAreas;
+	getCurveSpans(curves, true);
+	getExtraNames(names);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = NUM_FACTORS; f < getNumFactors(); f++) { extraAreas.push_back(lwlis->factorarray[f][luidx][0]); }
+	}
+	writeSimplifiedCurves("", simplify, curveFormat, curveText, curves.data(), results.data(), nsrclus, nlus, 0,
+		getNumFactors(), names.data(), extraAreas.data());
+
+	sprintf(buf2, "Finished writing simplified output data for the curves!!\n");
+	DisplayMessage(buf2);
+}
+
+
+/*
+** getLuResults()
+**
+** The cells are counted before the duplicates are removed.
+**
+*/
+int App::getLuResults(std::vector<LuResult> &results)
+{
+	int nsrclus = 0;
+	while (nsrclus < MAX_LUIDS && srclunums[nsrclus] != 0) { nsrclus++; }
+
+	results.clear();
+	for (int luidx = 0; luidx < MAX_LUIDS && allsrcsinklus[luidx] != 0; luidx++)
+	{
+		LuResult r;
+		r.luno = allsrcsinklus[luidx];
+		r.ncells = rawludata->ludtctrarray[luidx];
+		for (int f = 0; f < NUM_FACTORS; f++) { r.area[f] = lwlis->factorarray[f][luidx][0]; }
+		results.push_back(r);
+	}
+	return nsrclus;
+}
+
+
+double App::getValueCount(bool distinct)
+{
+	Ludata *data = distinct ? perludata : rawludata;
+	if (data == NULL) { return 0.0; }
+
+	double values = 0.0;
+	for (int luidx = 0; luidx < MAX_LUIDS && allsrcsinklus[luidx] != 0; luidx++)
+	{
+		for (int f = 0; f < getNumFactors(); f++)
+		{
+			values += (double)(distinct ? data->finalctr[f][luidx] : data->ludtctrarray[luidx]);
+		}
+	}
+	return values;
+}
+
+
+/*
+** writeLwliData()
+**
+** Write Lwli files.
+**
+*/
+void App::writeLwliData(const char *file)
+{
+	char buf2[512];
+	sprintf(buf2, "Writing output data for Lorenz curve!!\n");
+	DisplayMessage(buf2);
+
+	FILE *fp = fopen(file, "w");
+
+	if (fp)
+	{
+		fprintf(fp, "Area under lorenz curve\n");
+		fprintf(fp, "Landuse, Area_Elevation, Area_Distance, Area_Slope");
+		for (size_t e = 0; e < extraFactors.size(); e++) { fprintf(fp, ", Area_%s", extraFactors[e].name.c_str()); }
+		fprintf(fp, "\n");
+		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+		{
+			if (allsrcsinklus[luidx] != 0)
+			{
+				// Here, we use the final counter from the perludata.
+				// This has been updated during the removal of duplicates.
+				fprintf(fp, "Landuse_%d, ", allsrcsinklus[luidx]);
+				fprintf(fp, "%f, %f, %f", 
+							lwlis->factorarray[0][luidx][0],
+							lwlis->factorarray[1][luidx][0],
+							lwlis->factorarray[2][luidx][0]);
+				for (int f = NUM_FACTORS; f < getNumFactors(); f++)
+				{
+					fprintf(fp, ", %f", lwlis->factorarray[f][luidx][0]);
+				}
+				fprintf(fp, "\n");
+
+			}
+			else { break; }
+		}
+	}
+
+	fclose(fp);
+
+	sprintf(buf2, "Finished writing output data for Lorenz curve!!\n");
+	DisplayMessage(buf2);
+}
+
+
+
+/*
+** writeOutputs()
+**
+** Write output files.
+**
+*/
+void App::writeOutputs()
+{
+	// Write elevation outputs
+	if (simplify.mode != SIMPLIFY_NONE)
+	{
+		writeSimplifiedData();
+	}
+	else if (curveFormat == CURVES_NPY)
+	{
+		writeBinaryCurves();
+	}
+	else
+	{
+		writeFactorData(0, "elev_dataperc.txt");
+		writeFactorData(1, "dist_dataperc.txt");
+		writeFactorData(2, "slp_dataperc.txt");
+		for (int f = NUM_FACTORS; f < getNumFactors(); f++)
+		{
+			string file = extraFactors[f - NUM_FACTORS].name + "_dataperc.txt";
+			writeFactorData(f, file.c_str());
+		}
+	}
+
+	writeLwliData("LurenzCurveAreas.txt");
+
+}
+
+
+
+
+/*
+** calAreaPercOverws()
+**
+** This function calculates the area of each land use
+** over the watershed area. This will be achieved by
+** count the total number of cells in the watershed
+** and those in each of the sink and source landuse.
+**
+*/
+
+void App::calAreaPercOverws()
+{
+	
+	// input for this function will be
+	// sinklunums
+	// srclunums
+	// asclu
+	// Three counters will be needed:
+	int *sinkluctr;
+	int *srcluctr;
+	int totalluctr;
+
+	totalluctr = 0;
+
+	// Initiate the counter values
+	sinkluctr = new int[MAX_LUIDS];
+	if (sinkluctr == NULL)
+	{
+		fatalError("Out of memory in calAreaPercOverws()");
+	}
+	memset(sinkluctr, 0, sizeof(int)*MAX_LUIDS);
+
+	srcluctr = new int[MAX_LUIDS];
+	if (srcluctr == NULL)
+	{
+		fatalError("Out of memory in calAreaPercOverws()");
+	}
+	memset(srcluctr, 0, sizeof(int)*MAX_LUIDS);
+
+	for (int index = 0; index<rows*cols; index++)
+	{
+		
+		if (asclu[index] != 0)
+		{
+			//printf("Reading int%d..\n", asclu[index]);
+			totalluctr = totalluctr + 1;
+		}
+
+		for (int i = 0; i < MAX_LUIDS; i++)
+		{
+			if (srclunums[i] == 0)
+			{
+				break;
+			}
+			else if (asclu[index] == srclunums[i])
+			{
+				srcluctr[i] = srcluctr[i] +1;
+			}
+		}
+
+		for (int j = 0; j < MAX_LUIDS; j++)
+		{
+			if (sinklunums[j] == 0)
+			{
+				break;
+			}
+			else if (asclu[index] == sinklunums[j])
+			{
+				sinkluctr[j] = sinkluctr[j] + 1;
+			}
+		}
+	}
+
+
+
+	// Then these will be written into a file
+	char buf2[512];
+	sprintf(buf2, "Writing percentage of area for each land use over watershed area!\n");
+	DisplayMessage(buf2);
+
+	FILE *fp = fopen("luareaperc.txt", "w");
+
+	if (fp)
+	{
+		fprintf(fp, "Percentage of area for each land use over watershed area\n");
+		fprintf(fp, "Landuse, Total_cells, Percentage\n");
+
+		for (int luidx = 0; luidx < MAX_LUIDS; luidx++)
+		{
+			if (sinklunums[luidx] == 0)
+			{
+				break;
+			}
+			else
+			{
+				fprintf(fp, "Sink_%d, %d, %f\n", 
+					sinklunums[luidx],
+					sinkluctr[luidx],
+					(double)sinkluctr[luidx]/(double)totalluctr);
+			}
+		}
+
+		for (int luidx2 = 0; luidx2 < MAX_LUIDS; luidx2++)
+		{
+			if (srclunums[luidx2] == 0)
+			{
+				break;
+			}
+			else
+			{
+				fprintf(fp, "Source_%d, %d, %f\n",
+					srclunums[luidx2],
+					srcluctr[luidx2],
+					(double)srcluctr[luidx2] / (double)totalluctr);
+			}
+		}
+	}
+
+	fclose(fp);
+
+	sprintf(buf2, "Finished writing percentage of area for each land use over watershed area!\n");
+	DisplayMessage(buf2);
+}
+
+
+
+
+
+/*
+** readGisAsciiFiles()
+**
+** Reads in the grid files that are required. 
+**
+*/
+void App::readGisAsciiFiles()
+{
+	if (checkpointDir && resumeCheckpoint()) { return; }
+
+	readInputGrids();
+
+	// put the value into corresponding lu
+	{
+		TraceSpan span("app", "scatter");
+		rawludata = asc2ludata();
+	}
+	saveCheckpoint(CHECKPOINT_SCATTER);
+}
+
+
+/*
+** resumeCheckpoint()
+**
+** Opens the checkpoints of the inputs and takes the data of the
+** latest one, false if there is none. The directory is made if it
+** does not exist, a run that can't write checkpoints is stopped.
+**
+*/
+bool App::resumeCheckpoint()
+{
+	if (!makeDirs(checkpointDir))
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't make the checkpoint directory %s\n", checkpointDir);
+		fatalError(buf2);
+	}
+
+	vector<string> files;
+	files.push_back(srcluFile);
+	files.push_back(sinkluFile);
+	files.push_back(luFile);
+	string extra;
+	for (int f = 0; f < getNumFactors(); f++)
+	{
+		files.push_back(factorFile(f));
+		extra += (f < NUM_FACTORS) ? "" : extraFactors[f - NUM_FACTORS].name;
+		extra += '\n';
+	}
+	extra.append((const char *)&wsrows, sizeof(wsrows));
+	extra.append((const char *)&wscols, sizeof(wscols));
+	if (wsmask) { extra.append((const char *)wsmask, (size_t)wsrows*wscols); }
+	checkpoint = new StageCheckpoint(checkpointDir, inputFingerprint(files, extra.data(), extra.size()));
+
+	CheckpointData data;
+	int stage = checkpoint->load(data);
+	if (stage == CHECKPOINT_NONE) { return false; }
+
+	readLuLists();
+	int nlus = 0;
+	while (nlus < MAX_LUIDS && allsrcsinklus[nlus] != 0) { nlus++; }
+	bool match = (data.nlus == nlus && data.nfactors == getNumFactors());
+	for (int luidx = 0; match && luidx < nlus; luidx++) { match = (data.lunos[luidx] == allsrcsinklus[luidx]); }
+	if (!match)
+	{
+		char buf2[512];
+		sprintf(buf2, "The land uses of the checkpoint in %s do not match, remove it to start over\n", checkpointDir);
+		fatalError(buf2);
+	}
+
+	rows = data.rows;
+	cols = data.cols;
+	asclu = data.lugrid;
+	rawludata = new Ludata;
+	perludata = (stage == CHECKPOINT_DEDUP) ? new Ludata : NULL;
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		rawludata->luno = allsrcsinklus[luidx];
+		rawludata->ludtctrarray[luidx] = data.counts[luidx];
+		for (int f = 0; f < data.nfactors; f++)
+		{
+			size_t k = (size_t)luidx*data.nfactors + f;
+			rawludata->factorarray[f][luidx] = data.values[k];
+			rawludata->finalctr[f][luidx] = data.counts[luidx];
+			if (perludata)
+			{
+				perludata->factorarray[f][luidx] = data.percents[k];
+				perludata->finalctr[f][luidx] = data.finalctr[k];
+			}
+		}
+		if (perludata)
+		{
+			perludata->luno = allsrcsinklus[luidx];
+			perludata->ludtctrarray[luidx] = data.counts[luidx];
+		}
+	}
+	resumedStage = stage;
+	return true;
+}
+
+
+/*
+** saveCheckpoint()
+**
+** Starts the checkpoint of stage on its thread, nothing without
+** checkpointDir.
+**
+*/
+void App::saveCheckpoint(int stage)
+{
+	if (checkpoint == NULL) { return; }
+
+	CheckpointData data;
+	data.stage = stage;
+	data.rows = rows;
+	data.cols = cols;
+	data.lugrid = asclu;
+	data.nfactors = getNumFactors();
+	data.nlus = 0;
+	for (int luidx = 0; luidx < MAX_LUIDS && allsrcsinklus[luidx] != 0; luidx++)
+	{
+		bool dedup = (stage == CHECKPOINT_DEDUP);
+		data.nlus++;
+		data.lunos.push_back(allsrcsinklus[luidx]);
+		data.counts.push_back(rawludata->ludtctrarray[luidx]);
+		for (int f = 0; f < data.nfactors; f++)
+		{
+			data.finalctr.push_back(dedup ? perludata->finalctr[f][luidx] : rawludata->ludtctrarray[luidx]);
+			data.values.push_back(rawludata->factorarray[f][luidx]);
+			if (dedup) { data.percents.push_back(perludata->factorarray[f][luidx]); }
+		}
+	}
+	checkpoint->save(data);
+}
+
+
+/*
+** readInputGrids()
+**
+** Reads the land use lists and the grid files.
+**
+*/
+void App::readInputGrids()
+{
+	for (int i = 0; i<MAX_ROWS; i++)
+	{
+		validRows[i] = 1;
+	}
+
+	readLuLists();
+
+	// Read in the ascii files, each while the next one is read
+	// ahead. A fatal error that throws (the library) leaves no
+	// stream behind for the next App.
+	try
+	{
+		prefetchGridStream(demFile);
+		{
+			TraceSpan span("app", "read lu");
+			asclu = readArcviewInt(luFile);
+		}
+		prefetchGridStream(slopeFile);
+		{
+			TraceSpan span("app", "read dem");
+			ascfactors[0] = readArcviewFloat(demFile);
+		}
+		prefetchGridStream(distFile);
+		{
+			TraceSpan span("app", "read slope");
+			ascfactors[2] = readArcviewFloat(slopeFile);
+		}
+		if (getNumFactors() > NUM_FACTORS) { prefetchGridStream(factorFile(NUM_FACTORS)); }
+		{
+			TraceSpan span("app", "read dist");
+			ascfactors[1] = readArcviewFloat(distFile);
+		}
+		for (int f = NUM_FACTORS; f < getNumFactors(); f++)
+		{
+			if (f + 1 < getNumFactors()) { prefetchGridStream(factorFile(f + 1)); }
+			TraceSpan span("app", "read factor");
+			span.arg("factor", f);
+			ascfactors[f] = readArcviewFloat(factorFile(f));
+		}
+	}
+	catch (...)
+	{
+		dropPrefetchedStreams();
+		throw;
+	}
+}
+
+
+/*
+** readLuLists()
+**
+** Get the land use numbers for sink and source.
+**
+*/
+void App::readLuLists()
+{
+	srclunums = readTextInttoArray(srcluFile);
+	sinklunums = readTextInttoArray(sinkluFile);
+
+	allsrcsinklus = combineSrcSinklus();
+}
+
+
+/*
+** addFactor()
+**
+** The name becomes part of the file names and the header of
+** LurenzCurveAreas.txt.
+**
+*/
+void App::addFactor(const char *name, const char *file)
+{
+	char buf2[512];
+	if (name == NULL || name[0] == 0 || strlen(name) > 64 || strpbrk(name, "/\\, \t") != NULL)
+	{
+		sprintf(buf2, "Factor name \"%.64s\" must be a word of up to 64 characters\n", (name != NULL) ? name : "");
+		fatalError(buf2);
+	}
+	if (getNumFactors() >= MAX_FACTORS)
+	{
+		sprintf(buf2, "Too many factors, at most %d are supported\n", MAX_FACTORS);
+		fatalError(buf2);
+	}
+	ExtraFactor extra;
+	extra.name = name;
+	extra.file = file;
+	extraFactors.push_back(extra);
+}
+
+
+const char *App::factorFile(int factor)
+{
+	if (factor == 0) { return demFile; }
+	if (factor == 1) { return distFile; }
+	if (factor == 2) { return slopeFile; }
+	return extraFactors[factor - NUM_FACTORS].file.c_str();
+}
+
+
+/*
+** setWatershedMask()
+**
+** Sets the mask of the watershed, the mask is owned by the caller.
+**
+*/
+void App::setWatershedMask(const unsigned char *mask, int mrows, int mcols)
+{
+	wsmask = mask;
+	wsrows = mrows;
+	wscols = mcols;
+}
+
+
+/*
+** SortCalpercent()
+**
+** Sort rawdata and calculate the percent of the datas.
+**
+*/
+void App::SortCalpercent()
+{
+	// Nothing is left to do after a dedup checkpoint
+	if (resumedStage == CHECKPOINT_DEDUP) { return; }
+
+	// Sort the data, will be stored in the orderludata
+	if (resumedStage < CHECKPOINT_SORT)
+	{
+		sortludata();
+		saveCheckpoint(CHECKPOINT_SORT);
+	}
+
+	// Percent will be put into the perludata
+	{
+		TraceSpan span("app", "percent");
+		perludata = calperludata();
+	}
+
+	// Remove duplicates 
+	removeDuplicates();
+	saveCheckpoint(CHECKPOINT_DEDUP);
+}
+
+
+
+void App::CalLWLI()
+{
+	// After processing the data, the next step is to 
+	// calculate the Trapezoidal area of the data.
+	// The equation is:
+	// f(x) = delta x/2(y0 + 2*y1 + 2*y2 + ... + 2*yn-1 + yn)
+	// C++ does not have a function to make the graphs.
+	// I will use python to create the graphs.
+
+	// Required:
+	// Array of the data: orderludata, perludata.
+	{
+		TraceSpan span("app", "integrate");
+		lwlis = callwli();
+	}
+	
+	// After calculation, it is time to write the 
+	// output into text files.
+	// Outputs to be written:
+	// 1. elevation (lu1 orvalue, lu1 pertvalue, ...)
+	// 2. distance (lu1 orvalue, lu1 pertvalue, ...)
+	// 3. slope (lu1 orvalue, lu1 pertvalue, ...)
+	// 4. Final Lwli values
+	TraceSpan span("app", "write");
+	writeOutputs();
+
+	// The outputs are written, a run from here on starts over
+	if (checkpoint) { checkpoint->removeAll(); }
+
+}
+
+
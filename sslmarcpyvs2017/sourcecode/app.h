@@ -1,172 +1,265 @@
-/*
--------------------------------------------------------------------------------------------------------------
-**
-** Location weighted landscape index calculation program.
-**
-** This class was developed to do the calculation of landscape index.
-** The inputs include :
-** 1. land use map(should be reclassifed to include intended sink
-** and source classes).
-** 2. dem : defines the elevation
-** 3. slope : calculated from the DEM
-** 4. distance : calculated with the path distance tool with
-** dem as surface factor in ArcGIS.
-**
-** Qingyu Feng
-** qingyufeng@outlook.com
-** Department of Agricultural & Biological Engineering
-** Purdue University
-** West Lafayette, Indiana
-**
-** Jan 2018
-**
--------------------------------------------------------------------------------------------------------------
-** File statement:
-** This app class is the class that contain all of the functions
-** used in the process.
-**
-**
--------------------------------------------------------------------------------------------------------------
-*/
-
-// This is start of the header guard.
-// ADD_H can be any unique name.  
-// By convention, we use the name of the header file.
-#ifndef APP_H
-#define APP_H
-
-
-// This is the content of the .h file, 
-//	which is where the declarations go
-// int add(int x, int y); // function prototype for add.h -- don't forget the semicolon!
-// This is the end of the header guard
-
-// Declare class
-class App;
-
-#define MAX_ROWS   1000000
-#define MAX_COL_BYTES 1000000
-#define MAX_LUIDS 100
-// Declare class
-class App;
-
-#include <vector>
-#include <string>
-using namespace std;
-
-// Declare class
-class App;
-
-
-// Declare class
-class App;
-
-// Define class
-class App
-{
-public:
-	// Constructor and distructor 
-	// of the app for manage memories
-	App();
-	~App();
-
-	// Variables to store the data read from
-	// the asc files
-	int *srclunums;
-	int *sinklunums;
-	
-	float *ascelev;
-	float *ascslope;
-	float *ascdist;
-	int *asclu;
-
-	void readGisAsciiFiles();
-
-	// Then these two will need to be combined for easier processing
-	int *allsrcsinklus;
-
-
-	// Define a structure to store all of the datas
-	typedef struct Ludata
-	{
-		int luno;
-		// Stores all data
-		double *elevarray[MAX_LUIDS];
-		double *slopearray[MAX_LUIDS];
-		double *distarray[MAX_LUIDS];
-		// Stores the counter
-		int ludtctrarray[MAX_LUIDS];
-
-		// stores the final number of each data value
-		int finalelevctr[MAX_LUIDS];
-		int finaldistctr[MAX_LUIDS];
-		int finalslpctr[MAX_LUIDS];
-
-	};
-
-	Ludata *rawludata;
-	Ludata *perludata;
-	Ludata *lwlis;
-
-
-	void SortCalpercent();
-
-	void CalLWLI();
-
-	void calAreaPercOverws();
-
-
-	// Clean memory after running
-	void cleanMemory();
-
-private:
-
-	// Functions for reading input data
-	// from text files
-	int *readTextInttoArray(const char *file);
-	int *readArcviewInt(const char *file);
-	float *readArcviewFloat(const char *file);
-
-	int *combineSrcSinklus();
-
-	Ludata *asc2ludata();
-	void sortludata();
-	Ludata *calperludata();
-	Ludata *callwli();
-
-	void removeDuplicates();
-
-	double caltrapzarea(double olu1, double olu2, double perlu1, double perlu2);
-
-	void writeOutputs();
-	void writeElevData(const char *file);
-	void writeDistData(const char *file);
-	void writeSlpData(const char *file);
-	void writeLwliData(const char *file);
-
-	
-
-	int rows;
-	int cols;
-	float cellsize;
-	int noData;
-	int noDataLu;
-
-	int validRows[MAX_ROWS];
-	double xllcorner, yllcorner;
-
-
-};
-
-
-
-
-
-
-
-
-
-
-
-#endif
-
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+** This class was developed to do the calculation of landscape index.
+** The inputs include :
+** 1. land use map(should be reclassifed to include intended sink
+** and source classes).
+** 2. dem : defines the elevation
+** 3. slope : calculated from the DEM
+** 4. distance : calculated with the path distance tool with
+** dem as surface factor in ArcGIS.
+**
+** Qingyu Feng
+** qingyufeng@outlook.com
+** Department of Agricultural & Biological Engineering
+** Purdue University
+** West Lafayette, Indiana
+**
+** Jan 2018
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** This app class is the class that contain all of the functions
+** used in the process.
+**
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+// This is start of the header guard.
+// ADD_H can be any unique name.  
+// By convention, we use the name of the header file.
+#ifndef APP_H
+#define APP_H
+
+
+// This is the content of the .h file, 
+//	which is where the declarations go
+// int add(int x, int y); // function prototype for add.h -- don't forget the semicolon!
+// This is the end of the header guard
+
+// Declare class
+class App;
+
+#define MAX_ROWS   1000000
+#define MAX_COL_BYTES 1000000
+#define MAX_LUIDS 100
+
+// Factors of the curves: elevation, distance and slope (NUM_FACTORS),
+// then the extra factors of addFactor()
+#define MAX_FACTORS 8
+// Declare class
+class App;
+
+#include <vector>
+#include <string>
+using namespace std;
+
+#include "lorenz.h"
+#include "simplify.h"
+
+// Declare class
+class App;
+
+
+// Declare class
+class App;
+
+class StageCheckpoint;
+
+// Define class
+class App
+{
+public:
+	// Constructor and distructor 
+	// of the app for manage memories
+	App();
+	~App();
+
+	// Variables to store the data read from
+	// the asc files
+	int *srclunums;
+	int *sinklunums;
+	
+	// Grids of the factors, in the order of the factors
+	float *ascfactors[MAX_FACTORS];
+	int *asclu;
+
+	void readGisAsciiFiles();
+
+	// Only reads the land use lists and the four grids, without
+	// putting the values into the land use data arrays.
+	void readInputGrids();
+
+	// Reads the source and sink land use lists.
+	void readLuLists();
+
+	int getRows() { return rows; }
+	int getCols() { return cols; }
+
+	// Names of the input files. They default to the files
+	// written by the PySSLM toolbox into the working directory.
+	const char *srcluFile;
+	const char *sinkluFile;
+	const char *luFile;
+	const char *demFile;
+	const char *slopeFile;
+	const char *distFile;
+
+	// Adds a factor after elevation, distance and slope, read from
+	// file. Its curves go to <name>_dataperc.txt (all the points)
+	// and its areas to an Area_<name> column of LurenzCurveAreas.txt.
+	void addFactor(const char *name, const char *file);
+
+	// Factors of the run, NUM_FACTORS without addFactor()
+	int getNumFactors() { return NUM_FACTORS + (int)extraFactors.size(); }
+
+	// Format of the curve files, CURVES_TEXT (the default) or
+	// CURVES_NPY, see curvefile.h
+	int curveFormat;
+
+	// Simplification of the curve files (SIMPLIFY_NONE)
+	CurveSimplify simplify;
+
+	// Numbers and compression of the text curve files, see
+	// textout.h (defaultTextOptions())
+	TextOptions curveText;
+
+	// Directory of the stage checkpoints (checkpoint.h), NULL (the
+	// default) writes none. A run with the same inputs resumes
+	// after the last stage that was written.
+	const char *checkpointDir;
+
+	// Optional watershed mask from the terrain processing.
+	// Land use cells where the mask is 0 are not read, so the
+	// raw grids can be used instead of the clipped ones.
+	void setWatershedMask(const unsigned char *mask, int mrows, int mcols);
+	const unsigned char *getWatershedMask() { return wsmask; }
+
+	// Then these two will need to be combined for easier processing
+	int *allsrcsinklus;
+
+
+	// Define a structure to store all of the datas
+	typedef struct Ludata
+	{
+		int luno;
+		// Stores all data of each factor (elevation, distance,
+		// slope, then the extra factors)
+		double *factorarray[MAX_FACTORS][MAX_LUIDS];
+		// Stores the counter
+		int ludtctrarray[MAX_LUIDS];
+
+		// stores the final number of each data value of each factor
+		int finalctr[MAX_FACTORS][MAX_LUIDS];
+
+	};
+
+	Ludata *rawludata;
+	Ludata *perludata;
+	Ludata *lwlis;
+
+
+	void SortCalpercent();
+
+	void CalLWLI();
+
+	void calAreaPercOverws();
+
+	// Cells and areas of the land uses after CalLWLI(), sources
+	// first. Returns the number of source land uses.
+	int getLuResults(std::vector<LuResult> &results);
+
+	// Values of the land uses for the metrics (metrics.h): all the
+	// elevation, distance and slope values after
+	// readGisAsciiFiles(), or the distinct ones after SortCalpercent()
+	double getValueCount(bool distinct);
+
+
+	// Clean memory after running
+	void cleanMemory();
+
+private:
+	// Times the steps one by one, see sslmbench.cpp
+	friend class AppBenchmark;
+
+	// Runs App in the differential check, see sslmdiff.cpp
+	friend class AppUnderTest;
+
+	// Functions for reading input data
+	// from text files
+	int *readTextInttoArray(const char *file);
+	int *readArcviewInt(const char *file);
+	float *readArcviewFloat(const char *file);
+
+	int *combineSrcSinklus();
+
+	Ludata *asc2ludata();
+	void sortludata();
+	Ludata *calperludata();
+	Ludata *callwli();
+
+	void removeDuplicates();
+
+	double caltrapzarea(double olu1, double olu2, double perlu1, double perlu2);
+
+	void writeOutputs();
+	void writeFactorData(int factor, const char *file);
+	void writeLwliData(const char *file);
+	void writeBinaryCurves();
+	void writeSimplifiedData();
+
+	// getNumFactors() spans per land use, all points if full is
+	// set, else the points App writes (curveSpan())
+	void getCurveSpans(std::vector<CurveSpan> &spans, bool full);
+	void getExtraNames(std::vector<const char *> &names);
+
+	// Stage checkpoints, see checkpoint.h
+	StageCheckpoint *checkpoint;
+	int resumedStage;
+	bool resumeCheckpoint();
+	void saveCheckpoint(int stage);
+
+	
+
+	int rows;
+	int cols;
+	float cellsize;
+	int noData;
+	int noDataLu;
+
+	int validRows[MAX_ROWS];
+
+	// Factors of addFactor()
+	typedef struct ExtraFactor
+	{
+		std::string name;
+		std::string file;
+	} ExtraFactor;
+	std::vector<ExtraFactor> extraFactors;
+
+	const char *factorFile(int factor);
+
+	const unsigned char *wsmask;
+	int wsrows;
+	int wscols;
+	double xllcorner, yllcorner;
+
+
+};
+
+
+
+
+
+
+
+
+
+
+
+#endif
+
@@ -0,0 +1,123 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Frozen copy of the App class of the first version, the reference
+** of the differential check. It reads srclus.txt, sinklus.txt and
+** the four grids of the working directory and writes the curve
+** files, LurenzCurveAreas.txt and luareaperc.txt there, as sslmarcpy
+** did before any of the optimizations.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef APPREF_H
+#define APPREF_H
+
+#define REF_MAX_ROWS   1000000
+#define REF_MAX_COL_BYTES 1000000
+#define REF_MAX_LUIDS 100
+
+
+// Define class
+class AppReference
+{
+public:
+	AppReference();
+	~AppReference();
+
+	// readGisAsciiFiles(), SortCalpercent(), CalLWLI() and
+	// calAreaPercOverws(), then cleanMemory()
+	void run();
+
+	// Variables to store the data read from
+	// the asc files
+	int *srclunums;
+	int *sinklunums;
+
+	float *ascelev;
+	float *ascslope;
+	float *ascdist;
+	int *asclu;
+
+	void readGisAsciiFiles();
+
+	// Then these two will need to be combined for easier processing
+	int *allsrcsinklus;
+
+
+	// Define a structure to store all of the datas
+	typedef struct Ludata
+	{
+		int luno;
+		// Stores all data
+		double *elevarray[REF_MAX_LUIDS];
+		double *slopearray[REF_MAX_LUIDS];
+		double *distarray[REF_MAX_LUIDS];
+		// Stores the counter
+		int ludtctrarray[REF_MAX_LUIDS];
+
+		// stores the final number of each data value
+		int finalelevctr[REF_MAX_LUIDS];
+		int finaldistctr[REF_MAX_LUIDS];
+		int finalslpctr[REF_MAX_LUIDS];
+
+	} Ludata;
+
+	Ludata *rawludata;
+	Ludata *perludata;
+	Ludata *lwlis;
+
+
+	void SortCalpercent();
+
+	void CalLWLI();
+
+	void calAreaPercOverws();
+
+
+	// Clean memory after running
+	void cleanMemory();
+
+private:
+
+	// Functions for reading input data
+	// from text files
+	int *readTextInttoArray(const char *file);
+	int *readArcviewInt(const char *file);
+	float *readArcviewFloat(const char *file);
+
+	int *combineSrcSinklus();
+
+	Ludata *asc2ludata();
+	void sortludata();
+	Ludata *calperludata();
+	Ludata *callwli();
+
+	void removeDuplicates();
+
+	double caltrapzarea(double olu1, double olu2, double perlu1, double perlu2);
+
+	void writeOutputs();
+	void writeElevData(const char *file);
+	void writeDistData(const char *file);
+	void writeSlpData(const char *file);
+	void writeLwliData(const char *file);
+
+	void freeLudata(Ludata *data, bool single);
+	double lastPoint(const double *points, int count, int index);
+
+	int rows;
+	int cols;
+	float cellsize;
+	int noData;
+	int noDataLu;
+
+	int validRows[REF_MAX_ROWS];
+	double xllcorner, yllcorner;
+};
+
+#endif
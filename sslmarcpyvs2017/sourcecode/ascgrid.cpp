@@ -0,0 +1,402 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Generic reader and writer for ESRI ASCII grids.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <ctype.h>
+
+#include "app.h"
+#include "ascgrid.h"
+#include "message.h"
+
+
+/*
+** readHeaderLines()
+**
+** Reads the 6 header lines of an arcview grid. The header keywords
+** are matched case insensitive and xllcenter/yllcenter are converted
+** to the corner coordinates.
+**
+*/
+static AscGrid *readHeaderLines(GridStream *stream, const char *file)
+{
+	char buf2[512];
+	char key[256];
+	char ebuf[256];
+	double val;
+	bool xcenter = false;
+	bool ycenter = false;
+
+	AscGrid *grid = new AscGrid;
+	grid->rows = grid->cols = 0;
+	grid->xllcorner = grid->yllcorner = 0.0;
+	grid->cellsize = 1.0;
+	grid->noData = -9999.0;
+	grid->data = NULL;
+
+	// reading the first 6 lines
+	for (int i = 0; i < 6; i++)
+	{
+		if (gridGets(buf2, 256, stream) == NULL ||
+			sscanf(buf2, "%255s %lf", key, &val) != 2)
+		{
+			sprintf(ebuf, "Bad header in grid file %s\n", file);
+			fatalError(ebuf);
+		}
+		for (char *p = key; *p; p++) { *p = (char)tolower(*p); }
+
+		if (!strcmp(key, "nrows")) { grid->rows = (int)val; }
+		else if (!strcmp(key, "ncols")) { grid->cols = (int)val; }
+		else if (!strcmp(key, "xllcorner")) { grid->xllcorner = val; }
+		else if (!strcmp(key, "yllcorner")) { grid->yllcorner = val; }
+		else if (!strcmp(key, "xllcenter")) { grid->xllcorner = val; xcenter = true; }
+		else if (!strcmp(key, "yllcenter")) { grid->yllcorner = val; ycenter = true; }
+		else if (!strcmp(key, "cellsize")) { grid->cellsize = val; }
+		else if (!strcmp(key, "nodata_value")) { grid->noData = val; }
+	}
+	if (xcenter) { grid->xllcorner -= grid->cellsize / 2.0; }
+	if (ycenter) { grid->yllcorner -= grid->cellsize / 2.0; }
+
+	if (grid->rows <= 0 || grid->cols <= 0)
+	{
+		sprintf(ebuf, "Bad rows or columns in grid file %s\n", file);
+		fatalError(ebuf);
+	}
+
+	return grid;
+}
+
+
+/*
+** readAscHeader()
+**
+** Reads only the header of an arcview grid.
+**
+*/
+AscGrid *readAscHeader(const char *file)
+{
+	char ebuf[256];
+	GridStream *stream = openGridStream(file);
+	if (stream == NULL)
+	{
+		sprintf(ebuf, "Can't find %s\n", file);
+		fatalError(ebuf);
+	}
+
+	AscGrid *grid;
+	try
+	{
+		grid = readHeaderLines(stream, file);
+	}
+	catch (...)
+	{
+		closeGridStream(stream);
+		throw;
+	}
+	closeGridStream(stream);
+	return grid;
+}
+
+
+/*
+** openAscReader()
+**
+** Opens a grid and reads the header. The rows are then read one by one.
+**
+*/
+AscReader *openAscReader(const char *file)
+{
+	char ebuf[256];
+	GridStream *stream = openGridStream(file);
+	if (stream == NULL)
+	{
+		sprintf(ebuf, "Can't find %s\n", file);
+		fatalError(ebuf);
+	}
+
+	AscReader *reader = new AscReader;
+	reader->stream = stream;
+	reader->file = file;
+	reader->row = 0;
+	reader->buf = NULL;
+	reader->header = NULL;
+
+	// In the library fatalError() throws, the decompressing
+	// thread of the stream is stopped before it is passed on.
+	try
+	{
+		reader->header = readHeaderLines(stream, file);
+	}
+	catch (...)
+	{
+		closeAscReader(reader);
+		throw;
+	}
+	reader->buf = new char[MAX_COL_BYTES + 1];
+	if (reader->buf == NULL)
+	{
+		fatalError("Out of memory in openAscReader()");
+	}
+	return reader;
+}
+
+
+/*
+** nextAscLine()
+**
+** Reads the line of the next row into the buffer of the reader.
+**
+*/
+static char *nextAscLine(AscReader *reader)
+{
+	char ebuf[256];
+	if (gridGets(reader->buf, MAX_COL_BYTES, reader->stream) == NULL)
+	{
+		sprintf(ebuf, "Grid file %s ended at row %d\n", reader->file, reader->row);
+		fatalError(ebuf);
+	}
+	if (strlen(reader->buf) >= MAX_COL_BYTES - 1)
+	{
+		fatalError("Line too long from grid file, max is 1000000 bytes");
+	}
+	reader->row++;
+	return reader->buf;
+}
+
+
+static void shortRow(AscReader *reader)
+{
+	char ebuf[256];
+	sprintf(ebuf, "Row %d of %s has less than %d values\n",
+		reader->row - 1, reader->file, reader->header->cols);
+	fatalError(ebuf);
+}
+
+
+/*
+** readAscRowFloat()
+**
+** Reads the next row into row (cols values). strtof moves the pointer
+** behind the value, so the row is parsed in one pass without skipping
+** spaces by hand. It rounds the decimal to a float once, as the
+** sscanf("%f") of App does; strtod and a cast would round twice.
+**
+*/
+void readAscRowFloat(AscReader *reader, float *row)
+{
+	char *k = nextAscLine(reader);
+	char *end;
+	for (int j = 0; j < reader->header->cols; j++)
+	{
+		row[j] = strtof(k, &end);
+		if (end == k) { shortRow(reader); }
+		k = end;
+	}
+}
+
+
+/*
+** readAscRowInt()
+**
+** Reads the next row of an integer grid into row.
+**
+*/
+void readAscRowInt(AscReader *reader, int *row)
+{
+	char *k = nextAscLine(reader);
+	char *end;
+	for (int j = 0; j < reader->header->cols; j++)
+	{
+		row[j] = (int)strtol(k, &end, 10);
+		if (end == k) { shortRow(reader); }
+
+		// Integer grids exported as floats (1.0)
+		if (*end == '.')
+		{
+			row[j] = (int)strtod(k, &end);
+		}
+		k = end;
+	}
+}
+
+
+void skipAscRow(AscReader *reader)
+{
+	nextAscLine(reader);
+}
+
+
+/*
+** closeAscReader()
+**
+** Closes the file. The header is freed unless it was taken
+** (reader->header set to NULL) by the caller.
+**
+*/
+void closeAscReader(AscReader *reader)
+{
+	if (reader == NULL) { return; }
+	if (reader->stream) closeGridStream(reader->stream);
+	if (reader->buf) delete[] reader->buf;
+	if (reader->header) freeAscGrid(reader->header);
+	delete reader;
+}
+
+
+/*
+** readAscGrid()
+**
+** Reads an arcview grid file and stores all cells into a float array.
+**
+*/
+AscGrid *readAscGrid(const char *file)
+{
+	char buf2[512];
+	sprintf(buf2, "Reading grid: %s ...\n", file);
+	DisplayMessage(buf2);
+
+	AscReader *reader = openAscReader(file);
+	AscGrid *grid = reader->header;
+
+	grid->data = new float[(size_t)grid->rows*grid->cols];
+	if (grid->data == NULL)
+	{
+		fatalError("Out of memory in readAscGrid()");
+	}
+
+	for (int i = 0; i < grid->rows; i++)
+	{
+		readAscRowFloat(reader, grid->data + (size_t)i*grid->cols);
+	}
+
+	// The grid is returned, take it from the reader
+	reader->header = NULL;
+	closeAscReader(reader);
+
+	sprintf(buf2, "Done Reading Grid: %s...\n", file);
+	DisplayMessage(buf2);
+
+	return grid;
+}
+
+
+/*
+** writeAscGridHeader()
+**
+** Writes the 6 header lines of an arcview grid.
+**
+*/
+void writeAscGridHeader(FILE *fp, const AscGrid *header)
+{
+	fprintf(fp, "ncols         %d\n", header->cols);
+	fprintf(fp, "nrows         %d\n", header->rows);
+	fprintf(fp, "xllcorner     %.10g\n", header->xllcorner);
+	fprintf(fp, "yllcorner     %.10g\n", header->yllcorner);
+	fprintf(fp, "cellsize      %.10g\n", header->cellsize);
+	fprintf(fp, "NODATA_value  %g\n", header->noData);
+}
+
+
+/*
+** writeAscGrid()
+**
+** Writes a float array with the size and location of header.
+**
+*/
+void writeAscGrid(const char *file, const AscGrid *header, const float *data)
+{
+	char buf2[512];
+	sprintf(buf2, "Writing grid: %s ...\n", file);
+	DisplayMessage(buf2);
+
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	writeAscGridHeader(fp, header);
+	writeAscGridRows(fp, data, header->rows, header->cols);
+	fclose(fp);
+}
+
+
+/*
+** writeAscGridRows()
+**
+** Writes nrows rows of float values.
+**
+*/
+void writeAscGridRows(FILE *fp, const float *data, int nrows, int cols)
+{
+	for (int i = 0; i < nrows; i++)
+	{
+		const float *row = data + (size_t)i*cols;
+		for (int j = 0; j < cols - 1; j++)
+		{
+			fprintf(fp, "%.7g ", row[j]);
+		}
+		fprintf(fp, "%.7g\n", row[cols - 1]);
+	}
+}
+
+
+/*
+** writeAscGridInt()
+**
+** Writes an integer array with the size and location of header.
+**
+*/
+void writeAscGridInt(const char *file, const AscGrid *header, const int *data)
+{
+	char buf2[512];
+	sprintf(buf2, "Writing grid: %s ...\n", file);
+	DisplayMessage(buf2);
+
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	writeAscGridHeader(fp, header);
+	for (int i = 0; i < header->rows; i++)
+	{
+		const int *row = data + (size_t)i*header->cols;
+		for (int j = 0; j < header->cols - 1; j++)
+		{
+			fprintf(fp, "%d ", row[j]);
+		}
+		fprintf(fp, "%d\n", row[header->cols - 1]);
+	}
+	fclose(fp);
+}
+
+
+/*
+** freeAscGrid()
+**
+** Free the values and the header.
+**
+*/
+void freeAscGrid(AscGrid *grid)
+{
+	if (grid == NULL) { return; }
+	if (grid->data) delete[] grid->data;
+	delete grid;
+}
@@ -0,0 +1,76 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Generic reader and writer for ESRI ASCII grids. Unlike the
+** readers in the App class, these keep every cell of the grid
+** (no land use masking) together with the full header, so that
+** they can be used for terrain processing and for writing
+** result grids.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef ASCGRID_H
+#define ASCGRID_H
+
+#include <stdio.h>
+
+#include "gridstream.h"
+
+// Define a structure to store one grid and its header
+typedef struct AscGrid
+{
+	int rows;
+	int cols;
+	double xllcorner;
+	double yllcorner;
+	double cellsize;
+	double noData;
+
+	// rows*cols values, row major, first row is the north row
+	float *data;
+} AscGrid;
+
+// Read a whole grid into memory.
+AscGrid *readAscGrid(const char *file);
+
+// Read only the header, data is set to NULL.
+AscGrid *readAscHeader(const char *file);
+
+// Reads a grid row by row, for grids that are not kept in memory.
+// Compressed grids are read as well, see gridstream.h.
+typedef struct AscReader
+{
+	GridStream *stream;
+	const char *file;
+	AscGrid *header;
+	char *buf;
+	int row;
+} AscReader;
+
+AscReader *openAscReader(const char *file);
+void readAscRowFloat(AscReader *reader, float *row);
+void readAscRowInt(AscReader *reader, int *row);
+
+// Goes past the next row without parsing it
+void skipAscRow(AscReader *reader);
+void closeAscReader(AscReader *reader);
+
+// Write the header of grid and then the values in data.
+// The values are written with a %.7g format, nodata cells are
+// written as the noData value of the header.
+void writeAscGrid(const char *file, const AscGrid *header, const float *data);
+void writeAscGridInt(const char *file, const AscGrid *header, const int *data);
+
+// Pieces of writeAscGrid() for grids that are written
+// in chunks of rows.
+void writeAscGridHeader(FILE *fp, const AscGrid *header);
+void writeAscGridRows(FILE *fp, const float *data, int nrows, int cols);
+
+void freeAscGrid(AscGrid *grid);
+
+#endif
@@ -0,0 +1,394 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Batch mode over many input directories.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "batch.h"
+#include "engine.h"
+#include "curvefile.h"
+#include "ascgrid.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+// In batch mode an error ends the job, not the program
+static void throwFatal(const char *msg)
+{
+	throw runtime_error(msg);
+}
+
+
+// The progress messages of the jobs would mix, only the
+// lines of the batch itself are printed
+static void dropMessage(const char *, void *)
+{
+}
+
+
+// Error messages end with a newline, the summary needs one line
+static string oneLine(const string &msg)
+{
+	string line = msg;
+	replace(line.begin(), line.end(), '\n', ' ');
+	while (!line.empty() && line[line.size() - 1] == ' ') { line.erase(line.size() - 1); }
+	return line;
+}
+
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+BatchRunner::BatchRunner()
+{
+	nthreads = 0;
+	memoryBudget = 0;
+	curveFormat = CURVES_TEXT;
+	simplify.mode = SIMPLIFY_NONE;
+	simplify.tolerance = 0.0;
+	simplify.npoints = 0;
+	curveText = defaultTextOptions();
+	maxThreads = 1;
+}
+
+
+BatchRunner::~BatchRunner()
+{
+	for (size_t e = 0; e < engines.size(); e++) { delete engines[e]; }
+}
+
+
+/*
+** readManifest()
+**
+** Reads the input and output directories of the jobs.
+**
+*/
+void BatchRunner::readManifest(const char *manifest)
+{
+	char buf2[2048];
+	char first[1024];
+	char second[1024];
+
+	FILE *fp = fopen(manifest, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't find %s\n", manifest);
+		fatalError(buf2);
+	}
+
+	while (fgets(buf2, sizeof(buf2), fp) != NULL)
+	{
+		int nread = sscanf(buf2, "%1023s %1023s", first, second);
+		if (nread <= 0 || first[0] == '#') { continue; }
+
+		BatchJob job;
+		job.dir = first;
+		job.outdir = (nread == 2) ? second : first;
+		job.rows = job.cols = 0;
+		job.threads = 1;
+		job.memory = 0;
+		job.ok = true;
+		job.readTime = job.computeTime = job.writeTime = job.totalTime = 0;
+		jobs.push_back(job);
+	}
+	fclose(fp);
+
+	if (jobs.empty())
+	{
+		sprintf(buf2, "No input directories in %s\n", manifest);
+		fatalError(buf2);
+	}
+}
+
+
+/*
+** sizeJob()
+**
+** Threads and memory of a job from the header of its land use grid.
+** The output directory is made here, so a job that can not write
+** fails before it is read and calculated.
+**
+*/
+void BatchRunner::sizeJob(BatchJob &job)
+{
+	try
+	{
+		AscGrid *header = readAscHeader(joinPath(job.dir, "luws.txt").c_str());
+		job.rows = header->rows;
+		job.cols = header->cols;
+		freeAscGrid(header);
+	}
+	catch (const exception &e)
+	{
+		job.ok = false;
+		job.message = oneLine(e.what());
+		return;
+	}
+	if (!makeDirs(job.outdir))
+	{
+		job.ok = false;
+		job.message = "Can't make the output directory " + job.outdir;
+		return;
+	}
+
+	long long cells = (long long)job.rows*job.cols;
+	long long threads = cells / CELLS_PER_THREAD;
+	job.threads = (int)max(1LL, min((long long)maxThreads, threads));
+	job.memory = (double)cells*BYTES_PER_CELL;
+}
+
+
+/*
+** runJob()
+**
+** Reads, calculates and writes one input directory.
+**
+*/
+void BatchRunner::runJob(BatchJob &job, LorenzEngine *engine)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	try
+	{
+		vector<int> srclus, sinklus;
+		readLuList(joinPath(job.dir, "srclus.txt").c_str(), srclus);
+		readLuList(joinPath(job.dir, "sinklus.txt").c_str(), sinklus);
+
+		engine->nthreads = job.threads;
+		engine->curveFormat = curveFormat;
+		engine->simplify = simplify;
+		engine->curveText = curveText;
+		engine->setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+		engine->readGrids(joinPath(job.dir, "luws.txt").c_str(),
+			joinPath(job.dir, "demws.txt").c_str(),
+			joinPath(job.dir, "distws.txt").c_str(),
+			joinPath(job.dir, "slopews.txt").c_str());
+		job.readTime = secondsSince(start);
+
+		chrono::steady_clock::time_point step = chrono::steady_clock::now();
+		engine->compute();
+		job.computeTime = secondsSince(step);
+
+		step = chrono::steady_clock::now();
+		engine->writeOutputs(joinPath(job.outdir, "").c_str());
+		job.writeTime = secondsSince(step);
+	}
+	catch (const bad_alloc &)
+	{
+		job.ok = false;
+		job.message = "Out of memory";
+	}
+	catch (const exception &e)
+	{
+		job.ok = false;
+		job.message = oneLine(e.what());
+	}
+
+	// Keep the arrays of small jobs for the next one, the
+	// big ones would hold memory the budget gives to others
+	if (!job.ok || (memoryBudget > 0 && job.memory > memoryBudget / maxThreads))
+	{
+		engine->releaseMemory();
+	}
+	else
+	{
+		engine->reset();
+	}
+	job.totalTime = secondsSince(start);
+}
+
+
+/*
+** writeSummary()
+**
+** One line per job in the order of the manifest.
+**
+*/
+void BatchRunner::writeSummary(const char *summaryFile)
+{
+	char buf2[512];
+	FILE *fp = fopen(summaryFile, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", summaryFile);
+		fatalError(buf2);
+	}
+
+	fprintf(fp, "Batch summary\n");
+	fprintf(fp, "Job, Directory, Status, Rows, Cols, Threads, Read_s, Compute_s, Write_s, Total_s, Message\n");
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		const BatchJob &job = jobs[j];
+		fprintf(fp, "%d, %s, %s, %d, %d, %d, %.3f, %.3f, %.3f, %.3f, %s\n",
+			(int)j + 1, job.dir.c_str(), job.ok ? "ok" : "failed",
+			job.rows, job.cols, job.threads,
+			job.readTime, job.computeTime, job.writeTime, job.totalTime,
+			job.message.c_str());
+	}
+	fclose(fp);
+}
+
+
+/*
+** runBatch()
+**
+** The scheduler starts the largest pending job that fits into the
+** free threads and memory. When nothing is running the largest job
+** is started even if it does not fit, with all the threads.
+**
+*/
+int BatchRunner::runBatch(const char *manifest, const char *summaryFile)
+{
+	readManifest(manifest);
+
+	setFatalErrorHandler(throwFatal);
+	setMessageCallback(dropMessage, NULL);
+
+	maxThreads = (nthreads > 0) ? nthreads : numWorkers();
+
+	vector<int> pending;
+	int finished = 0;
+	for (int j = 0; j < (int)jobs.size(); j++)
+	{
+		sizeJob(jobs[j]);
+		if (jobs[j].ok) { pending.push_back(j); continue; }
+
+		finished++;
+		fprintf(stdout, "[%d/%d] %s: failed, %s\n", finished, (int)jobs.size(),
+			jobs[j].dir.c_str(), jobs[j].message.c_str());
+	}
+	stable_sort(pending.begin(), pending.end(), [&](int a, int b)
+	{
+		return (long long)jobs[a].rows*jobs[a].cols > (long long)jobs[b].rows*jobs[b].cols;
+	});
+
+	mutex lock;
+	condition_variable done;
+	int freeThreads = maxThreads;
+	double freeMemory = memoryBudget;
+	int running = 0;
+	vector<LorenzEngine *> idle;
+
+	// A thread per job, joined by the scheduler once it is done
+	vector<thread> workers(jobs.size());
+	vector<int> toJoin;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	unique_lock<mutex> guard(lock);
+	while (!pending.empty())
+	{
+		for (size_t w = 0; w < toJoin.size(); w++)
+		{
+			workers[toJoin[w]].join();
+		}
+		toJoin.clear();
+
+		// Largest pending job that fits
+		size_t next = pending.size();
+		for (size_t p = 0; p < pending.size(); p++)
+		{
+			const BatchJob &job = jobs[pending[p]];
+			if (job.threads <= freeThreads && (memoryBudget <= 0 || job.memory <= freeMemory))
+			{
+				next = p;
+				break;
+			}
+		}
+		if (next == pending.size())
+		{
+			if (running > 0)
+			{
+				done.wait(guard);
+				continue;
+			}
+			next = 0;
+			jobs[pending[0]].threads = freeThreads;
+		}
+
+		int j = pending[next];
+		pending.erase(pending.begin() + next);
+		BatchJob *job = &jobs[j];
+
+		LorenzEngine *engine;
+		if (idle.empty())
+		{
+			engine = new LorenzEngine();
+			engines.push_back(engine);
+		}
+		else
+		{
+			engine = idle.back();
+			idle.pop_back();
+		}
+
+		freeThreads -= job->threads;
+		freeMemory -= job->memory;
+		running++;
+
+		workers[j] = thread([&, j, job, engine]()
+		{
+			runJob(*job, engine);
+
+			lock_guard<mutex> jobGuard(lock);
+			freeThreads += job->threads;
+			freeMemory += job->memory;
+			idle.push_back(engine);
+			running--;
+			finished++;
+			toJoin.push_back(j);
+			fprintf(stdout, "[%d/%d] %s: %s %.3f s%s%s\n", finished, (int)jobs.size(),
+				job->dir.c_str(), job->ok ? "ok" : "failed", job->totalTime,
+				job->ok ? "" : ", ", job->message.c_str());
+			done.notify_all();
+		});
+	}
+	guard.unlock();
+
+	for (size_t w = 0; w < workers.size(); w++)
+	{
+		if (workers[w].joinable()) { workers[w].join(); }
+	}
+
+	setFatalErrorHandler(NULL);
+	setMessageCallback(NULL, NULL);
+
+	writeSummary(summaryFile);
+
+	int nfailed = 0;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		if (!jobs[j].ok) { nfailed++; }
+	}
+
+	char buf2[512];
+	sprintf(buf2, "Batch of %d jobs done in %.3f s, %d failed, summary in %s\n",
+		(int)jobs.size(), secondsSince(start), nfailed, summaryFile);
+	DisplayMessage(buf2);
+
+	return nfailed;
+}
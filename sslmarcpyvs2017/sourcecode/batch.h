@@ -0,0 +1,102 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Batch mode. Runs many input directories (each with the files
+** the PySSLM toolbox writes: srclus.txt, sinklus.txt, luws.txt,
+** demws.txt, distws.txt and slopews.txt) in one process.
+**
+** The jobs are started largest first. A job gets one thread per
+** CELLS_PER_THREAD cells of its grid (at most all of them) and an
+** estimate of its memory; it starts when enough threads and memory
+** are free, and smaller jobs that fit are started in between, so
+** small watersheds are packed around the big ones. The engines
+** and their arrays are kept for the next job.
+**
+** A job that fails is recorded in the summary and the batch goes
+** on with the others.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "simplify.h"
+
+class LorenzEngine;
+
+// Grid cells per thread of a job
+#define CELLS_PER_THREAD (1 << 20)
+
+// Estimated bytes per grid cell of a job: value and
+// percentage of the three factors, with room for the
+// arrays to grow
+#define BYTES_PER_CELL 64
+
+
+// Define a structure for one job of the batch
+typedef struct BatchJob
+{
+	std::string dir;
+	std::string outdir;
+
+	int rows;
+	int cols;
+	int threads;
+	double memory;
+
+	bool ok;
+	std::string message;
+	double readTime;
+	double computeTime;
+	double writeTime;
+	double totalTime;
+} BatchJob;
+
+
+// Define class
+class BatchRunner
+{
+public:
+	BatchRunner();
+	~BatchRunner();
+
+	// Threads of the batch, 0 for the number of cores
+	int nthreads;
+
+	// Memory budget in bytes, 0 for no limit
+	double memoryBudget;
+
+	// Format and simplification of the curve files of the
+	// jobs (curvefile.h, simplify.h)
+	int curveFormat;
+	CurveSimplify simplify;
+
+	// Numbers and compression of the text curve files (textout.h)
+	TextOptions curveText;
+
+	// The manifest has one input directory per line, optionally
+	// followed by the directory to write the outputs to (the input
+	// directory by default). The summary is written to
+	// summaryFile. Returns the number of failed jobs.
+	int runBatch(const char *manifest, const char *summaryFile);
+
+private:
+	void readManifest(const char *manifest);
+	void sizeJob(BatchJob &job);
+	void runJob(BatchJob &job, LorenzEngine *engine);
+	void writeSummary(const char *summaryFile);
+
+	std::vector<BatchJob> jobs;
+	std::vector<LorenzEngine *> engines;
+	int maxThreads;
+};
+
+#endif
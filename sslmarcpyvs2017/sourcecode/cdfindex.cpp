@@ -0,0 +1,481 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Query index over the curves, see cdfindex.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+
+#include "cdfindex.h"
+#include "engine.h"
+#include "lorenz.h"
+#include "parallel.h"
+#include "textout.h"
+#include "message.h"
+
+using namespace std;
+
+// Queries searched side by side
+#define QUERY_GROUP 16
+
+// Queries of a thread at a time in the batched calls
+#define QUERY_BLOCK 65536
+
+// Nodes of a cache line, 8 values or counts
+#define LINE_NODES 8
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER)
+#define PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#define PREFETCH(p)
+#endif
+
+static const char *factorNames[NUM_FACTORS] = { "elev", "dist", "slp" };
+
+
+// Number of trailing 1 bits of k
+static inline int trailingOnes(unsigned long long k)
+{
+	k = ~k;
+#if defined(__GNUC__)
+	return __builtin_ctzll(k);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long bit;
+	_BitScanForward64(&bit, k);
+	return (int)bit;
+#else
+	int n = 0;
+	while ((k & 1) == 0) { k >>= 1; n++; }
+	return n;
+#endif
+}
+
+
+// The search went right (the value was <= x) on the trailing 1 bits
+// of k, the node it went left at last is above them
+static inline long long lastLeft(long long k)
+{
+	return k >> (trailingOnes((unsigned long long)k) + 1);
+}
+
+
+// Offset of the element of store that starts a cache line
+template <class T>
+static size_t lineOffset(const vector<T> &store)
+{
+	size_t misalign = ((size_t)store.data() / sizeof(T)) % LINE_NODES;
+	return (misalign == 0) ? 0 : LINE_NODES - misalign;
+}
+
+
+/*
+** CdfIndex()
+** Constructor of an index without cells.
+*/
+CdfIndex::CdfIndex()
+{
+	valueOffset = 0;
+	countOffset = 0;
+	npoints = 0;
+	ncells = 0;
+	depth = 0;
+}
+
+
+/*
+** build()
+**
+** The tree is filled in order: walking it left, node, right gives
+** the values increasing. The number of cells <= u_j is recovered
+** from its percentage (c_j - 1)*100/n, which is exact to well
+** below half a cell.
+**
+*/
+void CdfIndex::build(const double *values, const double *percents, long long m, long long cells)
+{
+	npoints = m;
+	ncells = cells;
+	depth = 0;
+	while ((1LL << depth) <= m) { depth++; }
+
+	valueStore.assign(m + 1 + LINE_NODES, 0.0);
+	countStore.assign(m + 1 + LINE_NODES, 0);
+	valueOffset = lineOffset(valueStore);
+	countOffset = lineOffset(countStore);
+	below.assign(m + 1, 0);
+	below[0] = ncells;
+	if (m == 0) { return; }
+
+	double *tvalues = valueStore.data() + valueOffset;
+	long long *tcounts = countStore.data() + countOffset;
+
+	// In order walk with a stack of the nodes whose left side is done
+	vector<long long> stack;
+	long long k = 1;
+	long long j = 0;
+	long long previous = 0;
+	while (k <= m || !stack.empty())
+	{
+		if (k <= m)
+		{
+			stack.push_back(k);
+			k = 2*k;
+			continue;
+		}
+		k = stack.back();
+		stack.pop_back();
+
+		long long count = llround(percents[j]*(double)ncells/100.0) + 1;
+		tvalues[k] = values[j];
+		tcounts[k] = count;
+		below[k] = previous;
+		previous = count;
+		j++;
+		k = 2*k + 1;
+	}
+}
+
+
+/*
+** upperNode()
+**
+** Node of the first value > x, 0 if there is none.
+**
+*/
+long long CdfIndex::upperNode(double x) const
+{
+	const double *t = tree();
+	long long k = 1;
+	while (k <= npoints)
+	{
+		PREFETCH(t + k*LINE_NODES);
+		k = 2*k + (t[k] <= x);
+	}
+	return lastLeft(k);
+}
+
+
+/*
+** countNode()
+**
+** Node of the first count >= target, target has to be 1..ncells.
+**
+*/
+long long CdfIndex::countNode(long long target) const
+{
+	const long long *c = counts();
+	long long k = 1;
+	while (k <= npoints)
+	{
+		PREFETCH(c + k*LINE_NODES);
+		k = 2*k + (c[k] < target);
+	}
+	return lastLeft(k);
+}
+
+
+// Smallest count c with c/n >= q, in the arithmetic of cdf()
+static long long targetCount(double q, long long n)
+{
+	if (!(q > 0.0)) { return 1; }
+	if (q >= 1.0) { return n; }
+	long long c = (long long)ceil(q*(double)n);
+	if (c > 1 && (double)(c - 1)/(double)n >= q) { c--; }
+	else if (c < n && (double)c/(double)n < q) { c++; }
+	return c;
+}
+
+
+double CdfIndex::cdf(double x) const
+{
+	if (npoints == 0 || x != x) { return numeric_limits<double>::quiet_NaN(); }
+	return (double)below[upperNode(x)]/(double)ncells;
+}
+
+
+double CdfIndex::quantile(double q) const
+{
+	if (npoints == 0 || !(q <= 1.0)) { return numeric_limits<double>::quiet_NaN(); }
+	return tree()[countNode(targetCount(q, ncells))];
+}
+
+
+/*
+** cdfBlock()
+**
+** QUERY_GROUP searches at a time, level by level: the loads of the
+** group are independent, so their cache misses overlap. All the
+** levels but the last are full, so only the last step tests k.
+**
+*/
+void CdfIndex::cdfBlock(const double *x, long long n, double *out) const
+{
+	const double *t = tree();
+	long long k[QUERY_GROUP];
+
+	for (long long begin = 0; begin < n; begin += QUERY_GROUP)
+	{
+		int g = (n - begin < QUERY_GROUP) ? (int)(n - begin) : QUERY_GROUP;
+		const double *gx = x + begin;
+
+		for (int i = 0; i < g; i++) { k[i] = 1; }
+		for (int level = 1; level < depth; level++)
+		{
+			for (int i = 0; i < g; i++)
+			{
+				PREFETCH(t + k[i]*LINE_NODES);
+				k[i] = 2*k[i] + (t[k[i]] <= gx[i]);
+			}
+		}
+		for (int i = 0; i < g; i++)
+		{
+			if (k[i] <= npoints) { k[i] = 2*k[i] + (t[k[i]] <= gx[i]); }
+			out[begin + i] = (gx[i] == gx[i]) ? (double)below[lastLeft(k[i])]/(double)ncells :
+				numeric_limits<double>::quiet_NaN();
+		}
+	}
+}
+
+
+void CdfIndex::quantileBlock(const double *q, long long n, double *out) const
+{
+	const double *t = tree();
+	const long long *c = counts();
+	long long k[QUERY_GROUP];
+	long long target[QUERY_GROUP];
+
+	for (long long begin = 0; begin < n; begin += QUERY_GROUP)
+	{
+		int g = (n - begin < QUERY_GROUP) ? (int)(n - begin) : QUERY_GROUP;
+		const double *gq = q + begin;
+
+		for (int i = 0; i < g; i++)
+		{
+			k[i] = 1;
+			target[i] = targetCount(gq[i], ncells);
+		}
+		for (int level = 1; level < depth; level++)
+		{
+			for (int i = 0; i < g; i++)
+			{
+				PREFETCH(c + k[i]*LINE_NODES);
+				k[i] = 2*k[i] + (c[k[i]] < target[i]);
+			}
+		}
+		for (int i = 0; i < g; i++)
+		{
+			if (k[i] <= npoints) { k[i] = 2*k[i] + (c[k[i]] < target[i]); }
+			out[begin + i] = (gq[i] <= 1.0) ? t[lastLeft(k[i])] : numeric_limits<double>::quiet_NaN();
+		}
+	}
+}
+
+
+void CdfIndex::cdfBatch(const double *x, long long n, double *out, int nthreads) const
+{
+	if (npoints == 0)
+	{
+		for (long long i = 0; i < n; i++) { out[i] = numeric_limits<double>::quiet_NaN(); }
+		return;
+	}
+
+	int nblocks = (int)((n + QUERY_BLOCK - 1) / QUERY_BLOCK);
+	parallelBands(nblocks, (nthreads > 0) ? nthreads : numWorkers(), [&](int b, int e, int)
+	{
+		long long begin = (long long)b*QUERY_BLOCK;
+		long long end = ((long long)e*QUERY_BLOCK < n) ? (long long)e*QUERY_BLOCK : n;
+		cdfBlock(x + begin, end - begin, out + begin);
+	});
+}
+
+
+void CdfIndex::quantileBatch(const double *q, long long n, double *out, int nthreads) const
+{
+	if (npoints == 0)
+	{
+		for (long long i = 0; i < n; i++) { out[i] = numeric_limits<double>::quiet_NaN(); }
+		return;
+	}
+
+	int nblocks = (int)((n + QUERY_BLOCK - 1) / QUERY_BLOCK);
+	parallelBands(nblocks, (nthreads > 0) ? nthreads : numWorkers(), [&](int b, int e, int)
+	{
+		long long begin = (long long)b*QUERY_BLOCK;
+		long long end = ((long long)e*QUERY_BLOCK < n) ? (long long)e*QUERY_BLOCK : n;
+		quantileBlock(q + begin, end - begin, out + begin);
+	});
+}
+
+
+const CdfIndex &CurveIndexes::get(const LorenzEngine &engine, int luidx, int factor)
+{
+	if (indexes.size() != engine.curveValues.size())
+	{
+		indexes.assign(engine.curveValues.size(), CdfIndex());
+		built.assign(engine.curveValues.size(), 0);
+	}
+
+	int t = luidx*NUM_FACTORS + factor;
+	if (!built[t])
+	{
+		indexes[t].build(engine.curveValues[t].data(), engine.curvePercents[t].data(),
+			(long long)engine.curveValues[t].size(), engine.results[luidx].ncells);
+		built[t] = 1;
+	}
+	return indexes[t];
+}
+
+
+// Next line of fp of any length, false at the end of the file
+static bool readLine(FILE *fp, string &line)
+{
+	char chunk[4096];
+	line.clear();
+	while (fgets(chunk, sizeof(chunk), fp) != NULL)
+	{
+		line += chunk;
+		if (line[line.size() - 1] == '\n') { return true; }
+	}
+	return !line.empty();
+}
+
+
+/*
+** answerQueryFile()
+**
+** The numbers of a line are answered as one batch.
+**
+*/
+void answerQueryFile(const LorenzEngine &engine, const char *file, const char *outFile)
+{
+	char buf2[512];
+
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open query file %s\n", file);
+		fatalError(buf2);
+	}
+	FILE *out = fopen(outFile, "w");
+	if (out == NULL)
+	{
+		fclose(fp);
+		sprintf(buf2, "Can't open %s for writing\n", outFile);
+		fatalError(buf2);
+	}
+
+	CurveIndexes indexes;
+	string line;
+	vector<double> queries;
+	vector<double> answers;
+	long long nqueries = 0;
+	int lineno = 0;
+
+	while (readLine(fp, line))
+	{
+		lineno++;
+		char kind[32];
+		char factorName[32];
+		int luno;
+		int used = 0;
+		if (sscanf(line.c_str(), "%31s", kind) != 1 || kind[0] == '#') { continue; }
+		if (sscanf(line.c_str(), "%31s %d %31s%n", kind, &luno, factorName, &used) != 3 ||
+			(strcmp(kind, "cdf") != 0 && strcmp(kind, "quantile") != 0))
+		{
+			sprintf(buf2, "Line %d of %s is not \"cdf|quantile luno factor values\"\n", lineno, file);
+			fatalError(buf2);
+		}
+
+		int factor = -1;
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			if (!strcmp(factorName, factorNames[f])) { factor = f; }
+		}
+		if (!strcmp(factorName, "slope")) { factor = 2; }
+		if (factorName[0] >= '0' && factorName[0] < '0' + NUM_FACTORS && factorName[1] == '\0') { factor = factorName[0] - '0'; }
+		if (factor < 0)
+		{
+			sprintf(buf2, "Unknown factor %s in line %d of %s (elev, dist, slp or 0..2)\n", factorName, lineno, file);
+			fatalError(buf2);
+		}
+
+		int luidx = -1;
+		for (size_t l = 0; l < engine.results.size(); l++)
+		{
+			if (engine.results[l].luno == luno) { luidx = (int)l; }
+		}
+		if (luidx < 0)
+		{
+			sprintf(buf2, "Land use %d in line %d of %s is not a source or sink\n", luno, lineno, file);
+			fatalError(buf2);
+		}
+
+		queries.clear();
+		const char *p = line.c_str() + used;
+		while (true)
+		{
+			char *end;
+			double value = strtod(p, &end);
+			if (end == p) { break; }
+			queries.push_back(value);
+			p = end;
+		}
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') { p++; }
+		if (*p != '\0')
+		{
+			sprintf(buf2, "Bad number in line %d of %s\n", lineno, file);
+			fatalError(buf2);
+		}
+
+		const CdfIndex &index = indexes.get(engine, luidx, factor);
+		answers.resize(queries.size());
+		if (kind[0] == 'c') { index.cdfBatch(queries.data(), (long long)queries.size(), answers.data(), engine.nthreads); }
+		else { index.quantileBatch(queries.data(), (long long)queries.size(), answers.data(), engine.nthreads); }
+		nqueries += (long long)queries.size();
+
+		TextBuffer text(NUMBERS_SHORTEST);
+		text.append(kind);
+		text.append(' ');
+		text.integer(luno);
+		text.append(' ');
+		text.append(factorNames[factor]);
+		for (size_t i = 0; i < answers.size(); i++)
+		{
+			text.append(' ');
+			text.number(answers[i]);
+		}
+		text.append('\n');
+		fwrite(text.text.data(), 1, text.text.size(), out);
+	}
+	fclose(fp);
+
+	if (fclose(out) != 0)
+	{
+		sprintf(buf2, "Can't write %s\n", outFile);
+		fatalError(buf2);
+	}
+	sprintf(buf2, "%lld queries answered, written to %s\n", nqueries, outFile);
+	DisplayMessage(buf2);
+}
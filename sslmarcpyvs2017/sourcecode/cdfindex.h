@@ -0,0 +1,115 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Query index over the curve of a land use and factor, to answer
+** "what share of the cells of the land use has a value <= x" (CDF)
+** and "the smallest value that at least a share q of the cells has
+** up to" (quantile, the inverse) without reading the curve files.
+**
+** The curve gives the distinct values u_j in increasing order with
+** the percentage (c_j - 1)*100/n, c_j the number of cells <= u_j
+** (lorenz.h), so the counts are recovered exactly:
+**
+**   cdf(x)       c_j/n of the largest u_j <= x, 0 below u_1
+**   quantile(q)  the smallest u_j with c_j >= q*n, u_1 for q <= 0
+**
+** The values and the counts are kept in Eytzinger order (the nodes
+** of a complete binary tree level by level, the children of node k
+** at 2k and 2k + 1), so the search has no branches to mispredict,
+** the first levels stay in the cache and the 8 grandchildren of the
+** third level below a node are one cache line, fetched ahead while
+** the search goes down. The batched calls search 16 queries side by
+** side to keep that many loads in flight, in blocks on threads.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef CDFINDEX_H
+#define CDFINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+class LorenzEngine;
+
+// Define class
+class CdfIndex
+{
+public:
+	CdfIndex();
+
+	// From the m points of a curve of lorenzCurve() (values
+	// increasing) of ncells cells
+	void build(const double *values, const double *percents, long long m, long long ncells);
+
+	// Distinct values
+	long long size() const { return npoints; }
+
+	// Share of the cells <= x, NaN without cells or for a NaN x
+	double cdf(double x) const;
+
+	// Smallest value with cdf() >= q, NaN for q > 1, NaN q or no cells
+	double quantile(double q) const;
+
+	// The same for n queries, nthreads as parallelBands() (0 for
+	// numWorkers())
+	void cdfBatch(const double *x, long long n, double *out, int nthreads) const;
+	void quantileBatch(const double *q, long long n, double *out, int nthreads) const;
+
+private:
+	void cdfBlock(const double *x, long long n, double *out) const;
+	void quantileBlock(const double *q, long long n, double *out) const;
+
+	// Node of the first value > x, the first count >= target
+	long long upperNode(double x) const;
+	long long countNode(long long target) const;
+
+	// Nodes 1..npoints, node 0 is not used. The arrays are over
+	// allocated so that node 0 starts a cache line.
+	std::vector<double> valueStore;
+	std::vector<long long> countStore;
+	size_t valueOffset;
+	size_t countOffset;
+	const double *tree() const { return valueStore.data() + valueOffset; }
+	const long long *counts() const { return countStore.data() + countOffset; }
+
+	// Cells below the value of each node, node 0 holds ncells for
+	// the x above the largest value
+	std::vector<long long> below;
+
+	long long npoints;
+	long long ncells;
+
+	// Levels of the tree, all but the last are full
+	int depth;
+};
+
+
+// Indexes of all the curves of a computed engine, built on first
+// use, index luidx*NUM_FACTORS + factor
+class CurveIndexes
+{
+public:
+	void clear() { indexes.clear(); built.clear(); }
+	const CdfIndex &get(const LorenzEngine &engine, int luidx, int factor);
+
+private:
+	std::vector<CdfIndex> indexes;
+	std::vector<char> built;
+};
+
+
+// Answers the queries of file with the curves of engine and writes
+// one line of answers per query line to outFile. A query line is
+//
+//   cdf luno factor x1 x2 ...
+//   quantile luno factor q1 q2 ...
+//
+// with factor elev, dist, slope or 0..2. # starts a comment.
+void answerQueryFile(const LorenzEngine &engine, const char *file, const char *outFile);
+
+#endif
@@ -0,0 +1,207 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Store of the terrain values of the cells.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "cellstore.h"
+#include "message.h"
+
+using namespace std;
+
+
+/*
+** CellStore()
+** Constructor for the cell store.
+*/
+CellStore::CellStore()
+{
+	header = NULL;
+	ncells = 0;
+	for (int f = 0; f < NUM_FACTORS; f++) { values[f] = NULL; }
+}
+
+
+CellStore::~CellStore()
+{
+	cleanMemory();
+}
+
+
+/*
+** cleanMemory()
+**
+** Free all the dynamically allocated memory that was used.
+**
+*/
+void CellStore::cleanMemory()
+{
+	if (header) freeAscGrid(header);
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		if (values[f]) delete[] values[f];
+		values[f] = NULL;
+	}
+	header = NULL;
+	ncells = 0;
+}
+
+
+/*
+** loadTerrain()
+**
+** The three grids are read row by row at the same time, straight
+** into the store.
+**
+*/
+void CellStore::loadTerrain(const char *demfile, const char *distfile, const char *slopefile)
+{
+	char buf2[512];
+	sprintf(buf2, "Loading terrain into the cell store!!\n");
+	DisplayMessage(buf2);
+
+	AscReader *readers[NUM_FACTORS];
+	readers[0] = openAscReader(demfile);
+	readers[1] = openAscReader(distfile);
+	readers[2] = openAscReader(slopefile);
+
+	int rows = readers[0]->header->rows;
+	int cols = readers[0]->header->cols;
+	for (int f = 1; f < NUM_FACTORS; f++)
+	{
+		if (readers[f]->header->rows != rows || readers[f]->header->cols != cols)
+		{
+			sprintf(buf2, "Size of %s does not match %s\n", readers[f]->file, demfile);
+			fatalError(buf2);
+		}
+	}
+
+	ncells = (long long)rows*cols;
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		values[f] = new float[ncells > 0 ? ncells : 1];
+	}
+	for (int i = 0; i < rows; i++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			readAscRowFloat(readers[f], values[f] + (long long)i*cols);
+		}
+	}
+
+	header = readers[0]->header;
+	readers[0]->header = NULL;
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		closeAscReader(readers[f]);
+	}
+
+	sprintf(buf2, "Finished loading terrain, %lld cells stored!!\n", ncells);
+	DisplayMessage(buf2);
+}
+
+
+/*
+** readLuCodes()
+**
+** Streams the land use grid row by row, the land use grid is never
+** kept in memory, only the code of each cell.
+**
+*/
+signed char *CellStore::readLuCodes(const char *lufile, const int *lunos, int nlus, long long *luctr)
+{
+	char buf2[512];
+	AscReader *reader = openAscReader(lufile);
+	int rows = reader->header->rows;
+	int cols = reader->header->cols;
+	if (rows != header->rows || cols != header->cols)
+	{
+		sprintf(buf2, "Size of %s does not match the terrain grids\n", lufile);
+		fatalError(buf2);
+	}
+
+	signed char *codes = new signed char[ncells > 0 ? ncells : 1];
+	int *row = new int[cols];
+	if (codes == NULL || row == NULL)
+	{
+		fatalError("Out of memory in readLuCodes()");
+	}
+	for (int luidx = 0; luidx < nlus; luidx++) { luctr[luidx] = 0; }
+
+	for (int i = 0; i < rows; i++)
+	{
+		readAscRowInt(reader, row);
+
+		long long rowStart = (long long)i*cols;
+		for (int j = 0; j < cols; j++)
+		{
+			long long p = rowStart + j;
+			int val = row[j];
+			codes[p] = -1;
+			for (int luidx = 0; luidx < nlus; luidx++)
+			{
+				if (lunos[luidx] == val)
+				{
+					codes[p] = (signed char)luidx;
+					luctr[luidx]++;
+					break;
+				}
+			}
+		}
+	}
+
+	delete[] row;
+	closeAscReader(reader);
+	return codes;
+}
+
+
+/*
+** sortLuValues()
+**
+** Scatters the stored values into one array per land use and factor
+** and sorts them.
+**
+*/
+void CellStore::sortLuValues(const signed char *codes, int nlus, const long long *luctr, double **sorted)
+{
+	vector<long long> fill(nlus, 0);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			sorted[luidx*NUM_FACTORS + f] = new double[luctr[luidx] > 0 ? luctr[luidx] : 1];
+		}
+	}
+
+	for (long long p = 0; p < ncells; p++)
+	{
+		int luidx = codes[p];
+		if (luidx < 0) { continue; }
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			sorted[luidx*NUM_FACTORS + f][fill[luidx]] = values[f][p];
+		}
+		fill[luidx]++;
+	}
+
+	for (int t = 0; t < nlus*NUM_FACTORS; t++)
+	{
+		sort(sorted[t], sorted[t] + luctr[t / NUM_FACTORS]);
+	}
+}
@@ -0,0 +1,56 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Store of the terrain values (elevation, distance and slope) of
+** the cells of a watershed, so the terrain grids can be read once
+** and used with many land use grids. Every cell is kept, also the
+** ones where all three grids have nodata: App uses the values of
+** every cell of a listed land use, nodata or not.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef CELLSTORE_H
+#define CELLSTORE_H
+
+#include "ascgrid.h"
+#include "lorenz.h"
+
+// Define class
+class CellStore
+{
+public:
+	CellStore();
+	~CellStore();
+
+	// Size and location of the grids, data is NULL
+	AscGrid *header;
+
+	// Number of cells, rows*cols
+	long long ncells;
+
+	// Elevation, distance and slope of each cell, index
+	// row*cols + col
+	float *values[NUM_FACTORS];
+
+	// Reads the three terrain grids
+	void loadTerrain(const char *demfile, const char *distfile, const char *slopefile);
+
+	// Reads a land use grid and returns for each cell the
+	// index of its land use in lunos, -1 if it is not listed.
+	// The number of cells of each land use is put into luctr.
+	signed char *readLuCodes(const char *lufile, const int *lunos, int nlus, long long *luctr);
+
+	// Sorted values of each land use and factor, for the codes
+	// from readLuCodes(). sorted[luidx*NUM_FACTORS + f] has
+	// luctr[luidx] values and is freed with delete[].
+	void sortLuValues(const signed char *codes, int nlus, const long long *luctr, double **sorted);
+
+	void cleanMemory();
+};
+
+#endif
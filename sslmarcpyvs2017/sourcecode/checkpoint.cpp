@@ -0,0 +1,399 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Checkpoints of the stages of the App pipeline, see checkpoint.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "app.h"
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+// Arrays of the file start at a multiple of this
+#define CHECKPOINT_ALIGN 64
+
+static const char checkpointMagic[8] = { 'S', 'S', 'L', 'M', 'C', 'K', 'P', 'T' };
+static const char *stageNames[4] = { "", "scatter", "sort", "dedup" };
+
+
+// FNV-1a over the bytes
+static unsigned long long hashBytes(unsigned long long hash, const void *data, size_t n)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < n; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+unsigned long long inputFingerprint(const vector<string> &files, const void *extra, size_t extraBytes)
+{
+	const char *suffixes[3] = { "", ".gz", ".zst" };
+	unsigned long long hash = 14695981039346656037ULL;
+	int version = CHECKPOINT_VERSION;
+	hash = hashBytes(hash, &version, sizeof(version));
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		long long stamp[2] = { -1, -1 };
+		struct stat st;
+		for (int k = 0; k < 3; k++)
+		{
+			if (stat((files[i] + suffixes[k]).c_str(), &st) == 0)
+			{
+				stamp[0] = (long long)st.st_size;
+				stamp[1] = (long long)st.st_mtime;
+				break;
+			}
+		}
+		hash = hashBytes(hash, files[i].c_str(), files[i].size() + 1);
+		hash = hashBytes(hash, stamp, sizeof(stamp));
+	}
+	return hashBytes(hash, extra, extraBytes);
+}
+
+
+static long long alignUp(long long pos)
+{
+	return (pos + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+
+// Bytes of the tables after the header
+static long long tableBytes(int nlus, int nfactors, int arrays)
+{
+	return (long long)nlus*2*sizeof(int) + (long long)nlus*nfactors*sizeof(int) +
+		(long long)nlus*nfactors*arrays*sizeof(long long);
+}
+
+
+// Writes zeros up to target
+static bool padTo(FILE *fp, long long &pos, long long target)
+{
+	static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+	size_t n = (size_t)(target - pos);
+	pos = target;
+	return n == 0 || fwrite(zeros, 1, n, fp) == n;
+}
+
+
+// Reads and drops the bytes up to target
+static bool skipTo(FILE *fp, long long &pos, long long target)
+{
+	char skipped[CHECKPOINT_ALIGN];
+	if (target < pos || target - pos > CHECKPOINT_ALIGN) { return false; }
+	size_t n = (size_t)(target - pos);
+	pos = target;
+	return n == 0 || fread(skipped, 1, n, fp) == n;
+}
+
+
+/*
+** StageCheckpoint()
+** Constructor for the checkpoints of the inputs of fingerprint.
+*/
+StageCheckpoint::StageCheckpoint(const char *dir, unsigned long long fingerprint)
+{
+	this->dir = (dir != NULL && dir[0] != 0) ? dir : ".";
+	this->fingerprint = fingerprint;
+	gridOffset = fileSize = 0;
+	active = false;
+	written = 0;
+}
+
+
+StageCheckpoint::~StageCheckpoint()
+{
+	finish();
+}
+
+
+string StageCheckpoint::fileName(int stage) const
+{
+	return dir + "/sslm_" + stageNames[stage] + ".ckpt";
+}
+
+
+/*
+** save()
+**
+** The offsets are laid out here, the thread only writes.
+**
+*/
+void StageCheckpoint::save(const CheckpointData &data)
+{
+	finish();
+
+	job = data;
+	int arrays = job.percents.empty() ? 1 : 2;
+	long long pos = (long long)sizeof(CheckpointHeader) + tableBytes(job.nlus, job.nfactors, arrays);
+	gridOffset = alignUp(pos);
+	pos = gridOffset + (long long)job.rows*job.cols*sizeof(int);
+
+	offsets.resize((size_t)job.nlus*job.nfactors*arrays);
+	for (int luidx = 0; luidx < job.nlus; luidx++)
+	{
+		for (int f = 0; f < job.nfactors; f++)
+		{
+			for (int k = 0; k < arrays; k++)
+			{
+				pos = alignUp(pos);
+				offsets[((size_t)luidx*job.nfactors + f)*arrays + k] = pos;
+				pos += (long long)job.counts[luidx]*sizeof(double);
+			}
+		}
+	}
+	fileSize = pos;
+
+	{
+		lock_guard<mutex> guard(lock);
+		active = true;
+		written = 0;
+		error.clear();
+	}
+	worker = thread(&StageCheckpoint::writeStage, this);
+}
+
+
+/*
+** writeStage()
+**
+** Runs on the thread. The file is written under a temporary name
+** and renamed once it is complete; the checkpoints of the stages
+** before are then removed. An error only drops the checkpoint, it is
+** reported by finish().
+**
+*/
+void StageCheckpoint::writeStage()
+{
+	TraceSpan span("checkpoint", "write");
+	span.arg("stage", job.stage);
+
+	string file = fileName(job.stage);
+	string temp = file + ".tmp";
+	int arrays = job.percents.empty() ? 1 : 2;
+	bool ok = true;
+	long long pos = 0;
+	FILE *fp = fopen(temp.c_str(), "wb");
+	if (fp == NULL) { ok = false; }
+
+	if (ok)
+	{
+		CheckpointHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+		header.version = CHECKPOINT_VERSION;
+		header.stage = job.stage;
+		header.fingerprint = fingerprint;
+		header.rows = job.rows;
+		header.cols = job.cols;
+		header.nlus = job.nlus;
+		header.nfactors = job.nfactors;
+		header.hasPercents = (arrays == 2) ? 1 : 0;
+		header.gridOffset = gridOffset;
+		header.fileSize = fileSize;
+
+		ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+			fwrite(job.lunos.data(), sizeof(int), job.nlus, fp) == (size_t)job.nlus &&
+			fwrite(job.counts.data(), sizeof(int), job.nlus, fp) == (size_t)job.nlus &&
+			fwrite(job.finalctr.data(), sizeof(int), job.finalctr.size(), fp) == job.finalctr.size() &&
+			fwrite(offsets.data(), sizeof(long long), offsets.size(), fp) == offsets.size();
+		pos = (long long)sizeof(header) + tableBytes(job.nlus, job.nfactors, arrays);
+
+		size_t ncells = (size_t)job.rows*job.cols;
+		ok = ok && padTo(fp, pos, gridOffset) && fwrite(job.lugrid, sizeof(int), ncells, fp) == ncells;
+		pos += (long long)ncells*sizeof(int);
+	}
+
+	for (int luidx = 0; luidx < job.nlus && ok; luidx++)
+	{
+		size_t n = (size_t)job.counts[luidx];
+		for (int f = 0; f < job.nfactors && ok; f++)
+		{
+			for (int k = 0; k < arrays && ok; k++)
+			{
+				const double *values = (k == 0) ? job.values[(size_t)luidx*job.nfactors + f] :
+					job.percents[(size_t)luidx*job.nfactors + f];
+				ok = padTo(fp, pos, offsets[((size_t)luidx*job.nfactors + f)*arrays + k]) &&
+					fwrite(values, sizeof(double), n, fp) == n;
+				pos += (long long)n*sizeof(double);
+			}
+		}
+
+		lock_guard<mutex> guard(lock);
+		written = luidx + 1;
+		progress.notify_all();
+	}
+
+	if (fp != NULL && fclose(fp) != 0) { ok = false; }
+	if (ok)
+	{
+		remove(file.c_str());
+		ok = rename(temp.c_str(), file.c_str()) == 0;
+	}
+	if (ok)
+	{
+		for (int stage = CHECKPOINT_SCATTER; stage < job.stage; stage++) { remove(fileName(stage).c_str()); }
+	}
+	else { remove(temp.c_str()); }
+
+	lock_guard<mutex> guard(lock);
+	if (!ok) { error = "Can't write the checkpoint " + file + ", the run goes on without it\n"; }
+	written = job.nlus;
+	active = false;
+	progress.notify_all();
+}
+
+
+void StageCheckpoint::waitWritten(int luidx)
+{
+	unique_lock<mutex> guard(lock);
+	if (active && written <= luidx)
+	{
+		TraceSpan span("checkpoint", "wait");
+		progress.wait(guard, [&]() { return !active || written > luidx; });
+	}
+}
+
+
+void StageCheckpoint::finish()
+{
+	if (worker.joinable()) { worker.join(); }
+	if (!error.empty())
+	{
+		DisplayMessage(error.c_str());
+		error.clear();
+	}
+}
+
+
+void StageCheckpoint::removeAll()
+{
+	finish();
+	for (int stage = CHECKPOINT_SCATTER; stage <= CHECKPOINT_DEDUP; stage++)
+	{
+		remove(fileName(stage).c_str());
+	}
+}
+
+
+/*
+** readStage()
+**
+** False if the file is missing, of other inputs or not complete.
+**
+*/
+bool StageCheckpoint::readStage(int stage, CheckpointData &data)
+{
+	FILE *fp = fopen(fileName(stage).c_str(), "rb");
+	if (fp == NULL) { return false; }
+
+	CheckpointHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, checkpointMagic, sizeof(header.magic)) == 0 &&
+		header.version == CHECKPOINT_VERSION && header.stage == stage &&
+		header.fingerprint == fingerprint &&
+		header.rows > 0 && header.cols > 0 &&
+		header.nlus > 0 && header.nlus <= MAX_LUIDS &&
+		header.nfactors > 0 && header.nfactors <= MAX_FACTORS;
+	if (!ok)
+	{
+		fclose(fp);
+		return false;
+	}
+
+	int arrays = header.hasPercents ? 2 : 1;
+	data.stage = stage;
+	data.rows = header.rows;
+	data.cols = header.cols;
+	data.nlus = header.nlus;
+	data.nfactors = header.nfactors;
+	data.lunos.resize(data.nlus);
+	data.counts.resize(data.nlus);
+	data.finalctr.resize((size_t)data.nlus*data.nfactors);
+	vector<long long> offs((size_t)data.nlus*data.nfactors*arrays);
+	ok = fread(data.lunos.data(), sizeof(int), data.nlus, fp) == (size_t)data.nlus &&
+		fread(data.counts.data(), sizeof(int), data.nlus, fp) == (size_t)data.nlus &&
+		fread(data.finalctr.data(), sizeof(int), data.finalctr.size(), fp) == data.finalctr.size() &&
+		fread(offs.data(), sizeof(long long), offs.size(), fp) == offs.size();
+	long long pos = (long long)sizeof(header) + tableBytes(data.nlus, data.nfactors, arrays);
+
+	size_t ncells = (size_t)data.rows*data.cols;
+	data.lugrid = NULL;
+	if (ok)
+	{
+		data.lugrid = new int[ncells];
+		ok = skipTo(fp, pos, header.gridOffset) && fread(data.lugrid, sizeof(int), ncells, fp) == ncells;
+		pos += (long long)ncells*sizeof(int);
+	}
+
+	data.values.assign((size_t)data.nlus*data.nfactors, (double *)NULL);
+	data.percents.assign(arrays == 2 ? data.values.size() : 0, (double *)NULL);
+	for (int luidx = 0; luidx < data.nlus && ok; luidx++)
+	{
+		size_t n = (size_t)data.counts[luidx];
+		ok = data.counts[luidx] >= 0 && (long long)n <= (long long)ncells;
+		for (int f = 0; f < data.nfactors && ok; f++)
+		{
+			for (int k = 0; k < arrays && ok; k++)
+			{
+				double *&array = (k == 0) ? data.values[(size_t)luidx*data.nfactors + f] :
+					data.percents[(size_t)luidx*data.nfactors + f];
+				array = new double[n];
+				ok = skipTo(fp, pos, offs[((size_t)luidx*data.nfactors + f)*arrays + k]) &&
+					fread(array, sizeof(double), n, fp) == n;
+				pos += (long long)n*sizeof(double);
+			}
+		}
+	}
+	ok = ok && pos == header.fileSize;
+	fclose(fp);
+
+	if (!ok)
+	{
+		delete[] data.lugrid;
+		data.lugrid = NULL;
+		for (size_t i = 0; i < data.values.size(); i++) { delete[] data.values[i]; }
+		for (size_t i = 0; i < data.percents.size(); i++) { delete[] data.percents[i]; }
+		data.values.clear();
+		data.percents.clear();
+	}
+	return ok;
+}
+
+
+int StageCheckpoint::load(CheckpointData &data)
+{
+	char buf2[512];
+	for (int stage = CHECKPOINT_DEDUP; stage >= CHECKPOINT_SCATTER; stage--)
+	{
+		TraceSpan span("checkpoint", "read");
+		span.arg("stage", stage);
+		if (readStage(stage, data))
+		{
+			sprintf(buf2, "Resuming after the %s stage from %s\n", stageNames[stage], fileName(stage).c_str());
+			DisplayMessage(buf2);
+			return stage;
+		}
+	}
+	return CHECKPOINT_NONE;
+}
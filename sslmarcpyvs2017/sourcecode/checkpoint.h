@@ -0,0 +1,149 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Checkpoints of the stages of the App pipeline, so that a run that
+** is stopped (a preempted batch node, a crash) resumes from the last
+** stage it finished instead of reading and sorting the grids again.
+**
+** A checkpoint is written after the scatter (asc2ludata()), the sort
+** and the removal of the duplicates, to <dir>/sslm_scatter.ckpt,
+** sslm_sort.ckpt and sslm_dedup.ckpt. Each file has the land use
+** grid, the values (and after the dedup the percentages) of every
+** land use and factor and a fingerprint of the inputs. A checkpoint
+** replaces the one of the stage before once it is complete, and all
+** of them are removed when the outputs are written, so a directory
+** holds the checkpoints of one run.
+**
+** The file is written on a thread while the next stage runs. It is
+** written one land use after the other, in the order the sort and
+** the dedup work on them in place, so a stage only waits for the
+** land use it is about to change (waitWritten()). The file appears
+** under its name only once it is complete.
+**
+** Layout (native byte order, every array starts at a multiple of
+** 64 bytes, so the file can be mapped, e.g. numpy.memmap):
+**
+**   CheckpointHeader
+**   int    lunos[nlus]
+**   int    counts[nlus]                 cells of each land use
+**   int    finalctr[nlus][nfactors]     distinct values
+**   int64  offsets[nlus][nfactors][k]   values, then percentages
+**                                       (k = 2 with hasPercents)
+**   int    lu grid[rows][cols]          at gridOffset
+**   double arrays of counts[lu] values  at the offsets
+**
+** The fingerprint covers the names, sizes and modification times of
+** the input files, the factors and the watershed mask, not the bytes
+** of the grids, so the inputs are not read twice.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECKPOINT_VERSION 1
+
+// Stages, in the order of the pipeline
+#define CHECKPOINT_NONE 0
+#define CHECKPOINT_SCATTER 1
+#define CHECKPOINT_SORT 2
+#define CHECKPOINT_DEDUP 3
+
+typedef struct CheckpointHeader
+{
+	char magic[8];
+	int version;
+	int stage;
+	unsigned long long fingerprint;
+	int rows;
+	int cols;
+	int nlus;
+	int nfactors;
+	int hasPercents;
+	int reserved;
+	long long gridOffset;
+	long long fileSize;
+	char padding[64];
+} CheckpointHeader;
+
+// Arrays of a stage. The arrays are index luidx*nfactors + factor
+// and have counts[luidx] values each.
+typedef struct CheckpointData
+{
+	int stage;
+	int rows;
+	int cols;
+	int *lugrid;
+	int nlus;
+	int nfactors;
+	std::vector<int> lunos;
+	std::vector<int> counts;
+	std::vector<int> finalctr;
+	std::vector<double *> values;
+	std::vector<double *> percents;
+} CheckpointData;
+
+// Fingerprint of the input files (or their .gz, .zst) and of extra,
+// e.g. the factors and the watershed mask
+unsigned long long inputFingerprint(const std::vector<std::string> &files, const void *extra, size_t extraBytes);
+
+// Define class
+class StageCheckpoint
+{
+public:
+	StageCheckpoint(const char *dir, unsigned long long fingerprint);
+	~StageCheckpoint();
+
+	// The latest complete checkpoint of the inputs, CHECKPOINT_NONE
+	// without one. The arrays of data are new[] and belong to the
+	// caller. Checkpoints of other inputs or versions are ignored.
+	int load(CheckpointData &data);
+
+	// Starts writing data on the thread, after the checkpoint before
+	// is done. The arrays must stay until finish(), and a land use
+	// must not change before waitWritten() of it.
+	void save(const CheckpointData &data);
+
+	// Waits until the arrays of land use luidx are written
+	void waitWritten(int luidx);
+
+	// Waits for the thread and reports a write that failed
+	void finish();
+
+	// Removes the checkpoints of all stages
+	void removeAll();
+
+private:
+	std::string fileName(int stage) const;
+	void writeStage();
+	bool readStage(int stage, CheckpointData &data);
+
+	std::string dir;
+	unsigned long long fingerprint;
+
+	// Checkpoint being written and its offsets
+	CheckpointData job;
+	std::vector<long long> offsets;
+	long long gridOffset;
+	long long fileSize;
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable progress;
+	bool active;
+	int written;
+	std::string error;
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** NPY files of the lorenz curves and their JSON index.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "curvefile.h"
+#include "textout.h"
+#include "message.h"
+
+using namespace std;
+
+// Buffer of the writes, the rows are copied straight from the
+// arrays of the curves
+#define CURVE_BUFFER (4 << 20)
+
+static const char *curveNames[NUM_FACTORS] = { "elev", "dist", "slp" };
+
+
+CurveSpan curveSpan(const double *values, const double *percents, long long m, int factor)
+{
+	CurveSpan span;
+	span.values = values;
+	span.percents = percents;
+	span.nhead = (m > 2) ? m - 2 : 0;
+	span.last = (factor == 0) ? m - 1 : m - 2;
+	if (span.last < 0 && m > 0) { span.last = 0; }
+	return span;
+}
+
+
+CurveSpan fullCurveSpan(const double *values, const double *percents, long long m)
+{
+	CurveSpan span;
+	span.values = values;
+	span.percents = percents;
+	span.nhead = m;
+	span.last = -1;
+	return span;
+}
+
+
+static FILE *openCurveFile(const string &name)
+{
+	FILE *fp = fopen(name.c_str(), "wb");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", name.c_str());
+		fatalError(buf2);
+	}
+	setvbuf(fp, NULL, _IOFBF, CURVE_BUFFER);
+	return fp;
+}
+
+
+static void writeBlock(FILE *fp, const void *data, size_t size, const string &name)
+{
+	if (size > 0 && fwrite(data, 1, size, fp) != size)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't write %s\n", name.c_str());
+		fatalError(buf2);
+	}
+}
+
+
+/*
+** writeCurveTextFile()
+**
+** Values and percentages of each land use on two lines each. The
+** lines of a large curve are formatted in parallel by writeItems().
+**
+*/
+void writeCurveTextFile(const char *prefix, const char *file, const CurveSpan *spans, int stride,
+	const int *lunos, int nlus, const TextOptions &options)
+{
+	char line[128];
+	string name = string((prefix != NULL) ? prefix : "") + file;
+	TextSink *sink = openTextSink(name, options.compression);
+
+	sprintf(line, "No duplicated data for %s\n", file);
+	sink->write(line, strlen(line));
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		const CurveSpan &span = spans[luidx*stride];
+		for (int k = 0; k < 2; k++)
+		{
+			const double *points = (k == 0) ? span.values : span.percents;
+			sprintf(line, "%s for land use NO: %d\n", (k == 0) ? "Value" : "Percentage", lunos[luidx]);
+			sink->write(line, strlen(line));
+
+			long long n = span.nhead + ((span.last >= 0) ? 1 : 0);
+			if (n == 0)
+			{
+				TextBuffer zero(options.numbers);
+				zero.number(0.0);
+				zero.append('\n');
+				sink->write(zero.text.data(), zero.text.size());
+				continue;
+			}
+
+			writeItems(sink, n, options, [&](long long begin, long long end, TextBuffer &buffer)
+			{
+				for (long long index = begin; index < end; index++)
+				{
+					buffer.number((index < span.nhead) ? points[index] : points[span.last]);
+					buffer.append((index < n - 1) ? ',' : '\n');
+				}
+			});
+		}
+	}
+	sink->close();
+	delete sink;
+}
+
+
+static const char *factorName(int factor, const char *const *extraNames)
+{
+	return (factor < NUM_FACTORS) ? curveNames[factor] : extraNames[factor - NUM_FACTORS];
+}
+
+
+void writeCurveText(const char *prefix, const CurveSpan *spans, const int *lunos, int nlus, const TextOptions &options,
+	int nfactors, const char *const *extraNames)
+{
+	for (int f = 0; f < nfactors; f++)
+	{
+		string file = string(factorName(f, extraNames)) + "_dataperc.txt";
+		writeCurveTextFile(prefix, file.c_str(), spans + f, nfactors, lunos, nlus, options);
+	}
+}
+
+
+/*
+** writeNpy()
+**
+** Version 1.0 header padded so the data starts at a multiple of
+** 64 bytes, then the values row and the percentages row.
+**
+*/
+static void writeNpy(const string &name, const CurveSpan *spans, int nlus, int nfactors, int factor, long long total)
+{
+	const unsigned short one = 1;
+	bool little = (*(const unsigned char *)&one == 1);
+
+	char dict[256];
+	sprintf(dict, "{'descr': '%sf8', 'fortran_order': False, 'shape': (2, %lld), }",
+		little ? "<" : ">", total);
+	string header = dict;
+	while ((10 + header.size() + 1) % 64 != 0) { header += ' '; }
+	header += '\n';
+
+	unsigned char preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, 0, 0 };
+	preamble[8] = (unsigned char)(header.size() & 0xff);
+	preamble[9] = (unsigned char)(header.size() >> 8);
+
+	FILE *fp = openCurveFile(name);
+	writeBlock(fp, preamble, sizeof(preamble), name);
+	writeBlock(fp, header.data(), header.size(), name);
+
+	for (int row = 0; row < 2; row++)
+	{
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			const CurveSpan &span = spans[luidx*nfactors + factor];
+			const double *points = (row == 0) ? span.values : span.percents;
+			writeBlock(fp, points, sizeof(double)*span.nhead, name);
+			if (span.last >= 0) { writeBlock(fp, &points[span.last], sizeof(double), name); }
+		}
+	}
+
+	if (fclose(fp) != 0)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't write %s\n", name.c_str());
+		fatalError(buf2);
+	}
+}
+
+
+/*
+** writeCurveFiles()
+**
+** The names in the index are relative to the directory of the
+** index, so the files can be moved together.
+**
+*/
+void writeCurveFiles(const char *prefix, const CurveSpan *spans, const int *lunos, int nsrclus, int nlus,
+	int nfactors, const char *const *extraNames)
+{
+	string base = (prefix != NULL) ? prefix : "";
+	size_t slash = base.find_last_of("/\\");
+	string local = (slash == string::npos) ? base : base.substr(slash + 1);
+
+	vector<long long> offsets(nlus*nfactors), counts(nlus*nfactors);
+	for (int f = 0; f < nfactors; f++)
+	{
+		long long total = 0;
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			const CurveSpan &span = spans[luidx*nfactors + f];
+			offsets[luidx*nfactors + f] = total;
+			counts[luidx*nfactors + f] = span.nhead + ((span.last >= 0) ? 1 : 0);
+			total += counts[luidx*nfactors + f];
+		}
+		writeNpy(base + factorName(f, extraNames) + "_dataperc.npy", spans, nlus, nfactors, f, total);
+	}
+
+	string name = base + "dataperc_index.json";
+	FILE *fp = fopen(name.c_str(), "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", name.c_str());
+		fatalError(buf2);
+	}
+
+	fprintf(fp, "{\"version\": 1,\n \"files\": {");
+	for (int f = 0; f < nfactors; f++)
+	{
+		const char *name = factorName(f, extraNames);
+		fprintf(fp, "%s\"%s\": \"%s%s_dataperc.npy\"", (f > 0) ? ", " : "", name, local.c_str(), name);
+	}
+	fprintf(fp, "},\n \"landuses\": [");
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		fprintf(fp, "%s\n  {\"luno\": %d, \"source\": %s", (luidx > 0) ? "," : "",
+			lunos[luidx], (luidx < nsrclus) ? "true" : "false");
+		for (int f = 0; f < nfactors; f++)
+		{
+			fprintf(fp, ", \"%s\": [%lld, %lld]", factorName(f, extraNames),
+				offsets[luidx*nfactors + f], counts[luidx*nfactors + f]);
+		}
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+}
@@ -0,0 +1,82 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Binary output of the lorenz curves. Instead of elev_dataperc.txt,
+** dist_dataperc.txt and slp_dataperc.txt the points are written to
+** elev_dataperc.npy, dist_dataperc.npy and slp_dataperc.npy, NumPy
+** arrays of shape (2, n) in float64: row 0 holds the values and row
+** 1 the percentages of the curves of all land uses one after the
+** other. dataperc_index.json gives for each land use the offset and
+** number of its points in each file:
+**
+**   {"version": 1,
+**    "files": {"elev": "elev_dataperc.npy", ...},
+**    "landuses": [{"luno": 1, "source": true,
+**                  "elev": [offset, count], "dist": [...], "slp": [...]},
+**                 ...]}
+**
+** The factors added to App with -factor get a file and an entry of
+** their own name as well (soil_dataperc.npy, "soil").
+**
+** The points are the ones of the text files (which leave out one
+** point near the end of each curve, see App::writeFactorData()), at
+** full precision. Each row is written with a few large writes, and
+** numpy.load(..., mmap_mode="r") maps the files without parsing.
+**
+** The text files are written here as well, see textout.h for the
+** number formats and compression.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef CURVEFILE_H
+#define CURVEFILE_H
+
+#include "lorenz.h"
+#include "textout.h"
+
+// Formats of the curve files
+#define CURVES_TEXT 0
+#define CURVES_NPY 1
+
+// Points of one curve as the text files have them: the first nhead
+// points, then the point at index last (none if last is negative).
+typedef struct CurveSpan
+{
+	const double *values;
+	const double *percents;
+	long long nhead;
+	long long last;
+} CurveSpan;
+
+// Span of a curve of m points of factor as App writes it
+CurveSpan curveSpan(const double *values, const double *percents, long long m, int factor);
+
+// Span of all m points of a curve
+CurveSpan fullCurveSpan(const double *values, const double *percents, long long m);
+
+// Writes the curves of a factor to prefix + file with the layout of
+// App::writeFactorData(), numbers and compression as in options.
+// spans is the span of the first land use, the next land use is
+// stride spans further.
+void writeCurveTextFile(const char *prefix, const char *file, const CurveSpan *spans, int stride,
+	const int *lunos, int nlus, const TextOptions &options);
+
+// Writes elev_dataperc.txt, dist_dataperc.txt and slp_dataperc.txt.
+// spans has nfactors spans per land use, the factors after the first
+// NUM_FACTORS are named by extraNames (soil makes soil_dataperc.txt).
+void writeCurveText(const char *prefix, const CurveSpan *spans, const int *lunos, int nlus, const TextOptions &options,
+	int nfactors = NUM_FACTORS, const char *const *extraNames = NULL);
+
+// Writes elev_dataperc.npy, dist_dataperc.npy, slp_dataperc.npy
+// and dataperc_index.json with prefix in front of the names. spans
+// has nfactors spans per land use as in writeCurveText(), lunos the
+// sources first.
+void writeCurveFiles(const char *prefix, const CurveSpan *spans, const int *lunos, int nsrclus, int nlus,
+	int nfactors = NUM_FACTORS, const char *const *extraNames = NULL);
+
+#endif
@@ -0,0 +1,855 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Workers, coordinator and transports of the distributed mode, see
+** distributed.h.
+**
+** A partial is 8 byte numbers in the byte order of the machine:
+**
+**   "SSLMPRT1", rows, cols, first row, end row, sources, sinks,
+**   the land use numbers, then per land use its cells and per
+**   factor the number m of distinct values, the m values (doubles)
+**   and the m counts.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/select.h>
+#include <netdb.h>
+#endif
+
+#include "distributed.h"
+#include "socketio.h"
+#include "app.h"
+#include "engine.h"
+#include "ascgrid.h"
+#include "simplify.h"
+#include "parallel.h"
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+#define PARTIAL_MAGIC "SSLMPRT1"
+
+// Rows of the band read before they are pushed
+#define BAND_CHUNK_CELLS (1 << 20)
+
+// Milliseconds between the checks for partials and connections
+#define POLL_MS 200
+
+// Longest header line of a partial sent over tcp
+#define MAX_HEADER_LINE 4096
+
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+static void pollSleep()
+{
+	this_thread::sleep_for(chrono::milliseconds(POLL_MS));
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Partials
+
+template <typename T>
+static void putValue(vector<char> &out, T value)
+{
+	size_t n = out.size();
+	out.resize(n + sizeof(T));
+	memcpy(&out[n], &value, sizeof(T));
+}
+
+
+/*
+** PartialReader
+**
+** Reads the numbers of a partial in order, a partial that ends too
+** early is a fatal error.
+**
+*/
+class PartialReader
+{
+public:
+	PartialReader(const vector<char> &bytes, int k) : data(bytes), pos(0), band(k) {}
+
+	long long next()
+	{
+		long long value;
+		need(sizeof(value));
+		memcpy(&value, &data[pos], sizeof(value));
+		pos += sizeof(value);
+		return value;
+	}
+
+	// Offset of an array of n numbers, which is skipped
+	size_t skip(long long n)
+	{
+		size_t start = pos;
+		if (n < 0) { need(data.size() + 1); }
+		need((size_t)n * 8);
+		pos += (size_t)n * 8;
+		return start;
+	}
+
+	void need(size_t n)
+	{
+		if (pos + n > data.size())
+		{
+			char buf2[512];
+			sprintf(buf2, "The partial of band %d is cut short or damaged\n", band);
+			fatalError(buf2);
+		}
+	}
+
+	const vector<char> &data;
+	size_t pos;
+	int band;
+};
+
+
+// A received partial, the arrays stay in the bytes
+typedef struct BandPartial
+{
+	int rows;
+	int cols;
+	int rowStart;
+	int rowEnd;
+	int nsrclus;
+	int nsinklus;
+	vector<int> lunos;
+	vector<long long> ncells;
+
+	// Per land use and factor (luidx*NUM_FACTORS + f): distinct
+	// values and the offsets of the values and the counts
+	vector<long long> nvalues;
+	vector<size_t> valueAt;
+	vector<size_t> countAt;
+} BandPartial;
+
+
+static void parsePartial(const vector<char> &bytes, int band, BandPartial &part)
+{
+	char buf2[512];
+	PartialReader reader(bytes, band);
+	reader.need(8);
+	if (memcmp(&bytes[0], PARTIAL_MAGIC, 8) != 0)
+	{
+		sprintf(buf2, "The partial of band %d is not a partial of this program\n", band);
+		fatalError(buf2);
+	}
+	reader.pos = 8;
+
+	part.rows = (int)reader.next();
+	part.cols = (int)reader.next();
+	part.rowStart = (int)reader.next();
+	part.rowEnd = (int)reader.next();
+	part.nsrclus = (int)reader.next();
+	part.nsinklus = (int)reader.next();
+	int nlus = part.nsrclus + part.nsinklus;
+	if (part.nsrclus < 0 || part.nsinklus < 0 || nlus <= 0 || nlus > MAX_LUIDS)
+	{
+		sprintf(buf2, "The partial of band %d has %d land uses\n", band, nlus);
+		fatalError(buf2);
+	}
+
+	part.lunos.resize(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++) { part.lunos[luidx] = (int)reader.next(); }
+
+	part.ncells.resize(nlus);
+	part.nvalues.resize(nlus*NUM_FACTORS);
+	part.valueAt.resize(nlus*NUM_FACTORS);
+	part.countAt.resize(nlus*NUM_FACTORS);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		part.ncells[luidx] = reader.next();
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			int t = luidx*NUM_FACTORS + f;
+			part.nvalues[t] = reader.next();
+			part.valueAt[t] = reader.skip(part.nvalues[t]);
+			part.countAt[t] = reader.skip(part.nvalues[t]);
+		}
+	}
+}
+
+
+static double partValue(const vector<char> &bytes, const BandPartial &part, int t, long long i)
+{
+	double value;
+	memcpy(&value, &bytes[part.valueAt[t] + (size_t)i * 8], sizeof(value));
+	return value;
+}
+
+
+static long long partCount(const vector<char> &bytes, const BandPartial &part, int t, long long i)
+{
+	long long count;
+	memcpy(&count, &bytes[part.countAt[t] + (size_t)i * 8], sizeof(count));
+	return count;
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Shared directory
+
+// Define class
+class DirTransport : public PartialTransport
+{
+public:
+	DirTransport(const string &path) : dir(path) {}
+
+	void send(int band, int nbands, const vector<char> &data);
+	void receive(int nbands, vector<vector<char> > &parts);
+	void finish(int nbands);
+
+private:
+	string partFile(int band, int nbands);
+
+	string dir;
+};
+
+
+string DirTransport::partFile(int band, int nbands)
+{
+	char name[64];
+	sprintf(name, "band_%d_of_%d.part", band, nbands);
+	return joinPath(dir, name);
+}
+
+
+// The partial is renamed into place once complete, so the
+// coordinator never reads half a file
+void DirTransport::send(int band, int nbands, const vector<char> &data)
+{
+	char buf2[512];
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+	string file = partFile(band, nbands);
+	string temp = file + ".tmp";
+	FILE *fp = fopen(temp.c_str(), "wb");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %.400s for writing\n", temp.c_str());
+		fatalError(buf2);
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok = (fclose(fp) == 0) && ok;
+	remove(file.c_str());
+	if (!ok || rename(temp.c_str(), file.c_str()) != 0)
+	{
+		sprintf(buf2, "Can't write %.400s\n", file.c_str());
+		fatalError(buf2);
+	}
+}
+
+
+static bool readWholeFile(const string &file, vector<char> &data)
+{
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL) { return false; }
+	data.clear();
+	char buf[1 << 16];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof buf, fp)) > 0) { data.insert(data.end(), buf, buf + n); }
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+
+void DirTransport::receive(int nbands, vector<vector<char> > &parts)
+{
+	char buf2[512];
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parts.assign(nbands, vector<char>());
+	vector<bool> got(nbands, false);
+	int ngot = 0;
+
+	sprintf(buf2, "Waiting for %d partials in %.400s\n", nbands, dir.c_str());
+	DisplayMessage(buf2);
+	while (true)
+	{
+		for (int k = 0; k < nbands; k++)
+		{
+			if (!got[k] && readWholeFile(partFile(k, nbands), parts[k]))
+			{
+				got[k] = true;
+				ngot++;
+			}
+		}
+		if (ngot == nbands) { return; }
+
+		if (cancel != NULL && cancel->load())
+		{
+			fatalError("A worker failed, the partials are not complete\n");
+		}
+		if (timeout > 0 && secondsSince(start) > timeout)
+		{
+			sprintf(buf2, "Only %d of %d partials arrived in %.400s\n", ngot, nbands, dir.c_str());
+			fatalError(buf2);
+		}
+		pollSleep();
+	}
+}
+
+
+void DirTransport::finish(int nbands)
+{
+	for (int k = 0; k < nbands; k++) { remove(partFile(k, nbands).c_str()); }
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Sockets
+
+// Define class
+class TcpTransport : public PartialTransport
+{
+public:
+	TcpTransport(const string &h, const string &p) : host(h), port(p) {}
+
+	void send(int band, int nbands, const vector<char> &data);
+	void receive(int nbands, vector<vector<char> > &parts);
+
+private:
+	string host;
+	string port;
+};
+
+
+static struct addrinfo *resolve(const string &host, const string &port, bool passive)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+	struct addrinfo *list = NULL;
+	const char *name = (passive && host == "*") ? NULL : host.c_str();
+	if (!startSockets() || getaddrinfo(name, port.c_str(), &hints, &list) != 0)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't find the address %.200s:%.200s\n", host.c_str(), port.c_str());
+		fatalError(buf2);
+	}
+	return list;
+}
+
+
+// Without a listener a local port can be connected to itself when
+// it is also the port the connection goes out from
+static bool connectedToSelf(socket_t fd)
+{
+	struct sockaddr_storage local, peer;
+	socklen_t nlocal = sizeof(local), npeer = sizeof(peer);
+	if (getsockname(fd, (struct sockaddr *)&local, &nlocal) != 0 || getpeername(fd, (struct sockaddr *)&peer, &npeer) != 0)
+	{
+		return false;
+	}
+	return nlocal == npeer && memcmp(&local, &peer, nlocal) == 0;
+}
+
+
+/*
+** send()
+**
+** The coordinator may not be listening yet, so the connection is
+** tried again until the timeout. A partial is "band k n bytes" and
+** the bytes, answered with "ok".
+**
+*/
+void TcpTransport::send(int band, int nbands, const vector<char> &data)
+{
+	char buf2[512];
+	struct addrinfo *list = resolve(host, port, false);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	socket_t fd = INVALID_SOCKET;
+	while (fd == INVALID_SOCKET)
+	{
+		for (struct addrinfo *a = list; a != NULL && fd == INVALID_SOCKET; a = a->ai_next)
+		{
+			fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+			if (fd != INVALID_SOCKET && (connect(fd, a->ai_addr, (int)a->ai_addrlen) != 0 || connectedToSelf(fd)))
+			{
+				closeSocket(fd);
+				fd = INVALID_SOCKET;
+			}
+		}
+		if (fd == INVALID_SOCKET)
+		{
+			if (timeout > 0 && secondsSince(start) > timeout)
+			{
+				freeaddrinfo(list);
+				sprintf(buf2, "Can't connect to the coordinator at %.200s:%.200s\n", host.c_str(), port.c_str());
+				fatalError(buf2);
+			}
+			pollSleep();
+		}
+	}
+	freeaddrinfo(list);
+	setSocketTimeout(fd, timeout);
+
+	sprintf(buf2, "band %d %d %lld\n", band, nbands, (long long)data.size());
+	string pending, answer;
+	bool ok = sendAll(fd, buf2, strlen(buf2)) && sendAll(fd, data.data(), data.size()) &&
+		readLine(fd, pending, answer, MAX_HEADER_LINE) && answer == "ok";
+	closeSocket(fd);
+	if (!ok)
+	{
+		sprintf(buf2, "The coordinator at %.200s:%.200s did not take the partial of band %d\n",
+			host.c_str(), port.c_str(), band);
+		fatalError(buf2);
+	}
+}
+
+
+void TcpTransport::receive(int nbands, vector<vector<char> > &parts)
+{
+	char buf2[512];
+	struct addrinfo *list = resolve(host, port, true);
+	socket_t listenfd = INVALID_SOCKET;
+	for (struct addrinfo *a = list; a != NULL && listenfd == INVALID_SOCKET; a = a->ai_next)
+	{
+		listenfd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (listenfd == INVALID_SOCKET) { continue; }
+		int yes = 1;
+		setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes));
+		if (bind(listenfd, a->ai_addr, (int)a->ai_addrlen) != 0 || listen(listenfd, 16) != 0)
+		{
+			closeSocket(listenfd);
+			listenfd = INVALID_SOCKET;
+		}
+	}
+	freeaddrinfo(list);
+	if (listenfd == INVALID_SOCKET)
+	{
+		sprintf(buf2, "Can't listen on %.200s:%.200s\n", host.c_str(), port.c_str());
+		fatalError(buf2);
+	}
+
+	sprintf(buf2, "Waiting for %d partials on %.200s:%.200s\n", nbands, host.c_str(), port.c_str());
+	DisplayMessage(buf2);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parts.assign(nbands, vector<char>());
+	vector<bool> got(nbands, false);
+	int ngot = 0;
+	string error;
+	while (ngot < nbands && error.empty())
+	{
+		if (cancel != NULL && cancel->load()) { error = "A worker failed, the partials are not complete\n"; break; }
+		if (timeout > 0 && secondsSince(start) > timeout)
+		{
+			sprintf(buf2, "Only %d of %d partials arrived on port %.200s\n", ngot, nbands, port.c_str());
+			error = buf2;
+			break;
+		}
+
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(listenfd, &fds);
+		struct timeval wait = { 0, POLL_MS * 1000 };
+		if (select((int)listenfd + 1, &fds, NULL, NULL, &wait) <= 0) { continue; }
+		socket_t fd = accept(listenfd, NULL, NULL);
+		if (fd == INVALID_SOCKET) { continue; }
+
+		// A stalled sender can't keep the coordinator past the timeout
+		if (timeout > 0) { setSocketTimeout(fd, max(timeout - secondsSince(start), 0.001)); }
+
+		// A connection that is not a partial is dropped. The partial is
+		// read as it arrives, its size is not allocated up front.
+		string pending, line;
+		int band = -1, n = 0;
+		long long size = -1;
+		vector<char> data;
+		if (readLine(fd, pending, line, MAX_HEADER_LINE) && sscanf(line.c_str(), "band %d %d %lld", &band, &n, &size) == 3 &&
+			n == nbands && band >= 0 && band < nbands && size >= 0 && (unsigned long long)size <= (size_t)-1 &&
+			readBytes(fd, pending, data, (size_t)size))
+		{
+			sendAll(fd, "ok\n", 3);
+			if (!got[band])
+			{
+				parts[band].swap(data);
+				got[band] = true;
+				ngot++;
+			}
+		}
+		closeSocket(fd);
+	}
+	closeSocket(listenfd);
+	if (!error.empty()) { fatalError(error.c_str()); }
+}
+
+
+PartialTransport *createTransport(const char *spec)
+{
+	string text = spec;
+	if (text.compare(0, 4, "dir:") == 0 && text.size() > 4) { return new DirTransport(text.substr(4)); }
+	if (text.compare(0, 4, "tcp:") == 0)
+	{
+		size_t colon = text.rfind(':');
+		if (colon > 4 && colon + 1 < text.size())
+		{
+			return new TcpTransport(text.substr(4, colon - 4), text.substr(colon + 1));
+		}
+	}
+	return NULL;
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Workers and coordinator
+
+/*
+** DistributedRun()
+** Constructor, the partials go to the directory sslm_partials.
+*/
+DistributedRun::DistributedRun()
+{
+	transport = "dir:sslm_partials";
+	timeout = 3600;
+	nthreads = 0;
+	cancelFlag = NULL;
+}
+
+
+PartialTransport *DistributedRun::openTransport()
+{
+	PartialTransport *channel = createTransport(transport.c_str());
+	if (channel == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Unknown transport %.400s, use dir:path or tcp:host:port\n", transport.c_str());
+		fatalError(buf2);
+	}
+	channel->timeout = timeout;
+	channel->cancel = cancelFlag;
+	return channel;
+}
+
+
+/*
+** runBand()
+**
+** The rows before the band are only skipped, the rows after it are
+** not read. The values of each land use and factor are sorted and
+** kept once with the number of cells that have them.
+**
+*/
+void DistributedRun::runBand(App *app, int band, int nbands)
+{
+	char buf2[512];
+	if (nbands < 1 || band < 0 || band >= nbands)
+	{
+		sprintf(buf2, "Band %d of %d does not exist\n", band, nbands);
+		fatalError(buf2);
+	}
+
+	vector<int> srclus, sinklus;
+	readLuList(app->srcluFile, srclus);
+	readLuList(app->sinkluFile, sinklus);
+
+	const char *files[NUM_FACTORS + 1] = { app->luFile, app->demFile, app->distFile, app->slopeFile };
+	AscReader *readers[NUM_FACTORS + 1];
+	for (int g = 0; g < NUM_FACTORS + 1; g++) { readers[g] = openAscReader(files[g]); }
+	int rows = readers[0]->header->rows;
+	int cols = readers[0]->header->cols;
+	for (int g = 1; g < NUM_FACTORS + 1; g++)
+	{
+		if (readers[g]->header->rows != rows || readers[g]->header->cols != cols)
+		{
+			sprintf(buf2, "Size of %s does not match %s\n", files[g], files[0]);
+			fatalError(buf2);
+		}
+	}
+	int rowStart = (int)((long long)band*rows / nbands);
+	int rowEnd = (int)((long long)(band + 1)*rows / nbands);
+
+	LorenzEngine engine;
+	engine.setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+	engine.setGrid(max(rowEnd - rowStart, 1), cols);
+	{
+		TraceSpan span("distributed", "read band");
+		span.arg("band", band);
+		for (int i = 0; i < rowStart; i++)
+		{
+			for (int g = 0; g < NUM_FACTORS + 1; g++) { skipAscRow(readers[g]); }
+		}
+
+		int chunkRows = max(1, min(rowEnd - rowStart, BAND_CHUNK_CELLS / max(cols, 1)));
+		vector<int> lurows((size_t)chunkRows*cols);
+		vector<float> rowvals[NUM_FACTORS];
+		for (int f = 0; f < NUM_FACTORS; f++) { rowvals[f].resize((size_t)chunkRows*cols); }
+		for (int i = rowStart; i < rowEnd; i += chunkRows)
+		{
+			int n = min(chunkRows, rowEnd - i);
+			for (int r = 0; r < n; r++)
+			{
+				size_t offset = (size_t)r*cols;
+				readAscRowInt(readers[0], &lurows[offset]);
+				for (int f = 0; f < NUM_FACTORS; f++) { readAscRowFloat(readers[f + 1], &rowvals[f][offset]); }
+			}
+			engine.pushRows(n, &lurows[0], &rowvals[0][0], &rowvals[1][0], &rowvals[2][0]);
+		}
+	}
+	for (int g = 0; g < NUM_FACTORS + 1; g++) { closeAscReader(readers[g]); }
+
+	int nlus = (int)srclus.size() + (int)sinklus.size();
+	int ntasks = nlus*NUM_FACTORS;
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			TraceSpan span("distributed", "sort");
+			sort(engine.curveValues[t].begin(), engine.curveValues[t].end());
+		}
+	});
+
+	vector<char> data(PARTIAL_MAGIC, PARTIAL_MAGIC + 8);
+	long long header[6] = { rows, cols, rowStart, rowEnd, (long long)srclus.size(), (long long)sinklus.size() };
+	for (int k = 0; k < 6; k++) { putValue(data, header[k]); }
+	for (int luidx = 0; luidx < nlus; luidx++) { putValue(data, (long long)engine.results[luidx].luno); }
+
+	long long ncells = 0;
+	vector<double> values;
+	vector<long long> counts;
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		putValue(data, engine.results[luidx].ncells);
+		ncells += engine.results[luidx].ncells;
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			vector<double> &sorted = engine.curveValues[luidx*NUM_FACTORS + f];
+			values.clear();
+			counts.clear();
+			for (size_t k = 0; k < sorted.size(); k++)
+			{
+				if (k > 0 && sorted[k] == sorted[k - 1]) { counts.back()++; }
+				else
+				{
+					values.push_back(sorted[k]);
+					counts.push_back(1);
+				}
+			}
+			vector<double>().swap(sorted);
+
+			putValue(data, (long long)values.size());
+			for (size_t k = 0; k < values.size(); k++) { putValue(data, values[k]); }
+			for (size_t k = 0; k < counts.size(); k++) { putValue(data, counts[k]); }
+		}
+	}
+
+	PartialTransport *channel = openTransport();
+	{
+		TraceSpan span("distributed", "send");
+		channel->send(band, nbands, data);
+	}
+	delete channel;
+
+	sprintf(buf2, "Band %d of %d: rows %d to %d, %lld cells of the land uses, %.1f MB sent\n",
+		band, nbands, rowStart, rowEnd - 1, ncells, data.size() / (1024.0*1024.0));
+	DisplayMessage(buf2);
+}
+
+
+/*
+** runCoordinator()
+**
+** The runs of the bands are merged by value. A value gets the last
+** rank of its cells over all the bands, as in lorenzCurve(), and
+** the area is taken from the points as in lorenzAreaSorted().
+**
+*/
+void DistributedRun::runCoordinator(App *app, int nbands)
+{
+	char buf2[512];
+	if (nbands < 1)
+	{
+		fatalError("The coordinator needs at least one band\n");
+	}
+
+	vector<vector<char> > bytes;
+	PartialTransport *channel = openTransport();
+	{
+		TraceSpan span("distributed", "receive");
+		channel->receive(nbands, bytes);
+	}
+
+	vector<BandPartial> parts(nbands);
+	for (int k = 0; k < nbands; k++)
+	{
+		parsePartial(bytes[k], k, parts[k]);
+		const BandPartial &part = parts[k];
+		int rowStart = (int)((long long)k*part.rows / nbands);
+		int rowEnd = (int)((long long)(k + 1)*part.rows / nbands);
+		if (part.rows != parts[0].rows || part.cols != parts[0].cols || part.rowStart != rowStart ||
+			part.rowEnd != rowEnd || part.nsrclus != parts[0].nsrclus || part.lunos != parts[0].lunos)
+		{
+			sprintf(buf2, "The partial of band %d is not from the grids or land uses of band 0\n", k);
+			fatalError(buf2);
+		}
+	}
+
+	const BandPartial &first = parts[0];
+	int nlus = first.nsrclus + first.nsinklus;
+	LorenzEngine engine;
+	engine.nthreads = nthreads;
+	engine.curveFormat = app->curveFormat;
+	engine.simplify = app->simplify;
+	engine.curveText = app->curveText;
+	engine.setClasses(first.lunos.data(), first.nsrclus, first.lunos.data() + first.nsrclus, first.nsinklus);
+	engine.setGrid(first.rows, first.cols);
+
+	int ntasks = nlus*NUM_FACTORS;
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		typedef pair<double, int> Head;
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			TraceSpan span("distributed", "merge");
+			span.arg("lu", first.lunos[t / NUM_FACTORS]);
+			span.arg("factor", t % NUM_FACTORS);
+
+			long long n = 0;
+			priority_queue<Head, vector<Head>, greater<Head> > heads;
+			vector<long long> next(nbands, 0);
+			for (int k = 0; k < nbands; k++)
+			{
+				n += parts[k].ncells[t / NUM_FACTORS];
+				if (parts[k].nvalues[t] > 0) { heads.push(Head(partValue(bytes[k], parts[k], t, 0), k)); }
+			}
+
+			vector<double> &values = engine.curveValues[t];
+			vector<double> &percents = engine.curvePercents[t];
+			long long rank = 0;
+			while (!heads.empty())
+			{
+				double value = heads.top().first;
+				while (!heads.empty() && heads.top().first == value)
+				{
+					int k = heads.top().second;
+					heads.pop();
+					rank += partCount(bytes[k], parts[k], t, next[k]);
+					if (++next[k] < parts[k].nvalues[t]) { heads.push(Head(partValue(bytes[k], parts[k], t, next[k]), k)); }
+				}
+				values.push_back(value);
+				percents.push_back((double)(rank - 1) * (double)100. / (double)n);
+			}
+
+			engine.results[t / NUM_FACTORS].ncells = n;
+			engine.results[t / NUM_FACTORS].area[t % NUM_FACTORS] = polylineArea(values.data(), percents.data(), (long long)values.size());
+		}
+	});
+	vector<vector<char> >().swap(bytes);
+
+	engine.rowsPushed = engine.rows;
+	engine.computed = true;
+	engine.writeOutputs("");
+	channel->finish(nbands);
+	delete channel;
+
+	sprintf(buf2, "Merged the partials of %d bands of %d x %d cells\n", nbands, first.rows, first.cols);
+	DisplayMessage(buf2);
+}
+
+
+static string quoteArg(const string &arg)
+{
+	return "\"" + arg + "\"";
+}
+
+
+/*
+** runLocal()
+**
+** Each worker is a process of its own as on a cluster, started with
+** the same grids and transport and a share of the threads. The
+** coordinator runs meanwhile, so the sockets work too.
+**
+*/
+int DistributedRun::runLocal(App *app, const char *program, int nbands)
+{
+	char buf2[512];
+	if (nbands < 1)
+	{
+		fatalError("-distributed needs at least one band\n");
+	}
+	delete openTransport();
+
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	int threadsEach = max(1, nworkers / nbands);
+	atomic<bool> failed(false);
+	vector<int> codes(nbands, 0);
+	vector<thread> workers;
+	for (int k = 0; k < nbands; k++)
+	{
+		sprintf(buf2, " -band %d %d -jobs %d -timeout %g -transport ", k, nbands, threadsEach, timeout);
+		string command = quoteArg(program) + buf2 + quoteArg(transport) +
+			" -src " + quoteArg(app->srcluFile) + " -sink " + quoteArg(app->sinkluFile) +
+			" -lu " + quoteArg(app->luFile) + " -dem " + quoteArg(app->demFile) +
+			" -slope " + quoteArg(app->slopeFile) + " -dist " + quoteArg(app->distFile);
+#ifdef _WIN32
+		// cmd.exe drops the outer quotes of the line
+		command = "\"" + command + "\"";
+#endif
+		workers.push_back(thread([&, k, command]()
+		{
+			codes[k] = system(command.c_str());
+			if (codes[k] != 0) { failed = true; }
+		}));
+	}
+
+	// The coordinator stops waiting when a worker fails
+	cancelFlag = &failed;
+	runCoordinator(app, nbands);
+	cancelFlag = NULL;
+
+	for (int k = 0; k < nbands; k++) { workers[k].join(); }
+	int nfailed = 0;
+	for (int k = 0; k < nbands; k++) { nfailed += (codes[k] != 0) ? 1 : 0; }
+	if (nfailed > 0)
+	{
+		sprintf(buf2, "%d of %d workers failed\n", nfailed, nbands);
+		DisplayMessage(buf2);
+	}
+	return (nfailed > 0) ? 1 : 0;
+}
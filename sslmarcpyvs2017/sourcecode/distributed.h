@@ -0,0 +1,103 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Distributed mode for grids too large for one machine. Each worker
+** process reads one band of rows of the grids (the others are only
+** skipped) and sends a partial result: for every listed land use
+** its number of cells and, for each factor, the distinct values of
+** its cells sorted with the number of cells of each. A coordinator
+** merges the partials of all the bands and writes the same files as
+** a run on one machine, to the last bit: the area and the curve
+** only depend on the distinct values and the last rank of each.
+**
+**   sslmarcpy -band k n -transport dir:/scratch/run1     (k = 0..n-1)
+**   sslmarcpy -coordinate n -transport dir:/scratch/run1
+**
+** The transports are:
+**
+**   dir:path            a shared directory, band_k_of_n.part each
+**   tcp:host:port       the coordinator listens on port (on host,
+**                       * for all addresses), the workers connect
+**
+** -distributed n runs a coordinator and n local worker processes.
+** The grids are read in full, the -outlet mask is not applied.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class App;
+
+
+// Define class
+class PartialTransport
+{
+public:
+	PartialTransport() : cancel(NULL), timeout(0) {}
+	virtual ~PartialTransport() {}
+
+	// Worker: hands over the partial of band k of nbands
+	virtual void send(int band, int nbands, const std::vector<char> &data) = 0;
+
+	// Coordinator: the partials of all nbands bands, by band
+	virtual void receive(int nbands, std::vector<std::vector<char> > &parts) = 0;
+
+	// Coordinator: the partials were merged
+	virtual void finish(int) {}
+
+	// Set when the waiting should stop (local run with a failed worker)
+	const std::atomic<bool> *cancel;
+
+	// Seconds to wait for the other side, 0 for no limit
+	double timeout;
+};
+
+// "dir:path" or "tcp:host:port", NULL if spec is neither
+PartialTransport *createTransport(const char *spec);
+
+
+// Define class
+class DistributedRun
+{
+public:
+	DistributedRun();
+
+	// Transport of the partials, see createTransport()
+	std::string transport;
+
+	// Seconds to wait for the workers or the coordinator (3600)
+	double timeout;
+
+	// Threads of the sorting and merging, 0 for the number of cores
+	int nthreads;
+
+	// Worker: reads rows band*rows/nbands up to (band+1)*rows/nbands
+	// of the grids of app and sends their partial
+	void runBand(App *app, int band, int nbands);
+
+	// Coordinator: merges the partials of nbands bands and writes the
+	// output files with the curve options of app
+	void runCoordinator(App *app, int nbands);
+
+	// Runs nbands worker processes of program and the coordinator,
+	// returns 0 if all succeeded
+	int runLocal(App *app, const char *program, int nbands);
+
+private:
+	PartialTransport *openTransport();
+
+	// Set by runLocal() for the transport of the coordinator
+	const std::atomic<bool> *cancelFlag;
+};
+
+#endif
@@ -0,0 +1,514 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Lorenz curve engine fed by blocks of rows.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <atomic>
+
+#include "engine.h"
+#include "ascgrid.h"
+#include "message.h"
+#include "parallel.h"
+#include "curvefile.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(dir, mode) _mkdir(dir)
+#endif
+
+using namespace std;
+
+// Cells read before they are pushed, see readGrids()
+#define READ_CHUNK_CELLS (1 << 20)
+
+static const char *sortNames[NUM_FACTORS] = { "sort elev", "sort dist", "sort slope" };
+
+
+/*
+** LorenzEngine()
+** Constructor for the engine.
+*/
+LorenzEngine::LorenzEngine()
+{
+	nthreads = 0;
+	curveFormat = CURVES_TEXT;
+	simplify.mode = SIMPLIFY_NONE;
+	simplify.tolerance = 0.0;
+	simplify.npoints = 0;
+	curveText = defaultTextOptions();
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		quantum[f] = 0.0;
+		activeQuantum[f] = 0.0;
+	}
+	nsrclus = 0;
+	nsinklus = 0;
+	rows = 0;
+	cols = 0;
+	rowsPushed = 0;
+	computed = false;
+	lastLu = 0;
+	lastIdx = -1;
+}
+
+
+LorenzEngine::~LorenzEngine()
+{
+}
+
+
+/*
+** setClasses()
+**
+** Land use 0 marks the end of the lists in App, so it can not be
+** a source or sink here either.
+**
+*/
+void LorenzEngine::setClasses(const int *srclus, int nsrc, const int *sinklus, int nsink)
+{
+	char buf2[512];
+
+	if (nsrc < 0 || nsink < 0 || nsrc + nsink == 0)
+	{
+		fatalError("No source or sink land uses given");
+	}
+
+	lunos.clear();
+	for (int luidx = 0; luidx < nsrc + nsink; luidx++)
+	{
+		int luno = (luidx < nsrc) ? srclus[luidx] : sinklus[luidx - nsrc];
+		if (luno == 0)
+		{
+			fatalError("Land use 0 can not be a source or sink");
+		}
+		if (find(lunos.begin(), lunos.end(), luno) != lunos.end())
+		{
+			sprintf(buf2, "Land use %d is listed more than once\n", luno);
+			fatalError(buf2);
+		}
+		lunos.push_back(luno);
+	}
+	nsrclus = nsrc;
+	nsinklus = nsink;
+
+	results.assign(nsrc + nsink, LuResult());
+	for (int luidx = 0; luidx < nsrc + nsink; luidx++)
+	{
+		results[luidx].luno = lunos[luidx];
+	}
+	reset();
+}
+
+
+void LorenzEngine::setGrid(int nrows, int ncols)
+{
+	if (nrows <= 0 || ncols <= 0)
+	{
+		fatalError("The grid must have at least one row and column");
+	}
+	rows = nrows;
+	cols = ncols;
+	reset();
+}
+
+
+/*
+** reset()
+**
+** The arrays keep their memory, so the next grid of the same
+** size is pushed without new allocations. The land use found last
+** is forgotten, the lists may have changed.
+**
+*/
+void LorenzEngine::reset()
+{
+	int nlus = nsrclus + nsinklus;
+
+	lastLu = 0;
+	lastIdx = -1;
+
+	curveValues.resize(nlus*NUM_FACTORS);
+	curvePercents.resize(nlus*NUM_FACTORS);
+	histograms.resize(nlus*NUM_FACTORS);
+	for (int t = 0; t < nlus*NUM_FACTORS; t++)
+	{
+		curveValues[t].clear();
+		curvePercents[t].clear();
+		histograms[t].clear();
+	}
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		results[luidx].ncells = 0;
+		for (int f = 0; f < NUM_FACTORS; f++) { results[luidx].area[f] = 0.0; }
+	}
+	rowsPushed = 0;
+	computed = false;
+}
+
+
+void LorenzEngine::releaseMemory()
+{
+	for (size_t t = 0; t < curveValues.size(); t++)
+	{
+		vector<double>().swap(curveValues[t]);
+		vector<double>().swap(curvePercents[t]);
+	}
+	reset();
+}
+
+
+/*
+** findLu()
+**
+** Index of luno in the lists, -1 if it is not listed. Land uses
+** come in patches, so the last one found is checked first.
+**
+*/
+int LorenzEngine::findLu(int luno)
+{
+	if (luno == lastLu) { return lastIdx; }
+
+	lastLu = luno;
+	lastIdx = -1;
+	if (luno == 0) { return -1; }
+	for (int luidx = 0; luidx < (int)lunos.size(); luidx++)
+	{
+		if (lunos[luidx] == luno) { lastIdx = luidx; break; }
+	}
+	return lastIdx;
+}
+
+
+/*
+** pushRows()
+**
+** Puts the values of the cells of the listed land uses into the
+** arrays of their land use, or counts them in the histograms of
+** the quantized factors.
+**
+*/
+void LorenzEngine::pushRows(int nrows, const int *lu, const float *elev, const float *dist, const float *slope)
+{
+	static const char *factorNames[NUM_FACTORS] = { "elevation", "distance", "slope" };
+	char buf2[512];
+
+	if (lunos.empty() || cols <= 0)
+	{
+		fatalError("The land uses and the grid size must be set before pushing rows");
+	}
+	if (computed)
+	{
+		fatalError("The results are already calculated, reset before pushing rows");
+	}
+	if (nrows < 0 || rowsPushed + nrows > rows)
+	{
+		fatalError("More rows pushed than the grid has");
+	}
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		if (!(quantum[f] >= 0.0) || (rowsPushed > 0 && quantum[f] != activeQuantum[f]))
+		{
+			fatalError("The quantum must be 0 or more and can not change while the rows of a grid are pushed");
+		}
+		activeQuantum[f] = quantum[f];
+	}
+
+	const float *factors[NUM_FACTORS] = { elev, dist, slope };
+	long long ncells = (long long)nrows*cols;
+
+	for (long long index = 0; index < ncells; index++)
+	{
+		int luidx = findLu(lu[index]);
+		if (luidx < 0) { continue; }
+
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			if (activeQuantum[f] == 0.0)
+			{
+				curveValues[luidx*NUM_FACTORS + f].push_back(factors[f][index]);
+				continue;
+			}
+
+			long long key = 0;
+			if (!quantizeValue(factors[f][index], activeQuantum[f], key))
+			{
+				sprintf(buf2, "Value %.9g of the %s grid is not a multiple of the quantum %g\n",
+					factors[f][index], factorNames[f], activeQuantum[f]);
+				fatalError(buf2);
+			}
+			histograms[luidx*NUM_FACTORS + f].add(key);
+		}
+		results[luidx].ncells++;
+	}
+	rowsPushed += nrows;
+}
+
+
+/*
+** readGrids()
+**
+** Streams the four grids into pushRows() in chunks of about
+** READ_CHUNK_CELLS cells, so the reading and the scattering of a
+** chunk are separate spans of the trace (trace.h).
+**
+*/
+void LorenzEngine::readGrids(const char *lufile, const char *demfile, const char *distfile, const char *slopefile)
+{
+	char buf2[512];
+	const char *files[NUM_FACTORS + 1] = { lufile, demfile, distfile, slopefile };
+	AscReader *readers[NUM_FACTORS + 1] = { NULL, NULL, NULL, NULL };
+
+	// In the library fatalError() throws, the files are
+	// closed before the error is passed on.
+	try
+	{
+		for (int g = 0; g < NUM_FACTORS + 1; g++)
+		{
+			readers[g] = openAscReader(files[g]);
+		}
+
+		int nrows = readers[0]->header->rows;
+		int ncols = readers[0]->header->cols;
+		for (int g = 1; g < NUM_FACTORS + 1; g++)
+		{
+			if (readers[g]->header->rows != nrows || readers[g]->header->cols != ncols)
+			{
+				sprintf(buf2, "Size of %s does not match %s\n", files[g], lufile);
+				fatalError(buf2);
+			}
+		}
+		setGrid(nrows, ncols);
+
+		int chunkRows = max(1, min(nrows, READ_CHUNK_CELLS / max(ncols, 1)));
+		vector<int> lurows((size_t)chunkRows*ncols);
+		vector<float> rowvals[NUM_FACTORS];
+		for (int f = 0; f < NUM_FACTORS; f++) { rowvals[f].resize((size_t)chunkRows*ncols); }
+
+		for (int i = 0; i < nrows; i += chunkRows)
+		{
+			int n = min(chunkRows, nrows - i);
+			{
+				TraceSpan span("engine", "read");
+				span.arg("row", i);
+				span.arg("rows", n);
+				for (int r = 0; r < n; r++)
+				{
+					size_t offset = (size_t)r*ncols;
+					readAscRowInt(readers[0], &lurows[offset]);
+					for (int f = 0; f < NUM_FACTORS; f++)
+					{
+						readAscRowFloat(readers[f + 1], &rowvals[f][offset]);
+					}
+				}
+			}
+
+			TraceSpan span("engine", "scatter");
+			span.arg("row", i);
+			span.arg("rows", n);
+			pushRows(n, &lurows[0], &rowvals[0][0], &rowvals[1][0], &rowvals[2][0]);
+		}
+	}
+	catch (...)
+	{
+		for (int g = 0; g < NUM_FACTORS + 1; g++)
+		{
+			if (readers[g]) closeAscReader(readers[g]);
+		}
+		throw;
+	}
+
+	for (int g = 0; g < NUM_FACTORS + 1; g++)
+	{
+		closeAscReader(readers[g]);
+	}
+}
+
+
+/*
+** compute()
+**
+** Each land use and factor is sorted and turned into its curve on
+** its own, the workers take them from a shared counter since the
+** arrays have very different sizes. The curves of the quantized
+** factors come from their histograms.
+**
+*/
+void LorenzEngine::compute()
+{
+	if (lunos.empty() || rowsPushed != rows)
+	{
+		fatalError("All the rows of the grid must be pushed before computing");
+	}
+	if (computed) { return; }
+
+	int ntasks = (nsrclus + nsinklus)*NUM_FACTORS;
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			vector<double> &values = curveValues[t];
+			long long n = (long long)values.size();
+			int luno = lunos[t / NUM_FACTORS];
+
+			if (activeQuantum[t % NUM_FACTORS] > 0.0)
+			{
+				TraceSpan span("engine", "histogram");
+				span.arg("lu", luno);
+				span.arg("factor", t % NUM_FACTORS);
+				span.arg("values", (double)histograms[t].size());
+				histograms[t].curve(activeQuantum[t % NUM_FACTORS], values, curvePercents[t]);
+				histograms[t].clear();
+				results[t / NUM_FACTORS].area[t % NUM_FACTORS] =
+					lorenzAreaCurve(values.data(), curvePercents[t].data(), (long long)values.size());
+				span.arg("points", (double)values.size());
+				continue;
+			}
+
+			{
+				TraceSpan span("engine", sortNames[t % NUM_FACTORS]);
+				span.arg("lu", luno);
+				span.arg("values", (double)n);
+				sort(values.begin(), values.end());
+			}
+			{
+				TraceSpan span("engine", "integrate");
+				span.arg("lu", luno);
+				span.arg("factor", t % NUM_FACTORS);
+				results[t / NUM_FACTORS].area[t % NUM_FACTORS] = lorenzAreaSorted(values.data(), n);
+			}
+
+			TraceSpan span("engine", "dedup");
+			span.arg("lu", luno);
+			span.arg("factor", t % NUM_FACTORS);
+			curvePercents[t].resize(n);
+			long long m = lorenzCurve(values.data(), n, curvePercents[t].data());
+			values.resize(m);
+			curvePercents[t].resize(m);
+			span.arg("points", (double)m);
+		}
+	});
+
+	computed = true;
+}
+
+
+double LorenzEngine::areaPerc(int luidx)
+{
+	long long total = 0;
+	for (size_t i = 0; i < results.size(); i++) { total += results[i].ncells; }
+	return (total > 0) ? (double)results[luidx].ncells / (double)total : 0.0;
+}
+
+
+/*
+** writeOutputs()
+**
+** Same files as App::writeOutputs() and App::calAreaPercOverws().
+**
+*/
+void LorenzEngine::writeOutputs(const char *prefix)
+{
+	TraceSpan span("engine", "write");
+	string base = (prefix != NULL) ? prefix : "";
+	TextOptions text = curveText;
+	if (text.nthreads == 0) { text.nthreads = nthreads; }
+
+	if (simplify.mode != SIMPLIFY_NONE)
+	{
+		int nlus = (int)results.size();
+		vector<CurveSpan> curves(nlus*NUM_FACTORS);
+		for (int t = 0; t < nlus*NUM_FACTORS; t++)
+		{
+			curves[t] = fullCurveSpan(curveValues[t].data(), curvePercents[t].data(), (long long)curveValues[t].size());
+		}
+		writeSimplifiedCurves(base.c_str(), simplify, curveFormat, text, curves.data(), results.data(), nsrclus, nlus, nthreads);
+	}
+	else
+	{
+		// The points App writes, see curveSpan()
+		int nlus = (int)results.size();
+		vector<CurveSpan> spans(nlus*NUM_FACTORS);
+		for (int t = 0; t < nlus*NUM_FACTORS; t++)
+		{
+			spans[t] = curveSpan(curveValues[t].data(), curvePercents[t].data(),
+				(long long)curveValues[t].size(), t % NUM_FACTORS);
+		}
+
+		if (curveFormat == CURVES_NPY) { writeCurveFiles(base.c_str(), spans.data(), lunos.data(), nsrclus, nlus); }
+		else { writeCurveText(base.c_str(), spans.data(), lunos.data(), nlus, text); }
+	}
+	writeLorenzAreas((base + "LurenzCurveAreas.txt").c_str(), results.data(), (int)results.size());
+	writeAreaPerc((base + "luareaperc.txt").c_str(), results.data(), nsrclus, nsinklus);
+}
+
+
+void readLuList(const char *file, vector<int> &lunos)
+{
+	char buf[512];
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf, "Can't find %s\n", file);
+		fatalError(buf);
+	}
+
+	lunos.clear();
+	int val;
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		if (sscanf(buf, "%d", &val) != 1) { continue; }
+		if (val == 0) { break; }
+		lunos.push_back(val);
+	}
+	fclose(fp);
+}
+
+
+string joinPath(const string &dir, const char *file)
+{
+	if (dir.empty()) { return file; }
+	char last = dir[dir.size() - 1];
+	if (last == '/' || last == '\\') { return dir + file; }
+	return dir + "/" + file;
+}
+
+
+/*
+** makeDirs()
+**
+** Each directory of the path is made in turn, the ones that exist
+** already are left as they are.
+**
+*/
+bool makeDirs(const string &dir)
+{
+	if (dir.empty()) { return true; }
+	for (size_t k = 1; k <= dir.size(); k++)
+	{
+		if (k < dir.size() && dir[k] != '/' && dir[k] != '\\') { continue; }
+		string part = dir.substr(0, k);
+		if (part.size() == 2 && part[1] == ':') { continue; }
+		mkdir(part.c_str(), 0755);
+	}
+
+	struct stat st;
+	return stat(dir.c_str(), &st) == 0 && (st.st_mode & S_IFDIR) != 0;
+}
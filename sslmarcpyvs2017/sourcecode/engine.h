@@ -0,0 +1,134 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Lorenz curve engine used by the library. The caller gives the
+** source and sink land uses and the size of the grids, then pushes
+** the land use and terrain values a block of rows at a time, so the
+** grids never have to be in memory as a whole. The values of the
+** listed land uses are scattered into one array per land use and
+** factor as the rows arrive.
+**
+** The cells are selected as in App: every cell whose land use is
+** listed is used, with the terrain values it has. The areas are
+** the same to the last bit as the ones of App::callwli().
+**
+** A factor with a quantum (e.g. 0.01 for a grid in centimeters) is
+** counted into a QuantizedHistogram per land use instead (histogram.h)
+** and its curve is read off the counts without a sort. A value that
+** does not lie on the quantum is an error.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+#include "lorenz.h"
+#include "simplify.h"
+
+// Define class
+class LorenzEngine
+{
+public:
+	LorenzEngine();
+	~LorenzEngine();
+
+	// Source and sink land uses, this also clears all the data
+	void setClasses(const int *srclus, int nsrclus, const int *sinklus, int nsinklus);
+
+	// Size of the grids the rows are pushed from
+	void setGrid(int nrows, int ncols);
+
+	// Adds nrows full rows. The arrays have nrows*cols values.
+	void pushRows(int nrows, const int *lu, const float *elev, const float *dist, const float *slope);
+
+	// Reads the grids from arcview files and pushes their rows
+	void readGrids(const char *lufile, const char *demfile, const char *distfile, const char *slopefile);
+
+	// Sorts the values and calculates the curves and areas. All
+	// the rows of the grid have to be pushed.
+	void compute();
+
+	// Clears the pushed rows and results, the land uses and
+	// the grid size are kept.
+	void reset();
+
+	// Number of threads, 0 uses numWorkers()
+	int nthreads;
+
+	// Format of the curve files of writeOutputs(), CURVES_TEXT
+	// or CURVES_NPY (curvefile.h)
+	int curveFormat;
+
+	// Simplification of the curve files (SIMPLIFY_NONE)
+	CurveSimplify simplify;
+
+	// Numbers and compression of the text curve files (textout.h)
+	TextOptions curveText;
+
+	// Quantum of the values of each factor, 0 sorts them (the
+	// default). Set before the first rows of a grid are pushed.
+	double quantum[NUM_FACTORS];
+
+	int nsrclus;
+	int nsinklus;
+	int rows;
+	int cols;
+	int rowsPushed;
+	bool computed;
+
+	// Sources first, then sinks
+	std::vector<LuResult> results;
+
+	// Points of the curve of each land use and factor after
+	// compute(), index luidx*NUM_FACTORS + factor.
+	std::vector<std::vector<double> > curveValues;
+	std::vector<std::vector<double> > curvePercents;
+
+	// Share of the cells of a land use over all listed cells
+	double areaPerc(int luidx);
+
+	// reset() that also frees the memory kept for the next grid
+	void releaseMemory();
+
+	// Writes the output files of App with prefix in front of
+	// their names: elev_dataperc.txt, dist_dataperc.txt,
+	// slp_dataperc.txt, LurenzCurveAreas.txt and luareaperc.txt.
+	// With CURVES_NPY the curves go to the files of curvefile.h.
+	void writeOutputs(const char *prefix);
+
+private:
+	int findLu(int luno);
+
+	std::vector<int> lunos;
+	int lastLu;
+	int lastIdx;
+
+	// Quantum of the grid being pushed and the histograms of the
+	// quantized factors, index luidx*NUM_FACTORS + factor
+	double activeQuantum[NUM_FACTORS];
+	std::vector<QuantizedHistogram> histograms;
+};
+
+
+// Land use numbers of srclus.txt or sinklus.txt, one per line as
+// read by App::readTextInttoArray(). A 0 ends the list.
+void readLuList(const char *file, std::vector<int> &lunos);
+
+// file in the directory dir, for the input sets of the batch
+// and server modes
+std::string joinPath(const std::string &dir, const char *file);
+
+// Makes the directory dir and the ones above it (mkdir -p), false
+// if it is not a directory afterwards
+bool makeDirs(const std::string &dir);
+
+#endif
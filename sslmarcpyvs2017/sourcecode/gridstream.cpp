@@ -0,0 +1,482 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Plain and compressed grid files read line by line. A thread per
+** stream reads (and decompresses) the file into chunks ahead of
+** gridGets(); the chunks are given back to it once they are read,
+** so a stream holds at most QUEUE_CHUNKS + 3 of them.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SSLM_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SSLM_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gridstream.h"
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+#define STREAM_PLAIN 0
+#define STREAM_GZIP 1
+#define STREAM_ZSTD 2
+
+// Compressed bytes read at a time and size of the decompressed
+// chunks; at most QUEUE_CHUNKS wait for the reader.
+#define IN_CHUNK (1 << 20)
+#define OUT_CHUNK (4 << 20)
+#define QUEUE_CHUNKS 4
+
+// Bytes read at a time from plain files
+#define PLAIN_CHUNK (4 << 20)
+
+// Prefetched streams not yet opened
+#define MAX_PREFETCHED 4
+
+
+struct GridStream
+{
+	string file;
+	int kind;
+	FILE *fp;
+
+	thread worker;
+	mutex lock;
+	condition_variable ready;
+	condition_variable space;
+	deque<vector<char> > chunks;
+
+	// Chunk read by gridGets(), filled again by the thread
+	vector<vector<char> > spare;
+	bool done;
+	bool stop;
+	string error;
+
+	// Chunk the lines are taken from
+	vector<char> current;
+	size_t pos;
+};
+
+
+static bool endsWith(const string &s, const char *suffix)
+{
+	size_t n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+
+/*
+** takeBuffer()
+**
+** Gives chunk the capacity of a spare chunk if there is one, and
+** size bytes.
+**
+*/
+static void takeBuffer(GridStream *s, vector<char> &chunk, size_t size)
+{
+	{
+		lock_guard<mutex> guard(s->lock);
+		if (!s->spare.empty())
+		{
+			chunk.swap(s->spare.back());
+			s->spare.pop_back();
+		}
+	}
+	chunk.resize(size);
+}
+
+
+/*
+** pushChunk()
+**
+** Hands a chunk to the reader, false if the stream is
+** being closed.
+**
+*/
+static bool pushChunk(GridStream *s, vector<char> &chunk)
+{
+	unique_lock<mutex> guard(s->lock);
+	s->space.wait(guard, [&]() { return s->stop || s->chunks.size() < QUEUE_CHUNKS; });
+	if (s->stop) { return false; }
+	s->chunks.push_back(vector<char>());
+	s->chunks.back().swap(chunk);
+	s->ready.notify_one();
+	return true;
+}
+
+
+static void finish(GridStream *s, const string &error)
+{
+	lock_guard<mutex> guard(s->lock);
+	s->done = true;
+	s->error = error;
+	s->ready.notify_one();
+}
+
+
+#ifdef SSLM_WITH_ZLIB
+/*
+** inflateFile()
+**
+** windowBits 15 + 32 takes gzip and zlib headers. Files of several
+** gzip members (as from pigz or cat) are read member after member.
+**
+*/
+static string inflateFile(GridStream *s)
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, 15 + 32) != Z_OK) { return "Can't start decompressing "; }
+
+	vector<char> in(IN_CHUNK);
+	vector<char> out;
+	string error;
+	bool ended = false;
+	while (error.empty())
+	{
+		if (z.avail_in == 0)
+		{
+			size_t n = fread(in.data(), 1, in.size(), s->fp);
+			if (n == 0)
+			{
+				if (!ended) { error = "Unexpected end of "; }
+				break;
+			}
+			z.next_in = (Bytef *)in.data();
+			z.avail_in = (uInt)n;
+		}
+		if (ended)
+		{
+			inflateReset(&z);
+			ended = false;
+		}
+
+		{
+			TraceSpan span("grid", "inflate");
+			takeBuffer(s, out, OUT_CHUNK);
+			z.next_out = (Bytef *)out.data();
+			z.avail_out = (uInt)out.size();
+			while (z.avail_out > 0 && z.avail_in > 0)
+			{
+				int rc = inflate(&z, Z_NO_FLUSH);
+				if (rc == Z_STREAM_END) { ended = true; break; }
+				if (rc != Z_OK && rc != Z_BUF_ERROR) { error = "Corrupt gzip data in "; break; }
+				if (z.avail_in == 0)
+				{
+					size_t n = fread(in.data(), 1, in.size(), s->fp);
+					if (n == 0) { break; }
+					z.next_in = (Bytef *)in.data();
+					z.avail_in = (uInt)n;
+				}
+			}
+			out.resize(out.size() - z.avail_out);
+			span.arg("bytes", (double)out.size());
+		}
+		if (!out.empty() && !pushChunk(s, out)) { break; }
+	}
+	inflateEnd(&z);
+	return error;
+}
+#endif
+
+
+#ifdef SSLM_WITH_ZSTD
+static string unzstdFile(GridStream *s)
+{
+	ZSTD_DStream *z = ZSTD_createDStream();
+	ZSTD_initDStream(z);
+
+	vector<char> in(IN_CHUNK);
+	vector<char> out;
+	string error;
+	size_t left = 0;
+	ZSTD_inBuffer ib = { in.data(), 0, 0 };
+	while (error.empty())
+	{
+		if (ib.pos == ib.size)
+		{
+			ib.size = fread(in.data(), 1, in.size(), s->fp);
+			ib.pos = 0;
+			if (ib.size == 0)
+			{
+				if (left != 0) { error = "Unexpected end of "; }
+				break;
+			}
+		}
+
+		{
+			TraceSpan span("grid", "unzstd");
+			takeBuffer(s, out, OUT_CHUNK);
+			ZSTD_outBuffer ob = { out.data(), out.size(), 0 };
+			while (ob.pos < ob.size && ib.pos < ib.size)
+			{
+				left = ZSTD_decompressStream(z, &ob, &ib);
+				if (ZSTD_isError(left)) { error = "Corrupt zstd data in "; break; }
+			}
+			out.resize(ob.pos);
+			span.arg("bytes", (double)out.size());
+		}
+		if (!out.empty() && !pushChunk(s, out)) { break; }
+	}
+	ZSTD_freeDStream(z);
+	return error;
+}
+#endif
+
+
+/*
+** readPlain()
+**
+** Large reads, so that the disk (or the network of a mounted
+** scratch space) is busy while gridGets() parses the last chunk.
+**
+*/
+static string readPlain(GridStream *s)
+{
+	vector<char> chunk;
+	while (true)
+	{
+		{
+			TraceSpan span("grid", "read");
+			takeBuffer(s, chunk, PLAIN_CHUNK);
+			chunk.resize(fread(chunk.data(), 1, chunk.size(), s->fp));
+			span.arg("bytes", (double)chunk.size());
+		}
+		if (chunk.empty())
+		{
+			return ferror(s->fp) ? "Can't read " : "";
+		}
+		if (!pushChunk(s, chunk)) { return ""; }
+	}
+}
+
+
+/*
+** readAhead()
+**
+** Runs on the thread of the stream. Errors are passed to the
+** reader, which reports them when it gets to them.
+**
+*/
+static void readAhead(GridStream *s)
+{
+	string error;
+	if (s->kind == STREAM_PLAIN) { error = readPlain(s); }
+#ifdef SSLM_WITH_ZLIB
+	if (s->kind == STREAM_GZIP) { error = inflateFile(s); }
+#endif
+#ifdef SSLM_WITH_ZSTD
+	if (s->kind == STREAM_ZSTD) { error = unzstdFile(s); }
+#endif
+	finish(s, error.empty() ? error : error + s->file);
+}
+
+
+static mutex prefetchLock;
+static map<string, GridStream *> prefetched;
+
+
+/*
+** openStream()
+**
+** openGridStream() without the prefetched streams. A compressed file
+** the program can't read is a fatal error unless quiet is set, then
+** NULL is returned.
+**
+*/
+static GridStream *openStream(const char *file, bool quiet)
+{
+	char ebuf[512];
+	string name = file;
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL && !endsWith(name, ".gz") && !endsWith(name, ".zst"))
+	{
+		const char *suffixes[2] = { ".gz", ".zst" };
+		for (int k = 0; k < 2 && fp == NULL; k++)
+		{
+			name = string(file) + suffixes[k];
+			fp = fopen(name.c_str(), "rb");
+		}
+	}
+	if (fp == NULL) { return NULL; }
+
+	GridStream *s = new GridStream;
+	s->file = name;
+	s->kind = endsWith(name, ".gz") ? STREAM_GZIP : (endsWith(name, ".zst") ? STREAM_ZSTD : STREAM_PLAIN);
+	s->fp = fp;
+	s->done = false;
+	s->stop = false;
+	s->pos = 0;
+
+#ifndef SSLM_WITH_ZLIB
+	if (s->kind == STREAM_GZIP)
+	{
+		closeGridStream(s);
+		if (quiet) { return NULL; }
+		sprintf(ebuf, "Can't read %s, the program was built without gzip (SSLM_WITH_ZLIB)\n", name.c_str());
+		fatalError(ebuf);
+	}
+#endif
+#ifndef SSLM_WITH_ZSTD
+	if (s->kind == STREAM_ZSTD)
+	{
+		closeGridStream(s);
+		if (quiet) { return NULL; }
+		sprintf(ebuf, "Can't read %s, the program was built without zstd (SSLM_WITH_ZSTD)\n", name.c_str());
+		fatalError(ebuf);
+	}
+#endif
+
+	s->worker = thread(readAhead, s);
+	return s;
+}
+
+
+GridStream *openGridStream(const char *file)
+{
+	{
+		lock_guard<mutex> guard(prefetchLock);
+		map<string, GridStream *>::iterator it = prefetched.find(file);
+		if (it != prefetched.end())
+		{
+			GridStream *s = it->second;
+			prefetched.erase(it);
+			return s;
+		}
+	}
+	return openStream(file, false);
+}
+
+
+void prefetchGridStream(const char *file)
+{
+	{
+		lock_guard<mutex> guard(prefetchLock);
+		if (prefetched.count(file) > 0 || prefetched.size() >= MAX_PREFETCHED) { return; }
+	}
+	GridStream *s = openStream(file, true);
+	if (s == NULL) { return; }
+
+	lock_guard<mutex> guard(prefetchLock);
+	if (!prefetched.insert(make_pair(string(file), s)).second) { closeGridStream(s); }
+}
+
+
+void dropPrefetchedStreams()
+{
+	map<string, GridStream *> streams;
+	{
+		lock_guard<mutex> guard(prefetchLock);
+		streams.swap(prefetched);
+	}
+	for (map<string, GridStream *>::iterator it = streams.begin(); it != streams.end(); ++it)
+	{
+		closeGridStream(it->second);
+	}
+}
+
+
+/*
+** nextChunk()
+**
+** Waits for the next chunk, false at the end. The chunk read
+** before is kept for the thread to fill again.
+**
+*/
+static bool nextChunk(GridStream *s)
+{
+	unique_lock<mutex> guard(s->lock);
+	if (!s->done && s->chunks.empty())
+	{
+		TraceSpan span("grid", "wait chunk");
+		s->ready.wait(guard, [&]() { return s->done || !s->chunks.empty(); });
+	}
+	if (s->chunks.empty())
+	{
+		if (!s->error.empty())
+		{
+			string error = s->error + "\n";
+			guard.unlock();
+			fatalError(error.c_str());
+		}
+		return false;
+	}
+	if (s->current.capacity() > 0 && s->spare.empty())
+	{
+		s->spare.push_back(vector<char>());
+		s->spare.back().swap(s->current);
+	}
+	s->current.swap(s->chunks.front());
+	s->chunks.pop_front();
+	s->pos = 0;
+	s->space.notify_one();
+	return true;
+}
+
+
+char *gridGets(char *buf, int size, GridStream *s)
+{
+	int n = 0;
+	while (n < size - 1)
+	{
+		if (s->pos == s->current.size() && !nextChunk(s)) { break; }
+
+		const char *start = s->current.data() + s->pos;
+		size_t want = min(s->current.size() - s->pos, (size_t)(size - 1 - n));
+		const char *nl = (const char *)memchr(start, '\n', want);
+		size_t take = (nl != NULL) ? (size_t)(nl - start) + 1 : want;
+		memcpy(buf + n, start, take);
+		n += (int)take;
+		s->pos += take;
+		if (nl != NULL) { break; }
+	}
+	if (n == 0) { return NULL; }
+	buf[n] = '\0';
+
+	if (n >= 2 && buf[n - 1] == '\n' && buf[n - 2] == '\r')
+	{
+		buf[n - 2] = '\n';
+		buf[n - 1] = '\0';
+	}
+	return buf;
+}
+
+
+void closeGridStream(GridStream *s)
+{
+	if (s == NULL) { return; }
+	if (s->worker.joinable())
+	{
+		{
+			lock_guard<mutex> guard(s->lock);
+			s->stop = true;
+			s->space.notify_one();
+		}
+		s->worker.join();
+	}
+	if (s->fp) fclose(s->fp);
+	delete s;
+}
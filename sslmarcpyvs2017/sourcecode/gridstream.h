@@ -0,0 +1,47 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Line reader of the grid files that also reads compressed grids.
+** A name ending in .gz (gzip) or .zst (zstd) is decompressed while
+** it is read, and so is name.gz or name.zst when name itself does
+** not exist, so luws.txt can be archived as luws.txt.gz.
+**
+** A file is read (and decompressed) on a thread of its own into
+** chunks of a few megabytes; gridGets() takes the lines out of the
+** chunks while the next ones are read, so the disk does not wait for
+** the parser and the parser only waits for the disk when it is ahead.
+** At most four chunks wait, and compressed data is never written to
+** disk. gzip needs the program built with SSLM_WITH_ZLIB and zstd
+** with SSLM_WITH_ZSTD (see textout.h).
+**
+** prefetchGridStream() opens the next grid before it is needed, its
+** thread fills the chunks while the current grid is parsed, and the
+** openGridStream() of the same name takes the stream over.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef GRIDSTREAM_H
+#define GRIDSTREAM_H
+
+typedef struct GridStream GridStream;
+
+// Opens file (or file.gz, file.zst) for reading, NULL if none exists
+GridStream *openGridStream(const char *file);
+
+// Starts reading file ahead, nothing if it does not exist
+void prefetchGridStream(const char *file);
+
+// Closes the prefetched streams that were not opened
+void dropPrefetchedStreams();
+
+// Reads a line like fgets(), "\r\n" is returned as "\n"
+char *gridGets(char *buf, int size, GridStream *stream);
+
+void closeGridStream(GridStream *stream);
+
+#endif
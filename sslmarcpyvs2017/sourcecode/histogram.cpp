@@ -0,0 +1,209 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Counting histogram of quantized values, see histogram.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <vector>
+
+#include "histogram.h"
+
+using namespace std;
+
+
+/*
+** QuantizedHistogram()
+** Constructor for an empty histogram.
+*/
+QuantizedHistogram::QuantizedHistogram()
+{
+	tableFirst = 0;
+	lastPage = LLONG_MIN;
+	lastBase = 0;
+	sparse = false;
+	nvalues = 0;
+}
+
+
+/*
+** clear()
+** Frees the pages and the keys, the histogram is empty again.
+*/
+void QuantizedHistogram::clear()
+{
+	vector<unsigned int>().swap(bins);
+	vector<long long>().swap(pageKeys);
+	vector<int>().swap(pageTable);
+	unordered_map<long long, int>().swap(pageIndex);
+	vector<long long>().swap(keys);
+	tableFirst = 0;
+	lastPage = LLONG_MIN;
+	lastBase = 0;
+	sparse = false;
+	nvalues = 0;
+}
+
+
+/*
+** addSlow()
+**
+** A key off the last page: the page is looked up or made. A new
+** page that leaves too few values per bin turns the histogram into
+** the list of keys.
+**
+*/
+void QuantizedHistogram::addSlow(long long key)
+{
+	long long page = key >> HISTOGRAM_PAGE_SHIFT;
+	int slot = findPage(page);
+	if (slot < 0)
+	{
+		size_t nbins = bins.size() + HISTOGRAM_PAGE_BINS;
+		if (nbins > HISTOGRAM_MIN_BINS && (double)nbins > (double)HISTOGRAM_SPARSE_BINS*(double)nvalues)
+		{
+			makeSparse();
+			keys.push_back(key);
+			return;
+		}
+		slot = newPage(page);
+	}
+	lastPage = page;
+	lastBase = (size_t)slot*HISTOGRAM_PAGE_BINS;
+	bins[lastBase + (key & (HISTOGRAM_PAGE_BINS - 1))]++;
+}
+
+
+int QuantizedHistogram::findPage(long long page) const
+{
+	long long t = page - tableFirst;
+	if (t >= 0 && t < (long long)pageTable.size()) { return pageTable[t]; }
+
+	unordered_map<long long, int>::const_iterator it = pageIndex.find(page);
+	return (it != pageIndex.end()) ? it->second : -1;
+}
+
+
+/*
+** newPage()
+**
+** The table grows to take in the page if its span stays within
+** HISTOGRAM_TABLE_PAGES, pages further away go to the hash.
+**
+*/
+int QuantizedHistogram::newPage(long long page)
+{
+	int slot = (int)pageKeys.size();
+	pageKeys.push_back(page);
+	bins.resize(bins.size() + HISTOGRAM_PAGE_BINS, 0);
+
+	if (pageTable.empty())
+	{
+		tableFirst = page;
+		pageTable.push_back(slot);
+		return slot;
+	}
+
+	long long first = min(tableFirst, page);
+	long long last = max(tableFirst + (long long)pageTable.size() - 1, page);
+	if (last - first + 1 > HISTOGRAM_TABLE_PAGES)
+	{
+		pageIndex[page] = slot;
+		return slot;
+	}
+	if (page < tableFirst)
+	{
+		pageTable.insert(pageTable.begin(), (size_t)(tableFirst - page), -1);
+		tableFirst = page;
+	}
+	else if (page - tableFirst >= (long long)pageTable.size())
+	{
+		pageTable.resize((size_t)(page - tableFirst + 1), -1);
+	}
+	pageTable[page - tableFirst] = slot;
+	return slot;
+}
+
+
+/*
+** makeSparse()
+**
+** The counts go back to keys. The pages hold more than
+** HISTOGRAM_SPARSE_BINS bins per value by now, so this is less work
+** than the bins took.
+**
+*/
+void QuantizedHistogram::makeSparse()
+{
+	keys.reserve((size_t)nvalues);
+	for (size_t p = 0; p < pageKeys.size(); p++)
+	{
+		const unsigned int *page = &bins[p*HISTOGRAM_PAGE_BINS];
+		long long first = pageKeys[p] << HISTOGRAM_PAGE_SHIFT;
+		for (int b = 0; b < HISTOGRAM_PAGE_BINS; b++)
+		{
+			keys.insert(keys.end(), page[b], first + b);
+		}
+	}
+	vector<unsigned int>().swap(bins);
+	vector<long long>().swap(pageKeys);
+	vector<int>().swap(pageTable);
+	unordered_map<long long, int>().swap(pageIndex);
+	lastPage = LLONG_MIN;
+	sparse = true;
+}
+
+
+/*
+** curve()
+**
+** The percentage of a distinct value is (c - 1)*100/n with c the
+** values up to it, calculated as lorenzCurve() does.
+**
+*/
+void QuantizedHistogram::curve(double quantum, vector<double> &values, vector<double> &percents)
+{
+	values.clear();
+	percents.clear();
+	long long n = nvalues;
+	long long below = 0;
+
+	if (sparse)
+	{
+		sort(keys.begin(), keys.end());
+		for (size_t k = 0; k < keys.size(); k++)
+		{
+			if (k + 1 < keys.size() && keys[k] == keys[k + 1]) { continue; }
+			below = (long long)k + 1;
+			values.push_back(quantizedValue(keys[k], quantum));
+			percents.push_back((double)(below - 1) * (double)100. / (double)n);
+		}
+		return;
+	}
+
+	vector<long long> order(pageKeys);
+	sort(order.begin(), order.end());
+	for (size_t p = 0; p < order.size(); p++)
+	{
+		const unsigned int *page = &bins[(size_t)findPage(order[p])*HISTOGRAM_PAGE_BINS];
+		long long first = order[p] << HISTOGRAM_PAGE_SHIFT;
+		for (int b = 0; b < HISTOGRAM_PAGE_BINS; b++)
+		{
+			if (page[b] == 0) { continue; }
+			below += page[b];
+			values.push_back(quantizedValue(first + b, quantum));
+			percents.push_back((double)(below - 1) * (double)100. / (double)n);
+		}
+	}
+}
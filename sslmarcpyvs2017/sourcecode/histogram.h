@@ -0,0 +1,134 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Counting histogram of the values of a land use and factor that
+** lie on a quantum: grids in centimeters, 0.01 degree or whole
+** meters hold values k*quantum, so the curve and its area follow
+** from the count of each k in increasing order (lorenz.h) without
+** sorting the cells, in O(n + range).
+**
+** The keys are counted in pages of HISTOGRAM_PAGE_BINS bins, only
+** the pages that are hit exist, so a wide range with gaps (nodata
+** far below the terrain values) costs the pages around the values.
+** A table finds the pages of a span of up to HISTOGRAM_TABLE_PAGES
+** pages, a hash the ones outside it. When the values are spread so
+** thin that the pages would hold more bins than HISTOGRAM_SPARSE_BINS
+** per value, the keys are kept in a list and sorted instead.
+**
+** A value v of a float grid lies on the quantum q if (float)(k*q)
+** is v for the nearest integer k, which is what a grid written with
+** that resolution holds. The value of key k is then given back the
+** same to the last bit, and different values get different keys in
+** the same order, so the curve and area are the ones of the sort.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <math.h>
+#include <unordered_map>
+#include <vector>
+
+// Bins of a page, a power of two
+#define HISTOGRAM_PAGE_SHIFT 8
+#define HISTOGRAM_PAGE_BINS (1 << HISTOGRAM_PAGE_SHIFT)
+
+// Bins per value above which the pages turn into a list of keys,
+// and the bins that are always allowed
+#define HISTOGRAM_SPARSE_BINS 8
+#define HISTOGRAM_MIN_BINS (1 << 16)
+
+// Largest span of pages of the page table
+#define HISTOGRAM_TABLE_PAGES (1 << 16)
+
+
+// Key of v on quantum, false if v does not lie on it (or is NaN or
+// out of range)
+inline bool quantizeValue(float v, double quantum, long long &key)
+{
+	double k = floor((double)v / quantum + 0.5);
+	if (!(fabs(k) < 4.0e18)) { return false; }
+	key = (long long)k;
+	return (float)(k*quantum) == v;
+}
+
+// The value of key, the same as the v it came from
+inline double quantizedValue(long long key, double quantum)
+{
+	return (double)(float)((double)key*quantum);
+}
+
+
+// Define class
+class QuantizedHistogram
+{
+public:
+	QuantizedHistogram();
+
+	// Removes the counts and frees the memory
+	void clear();
+
+	// Counts one value of key
+	void add(long long key)
+	{
+		nvalues++;
+		if (sparse)
+		{
+			keys.push_back(key);
+			return;
+		}
+		long long page = key >> HISTOGRAM_PAGE_SHIFT;
+		if (page != lastPage)
+		{
+			addSlow(key);
+			return;
+		}
+		bins[lastBase + (key & (HISTOGRAM_PAGE_BINS - 1))]++;
+	}
+
+	// Values counted
+	long long size() const { return nvalues; }
+
+	// Points of the lorenz curve of the values: the distinct values
+	// (k*quantum) in increasing order and their percentages, as
+	// lorenzCurve() gives them from the sorted values. Sorts the
+	// keys of a sparse histogram.
+	void curve(double quantum, std::vector<double> &values, std::vector<double> &percents);
+
+	// Pages or the list of keys
+	bool isSparse() const { return sparse; }
+
+private:
+	void addSlow(long long key);
+	int findPage(long long page) const;
+	int newPage(long long page);
+	void makeSparse();
+
+	// Counts of the pages one after the other, the page of
+	// pageKeys[p] at bins[p*HISTOGRAM_PAGE_BINS]
+	std::vector<unsigned int> bins;
+	std::vector<long long> pageKeys;
+
+	// Slot of the pages from tableFirst on (-1 for none), and of the
+	// pages outside the table
+	long long tableFirst;
+	std::vector<int> pageTable;
+	std::unordered_map<long long, int> pageIndex;
+
+	// Page of the last key, values come in patches
+	long long lastPage;
+	size_t lastBase;
+
+	bool sparse;
+	std::vector<long long> keys;
+
+	long long nvalues;
+};
+
+#endif
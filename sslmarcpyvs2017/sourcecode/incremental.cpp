@@ -0,0 +1,386 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Incremental recalculation of the lorenz curve areas for land
+** use edits.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <algorithm>
+
+#include "app.h"
+#include "incremental.h"
+#include "lorenz.h"
+#include "message.h"
+
+using namespace std;
+
+
+OrderTree::OrderTree()
+{
+	n = 0;
+	exactArea = 0.0;
+	changed = false;
+}
+
+
+/*
+** OrderTree::build()
+**
+** Builds the tree from sorted values. The values come in order,
+** so each one is added at the end of the map.
+**
+*/
+void OrderTree::build(const double *sorted, long long nvals)
+{
+	cnt.clear();
+	n = nvals;
+	for (long long index = 0; index < nvals; index++)
+	{
+		double v = sorted[index];
+		if (index > 0 && sorted[index - 1] == v)
+		{
+			cnt.rbegin()->second++;
+		}
+		else
+		{
+			cnt.insert(cnt.end(), pair<const double, long long>(v, 1));
+		}
+	}
+	exactArea = lorenzAreaSorted(sorted, nvals);
+	changed = false;
+}
+
+
+void OrderTree::insert(double v)
+{
+	cnt[v]++;
+	n++;
+	changed = true;
+}
+
+
+/*
+** OrderTree::remove()
+**
+** Removes one value that is in the tree.
+**
+*/
+void OrderTree::remove(double v)
+{
+	map<double, long long>::iterator it = cnt.find(v);
+	if (it == cnt.end())
+	{
+		fatalError("Removing a value that is not in the tree");
+	}
+	if (--it->second == 0) { cnt.erase(it); }
+	n--;
+	changed = true;
+}
+
+
+/*
+** OrderTree::area()
+**
+** A distinct value is the last of its copies in the sorted values,
+** at index (values up to it) - 1; the trapezoids are the ones of
+** lorenzAreaSorted() with the same operations.
+**
+*/
+double OrderTree::area()
+{
+	if (!changed) { return exactArea; }
+
+	double sum = 0.0;
+	double prevval = 0.0;
+	double prevper = 0.0;
+	long long upto = 0;
+	for (map<double, long long>::iterator it = cnt.begin(); it != cnt.end(); ++it)
+	{
+		upto += it->second;
+		double per = (double)(upto - 1) * (double)100. / (double)n;
+		if (it != cnt.begin())
+		{
+			sum = sum + (it->first - prevval)*(prevper + per) / (double)2;
+		}
+		prevval = it->first;
+		prevper = per;
+	}
+	exactArea = sum;
+	changed = false;
+	return exactArea;
+}
+
+
+IncrementalLorenz::IncrementalLorenz()
+{
+	codes = NULL;
+	lunos = NULL;
+	nlus = nsrclus = nsinklus = 0;
+}
+
+
+IncrementalLorenz::~IncrementalLorenz()
+{
+	if (codes) delete[] codes;
+}
+
+
+int IncrementalLorenz::luCode(int luno)
+{
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		if (lunos[luidx] == luno) { return luidx; }
+	}
+	return -1;
+}
+
+
+/*
+** loadBaseline()
+**
+** Loads the terrain and land use of app and builds the tree of
+** each land use and factor from the sorted values.
+**
+*/
+void IncrementalLorenz::loadBaseline(App *app)
+{
+	char buf2[512];
+
+	app->readLuLists();
+	lunos = app->allsrcsinklus;
+	nsrclus = 0;
+	while (nsrclus < MAX_LUIDS && app->srclunums[nsrclus] != 0) { nsrclus++; }
+	nsinklus = 0;
+	while (nsinklus < MAX_LUIDS && app->sinklunums[nsinklus] != 0) { nsinklus++; }
+	nlus = nsrclus + nsinklus;
+
+	store.loadTerrain(app->demFile, app->distFile, app->slopeFile);
+	luctr.assign(nlus, 0);
+	codes = store.readLuCodes(app->luFile, lunos, nlus, &luctr[0]);
+
+	sprintf(buf2, "Building the baseline trees!!\n");
+	DisplayMessage(buf2);
+
+	vector<double *> sorted(nlus*NUM_FACTORS);
+	store.sortLuValues(codes, nlus, &luctr[0], &sorted[0]);
+
+	trees.assign(nlus*NUM_FACTORS, OrderTree());
+	for (int t = 0; t < nlus*NUM_FACTORS; t++)
+	{
+		trees[t].build(sorted[t], luctr[t / NUM_FACTORS]);
+		delete[] sorted[t];
+	}
+
+	sprintf(buf2, "Finished building the baseline trees!!\n");
+	DisplayMessage(buf2);
+}
+
+
+/*
+** changeCell()
+**
+** Moves the values of cell p to the trees of newcode.
+**
+*/
+void IncrementalLorenz::changeCell(long long p, int newcode)
+{
+	int oldcode = codes[p];
+	if (oldcode == newcode) { return; }
+
+	editcells.push_back(p);
+	editcodes.push_back((signed char)oldcode);
+
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		double v = store.values[f][p];
+		if (oldcode >= 0) { trees[oldcode*NUM_FACTORS + f].remove(v); }
+		if (newcode >= 0) { trees[newcode*NUM_FACTORS + f].insert(v); }
+	}
+	if (oldcode >= 0) { luctr[oldcode]--; }
+	if (newcode >= 0) { luctr[newcode]++; }
+	codes[p] = (signed char)newcode;
+}
+
+
+/*
+** applyEdits()
+**
+** Reads and applies the changed cells of an edit file. Edits made
+** against another land use than the current one are rejected, so a
+** scenario of another baseline does not change the wrong cells.
+** Lines that are not 4 numbers are reported, empty lines and lines
+** starting with # are comments.
+**
+*/
+long long IncrementalLorenz::applyEdits(const char *editfile)
+{
+	char buf2[512];
+	FILE *fp = fopen(editfile, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't find %s\n", editfile);
+		fatalError(buf2);
+	}
+
+	int cols = store.header->cols;
+	int rows = store.header->rows;
+	long long nchanged = 0;
+	long long nskipped = 0;
+	long long nrejected = 0;
+	long long nbad = 0;
+	long long lineno = 0;
+	int row, col, oldlu, newlu;
+	char text[512];
+	char rest[2];
+
+	while (fgets(text, sizeof(text), fp) != NULL)
+	{
+		lineno++;
+		if (sscanf(text, "%1s", rest) != 1 || rest[0] == '#') { continue; }
+		if (sscanf(text, "%d %d %d %d %1s", &row, &col, &oldlu, &newlu, rest) != 4)
+		{
+			sprintf(buf2, "%s line %lld is not \"row col oldlu newlu\", skipped\n", editfile, lineno);
+			DisplayMessage(buf2);
+			nbad++;
+			continue;
+		}
+		if (row < 0 || col < 0 || row >= rows || col >= cols) { nskipped++; continue; }
+
+		long long p = (long long)row*cols + col;
+		if (codes[p] != luCode(oldlu))
+		{
+			sprintf(buf2, "Cell %d %d is not land use %d, edit rejected\n", row, col, oldlu);
+			DisplayMessage(buf2);
+			nrejected++;
+			continue;
+		}
+		changeCell(p, luCode(newlu));
+		nchanged++;
+	}
+	fclose(fp);
+
+	if (nskipped > 0)
+	{
+		sprintf(buf2, "%lld edits outside of the grid were skipped\n", nskipped);
+		DisplayMessage(buf2);
+	}
+	if (nrejected > 0)
+	{
+		sprintf(buf2, "%lld edits of cells that are not their old land use were rejected\n", nrejected);
+		DisplayMessage(buf2);
+	}
+	if (nbad > 0)
+	{
+		sprintf(buf2, "%lld lines of %s could not be read\n", nbad, editfile);
+		DisplayMessage(buf2);
+	}
+	return nchanged;
+}
+
+
+/*
+** revertEdits()
+**
+** Undoes the changes in reverse order.
+**
+*/
+void IncrementalLorenz::revertEdits()
+{
+	for (size_t e = editcells.size(); e > 0; e--)
+	{
+		long long p = editcells[e - 1];
+		int basecode = editcodes[e - 1];
+		int curcode = codes[p];
+
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			double v = store.values[f][p];
+			if (curcode >= 0) { trees[curcode*NUM_FACTORS + f].remove(v); }
+			if (basecode >= 0) { trees[basecode*NUM_FACTORS + f].insert(v); }
+		}
+		if (curcode >= 0) { luctr[curcode]--; }
+		if (basecode >= 0) { luctr[basecode]++; }
+		codes[p] = (signed char)basecode;
+	}
+	editcells.clear();
+	editcodes.clear();
+}
+
+
+/*
+** writeResults()
+**
+** Writes the areas and area percentages of the current land use.
+**
+*/
+void IncrementalLorenz::writeResults(const char *prefix)
+{
+	char buf2[512];
+	vector<LuResult> results(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		results[luidx].luno = lunos[luidx];
+		results[luidx].ncells = luctr[luidx];
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			results[luidx].area[f] = trees[luidx*NUM_FACTORS + f].area();
+		}
+	}
+
+	sprintf(buf2, "%sLurenzCurveAreas.txt", prefix);
+	writeLorenzAreas(buf2, &results[0], nlus);
+	sprintf(buf2, "%sluareaperc.txt", prefix);
+	writeAreaPerc(buf2, &results[0], nsrclus, nsinklus);
+}
+
+
+/*
+** runScenarios()
+**
+** Loads the baseline once and runs each scenario of the manifest.
+**
+*/
+void IncrementalLorenz::runScenarios(App *app, const char *manifest)
+{
+	char buf2[1024];
+	char label[512];
+	char editfile[512];
+
+	loadBaseline(app);
+
+	FILE *fp = fopen(manifest, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't find %s\n", manifest);
+		fatalError(buf2);
+	}
+
+	while (fgets(buf2, sizeof(buf2), fp) != NULL)
+	{
+		if (sscanf(buf2, "%511s %511s", label, editfile) != 2 || label[0] == '#') { continue; }
+
+		long long nchanged = applyEdits(editfile);
+
+		char prefix[520];
+		sprintf(prefix, "%s_", label);
+		writeResults(prefix);
+
+		sprintf(buf2, "Scenario %s: %lld cells changed!!\n", label, nchanged);
+		DisplayMessage(buf2);
+
+		revertEdits();
+	}
+	fclose(fp);
+}
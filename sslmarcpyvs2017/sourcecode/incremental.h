@@ -0,0 +1,105 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Incremental recalculation of the lorenz curve areas for land
+** use edits (what-if scenarios). The values of each land use and
+** factor from a baseline run are kept in ordered trees of the
+** distinct values and their counts. Changing the land use of a cell
+** removes its values from the trees of the old land use and adds
+** them to the new one. The area of a tree that changed is summed
+** again over its distinct values, trapezoid by trapezoid as App
+** does it, so the areas are the same as a full run to the last bit
+** (the closed form of lorenz.h is not, it rounds differently). A
+** scenario costs the changed cells and the distinct values of the
+** land uses they touch; the grids are not read or sorted again.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <map>
+#include <vector>
+
+#include "cellstore.h"
+
+class App;
+
+
+// Values of one land use and factor
+class OrderTree
+{
+public:
+	OrderTree();
+
+	// Builds the tree from sorted values
+	void build(const double *sorted, long long nvals);
+	void insert(double v);
+	void remove(double v);
+
+	// Area as lorenzAreaSorted() of the values, kept until the
+	// values change
+	double area();
+
+	long long n;
+
+private:
+	std::map<double, long long> cnt;
+	double exactArea;
+	bool changed;
+};
+
+
+// Define class
+class IncrementalLorenz
+{
+public:
+	IncrementalLorenz();
+	~IncrementalLorenz();
+
+	// Reads the lists and grids of app and builds the trees
+	void loadBaseline(App *app);
+
+	// Each line of the edit file is "row col oldlu newlu", rows and
+	// columns counted from 0 at the upper left corner. An edit of a
+	// cell that is not oldlu is rejected (unlisted land uses are not
+	// told apart). Returns the number of changed cells.
+	long long applyEdits(const char *editfile);
+
+	// Undoes all edits since the baseline
+	void revertEdits();
+
+	// Writes LurenzCurveAreas.txt and luareaperc.txt of the
+	// current land use, prefix is added to the file names.
+	void writeResults(const char *prefix);
+
+	// Runs the scenarios of a manifest ("label editfile" per line):
+	// each is applied to the baseline, written and reverted.
+	void runScenarios(App *app, const char *manifest);
+
+private:
+	void changeCell(long long p, int newcode);
+	int luCode(int luno);
+
+	CellStore store;
+	signed char *codes;
+
+	const int *lunos;
+	int nlus;
+	int nsrclus;
+	int nsinklus;
+	std::vector<long long> luctr;
+
+	std::vector<OrderTree> trees;
+
+	// Changed cells and their code before the change, to revert
+	std::vector<long long> editcells;
+	std::vector<signed char> editcodes;
+};
+
+#endif
@@ -0,0 +1,514 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Moving window (local) lorenz curve areas.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <math.h>
+#include <cfloat>
+#include <vector>
+
+#include "app.h"
+#include "ascgrid.h"
+#include "locallwli.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+#define LOCAL_NODATA -9999.0f
+
+// Largest number of quantized values of one factor
+#define MAX_QUANT_BINS (1 << 26)
+
+static const char *factorNames[NUM_FACTORS] = { "elev", "dist", "slp" };
+
+
+/*
+** QuantTree::init()
+**
+** Empty tree for values 0 to nbins - 1.
+**
+*/
+void QuantTree::init(int bins)
+{
+	nbins = bins;
+	topbit = 1;
+	while (topbit * 2 <= nbins) { topbit *= 2; }
+	tree.assign(nbins + 1, 0);
+	cnt.assign(nbins, 0);
+	n = 0;
+	sum = 0;
+	gapsum = 0;
+}
+
+
+void QuantTree::add(int bin, int delta)
+{
+	for (int i = bin + 1; i <= nbins; i += i & (-i)) { tree[i] += delta; }
+}
+
+
+// Number of values <= bin
+long long QuantTree::prefix(int bin)
+{
+	long long total = 0;
+	for (int i = bin + 1; i > 0; i -= i & (-i)) { total += tree[i]; }
+	return total;
+}
+
+
+// Smallest bin with prefix(bin) >= k, k from 1 to n
+int QuantTree::kth(long long k)
+{
+	int pos = 0;
+	for (int step = topbit; step > 0; step /= 2)
+	{
+		if (pos + step <= nbins && tree[pos + step] < k)
+		{
+			pos += step;
+			k -= tree[pos];
+		}
+	}
+	return pos;
+}
+
+
+// Largest used bin below bin, -1 if none
+int QuantTree::pred(int bin)
+{
+	long long below = (bin > 0) ? prefix(bin - 1) : 0;
+	return (below == 0) ? -1 : kth(below);
+}
+
+
+// Smallest used bin above bin, -1 if none
+int QuantTree::succ(int bin)
+{
+	long long upto = prefix(bin);
+	return (upto == n) ? -1 : kth(upto + 1);
+}
+
+
+/*
+** QuantTree::insert()
+**
+** Adds one value. Only the gap of the value itself and the gap of
+** the next larger value change, see lorenz.h.
+**
+*/
+void QuantTree::insert(int bin)
+{
+	int a = pred(bin);
+	int gap = (a < 0) ? 0 : bin - a;
+
+	if (cnt[bin] == 0)
+	{
+		int c = succ(bin);
+		if (c >= 0)
+		{
+			int oldgap = (a < 0) ? 0 : c - a;
+			gapsum += (long long)cnt[c] * ((c - bin) - oldgap);
+		}
+	}
+	gapsum += gap;
+
+	cnt[bin]++;
+	add(bin, 1);
+	n++;
+	sum += bin;
+}
+
+
+/*
+** QuantTree::remove()
+**
+** Removes one value that was added before.
+**
+*/
+void QuantTree::remove(int bin)
+{
+	int a = pred(bin);
+	int gap = (a < 0) ? 0 : bin - a;
+
+	cnt[bin]--;
+	add(bin, -1);
+	n--;
+	sum -= bin;
+	gapsum -= gap;
+
+	if (cnt[bin] == 0)
+	{
+		int c = succ(bin);
+		if (c >= 0)
+		{
+			int newgap = (a < 0) ? 0 : c - a;
+			gapsum += (long long)cnt[c] * (newgap - (c - bin));
+		}
+	}
+}
+
+
+/*
+** QuantTree::area()
+**
+** Area under the lorenz curve, the sums are exact integers.
+**
+*/
+double QuantTree::area()
+{
+	if (n == 0) { return 0.0; }
+	long long umin = kth(1);
+	long long umax = kth(n);
+	long long num = 2 * (n*umax - sum) + gapsum - 2 * (umax - umin);
+	return 50.0 * (double)num / (double)n;
+}
+
+
+/*
+** LocalLorenz()
+** Constructor for the local lorenz object.
+*/
+LocalLorenz::LocalLorenz()
+{
+	window = 0;
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		quantum[f] = 0.0;
+		values[f] = NULL;
+	}
+	rows = cols = 0;
+	nlus = nsrclus = 0;
+	lunos = NULL;
+	celllu = NULL;
+	wsmask = NULL;
+}
+
+
+/*
+** ~LocalLorenz()
+**
+** Destrcutor, the grids belong to the App.
+*/
+LocalLorenz::~LocalLorenz()
+{
+	if (celllu) delete[] celllu;
+}
+
+
+/*
+** setupFactors()
+**
+** Finds the land use index of each cell and the quantum and
+** number of bins of each factor.
+**
+*/
+void LocalLorenz::setupFactors(App *app)
+{
+	rows = app->getRows();
+	cols = app->getCols();
+	lunos = app->allsrcsinklus;
+	wsmask = app->getWatershedMask();
+
+	nlus = 0;
+	while (nlus < MAX_LUIDS && lunos[nlus] != 0) { nlus++; }
+	nsrclus = 0;
+	while (nsrclus < MAX_LUIDS && app->srclunums[nsrclus] != 0) { nsrclus++; }
+
+	for (int f = 0; f < NUM_FACTORS; f++) { values[f] = app->ascfactors[f]; }
+
+	long long ncells = (long long)rows*cols;
+	celllu = new signed char[ncells];
+	if (celllu == NULL)
+	{
+		fatalError("Out of memory in LocalLorenz::setupFactors()");
+	}
+
+	for (long long index = 0; index < ncells; index++)
+	{
+		celllu[index] = -1;
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			if (app->asclu[index] == lunos[luidx])
+			{
+				celllu[index] = (signed char)luidx;
+				break;
+			}
+		}
+	}
+
+	char buf2[512];
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		double lo = DBL_MAX;
+		double hi = -DBL_MAX;
+		for (long long index = 0; index < ncells; index++)
+		{
+			if (celllu[index] < 0) { continue; }
+			if (values[f][index] < lo) { lo = values[f][index]; }
+			if (values[f][index] > hi) { hi = values[f][index]; }
+		}
+		if (lo > hi) { lo = hi = 0.0; }
+
+		if (quantum[f] <= 0.0)
+		{
+			quantum[f] = (hi > lo) ? (hi - lo) / 65535.0 : 1.0;
+		}
+		double steps = floor((hi - lo) / quantum[f] + 0.5);
+		if (steps + 1 > MAX_QUANT_BINS)
+		{
+			sprintf(buf2, "Quantum %g of %s gives too many values, use a larger one\n",
+				quantum[f], factorNames[f]);
+			fatalError(buf2);
+		}
+		vmin[f] = lo;
+		nbins[f] = (int)steps + 1;
+
+		sprintf(buf2, "Local %s: quantum %g, %d values\n", factorNames[f], quantum[f], nbins[f]);
+		DisplayMessage(buf2);
+	}
+}
+
+
+/*
+** updateCell()
+**
+** Adds (delta 1) or removes (delta -1) the values of cell i, j.
+**
+*/
+void LocalLorenz::updateCell(int i, int j, int delta, vector<QuantTree> &trees)
+{
+	if (i < 0 || j < 0 || i >= rows || j >= cols) { return; }
+
+	long long index = (long long)i*cols + j;
+	int luidx = celllu[index];
+	if (luidx < 0) { return; }
+
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		int bin = (int)floor((values[f][index] - vmin[f]) / quantum[f] + 0.5);
+		if (bin < 0) { bin = 0; }
+		if (bin >= nbins[f]) { bin = nbins[f] - 1; }
+
+		if (delta > 0) { trees[luidx*NUM_FACTORS + f].insert(bin); }
+		else { trees[luidx*NUM_FACTORS + f].remove(bin); }
+	}
+}
+
+
+/*
+** storeCell()
+**
+** Stores the areas of the window centered on cell i, j.
+**
+*/
+void LocalLorenz::storeCell(int i, int j, int chunkStart, vector<QuantTree> &trees)
+{
+	long long index = (long long)i*cols + j;
+	long long outidx = (long long)(i - chunkStart)*cols + j;
+	bool inside = (wsmask == NULL || wsmask[index]);
+
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		double srcsum = 0.0;
+		double allsum = 0.0;
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			QuantTree &tree = trees[luidx*NUM_FACTORS + f];
+			float area = LOCAL_NODATA;
+			if (inside && tree.n > 0)
+			{
+				double a = tree.area() * quantum[f];
+				area = (float)a;
+
+				// area percentage over the window times area,
+				// the number of cells of the window cancels out
+				allsum += (double)tree.n * a;
+				if (luidx < nsrclus) { srcsum += (double)tree.n * a; }
+			}
+			outareas[luidx*NUM_FACTORS + f][outidx] = area;
+		}
+		outlwli[f][outidx] = (allsum > 0.0) ? (float)(srcsum / allsum) : LOCAL_NODATA;
+	}
+}
+
+
+/*
+** calBand()
+**
+** Slides the window over rows r0 to r1 - 1 in a snake order: along
+** the first row to the right, one row down, along the next row to
+** the left and so on. Each step adds and removes one row or column
+** of the window.
+**
+*/
+void LocalLorenz::calBand(int r0, int r1, int chunkStart, vector<QuantTree> &trees)
+{
+	int h = window / 2;
+
+	for (size_t t = 0; t < trees.size(); t++)
+	{
+		trees[t].init(nbins[t % NUM_FACTORS]);
+	}
+
+	// Window around (r0, 0)
+	for (int i = r0 - h; i <= r0 + h; i++)
+	{
+		for (int j = -h; j <= h; j++) { updateCell(i, j, 1, trees); }
+	}
+
+	int c = 0;
+	for (int r = r0; r < r1; r++)
+	{
+		int step = ((r - r0) % 2 == 0) ? 1 : -1;
+		int last = (step > 0) ? cols - 1 : 0;
+
+		storeCell(r, c, chunkStart, trees);
+		while (c != last)
+		{
+			// Remove the column leaving the window, add the one entering
+			int leave = c - step*h;
+			int enter = c + step*(h + 1);
+			for (int i = r - h; i <= r + h; i++)
+			{
+				updateCell(i, leave, -1, trees);
+				updateCell(i, enter, 1, trees);
+			}
+			c += step;
+			storeCell(r, c, chunkStart, trees);
+		}
+
+		if (r + 1 < r1)
+		{
+			for (int j = c - h; j <= c + h; j++)
+			{
+				updateCell(r - h, j, -1, trees);
+				updateCell(r + h + 1, j, 1, trees);
+			}
+		}
+	}
+}
+
+
+/*
+** writeChunk()
+**
+** Appends the rows of the chunk to the output grids.
+**
+*/
+void LocalLorenz::writeChunk(int nrows)
+{
+	for (size_t t = 0; t < fpareas.size(); t++)
+	{
+		writeAscGridRows(fpareas[t], outareas[t], nrows, cols);
+	}
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		writeAscGridRows(fplwli[f], outlwli[f], nrows, cols);
+	}
+}
+
+
+/*
+** calLocalLorenz()
+**
+** Calculates the moving window areas. The rows are processed in
+** chunks, each chunk is split into bands over the threads and is
+** written before the next chunk starts, so that the outputs never
+** have to be kept for the whole grid.
+** Outputs:
+** local_<factor>_lu<no>.txt: area of each land use and factor
+** local_lwli_<factor>.txt: source share of area percentage times
+**    area (unweighted lwli) of each factor
+**
+*/
+void LocalLorenz::calLocalLorenz(App *app)
+{
+	char buf2[512];
+
+	if (window < 1 || window % 2 == 0)
+	{
+		fatalError("The window size has to be an odd number of cells");
+	}
+
+	sprintf(buf2, "Calculating local lorenz curve areas in %d x %d windows!!\n", window, window);
+	DisplayMessage(buf2);
+
+	setupFactors(app);
+
+	AscGrid *header = readAscHeader(app->luFile);
+	header->noData = LOCAL_NODATA;
+
+	int nworkers = numWorkers();
+	int bandRows = (window > 64) ? window : 64;
+	int chunkRows = bandRows * nworkers;
+	if (chunkRows > rows) { chunkRows = rows; }
+
+	// Open the outputs and allocate the chunk buffers
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			sprintf(buf2, "local_%s_lu%d.txt", factorNames[f], lunos[luidx]);
+			FILE *fp = fopen(buf2, "w");
+			if (fp == NULL) { fatalError("Can't open output of local lorenz areas"); }
+			writeAscGridHeader(fp, header);
+			fpareas.push_back(fp);
+			outareas.push_back(new float[(size_t)chunkRows*cols]);
+		}
+	}
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		sprintf(buf2, "local_lwli_%s.txt", factorNames[f]);
+		FILE *fp = fopen(buf2, "w");
+		if (fp == NULL) { fatalError("Can't open output of local lwli"); }
+		writeAscGridHeader(fp, header);
+		fplwli.push_back(fp);
+		outlwli.push_back(new float[(size_t)chunkRows*cols]);
+	}
+
+	vector< vector<QuantTree> > trees(nworkers, vector<QuantTree>(nlus*NUM_FACTORS));
+
+	for (int chunkStart = 0; chunkStart < rows; chunkStart += chunkRows)
+	{
+		int nrows = (chunkStart + chunkRows > rows) ? rows - chunkStart : chunkRows;
+
+		parallelBands(nrows, nworkers, [&](int begin, int end, int worker)
+		{
+			calBand(chunkStart + begin, chunkStart + end, chunkStart, trees[worker]);
+		});
+
+		writeChunk(nrows);
+	}
+
+	for (size_t t = 0; t < fpareas.size(); t++)
+	{
+		fclose(fpareas[t]);
+		delete[] outareas[t];
+	}
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		fclose(fplwli[f]);
+		delete[] outlwli[f];
+	}
+	fpareas.clear();
+	outareas.clear();
+	fplwli.clear();
+	outlwli.clear();
+	freeAscGrid(header);
+
+	sprintf(buf2, "Finished calculating local lorenz curve areas!!\n");
+	DisplayMessage(buf2);
+}
@@ -0,0 +1,111 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Moving window (local) lorenz curve areas. For every cell the
+** areas of each land use are calculated from the cells inside a
+** k x k window centered on the cell, giving maps of the source and
+** sink imbalance instead of one value for the watershed.
+**
+** The window slides one cell at a time, so only one column (or
+** one row at the end of a row) enters and leaves the window. The
+** values of each land use and factor are kept in a Fenwick tree
+** over quantized values, which gives the sums needed by the closed
+** form in lorenz.h in O(log V) per added or removed cell.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef LOCALLWLI_H
+#define LOCALLWLI_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "lorenz.h"
+
+class App;
+
+
+// Counts of quantized values of one land use and factor
+class QuantTree
+{
+public:
+	void init(int nbins);
+	void insert(int bin);
+	void remove(int bin);
+
+	// Area under the lorenz curve in units of the quantum
+	double area();
+
+	long long n;
+
+private:
+	void add(int bin, int delta);
+	long long prefix(int bin);
+	int kth(long long k);
+	int pred(int bin);
+	int succ(int bin);
+
+	int nbins;
+	int topbit;
+	std::vector<int> tree;
+	std::vector<int> cnt;
+	long long sum;
+	long long gapsum;
+};
+
+
+// Define class
+class LocalLorenz
+{
+public:
+	LocalLorenz();
+	~LocalLorenz();
+
+	// Window size in cells, an odd number
+	int window;
+
+	// Quantum of elevation, distance and slope. Values are
+	// rounded to multiples of it, 0 picks the quantum so that
+	// the range of the values has 65536 steps.
+	double quantum[NUM_FACTORS];
+
+	// Calculates the maps from the grids read by app and
+	// writes them as arcview grids.
+	void calLocalLorenz(App *app);
+
+private:
+	void setupFactors(App *app);
+	void calBand(int r0, int r1, int chunkStart, std::vector<QuantTree> &trees);
+	void updateCell(int i, int j, int delta, std::vector<QuantTree> &trees);
+	void storeCell(int i, int j, int chunkStart, std::vector<QuantTree> &trees);
+	void writeChunk(int nrows);
+
+	int rows;
+	int cols;
+	int nlus;
+	int nsrclus;
+	int *lunos;
+
+	// Index into lunos of each cell, -1 if not a source or sink
+	signed char *celllu;
+
+	const float *values[NUM_FACTORS];
+	double vmin[NUM_FACTORS];
+	int nbins[NUM_FACTORS];
+
+	const unsigned char *wsmask;
+
+	// Output rows of the current chunk, for each land use and
+	// factor, and the local index of each factor
+	std::vector<float *> outareas;
+	std::vector<float *> outlwli;
+	std::vector<FILE *> fpareas;
+	std::vector<FILE *> fplwli;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Lorenz curve area of a sorted array and writers of the
+** result files, shared by the modes that do not go through
+** the App class.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+
+#include "lorenz.h"
+#include "message.h"
+
+
+/*
+** lorenzAreaSorted()
+**
+** The percentage of the value at index i is i*100/n. Of equal
+** values only the last one is kept, then the trapezoids between
+** the kept values are summed in increasing order.
+**
+*/
+double lorenzAreaSorted(const double *sorted, long long n)
+{
+	double area = 0.0;
+	double prevval = 0.0;
+	double prevper = 0.0;
+	bool first = true;
+
+	for (long long index = 0; index < n; index++)
+	{
+		if (index < n - 1 && sorted[index] == sorted[index + 1]) { continue; }
+
+		double per = (double)index * (double)100. / (double)n;
+		if (!first)
+		{
+			area = area + (sorted[index] - prevval)*(prevper + per) / (double)2;
+		}
+		prevval = sorted[index];
+		prevper = per;
+		first = false;
+	}
+	return area;
+}
+
+
+/*
+** lorenzCurve()
+**
+** Same selection of the points as lorenzAreaSorted(), done in place.
+**
+*/
+long long lorenzCurve(double *sorted, long long n, double *percents)
+{
+	long long m = 0;
+
+	for (long long index = 0; index < n; index++)
+	{
+		if (index < n - 1 && sorted[index] == sorted[index + 1]) { continue; }
+
+		sorted[m] = sorted[index];
+		percents[m] = (double)index * (double)100. / (double)n;
+		m++;
+	}
+	return m;
+}
+
+
+double lorenzAreaCurve(const double *values, const double *percents, long long m)
+{
+	double area = 0.0;
+
+	for (long long j = 1; j < m; j++)
+	{
+		area = area + (values[j] - values[j - 1])*(percents[j - 1] + percents[j]) / (double)2;
+	}
+	return area;
+}
+
+
+/*
+** writeLorenzAreas()
+**
+** Write the area under the lorenz curve of each land use.
+**
+*/
+void writeLorenzAreas(const char *file, const LuResult *results, int nlus)
+{
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	fprintf(fp, "Area under lorenz curve\n");
+	fprintf(fp, "Landuse, Area_Elevation, Area_Distance, Area_Slope\n");
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		fprintf(fp, "Landuse_%d, ", results[luidx].luno);
+		fprintf(fp, "%f, %f, %f\n",
+			results[luidx].area[0],
+			results[luidx].area[1],
+			results[luidx].area[2]);
+	}
+	fclose(fp);
+}
+
+
+/*
+** writeAreaPerc()
+**
+** Write the percentage of area of each land use over the area
+** of all source and sink land uses, sinks first.
+**
+*/
+void writeAreaPerc(const char *file, const LuResult *results, int nsrclus, int nsinklus)
+{
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	long long total = 0;
+	for (int luidx = 0; luidx < nsrclus + nsinklus; luidx++)
+	{
+		total += results[luidx].ncells;
+	}
+
+	fprintf(fp, "Percentage of area for each land use over watershed area\n");
+	fprintf(fp, "Landuse, Total_cells, Percentage\n");
+	for (int luidx = nsrclus; luidx < nsrclus + nsinklus; luidx++)
+	{
+		fprintf(fp, "Sink_%d, %lld, %f\n",
+			results[luidx].luno,
+			results[luidx].ncells,
+			(double)results[luidx].ncells / (double)total);
+	}
+	for (int luidx = 0; luidx < nsrclus; luidx++)
+	{
+		fprintf(fp, "Source_%d, %lld, %f\n",
+			results[luidx].luno,
+			results[luidx].ncells,
+			(double)results[luidx].ncells / (double)total);
+	}
+	fclose(fp);
+}
@@ -0,0 +1,74 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Closed form of the area under the lorenz curve as it is
+** calculated by App::callwli().
+**
+** callwli() sorts the n values of a land use, gives the value at
+** index i the percentage i*100/n, removes duplicated values (keeping
+** the last one, so a distinct value u_j gets (c_j - 1)*100/n where
+** c_j is the number of values <= u_j) and sums the trapezoids
+** between the m distinct values.
+**
+** Summing the trapezoids cell by cell gives
+**
+**   area = 50/n * (2*(n*umax - S) + G - 2*(umax - umin))
+**
+** with S the sum of the values and G the sum over the distinct
+** values of count(u_j)*(u_j - u_(j-1)) (the gap of the smallest
+** value is 0). n, S, umin, umax and G only change locally when a
+** value is added or removed, which is what the windowed and
+** uncertainty calculations use.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef LORENZ_H
+#define LORENZ_H
+
+// Number of factors: elevation, distance, slope, in the
+// order of the columns of LurenzCurveAreas.txt
+#define NUM_FACTORS 3
+
+// Results of one land use
+typedef struct LuResult
+{
+	int luno;
+	long long ncells;
+	double area[NUM_FACTORS];
+} LuResult;
+
+
+// Area under the lorenz curve from the sums described above.
+inline double lorenzAreaFromSums(double n, double umin, double umax, double sum, double gapsum)
+{
+	if (n <= 0) { return 0.0; }
+	return 50.0 / n * (2.0*(n*umax - sum) + gapsum - 2.0*(umax - umin));
+}
+
+// Area under the lorenz curve of n sorted values, calculated
+// step by step as in App::calperludata(), removeDuplicates()
+// and callwli() so that the result is the same to the last bit.
+double lorenzAreaSorted(const double *sorted, long long n);
+
+// Points of the lorenz curve of n sorted values: the distinct
+// values are moved to the front of sorted and their percentages
+// are put into percents. Returns the number of points.
+long long lorenzCurve(double *sorted, long long n, double *percents);
+
+// Area under the curve of m points given by lorenzCurve(), or by
+// QuantizedHistogram::curve(), the same as lorenzAreaSorted() of
+// the values they came from.
+double lorenzAreaCurve(const double *values, const double *percents, long long m);
+
+// Write LurenzCurveAreas.txt and luareaperc.txt with the layout
+// of App::writeLwliData() and App::calAreaPercOverws(). results
+// holds the source land uses first, then the sink land uses.
+void writeLorenzAreas(const char *file, const LuResult *results, int nlus);
+void writeAreaPerc(const char *file, const LuResult *results, int nsrclus, int nsinklus);
+
+#endif
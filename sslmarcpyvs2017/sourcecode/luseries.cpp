@@ -0,0 +1,171 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Land use time series mode.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#include "app.h"
+#include "luseries.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+LuSeries::LuSeries()
+{
+	njobs = 0;
+	lunos = NULL;
+	nlus = nsrclus = nsinklus = 0;
+}
+
+
+LuSeries::~LuSeries()
+{
+}
+
+
+/*
+** readManifest()
+**
+** Reads the labels and land use grids of the series.
+**
+*/
+void LuSeries::readManifest(const char *manifest)
+{
+	char buf2[1024];
+	char first[512];
+	char second[512];
+
+	FILE *fp = fopen(manifest, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't find %s\n", manifest);
+		fatalError(buf2);
+	}
+
+	while (fgets(buf2, sizeof(buf2), fp) != NULL)
+	{
+		int nread = sscanf(buf2, "%511s %511s", first, second);
+		if (nread <= 0 || first[0] == '#') { continue; }
+
+		if (nread == 2)
+		{
+			labels.push_back(first);
+			lufiles.push_back(second);
+		}
+		else
+		{
+			// Label from the file name without folder and extension
+			string label = first;
+			size_t slash = label.find_last_of("/\\");
+			if (slash != string::npos) { label = label.substr(slash + 1); }
+			size_t dot = label.find_last_of('.');
+			if (dot != string::npos && dot > 0) { label = label.substr(0, dot); }
+			labels.push_back(label);
+			lufiles.push_back(first);
+		}
+	}
+	fclose(fp);
+
+	if (lufiles.empty())
+	{
+		sprintf(buf2, "No land use grids in %s\n", manifest);
+		fatalError(buf2);
+	}
+}
+
+
+/*
+** runYear()
+**
+** Reads the land use grid of one year and writes its outputs.
+**
+*/
+void LuSeries::runYear(int year)
+{
+	char buf2[1024];
+	sprintf(buf2, "Processing land use %s (%s)!!\n", labels[year].c_str(), lufiles[year].c_str());
+	DisplayMessage(buf2);
+
+	vector<long long> luctr(nlus);
+	signed char *codes = store.readLuCodes(lufiles[year].c_str(), lunos, nlus, &luctr[0]);
+
+	vector<double *> sorted(nlus*NUM_FACTORS);
+	store.sortLuValues(codes, nlus, &luctr[0], &sorted[0]);
+	delete[] codes;
+
+	vector<LuResult> results(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		results[luidx].luno = lunos[luidx];
+		results[luidx].ncells = luctr[luidx];
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			double *vals = sorted[luidx*NUM_FACTORS + f];
+			results[luidx].area[f] = lorenzAreaSorted(vals, luctr[luidx]);
+			delete[] vals;
+		}
+	}
+
+	sprintf(buf2, "%s_LurenzCurveAreas.txt", labels[year].c_str());
+	writeLorenzAreas(buf2, &results[0], nlus);
+	sprintf(buf2, "%s_luareaperc.txt", labels[year].c_str());
+	writeAreaPerc(buf2, &results[0], nsrclus, nsinklus);
+
+	sprintf(buf2, "Finished land use %s!!\n", labels[year].c_str());
+	DisplayMessage(buf2);
+}
+
+
+/*
+** runSeries()
+**
+** Loads the terrain of app once, then processes the years. A worker
+** takes the next year as soon as it is done with one, so long and
+** short years mix well.
+**
+*/
+void LuSeries::runSeries(App *app, const char *manifest)
+{
+	readManifest(manifest);
+
+	app->readLuLists();
+	lunos = app->allsrcsinklus;
+	nsrclus = 0;
+	while (nsrclus < MAX_LUIDS && app->srclunums[nsrclus] != 0) { nsrclus++; }
+	nsinklus = 0;
+	while (nsinklus < MAX_LUIDS && app->sinklunums[nsinklus] != 0) { nsinklus++; }
+	nlus = nsrclus + nsinklus;
+
+	store.loadTerrain(app->demFile, app->distFile, app->slopeFile);
+
+	int nyears = (int)lufiles.size();
+	int nworkers = (njobs > 0) ? njobs : numWorkers();
+	atomic<int> nextYear(0);
+
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		for (int year = nextYear++; year < nyears; year = nextYear++)
+		{
+			runYear(year);
+		}
+	});
+
+	store.cleanMemory();
+}
@@ -0,0 +1,59 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Land use time series mode. The terrain grids are read once into
+** a cell store, then each land use grid of the series is streamed
+** against the store. The years are processed in parallel and each
+** writes its own LurenzCurveAreas.txt and luareaperc.txt.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef LUSERIES_H
+#define LUSERIES_H
+
+#include <string>
+#include <vector>
+
+#include "cellstore.h"
+
+class App;
+
+// Define class
+class LuSeries
+{
+public:
+	LuSeries();
+	~LuSeries();
+
+	// Number of years processed at the same time, 0 for
+	// the number of cores. Each year needs the memory of
+	// its sorted values.
+	int njobs;
+
+	// The manifest has one land use grid per line, optionally
+	// preceded by a label ("2001 lu2001.txt"). Without a label the
+	// file name without extension is used. Outputs are
+	// <label>_LurenzCurveAreas.txt and <label>_luareaperc.txt.
+	void runSeries(App *app, const char *manifest);
+
+private:
+	void readManifest(const char *manifest);
+	void runYear(int year);
+
+	CellStore store;
+
+	std::vector<std::string> labels;
+	std::vector<std::string> lufiles;
+
+	const int *lunos;
+	int nlus;
+	int nsrclus;
+	int nsinklus;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Location weighted landscape index from the lorenz curve areas.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "lwli.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+/*
+** calLwliSets()
+**
+** The weights of a block are copied so that the weights of one land
+** use for all sets of the block are next to each other, then the
+** source and sink sums of the block are accumulated land use by
+** land use in loops the compiler vectorizes.
+**
+*/
+void calLwliSets(int nlus, const int *isSource, const double *coef,
+	const double *weights, long long nsets, double *out, int nthreads)
+{
+	int nblocks = (int)((nsets + LWLI_BLOCK - 1) / LWLI_BLOCK);
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+
+	parallelBands(nblocks, nworkers, [&](int begin, int end, int)
+	{
+		vector<double> wt((size_t)nlus*LWLI_BLOCK);
+		double src[NUM_FACTORS][LWLI_BLOCK];
+		double sink[NUM_FACTORS][LWLI_BLOCK];
+
+		for (int b = begin; b < end; b++)
+		{
+			long long s0 = (long long)b*LWLI_BLOCK;
+			int ns = (int)((nsets - s0 < LWLI_BLOCK) ? nsets - s0 : LWLI_BLOCK);
+
+			const double *w = weights + s0*nlus;
+			for (int s = 0; s < ns; s++)
+			{
+				for (int lu = 0; lu < nlus; lu++)
+				{
+					wt[(size_t)lu*LWLI_BLOCK + s] = w[(size_t)s*nlus + lu];
+				}
+			}
+
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				for (int s = 0; s < ns; s++) { src[f][s] = 0.0; sink[f][s] = 0.0; }
+			}
+			for (int lu = 0; lu < nlus; lu++)
+			{
+				const double *wlu = &wt[(size_t)lu*LWLI_BLOCK];
+				for (int f = 0; f < NUM_FACTORS; f++)
+				{
+					double c = coef[lu*NUM_FACTORS + f];
+					double *acc = isSource[lu] ? src[f] : sink[f];
+					for (int s = 0; s < ns; s++) { acc[s] += wlu[s] * c; }
+				}
+			}
+
+			double *o = out + s0*NUM_LWLI;
+			for (int s = 0; s < ns; s++)
+			{
+				double lwli[NUM_FACTORS];
+				for (int f = 0; f < NUM_FACTORS; f++)
+				{
+					lwli[f] = src[f][s] / (src[f][s] + sink[f][s]);
+					o[s*NUM_LWLI + f] = lwli[f];
+				}
+				o[s*NUM_LWLI + 3] = lwli[0] * lwli[1] / lwli[2];
+			}
+		}
+	});
+}
+
+
+void lwliCoefficients(const LuResult *results, int nlus, vector<double> &coef)
+{
+	long long total = 0;
+	for (int luidx = 0; luidx < nlus; luidx++) { total += results[luidx].ncells; }
+
+	coef.resize(nlus*NUM_FACTORS);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		double perc = (total > 0) ? (double)results[luidx].ncells / (double)total : 0.0;
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			coef[luidx*NUM_FACTORS + f] = perc * results[luidx].area[f];
+		}
+	}
+}
+
+
+void readLuWeights(const char *file, vector<int> &lunos, vector<double> &weights)
+{
+	char buf[512];
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf, "Can't find %s\n", file);
+		fatalError(buf);
+	}
+
+	// The first line is a header
+	fgets(buf, sizeof(buf), fp);
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		int luno;
+		double weight;
+		if (sscanf(buf, "%d , %lf", &luno, &weight) != 2) { continue; }
+		lunos.push_back(luno);
+		weights.push_back(weight);
+	}
+	fclose(fp);
+}
+
+
+/*
+** lwliWeights()
+**
+** The toolbox stops when a weight is given for a land use that is
+** not a source (or sink); a land use without a weight is an error
+** here as well instead of a Python exception.
+**
+*/
+void lwliWeights(const LuResult *results, int nsrclus, int nsinklus,
+	const char *srcfile, const char *sinkfile, vector<double> &weights)
+{
+	char buf2[512];
+	weights.assign(nsrclus + nsinklus, 0.0);
+
+	for (int k = 0; k < 2; k++)
+	{
+		const char *file = (k == 0) ? srcfile : sinkfile;
+		int first = (k == 0) ? 0 : nsrclus;
+		int last = (k == 0) ? nsrclus : nsrclus + nsinklus;
+
+		vector<int> lunos;
+		vector<double> values;
+		readLuWeights(file, lunos, values);
+		vector<bool> given(nsrclus + nsinklus, false);
+
+		for (size_t i = 0; i < lunos.size(); i++)
+		{
+			int luidx = first;
+			while (luidx < last && results[luidx].luno != lunos[i]) { luidx++; }
+			if (luidx == last)
+			{
+				sprintf(buf2, "Land use %d in %s is not a %s land use\n", lunos[i], file, (k == 0) ? "source" : "sink");
+				fatalError(buf2);
+			}
+			weights[luidx] = values[i];
+			given[luidx] = true;
+		}
+		for (int luidx = first; luidx < last; luidx++)
+		{
+			if (!given[luidx])
+			{
+				sprintf(buf2, "No weight for land use %d in %s\n", results[luidx].luno, file);
+				fatalError(buf2);
+			}
+		}
+	}
+}
+
+
+void writeFinalLwli(const char *file, const double *lwli)
+{
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	fprintf(fp, "LWLI Values\n");
+	fprintf(fp, "LWLI for elevation\t%f\n", lwli[0]);
+	fprintf(fp, "LWLI for distance\t%f\n", lwli[1]);
+	fprintf(fp, "LWLI for slope\t%f\n", lwli[2]);
+	fprintf(fp, "LWLI combined\t%f\n", lwli[3]);
+	fclose(fp);
+}
+
+
+/*
+** runLwliSets()
+**
+** Reads all the weight sets, evaluates them and writes the results.
+**
+*/
+void runLwliSets(const LuResult *results, int nsrclus, int nsinklus,
+	const char *setsfile, const char *outfile)
+{
+	char buf2[512];
+	int nlus = nsrclus + nsinklus;
+
+	FILE *fp = fopen(setsfile, "r");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't find %s\n", setsfile);
+		fatalError(buf2);
+	}
+
+	// Column of each land use of results in the file
+	string line;
+	int c;
+	while ((c = fgetc(fp)) != EOF && c != '\n') { line += (char)c; }
+	vector<int> columns;
+	const char *p = line.c_str();
+	while (*p)
+	{
+		char *end;
+		long luno = strtol(p, &end, 10);
+		if (end == p) { break; }
+		columns.push_back((int)luno);
+		p = end;
+		while (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r') { p++; }
+	}
+	int ncols = (int)columns.size();
+
+	vector<int> colOfLu(nlus, -1);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int col = 0; col < ncols; col++)
+		{
+			if (columns[col] == results[luidx].luno) { colOfLu[luidx] = col; }
+		}
+		if (colOfLu[luidx] < 0)
+		{
+			sprintf(buf2, "No weights for land use %d in %s\n", results[luidx].luno, setsfile);
+			fatalError(buf2);
+		}
+	}
+
+	// Weights in the order of results
+	vector<double> weights;
+	vector<double> row(ncols);
+	bool done = false;
+	while (!done)
+	{
+		for (int col = 0; col < ncols; col++)
+		{
+			if (fscanf(fp, " %lf ,", &row[col]) != 1)
+			{
+				if (col > 0)
+				{
+					sprintf(buf2, "Incomplete weight set %lld in %s\n", (long long)(weights.size() / nlus) + 1, setsfile);
+					fatalError(buf2);
+				}
+				done = true;
+				break;
+			}
+		}
+		if (done) { break; }
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			weights.push_back(row[colOfLu[luidx]]);
+		}
+	}
+	fclose(fp);
+
+	long long nsets = (long long)(weights.size() / nlus);
+	vector<int> isSource(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++) { isSource[luidx] = (luidx < nsrclus) ? 1 : 0; }
+	vector<double> coef;
+	lwliCoefficients(results, nlus, coef);
+
+	vector<double> out((size_t)nsets*NUM_LWLI);
+	calLwliSets(nlus, &isSource[0], &coef[0], weights.data(), nsets, out.data(), 0);
+
+	fp = fopen(outfile, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", outfile);
+		fatalError(buf2);
+	}
+	fprintf(fp, "Set, LWLI_Elevation, LWLI_Distance, LWLI_Slope, LWLI_Combined\n");
+	for (long long s = 0; s < nsets; s++)
+	{
+		const double *o = &out[s*NUM_LWLI];
+		fprintf(fp, "%lld, %.9g, %.9g, %.9g, %.9g\n", s + 1, o[0], o[1], o[2], o[3]);
+	}
+	fclose(fp);
+
+	sprintf(buf2, "Evaluated %lld weight sets into %s!!\n", nsets, outfile);
+	DisplayMessage(buf2);
+}
@@ -0,0 +1,67 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Location weighted landscape index (LWLI) from the lorenz curve
+** areas, as Step09_CalculateLWLI of the PySSLM toolbox does it. For
+** each factor
+**
+**   lwli = sum_src(w*p*a) / (sum_src(w*p*a) + sum_sink(w*p*a))
+**
+** with w the weight of a land use, p its share of the cells of the
+** source and sink land uses and a its area under the lorenz curve,
+** and the combined index is lwli_elev*lwli_dist/lwli_slope.
+**
+** Many weight sets are evaluated at once: the products p*a are
+** calculated once and the sets are processed in blocks, transposed
+** so that the inner loops run over the sets of a block.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef LWLI_H
+#define LWLI_H
+
+#include <vector>
+
+#include "lorenz.h"
+
+// Number of values per weight set: elevation, distance,
+// slope and combined
+#define NUM_LWLI 4
+
+// Weight sets per block of calLwliSets()
+#define LWLI_BLOCK 256
+
+
+// LWLI of nsets weight sets. coef has p*a of each land use and
+// factor (nlus*NUM_FACTORS), weights one row of nlus weights per
+// set, and out gets NUM_LWLI values per set.
+void calLwliSets(int nlus, const int *isSource, const double *coef,
+	const double *weights, long long nsets, double *out, int nthreads);
+
+// coef of calLwliSets() from results, sources first, then sinks
+void lwliCoefficients(const LuResult *results, int nlus, std::vector<double> &coef);
+
+// Reads srclus_withweights.txt or sinklus_withweights.txt, a
+// header line then "luno,weight" lines.
+void readLuWeights(const char *file, std::vector<int> &lunos, std::vector<double> &weights);
+
+// Weights of results in their order from the source and sink
+// weight files. Every land use needs a weight.
+void lwliWeights(const LuResult *results, int nsrclus, int nsinklus,
+	const char *srcfile, const char *sinkfile, std::vector<double> &weights);
+
+// Writes finallwlis.txt as the toolbox does
+void writeFinalLwli(const char *file, const double *lwli);
+
+// Weight sets file: a header line with the land use numbers
+// separated by commas, then one set of weights per line. The
+// results are written one line per set to outfile.
+void runLwliSets(const LuResult *results, int nsrclus, int nsinklus,
+	const char *setsfile, const char *outfile);
+
+#endif
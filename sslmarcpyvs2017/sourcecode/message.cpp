@@ -1,15 +1,65 @@
-#include <stdio.h>
-
-void DisplayMessage(char const *s1, char const *s2, int line)
-{
-	if (s1 == NULL)
-	{
-		fprintf(stdout, "No message\n");
-		return;
-	}
-	if (s2)
-		fprintf(stdout, "Message: %s\n    %s %d\n", s1, s2, line);
-	else
-		fprintf(stdout, "%s\n", s1);
-
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "message.h"
+
+static MessageCallback messageCallback = NULL;
+static void *messageUser = NULL;
+static FatalErrorHandler fatalHandler = NULL;
+
+
+void setMessageCallback(MessageCallback callback, void *user)
+{
+	messageCallback = callback;
+	messageUser = user;
+}
+
+
+void setFatalErrorHandler(FatalErrorHandler handler)
+{
+	fatalHandler = handler;
+}
+
+
+void DisplayMessage(char const *s1, char const *s2, int line)
+{
+	char buf[1024];
+
+	if (s1 == NULL)
+	{
+		sprintf(buf, "No message\n");
+	}
+	else if (s2)
+	{
+		snprintf(buf, sizeof buf, "Message: %s\n    %s %d\n", s1, s2, line);
+	}
+	else
+	{
+		snprintf(buf, sizeof buf, "%s\n", s1);
+	}
+
+	if (messageCallback)
+		messageCallback(buf, messageUser);
+	else
+		fprintf(stdout, "%s", buf);
+
+}
+
+
+void fatalError(const char *msg)
+{
+	char longMsg[1024];
+
+	// The library passes the error to its caller instead of
+	// ending the process, the handler does not return.
+	if (fatalHandler)
+	{
+		fatalHandler(msg);
+	}
+
+	snprintf(longMsg, 1024, "The TOPAZ to WEPP translator program has encountered an error\nand can not continue. The error is:\n\n%s", msg);
+
+	fprintf(stdout, "%s %s\n", longMsg, "Error calculating LWLI");
+	exit(-1);
+
 }
\ No newline at end of file
@@ -1,20 +1,29 @@
-// This is start of the header guard.
-// ADD_H can be any unique name.  
-// By convention, we use the name of the header file.
-#ifndef message_h
-#define message_h
-
-// This is the content of the .h file, 
-//	which is where the declarations go
-// int add(int x, int y); // function prototype for add.h -- don't forget the semicolon!
-
-// This is the end of the header guard
-
-void DisplayMessage(const char *m1, const char *m2 = 0, int line = 0);
-void fatalError(const char *msg);
-
-
-
-
-
+// This is start of the header guard.
+// ADD_H can be any unique name.  
+// By convention, we use the name of the header file.
+#ifndef message_h
+#define message_h
+
+// This is the content of the .h file, 
+//	which is where the declarations go
+// int add(int x, int y); // function prototype for add.h -- don't forget the semicolon!
+
+// This is the end of the header guard
+
+void DisplayMessage(const char *m1, const char *m2 = 0, int line = 0);
+void fatalError(const char *msg);
+
+// By default messages go to stdout and fatalError() ends the
+// program. An embedding program can take the messages, and
+// install a handler that throws (it must not return).
+typedef void (*MessageCallback)(const char *msg, void *user);
+typedef void (*FatalErrorHandler)(const char *msg);
+
+void setMessageCallback(MessageCallback callback, void *user);
+void setFatalErrorHandler(FatalErrorHandler handler);
+
+
+
+
+
 #endif
\ No newline at end of file
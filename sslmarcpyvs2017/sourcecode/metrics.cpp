@@ -0,0 +1,254 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Metrics of the stages of a run, see metrics.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "metrics.h"
+#include "message.h"
+
+using namespace std;
+
+
+double processCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) { return -1.0; }
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart)*1e-7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) { return -1.0; }
+	return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+		(double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)*1e-6;
+#endif
+}
+
+
+/*
+** processIoBytes()
+**
+** rchar and wchar count every read() and write(), also those served
+** from the page cache, which is what the stages ask for.
+**
+*/
+void processIoBytes(double *read, double *written)
+{
+	*read = -1.0;
+	*written = -1.0;
+#ifdef _WIN32
+	IO_COUNTERS io;
+	if (GetProcessIoCounters(GetCurrentProcess(), &io))
+	{
+		*read = (double)io.ReadTransferCount;
+		*written = (double)io.WriteTransferCount;
+	}
+#else
+	FILE *fp = fopen("/proc/self/io", "r");
+	if (fp == NULL) { return; }
+	char line[128];
+	unsigned long long value;
+	while (fgets(line, sizeof line, fp))
+	{
+		if (sscanf(line, "rchar: %llu", &value) == 1) { *read = (double)value; }
+		else if (sscanf(line, "wchar: %llu", &value) == 1) { *written = (double)value; }
+	}
+	fclose(fp);
+#endif
+}
+
+
+void processMemory(double *rss, double *peak)
+{
+	*rss = -1.0;
+	*peak = -1.0;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof pmc))
+	{
+		*rss = (double)pmc.WorkingSetSize;
+		*peak = (double)pmc.PeakWorkingSetSize;
+	}
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		*peak = (double)usage.ru_maxrss;
+#else
+		*peak = (double)usage.ru_maxrss*1024.0;
+#endif
+	}
+
+	// Resident pages are the second number of statm
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp != NULL)
+	{
+		unsigned long long size, resident;
+		if (fscanf(fp, "%llu %llu", &size, &resident) == 2)
+		{
+			*rss = (double)resident*(double)sysconf(_SC_PAGESIZE);
+		}
+		fclose(fp);
+	}
+
+	// ru_maxrss is only updated now and then
+	if (*rss > *peak) { *peak = *rss; }
+#endif
+}
+
+
+RunMetrics::RunMetrics()
+{
+	enabled = false;
+	runStart = chrono::steady_clock::now();
+	wallStart = runStart;
+	cpuStart = 0.0;
+	readStart = 0.0;
+	writtenStart = 0.0;
+}
+
+
+void RunMetrics::beginStage(const char *name)
+{
+	if (!enabled) { return; }
+	current = name;
+	processIoBytes(&readStart, &writtenStart);
+	cpuStart = processCpuSeconds();
+	wallStart = chrono::steady_clock::now();
+}
+
+
+void RunMetrics::endStage(double cells, double values)
+{
+	if (!enabled) { return; }
+	StageMetrics stage;
+	stage.name = current;
+	stage.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+	double cpu = processCpuSeconds();
+	stage.cpuSeconds = (cpu >= 0 && cpuStart >= 0) ? cpu - cpuStart : -1.0;
+
+	double read, written;
+	processIoBytes(&read, &written);
+	stage.bytesRead = (read >= 0 && readStart >= 0) ? read - readStart : -1.0;
+	stage.bytesWritten = (written >= 0 && writtenStart >= 0) ? written - writtenStart : -1.0;
+	processMemory(&stage.rssBytes, &stage.peakRssBytes);
+
+	stage.cells = cells;
+	stage.values = values;
+	stages.push_back(stage);
+}
+
+
+// A number, or null for the missing counters
+static void writeNumber(FILE *fp, const char *key, double value, bool last)
+{
+	if (value < 0) { fprintf(fp, "\"%s\": null", key); }
+	else if (value == (double)(long long)value) { fprintf(fp, "\"%s\": %lld", key, (long long)value); }
+	else { fprintf(fp, "\"%s\": %.6f", key, value); }
+	fprintf(fp, last ? "}" : ", ");
+}
+
+
+static void writeStage(FILE *fp, const StageMetrics &stage)
+{
+	fprintf(fp, "{\"name\": \"%s\", ", stage.name.c_str());
+	writeNumber(fp, "wall_seconds", stage.wallSeconds, false);
+	writeNumber(fp, "cpu_seconds", stage.cpuSeconds, false);
+	writeNumber(fp, "bytes_read", stage.bytesRead, false);
+	writeNumber(fp, "bytes_written", stage.bytesWritten, false);
+	writeNumber(fp, "cells", stage.cells, false);
+	writeNumber(fp, "values", stage.values, false);
+	writeNumber(fp, "cells_per_second", (stage.wallSeconds > 0) ? stage.cells / stage.wallSeconds : -1.0, false);
+	writeNumber(fp, "rss_bytes", stage.rssBytes, false);
+	writeNumber(fp, "peak_rss_bytes", stage.peakRssBytes, true);
+}
+
+
+/*
+** writeJson()
+**
+** The total covers the run from the construction of the metrics,
+** its cells and values are the largest of the stages.
+**
+*/
+void RunMetrics::writeJson(const char *file)
+{
+	char buf2[512];
+	StageMetrics total;
+	total.name = "total";
+	total.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+	total.cpuSeconds = processCpuSeconds();
+	processIoBytes(&total.bytesRead, &total.bytesWritten);
+	processMemory(&total.rssBytes, &total.peakRssBytes);
+	total.cells = 0;
+	total.values = 0;
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		total.cells = max(total.cells, stages[k].cells);
+		total.values = max(total.values, stages[k].values);
+	}
+
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+	fprintf(fp, "{\"version\": 1,\n \"stages\": [\n");
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		fprintf(fp, "  ");
+		writeStage(fp, stages[k]);
+		fprintf(fp, (k + 1 < stages.size()) ? ",\n" : "\n");
+	}
+	fprintf(fp, " ],\n \"total\": ");
+	writeStage(fp, total);
+	fprintf(fp, "}\n");
+	fclose(fp);
+
+	sprintf(buf2, "Metrics of %d stages written to %s\n", (int)stages.size(), file);
+	DisplayMessage(buf2);
+}
+
+
+void RunMetrics::printSummary(FILE *fp)
+{
+	fprintf(fp, "Stages:");
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		const StageMetrics &stage = stages[k];
+		double io = max(stage.bytesRead, 0.0) + max(stage.bytesWritten, 0.0);
+		double seconds = max(stage.wallSeconds, 1e-9);
+		fprintf(fp, "%s %s %.2fs %.1fMB/s %.3gMcells/s", (k > 0) ? " |" : "", stage.name.c_str(),
+			stage.wallSeconds, io / seconds / 1048576.0, stage.cells / seconds*1e-6);
+	}
+	fprintf(fp, "\n");
+}
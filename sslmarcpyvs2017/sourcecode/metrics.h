@@ -0,0 +1,98 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Metrics of the stages of a run (readGisAsciiFiles, SortCalpercent,
+** CalLWLI and calAreaPercOverws), so that a slow run can be told
+** apart as input, sorting or output:
+**
+**   wall and CPU seconds     steady clock and the CPU time of the
+**                            process (all threads)
+**   bytes read and written   the I/O counters of the process
+**                            (/proc/self/io, GetProcessIoCounters),
+**                            so compressed grids count their
+**                            compressed size
+**   cells and values         given by the caller, cells of the grids
+**                            and values of the land uses handled
+**   RSS and peak RSS         memory of the process at the end of the
+**                            stage
+**
+** A counter the system does not have is written as null. The
+** metrics go to a JSON file:
+**
+**   {"version": 1, "stages": [{"name": "readGisAsciiFiles",
+**     "wall_seconds": 1.25, "cpu_seconds": 1.20, "bytes_read": ...,
+**     "bytes_written": ..., "cells": ..., "values": ...,
+**     "cells_per_second": ..., "rss_bytes": ..., "peak_rss_bytes": ...},
+**     ...], "total": {...}}
+**
+** and to an optional one-line summary. Unless enabled is set
+** beginStage() and endStage() return at once.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef struct StageMetrics
+{
+	std::string name;
+	double wallSeconds;
+	double cpuSeconds;
+
+	// -1 where the system has no such counter
+	double bytesRead;
+	double bytesWritten;
+	double rssBytes;
+	double peakRssBytes;
+
+	double cells;
+	double values;
+} StageMetrics;
+
+class RunMetrics
+{
+public:
+	RunMetrics();
+
+	bool enabled;
+
+	void beginStage(const char *name);
+	void endStage(double cells, double values);
+
+	// Stages so far, with a "total" of the whole run
+	void writeJson(const char *file);
+
+	// One line: name, seconds, MB/s and cells/s of each stage
+	void printSummary(FILE *fp);
+
+	std::vector<StageMetrics> stages;
+
+private:
+	std::chrono::steady_clock::time_point runStart;
+	std::chrono::steady_clock::time_point wallStart;
+	double cpuStart;
+	double readStart;
+	double writtenStart;
+	std::string current;
+};
+
+// CPU seconds of the process, -1 if unknown
+double processCpuSeconds();
+
+// Bytes read and written by the process so far, -1 if unknown
+void processIoBytes(double *read, double *written);
+
+// Current and peak resident memory of the process, -1 if unknown
+void processMemory(double *rss, double *peak);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Small helpers to split a loop over rows (or land uses) into
+** contiguous bands that are processed by std::thread workers.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdlib.h>
+#include <exception>
+#include <thread>
+#include <vector>
+
+
+// Number of worker threads to use. Returns at least 1.
+// The SSLM_THREADS environment variable overrides the
+// number of cores.
+inline int numWorkers()
+{
+	const char *env = getenv("SSLM_THREADS");
+	if (env != NULL && atoi(env) > 0) { return atoi(env); }
+
+	unsigned int n = std::thread::hardware_concurrency();
+	return (n == 0) ? 1 : (int)n;
+}
+
+
+// Calls func(begin, end, worker) for nworkers contiguous bands of
+// [0, count). The last band is processed on the calling thread.
+// An exception thrown by a band is passed on to the caller after
+// all bands are done.
+template <class Func>
+void parallelBands(int count, int nworkers, Func func)
+{
+	if (nworkers > count) { nworkers = count; }
+	if (nworkers <= 1)
+	{
+		if (count > 0) { func(0, count, 0); }
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	std::vector<std::exception_ptr> errors(nworkers);
+	int band = count / nworkers;
+	int extra = count % nworkers;
+	int begin = 0;
+
+	for (int w = 0; w < nworkers; w++)
+	{
+		int end = begin + band + ((w < extra) ? 1 : 0);
+		std::exception_ptr *error = &errors[w];
+		auto run = [&func, error](int b, int e, int worker)
+		{
+			try { func(b, e, worker); }
+			catch (...) { *error = std::current_exception(); }
+		};
+
+		if (w == nworkers - 1)
+		{
+			run(begin, end, w);
+		}
+		else
+		{
+			threads.push_back(std::thread(run, begin, end, w));
+		}
+		begin = end;
+	}
+
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	for (int w = 0; w < nworkers; w++)
+	{
+		if (errors[w]) { std::rethrow_exception(errors[w]); }
+	}
+}
+
+#endif
@@ -0,0 +1,364 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Preview of the lorenz curve areas from a pyramid of the grids,
+** see pyramid.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "pyramid.h"
+#include "app.h"
+#include "ascgrid.h"
+#include "engine.h"
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+// Rows of the full grid in a band, the cell side of the coarsest level
+#define BAND_ROWS 8
+
+
+/*
+** LorenzPyramid()
+** Constructor for the pyramid.
+*/
+LorenzPyramid::LorenzPyramid()
+{
+	tolerance = 0.0;
+	nthreads = 0;
+	hasWeights = false;
+	for (int level = 0; level < PYRAMID_LEVELS; level++)
+	{
+		factor[level] = BAND_ROWS >> level;
+		engines[level] = NULL;
+	}
+	for (int f = 0; f < NUM_FACTORS; f++) { noData[f] = 0.0; }
+}
+
+
+LorenzPyramid::~LorenzPyramid()
+{
+	for (int level = 0; level < PYRAMID_LEVELS; level++)
+	{
+		delete engines[level];
+	}
+}
+
+
+// Land use most of the n cells of a coarse cell have, the smallest
+// of a tie. cells is sorted.
+static int majority(int *cells, int n)
+{
+	sort(cells, cells + n);
+	int best = cells[0];
+	int bestCount = 0;
+	for (int i = 0; i < n;)
+	{
+		int j = i;
+		while (j < n && cells[j] == cells[i]) { j++; }
+		if (j - i > bestCount)
+		{
+			best = cells[i];
+			bestCount = j - i;
+		}
+		i = j;
+	}
+	return best;
+}
+
+
+/*
+** pushCoarseRows()
+**
+** The nrows rows of a band (of cols cells) become the coarse rows of
+** level and are pushed to its engine.
+**
+*/
+void LorenzPyramid::pushCoarseRows(int level, int nrows, const int *lu, const float *const *values)
+{
+	LorenzEngine *engine = engines[level];
+	int k = factor[level];
+	int cols = engines[PYRAMID_LEVELS - 1]->cols;
+	int ccols = engine->cols;
+	int crows = (nrows + k - 1) / k;
+
+	vector<int> clu((size_t)crows*ccols);
+	vector<float> cvalues[NUM_FACTORS];
+	for (int f = 0; f < NUM_FACTORS; f++) { cvalues[f].resize((size_t)crows*ccols); }
+	int cells[BAND_ROWS*BAND_ROWS];
+
+	for (int cr = 0; cr < crows; cr++)
+	{
+		int r0 = cr*k;
+		int r1 = min(r0 + k, nrows);
+		for (int cc = 0; cc < ccols; cc++)
+		{
+			int c0 = cc*k;
+			int c1 = min(c0 + k, cols);
+			size_t out = (size_t)cr*ccols + cc;
+
+			int n = 0;
+			for (int r = r0; r < r1; r++)
+			{
+				for (int c = c0; c < c1; c++) { cells[n++] = lu[(size_t)r*cols + c]; }
+			}
+			clu[out] = majority(cells, n);
+
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				double sum = 0.0;
+				int count = 0;
+				for (int r = r0; r < r1; r++)
+				{
+					const float *row = values[f] + (size_t)r*cols;
+					for (int c = c0; c < c1; c++)
+					{
+						if (row[c] != noData[f])
+						{
+							sum += row[c];
+							count++;
+						}
+					}
+				}
+				cvalues[f][out] = (count > 0) ? (float)(sum / count) : (float)noData[f];
+			}
+		}
+	}
+
+	engine->pushRows(crows, clu.data(), cvalues[0].data(), cvalues[1].data(), cvalues[2].data());
+}
+
+
+/*
+** readLevels()
+**
+** One pass over the grids: each band of rows is pushed to the
+** engine of the full grid and downsampled for the others.
+**
+*/
+void LorenzPyramid::readLevels(App *app)
+{
+	char buf2[512];
+	vector<int> srclus;
+	vector<int> sinklus;
+	readLuList(app->srcluFile, srclus);
+	readLuList(app->sinkluFile, sinklus);
+
+	const char *files[NUM_FACTORS + 1] = { app->luFile, app->demFile, app->distFile, app->slopeFile };
+	AscReader *readers[NUM_FACTORS + 1];
+	for (int g = 0; g < NUM_FACTORS + 1; g++)
+	{
+		readers[g] = openAscReader(files[g]);
+	}
+
+	int rows = readers[0]->header->rows;
+	int cols = readers[0]->header->cols;
+	for (int g = 1; g < NUM_FACTORS + 1; g++)
+	{
+		if (readers[g]->header->rows != rows || readers[g]->header->cols != cols)
+		{
+			sprintf(buf2, "Size of %s does not match %s\n", files[g], files[0]);
+			fatalError(buf2);
+		}
+		noData[g - 1] = readers[g]->header->noData;
+	}
+
+	for (int level = 0; level < PYRAMID_LEVELS; level++)
+	{
+		int k = factor[level];
+		engines[level] = new LorenzEngine();
+		engines[level]->nthreads = nthreads;
+		engines[level]->setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+		engines[level]->setGrid((rows + k - 1) / k, (cols + k - 1) / k);
+	}
+
+	// The full grid writes the files of a normal run
+	LorenzEngine *full = engines[PYRAMID_LEVELS - 1];
+	full->curveFormat = app->curveFormat;
+	full->simplify = app->simplify;
+	full->curveText = app->curveText;
+
+	vector<int> lu((size_t)BAND_ROWS*cols);
+	vector<float> values[NUM_FACTORS];
+	for (int f = 0; f < NUM_FACTORS; f++) { values[f].resize((size_t)BAND_ROWS*cols); }
+	const float *bands[NUM_FACTORS] = { values[0].data(), values[1].data(), values[2].data() };
+
+	for (int i = 0; i < rows; i += BAND_ROWS)
+	{
+		int n = min(BAND_ROWS, rows - i);
+		{
+			TraceSpan span("pyramid", "read");
+			span.arg("row", i);
+			for (int r = 0; r < n; r++)
+			{
+				size_t offset = (size_t)r*cols;
+				readAscRowInt(readers[0], &lu[offset]);
+				for (int f = 0; f < NUM_FACTORS; f++)
+				{
+					readAscRowFloat(readers[f + 1], &values[f][offset]);
+				}
+			}
+		}
+
+		TraceSpan span("pyramid", "downsample");
+		span.arg("row", i);
+		engines[PYRAMID_LEVELS - 1]->pushRows(n, lu.data(), bands[0], bands[1], bands[2]);
+		for (int level = 0; level < PYRAMID_LEVELS - 1; level++)
+		{
+			pushCoarseRows(level, n, lu.data(), bands);
+		}
+	}
+
+	for (int g = 0; g < NUM_FACTORS + 1; g++)
+	{
+		closeAscReader(readers[g]);
+	}
+}
+
+
+// Change from b to a in percent of the larger
+static double relativeChange(double a, double b)
+{
+	double scale = max(fabs(a), fabs(b));
+	return (scale > 0.0) ? fabs(a - b) / scale * 100.0 : 0.0;
+}
+
+
+double LorenzPyramid::levelChange(int level) const
+{
+	double change = 0.0;
+	const vector<LuResult> &now = results[level];
+	const vector<LuResult> &before = results[level - 1];
+	for (size_t luidx = 0; luidx < now.size(); luidx++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			double c = relativeChange(now[luidx].area[f], before[luidx].area[f]);
+			change = (c > change || c != c) ? c : change;
+		}
+	}
+	for (int v = 0; hasWeights && v < NUM_LWLI; v++)
+	{
+		double c = relativeChange(lwli[level][v], lwli[level - 1][v]);
+		change = (c > change || c != c) ? c : change;
+	}
+	return change;
+}
+
+
+/*
+** runPyramid()
+**
+** The estimate files are flushed after each level, so they can be
+** read while the finer levels are calculated.
+**
+*/
+void LorenzPyramid::runPyramid(App *app, const char *srcWeightFile, const char *sinkWeightFile)
+{
+	char buf2[512];
+	readLevels(app);
+
+	int nsrclus = engines[0]->nsrclus;
+	int nsinklus = engines[0]->nsinklus;
+	int nlus = nsrclus + nsinklus;
+	vector<int> isSource(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++) { isSource[luidx] = (luidx < nsrclus) ? 1 : 0; }
+
+	hasWeights = (srcWeightFile != NULL);
+	vector<double> weights;
+
+	FILE *fp = fopen("pyramid_areas.txt", "w");
+	FILE *fpLwli = hasWeights ? fopen("pyramid_lwli.txt", "w") : NULL;
+	if (fp == NULL || (hasWeights && fpLwli == NULL))
+	{
+		fatalError("Can't open pyramid_areas.txt or pyramid_lwli.txt for writing\n");
+	}
+	fprintf(fp, "Area under lorenz curve by pyramid level\n");
+	fprintf(fp, "Level, Landuse, Total_cells, Area_Elevation, Area_Distance, Area_Slope\n");
+	if (hasWeights)
+	{
+		fprintf(fpLwli, "LWLI by pyramid level\n");
+		fprintf(fpLwli, "Level, LWLI_Elevation, LWLI_Distance, LWLI_Slope, LWLI_Combined\n");
+	}
+
+	for (int level = 0; level < PYRAMID_LEVELS; level++)
+	{
+		LorenzEngine *engine = engines[level];
+		{
+			TraceSpan span("pyramid", "level");
+			span.arg("factor", factor[level]);
+			engine->compute();
+		}
+		results[level] = engine->results;
+
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			const LuResult &r = results[level][luidx];
+			fprintf(fp, "%dx, Landuse_%d, %lld, %f, %f, %f\n", factor[level], r.luno, r.ncells, r.area[0], r.area[1], r.area[2]);
+		}
+		fflush(fp);
+
+		if (hasWeights)
+		{
+			if (weights.empty())
+			{
+				lwliWeights(results[level].data(), nsrclus, nsinklus, srcWeightFile, sinkWeightFile, weights);
+			}
+			vector<double> coef;
+			lwliCoefficients(results[level].data(), nlus, coef);
+			calLwliSets(nlus, isSource.data(), coef.data(), weights.data(), 1, lwli[level], 1);
+			fprintf(fpLwli, "%dx, %f, %f, %f, %f\n", factor[level], lwli[level][0], lwli[level][1], lwli[level][2], lwli[level][3]);
+			fflush(fpLwli);
+		}
+
+		double change = (level > 0) ? levelChange(level) : 0.0;
+		if (level == 0)
+		{
+			sprintf(buf2, "Pyramid %dx (%d x %d cells) done\n", factor[level], engine->rows, engine->cols);
+		}
+		else
+		{
+			sprintf(buf2, "Pyramid %dx (%d x %d cells) done, largest change %.3f%%\n",
+				factor[level], engine->rows, engine->cols, change);
+		}
+		DisplayMessage(buf2);
+		if (hasWeights)
+		{
+			sprintf(buf2, "  LWLI %f %f %f combined %f\n", lwli[level][0], lwli[level][1], lwli[level][2], lwli[level][3]);
+			DisplayMessage(buf2);
+		}
+
+		if (level == PYRAMID_LEVELS - 1)
+		{
+			engine->writeOutputs("");
+			if (hasWeights) { writeFinalLwli("finallwlis.txt", lwli[level]); }
+		}
+		else if (level > 0 && tolerance > 0.0 && change <= tolerance)
+		{
+			sprintf(buf2, "Levels %dx and %dx agree within %g%%, the finer levels are skipped\n",
+				factor[level - 1], factor[level], tolerance);
+			DisplayMessage(buf2);
+			break;
+		}
+
+		// Only the finer levels are needed from here on
+		engine->releaseMemory();
+	}
+
+	fclose(fp);
+	if (fpLwli) { fclose(fpLwli); }
+}
@@ -0,0 +1,80 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Preview of the lorenz curve areas from a pyramid of the grids.
+** While the grids are read (once, a band of 8 rows at a time) they
+** are also downsampled 2x, 4x and 8x: a coarse cell gets the land
+** use most of its cells have (the smallest of a tie) and the mean
+** of the terrain values that are not nodata. The rows of every
+** level go to a LorenzEngine of their own.
+**
+** The areas are then calculated from the coarsest level to the full
+** grid, each level is reported and appended to pyramid_areas.txt
+** (and, with weights, its LWLI to pyramid_lwli.txt) as soon as it
+** is done. With a tolerance the refinement stops once every area
+** (and LWLI) of a level is within tolerance percent of the level
+** before it. The full grid writes the files of a normal run.
+**
+** The -outlet mask is not applied.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <vector>
+
+#include "lorenz.h"
+#include "lwli.h"
+
+// Levels of the pyramid: 8x, 4x, 2x and the full grid
+#define PYRAMID_LEVELS 4
+
+class App;
+class LorenzEngine;
+
+// Define class
+class LorenzPyramid
+{
+public:
+	LorenzPyramid();
+	~LorenzPyramid();
+
+	// Largest change in percent between two levels at which the
+	// refinement stops, 0 calculates all levels (the default)
+	double tolerance;
+
+	// Number of threads, 0 uses numWorkers()
+	int nthreads;
+
+	// Reads the input files named in app and reports the levels.
+	// The weight files are optional (NULL).
+	void runPyramid(App *app, const char *srcWeightFile, const char *sinkWeightFile);
+
+private:
+	void readLevels(App *app);
+	void pushCoarseRows(int level, int nrows, const int *lu, const float *const *values);
+
+	// Largest change of the areas and LWLI from the level before,
+	// in percent
+	double levelChange(int level) const;
+
+	// Cells of a coarse cell side of each level
+	int factor[PYRAMID_LEVELS];
+	LorenzEngine *engines[PYRAMID_LEVELS];
+
+	// Nodata of the terrain grids
+	double noData[NUM_FACTORS];
+
+	// Results and LWLI of the levels done
+	std::vector<LuResult> results[PYRAMID_LEVELS];
+	double lwli[PYRAMID_LEVELS][NUM_LWLI];
+	bool hasWeights;
+};
+
+#endif
@@ -0,0 +1,623 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Server mode with a cache of loaded watersheds, and its client.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "server.h"
+#include "socketio.h"
+
+#ifdef _WIN32
+#include <afunix.h>
+#else
+#include <sys/un.h>
+#endif
+
+#include "engine.h"
+#include "ascgrid.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+// In server mode an error ends the request, not the program
+static void throwFatal(const char *msg)
+{
+	throw runtime_error(msg);
+}
+
+
+static void dropMessage(const char *, void *)
+{
+}
+
+
+static const char *gridNames[NUM_FACTORS + 1] = { "luws.txt", "demws.txt", "distws.txt", "slopews.txt" };
+
+
+// Size and modification time of the four grids of dir, or of the
+// compressed files read in their place (gridstream.h), -1 for a
+// grid that does not exist
+static void gridStamps(const string &dir, long long stamps[NUM_FACTORS + 1][2])
+{
+	const char *suffixes[3] = { "", ".gz", ".zst" };
+	for (int g = 0; g < NUM_FACTORS + 1; g++)
+	{
+		string file = joinPath(dir, gridNames[g]);
+		stamps[g][0] = stamps[g][1] = -1;
+		struct stat st;
+		for (int k = 0; k < 3; k++)
+		{
+			if (stat((file + suffixes[k]).c_str(), &st) == 0)
+			{
+				stamps[g][0] = (long long)st.st_size;
+				stamps[g][1] = (long long)st.st_mtime;
+				break;
+			}
+		}
+	}
+}
+
+
+static bool socketAddress(const char *socketPath, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(socketPath) >= sizeof(addr->sun_path)) { return false; }
+	strcpy(addr->sun_path, socketPath);
+	return true;
+}
+
+
+static bool sendAll(socket_t fd, const string &data)
+{
+	return sendAll(fd, data.data(), data.size());
+}
+
+
+// Land use list like 1,2,3
+static void parseLuList(const string &text, vector<int> &lunos)
+{
+	char buf2[512];
+	const char *p = text.c_str();
+	while (*p)
+	{
+		char *end;
+		long luno = strtol(p, &end, 10);
+		if (end == p || (*end != ',' && *end != '\0') || luno == 0)
+		{
+			sprintf(buf2, "Bad land use list %.400s", text.c_str());
+			fatalError(buf2);
+		}
+		lunos.push_back((int)luno);
+		p = (*end == ',') ? end + 1 : end;
+	}
+}
+
+
+WatershedCache::WatershedCache()
+{
+	budget = 0;
+	bytes = 0;
+	nextLoad = 0;
+	hits = 0;
+	misses = 0;
+}
+
+
+/*
+** load()
+**
+** Reads the land use and terrain grids of dir, groups the cells by
+** land use and sorts them. The areas of every land use are then
+** calculated as App::callwli() does.
+**
+*/
+shared_ptr<const Watershed> WatershedCache::load(const string &dir)
+{
+	shared_ptr<Watershed> ws = make_shared<Watershed>();
+	ws->dir = dir;
+	gridStamps(dir, ws->stamps);
+
+	const char **names = gridNames;
+	AscReader *readers[NUM_FACTORS + 1] = { NULL, NULL, NULL, NULL };
+	try
+	{
+		for (int g = 0; g < NUM_FACTORS + 1; g++)
+		{
+			readers[g] = openAscReader(joinPath(dir, names[g]).c_str());
+		}
+		ws->rows = readers[0]->header->rows;
+		ws->cols = readers[0]->header->cols;
+		for (int g = 1; g < NUM_FACTORS + 1; g++)
+		{
+			if (readers[g]->header->rows != ws->rows || readers[g]->header->cols != ws->cols)
+			{
+				char buf2[512];
+				sprintf(buf2, "Size of %.200s does not match %.200s", names[g], names[0]);
+				fatalError(buf2);
+			}
+		}
+
+		int nodata = (int)readers[0]->header->noData;
+		vector<int> lurow(ws->cols);
+		vector<float> rowvals[NUM_FACTORS];
+		for (int f = 0; f < NUM_FACTORS; f++) { rowvals[f].resize(ws->cols); }
+		unordered_map<int, int> classIdx;
+
+		for (int i = 0; i < ws->rows; i++)
+		{
+			readAscRowInt(readers[0], &lurow[0]);
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				readAscRowFloat(readers[f + 1], &rowvals[f][0]);
+			}
+			for (int j = 0; j < ws->cols; j++)
+			{
+				int luno = lurow[j];
+				if (luno == 0 || luno == nodata) { continue; }
+
+				unordered_map<int, int>::iterator it = classIdx.find(luno);
+				if (it == classIdx.end())
+				{
+					it = classIdx.insert(make_pair(luno, (int)ws->classes.size())).first;
+					ws->classes.push_back(LuClass());
+					ws->classes.back().luno = luno;
+				}
+				LuClass &lc = ws->classes[it->second];
+				for (int f = 0; f < NUM_FACTORS; f++) { lc.sorted[f].push_back(rowvals[f][j]); }
+			}
+		}
+	}
+	catch (...)
+	{
+		for (int g = 0; g < NUM_FACTORS + 1; g++)
+		{
+			if (readers[g]) closeAscReader(readers[g]);
+		}
+		throw;
+	}
+	for (int g = 0; g < NUM_FACTORS + 1; g++)
+	{
+		closeAscReader(readers[g]);
+	}
+
+	sort(ws->classes.begin(), ws->classes.end(), [](const LuClass &a, const LuClass &b)
+	{
+		return a.luno < b.luno;
+	});
+
+	// Each land use and factor is sorted on its own
+	int ntasks = (int)ws->classes.size()*NUM_FACTORS;
+	int nworkers = numWorkers();
+	atomic<int> nextTask(0);
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		vector<double> values;
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			LuClass &lc = ws->classes[t / NUM_FACTORS];
+			vector<float> &sorted = lc.sorted[t % NUM_FACTORS];
+			sorted.shrink_to_fit();
+			sort(sorted.begin(), sorted.end());
+
+			values.assign(sorted.begin(), sorted.end());
+			lc.area[t % NUM_FACTORS] = lorenzAreaSorted(values.data(), (long long)values.size());
+		}
+	});
+
+	ws->bytes = sizeof(Watershed);
+	for (size_t c = 0; c < ws->classes.size(); c++)
+	{
+		LuClass &lc = ws->classes[c];
+		lc.ncells = (long long)lc.sorted[0].size();
+		ws->bytes += sizeof(LuClass) + (double)lc.ncells*NUM_FACTORS*sizeof(float);
+	}
+	return ws;
+}
+
+
+/*
+** get()
+**
+** The cache holds a future of each watershed, so the requests that
+** come while it is loaded wait for the same load.
+**
+*/
+shared_ptr<const Watershed> WatershedCache::get(const string &dir)
+{
+	long long stamps[NUM_FACTORS + 1][2];
+	gridStamps(dir, stamps);
+
+	unique_lock<mutex> guard(lock);
+	map<string, Entry>::iterator it = entries.find(dir);
+	if (it != entries.end())
+	{
+		Loading loading = it->second.watershed;
+		bool ready = loading.wait_for(chrono::seconds(0)) == future_status::ready;
+		if (ready && memcmp(loading.get()->stamps, stamps, sizeof(stamps)) != 0)
+		{
+			// A grid changed, load it again
+			bytes -= it->second.bytes;
+			lru.erase(it->second.lru);
+			entries.erase(it);
+		}
+		else
+		{
+			hits++;
+			lru.splice(lru.begin(), lru, it->second.lru);
+			guard.unlock();
+			return loading.get();
+		}
+	}
+
+	misses++;
+	promise<shared_ptr<const Watershed> > loaded;
+	lru.push_front(dir);
+	Entry &entry = entries[dir];
+	entry.watershed = loaded.get_future().share();
+	entry.loadId = ++nextLoad;
+	entry.bytes = 0;
+	entry.lru = lru.begin();
+	long long loadId = entry.loadId;
+	guard.unlock();
+
+	shared_ptr<const Watershed> ws;
+	try
+	{
+		ws = load(dir);
+		loaded.set_value(ws);
+	}
+	catch (...)
+	{
+		loaded.set_exception(current_exception());
+
+		// Forget the failed load, the next request tries again
+		guard.lock();
+		it = entries.find(dir);
+		if (it != entries.end() && it->second.loadId == loadId)
+		{
+			lru.erase(it->second.lru);
+			entries.erase(it);
+		}
+		throw;
+	}
+
+	guard.lock();
+	it = entries.find(dir);
+	if (it != entries.end() && it->second.loadId == loadId)
+	{
+		it->second.bytes = ws->bytes;
+		bytes += ws->bytes;
+		evict();
+	}
+	return ws;
+}
+
+
+/*
+** evict()
+**
+** Drops the least recently used watersheds until the cache fits
+** the budget. Requests that still use a dropped watershed keep it
+** until they are done.
+**
+*/
+void WatershedCache::evict()
+{
+	while (budget > 0 && bytes > budget && lru.size() > 1)
+	{
+		map<string, Entry>::iterator it = entries.find(lru.back());
+		bytes -= it->second.bytes;
+		entries.erase(it);
+		lru.pop_back();
+	}
+}
+
+
+void WatershedCache::drop(const string &dir)
+{
+	lock_guard<mutex> guard(lock);
+	map<string, Entry>::iterator it = entries.find(dir);
+	if (it != entries.end())
+	{
+		bytes -= it->second.bytes;
+		lru.erase(it->second.lru);
+		entries.erase(it);
+	}
+}
+
+
+string WatershedCache::stats()
+{
+	char buf2[512];
+	lock_guard<mutex> guard(lock);
+	sprintf(buf2, "watersheds %d bytes %.0f budget %.0f hits %lld misses %lld",
+		(int)entries.size(), bytes, budget, hits, misses);
+	return buf2;
+}
+
+
+LorenzServer::LorenzServer()
+{
+	listenfd = (long long)INVALID_SOCKET;
+	stopping = false;
+	nclients = 0;
+	maxClients = SERVER_MAX_CLIENTS;
+}
+
+
+LorenzServer::~LorenzServer()
+{
+}
+
+
+/*
+** answerAreas()
+**
+** Areas of the listed land uses, sources first. A listed land use
+** that is not in the watershed has no cells and areas of 0.
+**
+*/
+string LorenzServer::answerAreas(const string &dir, const string &src, const string &sink)
+{
+	vector<int> lunos;
+	parseLuList(src, lunos);
+	int nsrclus = (int)lunos.size();
+	parseLuList(sink, lunos);
+	for (size_t i = 0; i < lunos.size(); i++)
+	{
+		if (find(lunos.begin(), lunos.begin() + i, lunos[i]) != lunos.begin() + i)
+		{
+			fatalError("A land use is listed more than once");
+		}
+	}
+
+	shared_ptr<const Watershed> ws = cache.get(dir);
+
+	vector<const LuClass *> found(lunos.size(), (const LuClass *)NULL);
+	long long total = 0;
+	for (size_t i = 0; i < lunos.size(); i++)
+	{
+		vector<LuClass>::const_iterator it = lower_bound(ws->classes.begin(), ws->classes.end(), lunos[i],
+			[](const LuClass &a, int luno) { return a.luno < luno; });
+		if (it != ws->classes.end() && it->luno == lunos[i])
+		{
+			found[i] = &*it;
+			total += it->ncells;
+		}
+	}
+
+	char line[512];
+	sprintf(line, "ok %d\n", (int)lunos.size());
+	string reply = line;
+	for (size_t i = 0; i < lunos.size(); i++)
+	{
+		const LuClass *lc = found[i];
+		long long ncells = lc ? lc->ncells : 0;
+		sprintf(line, "%d %s %lld %.17g %.17g %.17g %.17g\n",
+			lunos[i], ((int)i < nsrclus) ? "source" : "sink", ncells,
+			(total > 0) ? (double)ncells / (double)total : 0.0,
+			lc ? lc->area[0] : 0.0, lc ? lc->area[1] : 0.0, lc ? lc->area[2] : 0.0);
+		reply += line;
+	}
+	return reply;
+}
+
+
+/*
+** answer()
+**
+** Answer of one request line.
+**
+*/
+string LorenzServer::answer(const string &request)
+{
+	char command[64];
+	char args[3][1024];
+	int nread = sscanf(request.c_str(), "%63s %1023s %1023s %1023s", command, args[0], args[1], args[2]);
+	if (nread <= 0) { return "error Empty request\n"; }
+
+	try
+	{
+		if (!strcmp(command, "areas") && nread == 4)
+		{
+			return answerAreas(args[0], args[1], args[2]);
+		}
+		if (!strcmp(command, "stats"))
+		{
+			return "ok 1\n" + cache.stats() + "\n";
+		}
+		if (!strcmp(command, "drop") && nread == 2)
+		{
+			cache.drop(args[0]);
+			return "ok 0\n";
+		}
+		if (!strcmp(command, "shutdown"))
+		{
+			stopping = true;
+			shutdown((socket_t)listenfd, SHUT_RDWR);
+
+			// serve() may wait for a free client
+			lock_guard<mutex> guard(clientLock);
+			clientsDone.notify_all();
+			return "ok 0\n";
+		}
+		return "error Unknown request, use areas dir src sink, stats, drop dir or shutdown\n";
+	}
+	catch (const bad_alloc &)
+	{
+		return "error Out of memory\n";
+	}
+	catch (const exception &e)
+	{
+		string msg = e.what();
+		replace(msg.begin(), msg.end(), '\n', ' ');
+		while (!msg.empty() && msg[msg.size() - 1] == ' ') { msg.erase(msg.size() - 1); }
+		return "error " + msg + "\n";
+	}
+}
+
+
+/*
+** serveClient()
+**
+** Answers the requests of one connection until it is closed.
+**
+*/
+void LorenzServer::serveClient(long long fd)
+{
+	string pending, request;
+	while (readLine((socket_t)fd, pending, request))
+	{
+		if (!sendAll((socket_t)fd, answer(request))) { break; }
+	}
+	closeSocket((socket_t)fd);
+
+	lock_guard<mutex> guard(clientLock);
+	nclients--;
+	clientsDone.notify_all();
+}
+
+
+/*
+** serve()
+**
+** Every connection gets its own thread, the cache is shared. With
+** maxClients connected no more are accepted until one is closed. A
+** failing accept() (out of file descriptors) is tried again after a
+** pause that doubles up to a second.
+**
+*/
+void LorenzServer::serve(const char *socketPath)
+{
+	char buf2[512];
+	struct sockaddr_un addr;
+
+	if (!startSockets() || !socketAddress(socketPath, &addr))
+	{
+		sprintf(buf2, "Can't use socket %.400s\n", socketPath);
+		fatalError(buf2);
+	}
+
+	socket_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	remove(socketPath);
+	if (fd == INVALID_SOCKET || ::bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+	{
+		sprintf(buf2, "Can't listen on socket %.400s\n", socketPath);
+		fatalError(buf2);
+	}
+	listenfd = (long long)fd;
+
+	sprintf(buf2, "Listening on %s, cache budget %g MB!!\n", socketPath, cache.budget / (1024.0*1024.0));
+	DisplayMessage(buf2);
+
+	// Errors end a request, messages of the loads are not printed
+	setFatalErrorHandler(throwFatal);
+	setMessageCallback(dropMessage, NULL);
+
+	int pauseMs = 0;
+	while (!stopping)
+	{
+		{
+			unique_lock<mutex> guard(clientLock);
+			clientsDone.wait(guard, [this]() { return nclients < maxClients || stopping; });
+		}
+		if (stopping) { break; }
+
+		socket_t client = accept(fd, NULL, NULL);
+		if (client == INVALID_SOCKET)
+		{
+			if (stopping) { break; }
+			if (pauseMs == 0)
+			{
+				fprintf(stdout, "Can't accept connections (%s), trying again\n", socketErrorText().c_str());
+				fflush(stdout);
+			}
+			pauseMs = min(max(2*pauseMs, 10), 1000);
+			this_thread::sleep_for(chrono::milliseconds(pauseMs));
+			continue;
+		}
+		if (pauseMs > 0)
+		{
+			fprintf(stdout, "Accepting connections again\n");
+			fflush(stdout);
+			pauseMs = 0;
+		}
+
+		lock_guard<mutex> guard(clientLock);
+		nclients++;
+		thread(&LorenzServer::serveClient, this, (long long)client).detach();
+	}
+
+	unique_lock<mutex> guard(clientLock);
+	clientsDone.wait(guard, [this]() { return nclients == 0; });
+	guard.unlock();
+
+	closeSocket(fd);
+	remove(socketPath);
+	setFatalErrorHandler(NULL);
+	setMessageCallback(NULL, NULL);
+
+	DisplayMessage("Server stopped!!\n");
+}
+
+
+/*
+** sendRequest()
+**
+** Sends one request line and prints the answer.
+**
+*/
+int sendRequest(const char *socketPath, const char *request)
+{
+	char buf2[512];
+	struct sockaddr_un addr;
+
+	socket_t fd = INVALID_SOCKET;
+	if (startSockets() && socketAddress(socketPath, &addr))
+	{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	}
+	if (fd == INVALID_SOCKET || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		sprintf(buf2, "Can't connect to socket %.400s\n", socketPath);
+		fatalError(buf2);
+	}
+
+	string pending, line;
+	bool ok = sendAll(fd, string(request) + "\n") && readLine(fd, pending, line);
+	if (ok)
+	{
+		fprintf(stdout, "%s\n", line.c_str());
+		int nlines = 0;
+		ok = (sscanf(line.c_str(), "ok %d", &nlines) == 1);
+		for (int i = 0; ok && i < nlines && readLine(fd, pending, line); i++)
+		{
+			fprintf(stdout, "%s\n", line.c_str());
+		}
+	}
+	closeSocket(fd);
+	return ok ? 0 : 1;
+}
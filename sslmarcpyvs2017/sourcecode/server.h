@@ -0,0 +1,154 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Server mode. The program stays running, listens on a Unix domain
+** socket and answers requests for the lorenz curve areas of a
+** watershed directory (the files written by the PySSLM toolbox) for
+** a given set of source and sink land uses.
+**
+** The area of a land use only depends on its own cells, so when a
+** watershed is loaded the cells are grouped by land use, sorted and
+** the areas of every land use are calculated once. A request then
+** only picks the listed land uses and the share of their cells.
+** Loaded watersheds are kept in a cache with a memory budget, the
+** least recently used ones are dropped first. A watershed is loaded
+** again when one of its grids changed (size or modification time).
+**
+** Requests are lines of text, each answered with "ok n" and n lines,
+** or with one "error message" line:
+**
+**   areas dir src sink    src and sink are lists like 1,2,3. One
+**                         line per land use, sources first:
+**                         luno source|sink ncells area_perc
+**                         area_elev area_dist area_slope
+**   stats                 cached watersheds, bytes, hits, misses
+**   drop dir              removes dir from the cache
+**   shutdown              stops the server
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "lorenz.h"
+
+// Clients served at once by default
+#define SERVER_MAX_CLIENTS 64
+
+
+// Cells of one land use of a watershed
+typedef struct LuClass
+{
+	int luno;
+	long long ncells;
+	double area[NUM_FACTORS];
+
+	// Values of the cells sorted for each factor
+	std::vector<float> sorted[NUM_FACTORS];
+} LuClass;
+
+
+// A loaded watershed, classes sorted by luno
+typedef struct Watershed
+{
+	std::string dir;
+
+	// Size and modification time of the land use and terrain grids
+	long long stamps[NUM_FACTORS + 1][2];
+	int rows;
+	int cols;
+	double bytes;
+	std::vector<LuClass> classes;
+} Watershed;
+
+
+// Define class
+class WatershedCache
+{
+public:
+	WatershedCache();
+
+	// Memory budget in bytes, 0 for no limit. The watershed
+	// in use is kept even if it is bigger.
+	double budget;
+
+	// The watershed of dir, loaded if it is not cached. Many
+	// threads can ask for the same dir, it is loaded once.
+	std::shared_ptr<const Watershed> get(const std::string &dir);
+
+	void drop(const std::string &dir);
+	std::string stats();
+
+private:
+	typedef std::shared_future<std::shared_ptr<const Watershed> > Loading;
+
+	struct Entry
+	{
+		Loading watershed;
+		long long loadId;
+		double bytes;
+		std::list<std::string>::iterator lru;
+	};
+
+	static std::shared_ptr<const Watershed> load(const std::string &dir);
+	void evict();
+
+	std::mutex lock;
+	std::map<std::string, Entry> entries;
+
+	// Most recently used first
+	std::list<std::string> lru;
+	double bytes;
+	long long nextLoad;
+	long long hits;
+	long long misses;
+};
+
+
+// Define class
+class LorenzServer
+{
+public:
+	LorenzServer();
+	~LorenzServer();
+
+	WatershedCache cache;
+
+	// Clients served at once, more wait to be accepted
+	int maxClients;
+
+	// Serves requests until a shutdown request
+	void serve(const char *socketPath);
+
+private:
+	void serveClient(long long fd);
+	std::string answer(const std::string &request);
+	std::string answerAreas(const std::string &dir, const std::string &src, const std::string &sink);
+
+	long long listenfd;
+	std::atomic<bool> stopping;
+	int nclients;
+	std::mutex clientLock;
+	std::condition_variable clientsDone;
+};
+
+// Client of the server: sends request and prints the answer.
+// Returns 0 if the answer is ok.
+int sendRequest(const char *socketPath, const char *request);
+
+#endif
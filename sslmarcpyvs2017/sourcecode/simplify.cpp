@@ -0,0 +1,225 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Error bounded and percentile simplification of the lorenz curves.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include "simplify.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+static const char *factorNames[NUM_FACTORS] = { "Elevation", "Distance", "Slope" };
+
+
+/*
+** simplifyByError()
+**
+** lo and hi bound the slope of a line from the anchor a that stays
+** within tolerance of every point between a and the current point.
+** If the slope to point j is outside, j - 1 becomes the new anchor;
+** the line from there to j passes no points, so it is always good.
+**
+*/
+void simplifyByError(const double *x, const double *y, long long m, double tolerance, vector<long long> &keep)
+{
+	keep.clear();
+	if (m <= 0) { return; }
+	keep.push_back(0);
+
+	long long a = 0;
+	double lo = -HUGE_VAL, hi = HUGE_VAL;
+	for (long long j = 1; j < m; j++)
+	{
+		double slope = (y[j] - y[a]) / (x[j] - x[a]);
+		if (slope < lo || slope > hi)
+		{
+			a = j - 1;
+			keep.push_back(a);
+			lo = -HUGE_VAL;
+			hi = HUGE_VAL;
+		}
+
+		double dx = x[j] - x[a];
+		lo = max(lo, (y[j] - tolerance - y[a]) / dx);
+		hi = min(hi, (y[j] + tolerance - y[a]) / dx);
+	}
+	if (keep.back() != m - 1) { keep.push_back(m - 1); }
+}
+
+
+void simplifyByPercentiles(const double *x, const double *y, long long m, int npoints,
+	vector<double> &sx, vector<double> &sy)
+{
+	sx.clear();
+	sy.clear();
+	if (m <= (long long)npoints + 1)
+	{
+		sx.assign(x, x + m);
+		sy.assign(y, y + m);
+		return;
+	}
+
+	long long i = 0;
+	for (int k = 0; k <= npoints; k++)
+	{
+		if (k == npoints)
+		{
+			sx.push_back(x[m - 1]);
+			sy.push_back(y[m - 1]);
+			break;
+		}
+
+		double target = y[0] + (y[m - 1] - y[0]) * (double)k / (double)npoints;
+		while (i < m - 2 && y[i + 1] < target) { i++; }
+		double t = (target - y[i]) / (y[i + 1] - y[i]);
+		sx.push_back(x[i] + t * (x[i + 1] - x[i]));
+		sy.push_back(target);
+	}
+}
+
+
+/*
+** maxVerticalError()
+**
+** Both polylines have increasing x, so the segment of the
+** simplified one under each point is found with one pointer.
+**
+*/
+double maxVerticalError(const double *x, const double *y, long long m,
+	const double *sx, const double *sy, long long k)
+{
+	if (m == 0 || k == 0) { return 0.0; }
+
+	double error = 0.0;
+	long long s = 0;
+	for (long long i = 0; i < m; i++)
+	{
+		while (s < k - 2 && sx[s + 1] < x[i]) { s++; }
+
+		double line;
+		if (k == 1 || x[i] <= sx[0]) { line = sy[0]; }
+		else if (x[i] >= sx[k - 1]) { line = sy[k - 1]; }
+		else { line = sy[s] + (x[i] - sx[s]) * (sy[s + 1] - sy[s]) / (sx[s + 1] - sx[s]); }
+
+		error = max(error, fabs(y[i] - line));
+	}
+	return error;
+}
+
+
+double polylineArea(const double *x, const double *y, long long m)
+{
+	double area = 0.0;
+	for (long long i = 1; i < m; i++)
+	{
+		area = area + (x[i] - x[i - 1])*(y[i - 1] + y[i]) / (double)2;
+	}
+	return area;
+}
+
+
+/*
+** writeSimplifiedCurves()
+**
+** The curves are simplified in parallel, one task per land use and
+** factor, then written together.
+**
+*/
+void writeSimplifiedCurves(const char *prefix, const CurveSimplify &options, int format, const TextOptions &text,
+	const CurveSpan *curves, const LuResult *results, int nsrclus, int nlus, int nthreads,
+	int nfactors, const char *const *extraNames, const double *extraAreas)
+{
+	char buf2[512];
+	string base = (prefix != NULL) ? prefix : "";
+
+	int ntasks = nlus*nfactors;
+	vector<vector<double> > sx(ntasks), sy(ntasks);
+	vector<double> errors(ntasks), areas(ntasks);
+
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		vector<long long> keep;
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			const double *x = curves[t].values;
+			const double *y = curves[t].percents;
+			long long m = curves[t].nhead;
+
+			if (options.mode == SIMPLIFY_ERROR)
+			{
+				simplifyByError(x, y, m, options.tolerance, keep);
+				for (size_t k = 0; k < keep.size(); k++)
+				{
+					sx[t].push_back(x[keep[k]]);
+					sy[t].push_back(y[keep[k]]);
+				}
+			}
+			else
+			{
+				simplifyByPercentiles(x, y, m, options.npoints, sx[t], sy[t]);
+			}
+
+			long long k = (long long)sx[t].size();
+			errors[t] = maxVerticalError(x, y, m, sx[t].data(), sy[t].data(), k);
+			areas[t] = polylineArea(sx[t].data(), sy[t].data(), k);
+		}
+	});
+
+	vector<CurveSpan> spans(ntasks);
+	vector<int> lunos(nlus);
+	for (int t = 0; t < ntasks; t++)
+	{
+		spans[t] = fullCurveSpan(sx[t].data(), sy[t].data(), (long long)sx[t].size());
+	}
+	for (int luidx = 0; luidx < nlus; luidx++) { lunos[luidx] = results[luidx].luno; }
+
+	if (format == CURVES_NPY) { writeCurveFiles(base.c_str(), spans.data(), lunos.data(), nsrclus, nlus, nfactors, extraNames); }
+	else { writeCurveText(base.c_str(), spans.data(), lunos.data(), nlus, text, nfactors, extraNames); }
+
+	string name = base + "curve_simplification.txt";
+	FILE *fp = fopen(name.c_str(), "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", name.c_str());
+		fatalError(buf2);
+	}
+
+	if (options.mode == SIMPLIFY_ERROR)
+	{
+		fprintf(fp, "Simplified lorenz curves, largest vertical error %g percent\n", options.tolerance);
+	}
+	else
+	{
+		fprintf(fp, "Simplified lorenz curves, %d percentile intervals\n", options.npoints);
+	}
+	fprintf(fp, "Landuse, Factor, Points, Kept, Max_error_perc, Area, Area_simplified\n");
+	int nextra = nfactors - NUM_FACTORS;
+	for (int t = 0; t < ntasks; t++)
+	{
+		int luidx = t / nfactors, f = t % nfactors;
+		fprintf(fp, "Landuse_%d, %s, %lld, %lld, %f, %f, %f\n",
+			lunos[luidx], (f < NUM_FACTORS) ? factorNames[f] : extraNames[f - NUM_FACTORS],
+			curves[t].nhead, (long long)sx[t].size(), errors[t],
+			(f < NUM_FACTORS) ? results[luidx].area[f] : extraAreas[luidx*nextra + f - NUM_FACTORS], areas[t]);
+	}
+	fclose(fp);
+}
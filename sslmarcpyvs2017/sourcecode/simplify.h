@@ -0,0 +1,86 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Simplification of the lorenz curves before they are written. A
+** curve has a point for every distinct value of a land use, far
+** more than a plot can show. Two ways to reduce it:
+**
+**   error         keeps a subset of the points such that the line
+**                 through them is at most the tolerance (in percent)
+**                 above or below every point of the curve. It is
+**                 found in one pass: from the last kept point the
+**                 slopes that stay within the tolerance of all the
+**                 points passed so far form an interval, and a point
+**                 is kept when the next one is outside of it.
+**   percentiles   n + 1 points at evenly spaced percentages between
+**                 the first and the last point, with the values
+**                 interpolated along the curve.
+**
+** The simplified curves are written in the layout of the curve
+** files (text or NPY, see curvefile.h) so the plots read them as
+** before. curve_simplification.txt lists for each land use and
+** factor the points before and after, the largest vertical error of
+** the simplified curve, the exact area and the area under the
+** simplified curve.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <vector>
+
+#include "lorenz.h"
+#include "curvefile.h"
+
+// Simplification modes
+#define SIMPLIFY_NONE 0
+#define SIMPLIFY_ERROR 1
+#define SIMPLIFY_PERCENTILES 2
+
+typedef struct CurveSimplify
+{
+	int mode;
+
+	// Largest vertical error in percent for SIMPLIFY_ERROR
+	double tolerance;
+
+	// Number of intervals for SIMPLIFY_PERCENTILES
+	int npoints;
+} CurveSimplify;
+
+
+// Indices of the points of the curve (x increasing) that are kept,
+// the first and the last are always kept.
+void simplifyByError(const double *x, const double *y, long long m, double tolerance, std::vector<long long> &keep);
+
+// npoints + 1 points evenly spaced in y from the first to the last
+// point of the curve (y increasing)
+void simplifyByPercentiles(const double *x, const double *y, long long m, int npoints,
+	std::vector<double> &sx, std::vector<double> &sy);
+
+// Largest vertical distance of the points of the curve from the
+// polyline sx, sy
+double maxVerticalError(const double *x, const double *y, long long m,
+	const double *sx, const double *sy, long long k);
+
+// Area under a polyline, the trapezoids of lorenzAreaSorted()
+double polylineArea(const double *x, const double *y, long long m);
+
+// Simplifies the curves (nfactors full spans per land use, see
+// fullCurveSpan()), writes them in format (CURVES_TEXT with text,
+// or CURVES_NPY) and writes curve_simplification.txt, all with
+// prefix in front of the names. The factors after the first
+// NUM_FACTORS are named by extraNames (see writeCurveText()) and
+// their exact areas are extraAreas, nfactors - NUM_FACTORS per land
+// use.
+void writeSimplifiedCurves(const char *prefix, const CurveSimplify &options, int format, const TextOptions &text,
+	const CurveSpan *curves, const LuResult *results, int nsrclus, int nlus, int nthreads,
+	int nfactors = NUM_FACTORS, const char *const *extraNames = NULL, const double *extraAreas = NULL);
+
+#endif
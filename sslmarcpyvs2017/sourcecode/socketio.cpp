@@ -0,0 +1,135 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Sockets shared by the server and the distributed mode, see
+** socketio.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "socketio.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/time.h>
+#endif
+
+using namespace std;
+
+// Largest block of one send() or recv()
+#define SOCKET_CHUNK (1 << 30)
+
+// Growth of the data of readBytes()
+#define READ_CHUNK (1 << 24)
+
+
+bool startSockets()
+{
+#ifdef _WIN32
+	WSADATA wsa;
+	return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+	return true;
+#endif
+}
+
+
+bool sendAll(socket_t fd, const char *data, size_t size)
+{
+	size_t sent = 0;
+	while (sent < size)
+	{
+		int n = ::send(fd, data + sent, (int)min(size - sent, (size_t)SOCKET_CHUNK), MSG_NOSIGNAL);
+		if (n <= 0) { return false; }
+		sent += n;
+	}
+	return true;
+}
+
+
+bool readLine(socket_t fd, string &pending, string &line, size_t maxLength)
+{
+	char buf[4096];
+	size_t end;
+	while ((end = pending.find('\n')) == string::npos)
+	{
+		if (maxLength > 0 && pending.size() > maxLength) { return false; }
+		int n = recv(fd, buf, sizeof(buf), 0);
+		if (n <= 0) { return false; }
+		pending.append(buf, n);
+	}
+	if (maxLength > 0 && end > maxLength) { return false; }
+	line = pending.substr(0, end);
+	if (!line.empty() && line[line.size() - 1] == '\r') { line.erase(line.size() - 1); }
+	pending.erase(0, end + 1);
+	return true;
+}
+
+
+bool readBytes(socket_t fd, string &pending, vector<char> &data, size_t size)
+{
+	size_t got = min(pending.size(), size);
+	data.assign(pending.begin(), pending.begin() + got);
+	pending.erase(0, got);
+	while (got < size)
+	{
+		data.resize(got + min(size - got, (size_t)READ_CHUNK));
+		while (got < data.size())
+		{
+			int n = recv(fd, data.data() + got, (int)min(data.size() - got, (size_t)SOCKET_CHUNK), 0);
+			if (n <= 0)
+			{
+				data.resize(got);
+				return false;
+			}
+			got += n;
+		}
+	}
+	return true;
+}
+
+
+/*
+** setSocketTimeout()
+**
+** Winsock takes milliseconds, POSIX a timeval.
+**
+*/
+void setSocketTimeout(socket_t fd, double seconds)
+{
+	if (seconds <= 0) { return; }
+#ifdef _WIN32
+	DWORD wait = (DWORD)min(seconds*1000.0, 4.0e9);
+#else
+	struct timeval wait;
+	wait.tv_sec = (time_t)seconds;
+	wait.tv_usec = (long)((seconds - (double)wait.tv_sec)*1e6);
+#endif
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&wait, sizeof(wait));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (const char *)&wait, sizeof(wait));
+}
+
+
+string socketErrorText()
+{
+#ifdef _WIN32
+	char buf[64];
+	sprintf(buf, "Winsock error %d", WSAGetLastError());
+	return buf;
+#else
+	return strerror(errno);
+#endif
+}
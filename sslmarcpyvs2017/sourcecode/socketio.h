@@ -0,0 +1,62 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Sockets of the server mode (server.h) and of the tcp transport
+** of the distributed mode (distributed.h): the differences between
+** Winsock and POSIX sockets, and reading and writing whole lines
+** and blocks of bytes.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef SOCKETIO_H
+#define SOCKETIO_H
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define closeSocket closesocket
+#define SHUT_RDWR SD_BOTH
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define closeSocket close
+#define INVALID_SOCKET (-1)
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Starts Winsock, true elsewhere
+bool startSockets();
+
+// Sends all size bytes of data, false if the connection fails
+bool sendAll(socket_t fd, const char *data, size_t size);
+
+// Next line from fd without its end of line, pending keeps what was
+// read after it. False if the connection ends first or the line is
+// longer than maxLength (0 for no limit).
+bool readLine(socket_t fd, std::string &pending, std::string &line, size_t maxLength = 0);
+
+// size bytes from fd, the pending ones first. data grows with the
+// bytes that arrive, so a size the peer does not send fails when the
+// connection ends instead of allocating it.
+bool readBytes(socket_t fd, std::string &pending, std::vector<char> &data, size_t size);
+
+// Receives and sends on fd fail after seconds, 0 for no limit
+void setSocketTimeout(socket_t fd, double seconds);
+
+// Text of the error of the last failed socket call
+std::string socketErrorText();
+
+#endif
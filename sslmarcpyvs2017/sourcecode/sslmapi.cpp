@@ -0,0 +1,492 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** C interface of the lorenz curve library. The functions of the
+** program report errors with fatalError(), here it throws and each
+** entry point turns the exception into an error code.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sslmapi.h"
+#include "engine.h"
+#include "lorenz.h"
+#include "lwli.h"
+#include "cdfindex.h"
+#include "curvefile.h"
+#include "message.h"
+
+using namespace std;
+
+
+struct sslm_engine
+{
+	LorenzEngine engine;
+	string lastError;
+
+	// Query indexes of the curves, built by sslm_cdf() and sslm_quantile()
+	CurveIndexes indexes;
+};
+
+
+// Error raised by fatalError() inside the library
+class SslmError : public runtime_error
+{
+public:
+	SslmError(const char *msg, int code) : runtime_error(msg), code(code) {}
+	int code;
+};
+
+static sslm_log_callback logCallback = NULL;
+static void *logUser = NULL;
+
+
+static void throwFatal(const char *msg)
+{
+	throw SslmError(msg, SSLM_ERROR_ARGUMENT);
+}
+
+
+static void forwardMessage(const char *msg, void *)
+{
+	if (logCallback) { logCallback(msg, logUser); }
+}
+
+
+// Runs body and turns what it throws into an error code
+template <class Body>
+static int guard(sslm_handle h, Body body)
+{
+	if (h == NULL) { return SSLM_ERROR_ARGUMENT; }
+	try
+	{
+		h->lastError.clear();
+		body();
+		return SSLM_OK;
+	}
+	catch (const SslmError &e)
+	{
+		h->lastError = e.what();
+		return e.code;
+	}
+	catch (const bad_alloc &)
+	{
+		h->lastError = "Out of memory";
+		return SSLM_ERROR_MEMORY;
+	}
+	catch (const exception &e)
+	{
+		h->lastError = e.what();
+		return SSLM_ERROR_INTERNAL;
+	}
+	catch (...)
+	{
+		h->lastError = "Unknown error";
+		return SSLM_ERROR_INTERNAL;
+	}
+}
+
+
+static void requireComputed(sslm_handle h)
+{
+	if (!h->engine.computed)
+	{
+		throw SslmError("sslm_compute() has not been called", SSLM_ERROR_STATE);
+	}
+}
+
+
+static void requireIndex(sslm_handle h, int index)
+{
+	if (index < 0 || index >= (int)h->engine.results.size())
+	{
+		throw SslmError("Land use index out of range", SSLM_ERROR_ARGUMENT);
+	}
+}
+
+
+static void requireFactor(int factor)
+{
+	if (factor < 0 || factor >= NUM_FACTORS)
+	{
+		throw SslmError("Factor out of range", SSLM_ERROR_ARGUMENT);
+	}
+}
+
+
+static void requireQueries(const double *queries, long long n, double *out)
+{
+	if (n < 0)
+	{
+		throw SslmError("Negative number of queries", SSLM_ERROR_ARGUMENT);
+	}
+	if ((queries == NULL || out == NULL) && n > 0)
+	{
+		throw SslmError("NULL queries or output", SSLM_ERROR_ARGUMENT);
+	}
+}
+
+
+int sslm_api_version(void)
+{
+	return SSLM_API_VERSION;
+}
+
+
+sslm_handle sslm_create(void)
+{
+	setFatalErrorHandler(throwFatal);
+	setMessageCallback(forwardMessage, NULL);
+
+	return new (nothrow) sslm_engine;
+}
+
+
+void sslm_destroy(sslm_handle h)
+{
+	delete h;
+}
+
+
+int sslm_set_classes(sslm_handle h, const int *srclus, int nsrclus, const int *sinklus, int nsinklus)
+{
+	return guard(h, [&]()
+	{
+		if ((nsrclus > 0 && srclus == NULL) || (nsinklus > 0 && sinklus == NULL))
+		{
+			throw SslmError("NULL land use list", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.setClasses(srclus, nsrclus, sinklus, nsinklus);
+	});
+}
+
+
+int sslm_set_grid(sslm_handle h, int rows, int cols)
+{
+	return guard(h, [&]() { h->engine.setGrid(rows, cols); });
+}
+
+
+int sslm_push_rows(sslm_handle h, int nrows, const int *lu, const float *elev, const float *dist, const float *slope)
+{
+	return guard(h, [&]()
+	{
+		if (h->engine.results.empty() || h->engine.rows == 0 || h->engine.computed)
+		{
+			throw SslmError("Rows pushed before sslm_set_classes() and sslm_set_grid(), or after sslm_compute()", SSLM_ERROR_STATE);
+		}
+		if (lu == NULL || elev == NULL || dist == NULL || slope == NULL)
+		{
+			throw SslmError("NULL row data", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.pushRows(nrows, lu, elev, dist, slope);
+	});
+}
+
+
+int sslm_set_rasters(sslm_handle h, const char *lufile, const char *demfile, const char *distfile, const char *slopefile)
+{
+	return guard(h, [&]()
+	{
+		if (h->engine.results.empty())
+		{
+			throw SslmError("sslm_set_classes() has not been called", SSLM_ERROR_STATE);
+		}
+		if (lufile == NULL || demfile == NULL || distfile == NULL || slopefile == NULL)
+		{
+			throw SslmError("NULL file name", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.readGrids(lufile, demfile, distfile, slopefile);
+	});
+}
+
+
+int sslm_set_threads(sslm_handle h, int nthreads)
+{
+	return guard(h, [&]()
+	{
+		if (nthreads < 0) { throw SslmError("Negative number of threads", SSLM_ERROR_ARGUMENT); }
+		h->engine.nthreads = nthreads;
+	});
+}
+
+
+int sslm_set_quantum(sslm_handle h, int factor, double quantum)
+{
+	return guard(h, [&]()
+	{
+		if (factor < 0 || factor >= NUM_FACTORS || !(quantum >= 0.0))
+		{
+			throw SslmError("Bad factor or quantum", SSLM_ERROR_ARGUMENT);
+		}
+		if (h->engine.rowsPushed > 0)
+		{
+			throw SslmError("The quantum must be set before the rows are pushed", SSLM_ERROR_STATE);
+		}
+		h->engine.quantum[factor] = quantum;
+	});
+}
+
+
+int sslm_set_curve_format(sslm_handle h, int format)
+{
+	return guard(h, [&]()
+	{
+		if (format != SSLM_CURVES_TEXT && format != SSLM_CURVES_NPY)
+		{
+			throw SslmError("Unknown curve format", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.curveFormat = (format == SSLM_CURVES_NPY) ? CURVES_NPY : CURVES_TEXT;
+	});
+}
+
+
+int sslm_set_simplify(sslm_handle h, int mode, double tolerance, int npoints)
+{
+	return guard(h, [&]()
+	{
+		if ((mode == SSLM_SIMPLIFY_ERROR && !(tolerance > 0)) ||
+			(mode == SSLM_SIMPLIFY_PERCENTILES && npoints < 1) ||
+			mode < SSLM_SIMPLIFY_NONE || mode > SSLM_SIMPLIFY_PERCENTILES)
+		{
+			throw SslmError("Bad simplification", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.simplify.mode = mode;
+		h->engine.simplify.tolerance = tolerance;
+		h->engine.simplify.npoints = npoints;
+	});
+}
+
+
+int sslm_set_text_format(sslm_handle h, int numbers, int compression)
+{
+	return guard(h, [&]()
+	{
+		if (numbers < SSLM_NUMBERS_FIXED || numbers > SSLM_NUMBERS_SHORTEST ||
+			compression < SSLM_COMPRESS_NONE || compression > SSLM_COMPRESS_ZSTD)
+		{
+			throw SslmError("Bad text format", SSLM_ERROR_ARGUMENT);
+		}
+		if (!compressionAvailable(compression))
+		{
+			throw SslmError("The library was built without this compression", SSLM_ERROR_ARGUMENT);
+		}
+		h->engine.curveText.numbers = numbers;
+		h->engine.curveText.compression = compression;
+	});
+}
+
+
+int sslm_compute(sslm_handle h)
+{
+	return guard(h, [&]()
+	{
+		if (h->engine.results.empty() || h->engine.rowsPushed != h->engine.rows)
+		{
+			throw SslmError("All the rows of the grid must be pushed before sslm_compute()", SSLM_ERROR_STATE);
+		}
+		h->indexes.clear();
+		h->engine.compute();
+	});
+}
+
+
+int sslm_reset(sslm_handle h)
+{
+	return guard(h, [&]() { h->engine.reset(); });
+}
+
+
+int sslm_num_lus(sslm_handle h)
+{
+	return (h == NULL) ? 0 : (int)h->engine.results.size();
+}
+
+
+int sslm_get_result(sslm_handle h, int index, sslm_lu_result *result)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		requireIndex(h, index);
+		if (result == NULL) { throw SslmError("NULL result", SSLM_ERROR_ARGUMENT); }
+
+		const LuResult &r = h->engine.results[index];
+		result->luno = r.luno;
+		result->is_source = (index < h->engine.nsrclus) ? 1 : 0;
+		result->ncells = r.ncells;
+		result->area_perc = h->engine.areaPerc(index);
+		for (int f = 0; f < NUM_FACTORS; f++) { result->area[f] = r.area[f]; }
+	});
+}
+
+
+int sslm_get_curve(sslm_handle h, int index, int factor, const double **values, const double **percents, long long *npoints)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		requireIndex(h, index);
+		requireFactor(factor);
+		if (values == NULL || percents == NULL || npoints == NULL)
+		{
+			throw SslmError("NULL output pointer", SSLM_ERROR_ARGUMENT);
+		}
+
+		int t = index*NUM_FACTORS + factor;
+		*values = h->engine.curveValues[t].data();
+		*percents = h->engine.curvePercents[t].data();
+		*npoints = (long long)h->engine.curveValues[t].size();
+	});
+}
+
+
+int sslm_cdf(sslm_handle h, int index, int factor, const double *x, long long n, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		requireIndex(h, index);
+		requireFactor(factor);
+		requireQueries(x, n, out);
+		h->indexes.get(h->engine, index, factor).cdfBatch(x, n, out, h->engine.nthreads);
+	});
+}
+
+
+int sslm_quantile(sslm_handle h, int index, int factor, const double *q, long long n, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		requireIndex(h, index);
+		requireFactor(factor);
+		requireQueries(q, n, out);
+		h->indexes.get(h->engine, index, factor).quantileBatch(q, n, out, h->engine.nthreads);
+	});
+}
+
+
+static void buildFromCurve(CdfIndex &index, const double *values, const double *percents, long long npoints, long long ncells)
+{
+	if (npoints < 0 || ncells < npoints || (npoints > 0 && (values == NULL || percents == NULL)))
+	{
+		throw SslmError("Bad curve: NULL points or fewer cells than points", SSLM_ERROR_ARGUMENT);
+	}
+	index.build(values, percents, npoints, ncells);
+}
+
+
+int sslm_cdf_from_curve(sslm_handle h, const double *values, const double *percents, long long npoints, long long ncells,
+	const double *x, long long n, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireQueries(x, n, out);
+		CdfIndex index;
+		buildFromCurve(index, values, percents, npoints, ncells);
+		index.cdfBatch(x, n, out, h->engine.nthreads);
+	});
+}
+
+
+int sslm_quantile_from_curve(sslm_handle h, const double *values, const double *percents, long long npoints, long long ncells,
+	const double *q, long long n, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireQueries(q, n, out);
+		CdfIndex index;
+		buildFromCurve(index, values, percents, npoints, ncells);
+		index.quantileBatch(q, n, out, h->engine.nthreads);
+	});
+}
+
+
+int sslm_write_outputs(sslm_handle h, const char *prefix)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		h->engine.writeOutputs(prefix);
+	});
+}
+
+
+static void requireLwliArgs(int nlus, const double *weights, long long nsets, double *out)
+{
+	if (nlus <= 0 || nsets < 0)
+	{
+		throw SslmError("No land uses or weight sets", SSLM_ERROR_ARGUMENT);
+	}
+	if ((weights == NULL || out == NULL) && nsets > 0)
+	{
+		throw SslmError("NULL weights or output", SSLM_ERROR_ARGUMENT);
+	}
+}
+
+
+int sslm_lwli(sslm_handle h, const double *weights, long long nsets, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireComputed(h);
+		int nlus = (int)h->engine.results.size();
+		requireLwliArgs(nlus, weights, nsets, out);
+
+		vector<int> isSource(nlus);
+		for (int luidx = 0; luidx < nlus; luidx++) { isSource[luidx] = (luidx < h->engine.nsrclus) ? 1 : 0; }
+		vector<double> coef;
+		lwliCoefficients(h->engine.results.data(), nlus, coef);
+
+		calLwliSets(nlus, isSource.data(), coef.data(), weights, nsets, out, h->engine.nthreads);
+	});
+}
+
+
+int sslm_lwli_from_areas(sslm_handle h, int nlus, const int *is_source, const double *area_perc,
+	const double *area, const double *weights, long long nsets, double *out)
+{
+	return guard(h, [&]()
+	{
+		requireLwliArgs(nlus, weights, nsets, out);
+		if (is_source == NULL || area_perc == NULL || area == NULL)
+		{
+			throw SslmError("NULL land use results", SSLM_ERROR_ARGUMENT);
+		}
+
+		vector<double> coef(nlus*NUM_FACTORS);
+		for (int t = 0; t < nlus*NUM_FACTORS; t++)
+		{
+			coef[t] = area_perc[t / NUM_FACTORS] * area[t];
+		}
+
+		calLwliSets(nlus, is_source, coef.data(), weights, nsets, out, h->engine.nthreads);
+	});
+}
+
+
+const char *sslm_last_error(sslm_handle h)
+{
+	return (h == NULL) ? "NULL handle" : h->lastError.c_str();
+}
+
+
+void sslm_set_log_callback(sslm_log_callback callback, void *user)
+{
+	logUser = user;
+	logCallback = callback;
+}
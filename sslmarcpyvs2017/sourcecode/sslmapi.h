@@ -0,0 +1,205 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** C interface of the lorenz curve library (sslmlib), for programs
+** that embed the calculation instead of running sslmarcpy.exe on
+** files.
+**
+** Typical use:
+**
+**   sslm_handle h = sslm_create();
+**   sslm_set_classes(h, srclus, nsrc, sinklus, nsink);
+**   sslm_set_grid(h, rows, cols);
+**   for each block of rows: sslm_push_rows(h, nrows, lu, elev, dist, slope);
+**   sslm_compute(h);
+**   sslm_get_result(h, i, &result) for i < sslm_num_lus(h)
+**   sslm_cdf(h, i, SSLM_ELEVATION, x, n, out), sslm_quantile(...)
+**   sslm_destroy(h);
+**
+** Every function returns SSLM_OK or an error code, the message of
+** the last error of a handle is given by sslm_last_error(). The
+** library never ends the calling process and only prints through
+** the callback of sslm_set_log_callback().
+**
+** A handle must not be used by two threads at the same time,
+** different handles can.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef SSLMAPI_H
+#define SSLMAPI_H
+
+#if defined(_WIN32) && defined(SSLM_BUILD_DLL)
+#define SSLM_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(SSLM_USE_DLL)
+#define SSLM_API __declspec(dllimport)
+#else
+#define SSLM_API
+#endif
+
+#define SSLM_API_VERSION 7
+
+// Error codes
+#define SSLM_OK 0
+#define SSLM_ERROR_ARGUMENT 1
+#define SSLM_ERROR_STATE 2
+#define SSLM_ERROR_MEMORY 3
+#define SSLM_ERROR_INTERNAL 4
+
+// Factors, in the order of the columns of LurenzCurveAreas.txt
+#define SSLM_ELEVATION 0
+#define SSLM_DISTANCE 1
+#define SSLM_SLOPE 2
+
+// Formats of the curve files of sslm_write_outputs()
+#define SSLM_CURVES_TEXT 0
+#define SSLM_CURVES_NPY 1
+
+// Simplification of the curve files
+#define SSLM_SIMPLIFY_NONE 0
+#define SSLM_SIMPLIFY_ERROR 1
+#define SSLM_SIMPLIFY_PERCENTILES 2
+
+// Numbers and compression of the text curve files
+#define SSLM_NUMBERS_FIXED 0
+#define SSLM_NUMBERS_SHORTEST 1
+#define SSLM_COMPRESS_NONE 0
+#define SSLM_COMPRESS_GZIP 1
+#define SSLM_COMPRESS_ZSTD 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sslm_engine *sslm_handle;
+
+// Results of one land use
+typedef struct sslm_lu_result
+{
+	int luno;
+	int is_source;
+	long long ncells;
+
+	// Cells of the land use over the cells of all listed land uses
+	double area_perc;
+
+	// Area under the lorenz curve of elevation, distance and slope
+	double area[3];
+} sslm_lu_result;
+
+typedef void (*sslm_log_callback)(const char *msg, void *user);
+
+SSLM_API int sslm_api_version(void);
+
+// Returns NULL if there is no memory
+SSLM_API sslm_handle sslm_create(void);
+SSLM_API void sslm_destroy(sslm_handle h);
+
+// Land use 0 can not be listed. Clears all pushed data.
+SSLM_API int sslm_set_classes(sslm_handle h, const int *srclus, int nsrclus, const int *sinklus, int nsinklus);
+
+// Size of the grid, clears the pushed rows
+SSLM_API int sslm_set_grid(sslm_handle h, int rows, int cols);
+
+// Pushes nrows full rows, row major. Cells of unlisted land
+// uses are skipped, there is no nodata handling beyond that.
+SSLM_API int sslm_push_rows(sslm_handle h, int nrows, const int *lu, const float *elev, const float *dist, const float *slope);
+
+// Reads arcview grids and pushes them, sets the grid size
+SSLM_API int sslm_set_rasters(sslm_handle h, const char *lufile, const char *demfile, const char *distfile, const char *slopefile);
+
+// Number of threads used by sslm_compute(), 0 for all cores
+SSLM_API int sslm_set_threads(sslm_handle h, int nthreads);
+
+// Quantum of the values of a factor (e.g. 0.01 for centimeters),
+// 0 sorts them (the default). The values are counted in a histogram
+// instead, with the same curve and area; a value that is not a
+// multiple of the quantum fails sslm_push_rows(), reset before
+// pushing again. Set it before the first rows of a grid.
+SSLM_API int sslm_set_quantum(sslm_handle h, int factor, double quantum);
+
+SSLM_API int sslm_compute(sslm_handle h);
+
+// Drops the pushed rows and the results, keeps classes and grid
+SSLM_API int sslm_reset(sslm_handle h);
+
+// Number of land uses, sources first, then sinks
+SSLM_API int sslm_num_lus(sslm_handle h);
+
+SSLM_API int sslm_get_result(sslm_handle h, int index, sslm_lu_result *result);
+
+// Points of the lorenz curve of a land use and factor. The
+// arrays belong to the handle and stay valid until the next
+// call that changes it.
+SSLM_API int sslm_get_curve(sslm_handle h, int index, int factor, const double **values, const double **percents, long long *npoints);
+
+// Share of the cells of a land use with a value <= x[i] of factor
+// for n queries, into out[i]: the empirical CDF. The index of the
+// curve is built on the first query and kept until sslm_compute().
+// NaN for a land use without cells or a NaN x.
+SSLM_API int sslm_cdf(sslm_handle h, int index, int factor, const double *x, long long n, double *out);
+
+// Inverse of sslm_cdf(): the smallest value whose share is >= q[i]
+// (0..1). The smallest value for q <= 0, NaN for q > 1.
+SSLM_API int sslm_quantile(sslm_handle h, int index, int factor, const double *q, long long n, double *out);
+
+// The same from a curve kept by the caller (sslm_get_curve() or
+// the curve files, unsimplified) of ncells cells. The index is
+// built on each call, only the threads and the last error of h
+// are used.
+SSLM_API int sslm_cdf_from_curve(sslm_handle h, const double *values, const double *percents, long long npoints,
+	long long ncells, const double *x, long long n, double *out);
+SSLM_API int sslm_quantile_from_curve(sslm_handle h, const double *values, const double *percents, long long npoints,
+	long long ncells, const double *q, long long n, double *out);
+
+// Writes the files of sslmarcpy.exe with prefix in front of their
+// names: elev_dataperc.txt, dist_dataperc.txt, slp_dataperc.txt,
+// LurenzCurveAreas.txt and luareaperc.txt
+SSLM_API int sslm_write_outputs(sslm_handle h, const char *prefix);
+
+// SSLM_CURVES_NPY makes sslm_write_outputs() write the curves to
+// elev_, dist_ and slp_dataperc.npy and dataperc_index.json
+SSLM_API int sslm_set_curve_format(sslm_handle h, int format);
+
+// Simplifies the curves of sslm_write_outputs(): SSLM_SIMPLIFY_ERROR
+// keeps them within tolerance percent of every point,
+// SSLM_SIMPLIFY_PERCENTILES resamples them to npoints + 1 points.
+// curve_simplification.txt gets the errors and areas.
+SSLM_API int sslm_set_simplify(sslm_handle h, int mode, double tolerance, int npoints);
+
+// Numbers of the text curve files: SSLM_NUMBERS_FIXED ("%f", the
+// default) or SSLM_NUMBERS_SHORTEST (full precision). Compression
+// SSLM_COMPRESS_GZIP or SSLM_COMPRESS_ZSTD appends .gz or .zst to
+// the names; sslm_write_outputs() fails if the library was built
+// without it.
+SSLM_API int sslm_set_text_format(sslm_handle h, int numbers, int compression);
+
+// Location weighted landscape index of nsets weight sets, each
+// a row of sslm_num_lus() weights in the order of the results.
+// out gets 4 values per set: elevation, distance, slope and
+// combined. The sets are evaluated in parallel (sslm_set_threads).
+SSLM_API int sslm_lwli(sslm_handle h, const double *weights, long long nsets, double *out);
+
+// The same from results kept by the caller: is_source, area_perc
+// and area (3 per land use) of nlus land uses. Only the threads
+// and the last error of h are used.
+SSLM_API int sslm_lwli_from_areas(sslm_handle h, int nlus, const int *is_source, const double *area_perc,
+	const double *area, const double *weights, long long nsets, double *out);
+
+// Message of the last error of h, "" if there was none
+SSLM_API const char *sslm_last_error(sslm_handle h);
+
+// Progress messages of all handles go to callback, NULL
+// drops them (the default).
+SSLM_API void sslm_set_log_callback(sslm_log_callback callback, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
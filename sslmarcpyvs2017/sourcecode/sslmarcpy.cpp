@@ -1,109 +1,682 @@
-#include <stdio.h>
-#include <string>
-#include <time.h>
-#include <typeinfo>
-#include <iostream>
-
-
-#include "app.h"
-#include "message.h"
-
-
-
-/*
--------------------------------------------------------------------------------------------------------------
-**
-** Location weighted landscape index calculation program.
-**
-** This class was developed to do the calculation of landscape index.
-** The inputs include :
-** 1. land use map(should be reclassifed to include intended sink
-** and source classes).
-** 2. dem : defines the elevation
-** 3. slope : calculated from the DEM
-** 4. distance : calculated with the path distance tool with
-** dem as surface factor in ArcGIS.
-**
-** Qingyu Feng
-** qingyufeng@outlook.com
-** Department of Agricultural & Biological Engineering
-** Purdue University
-** West Lafayette, Indiana
-**
-** Jan 2018
-**
-**
--------------------------------------------------------------------------------------------------------------
-*/
-
-
-
-// ------------------------------------------------------------------------------------------------------------
-// Including standard and customized header files:
-
-#include <stdio.h>
-#include <string>
-#include <time.h>
-#include <typeinfo>
-#include <iostream>
-
-
-#include "app.h"
-#include "message.h"
-
-App *theLWLIApp;
-
-int main()
-{
-
-	// The first part is to set the start time of
-	// the program.
-	char buf[1024];
-	double elapsed_time;
-	time_t start, finish;
-
-	// Get the start time:
-	time(&start);
-	sprintf_s(buf, sizeof buf, "Starting the program %s\n", __DATE__);
-
-	// Define the new app class
-	theLWLIApp = new App();
-
-	// Read in the ascii input file
-	theLWLIApp->readGisAsciiFiles();
-
-	// Processing the values for Lorenz curve generation.
-	// Lorenz curve needs two columns:
-	// Column 1: value in decreasing order.
-	// Column 2: percent of ranks (order value/total number)
-	theLWLIApp->SortCalpercent();
-
-
-	// After processing the data, the next step is to 
-	// calculate the Trapezoidal area of the data.
-	// The equation is:
-	// f(x) = delta x/2(y0 + 2*y1 + 2*y2 + ... + 2*yn-1 + yn)
-	// C++ does not have a function to make the graphs.
-	// I will use python to create the graphs.
-	theLWLIApp->CalLWLI();
-
-	theLWLIApp->calAreaPercOverws();
-
-
-	
-	theLWLIApp->cleanMemory();
-
-	time(&finish);
-	elapsed_time = difftime(finish, start);
-
-	long elapMin, elapSec, elapHour;
-
-	elapHour = (long)(elapsed_time / 3600);
-	elapMin = (long)((elapsed_time - (elapHour * 3600)) / 60);
-	elapSec = (long)(elapsed_time - (elapHour * 3600) - (elapMin * 60));
-
-	fprintf(stdout, "Runtime: %d:%02d:%02d  (Hours:Minutes:Seconds)\n", elapHour, elapMin, elapSec);
-
-	return 0;
-}
-
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <typeinfo>
+#include <iostream>
+
+
+#include "app.h"
+#include "message.h"
+
+
+
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+** This class was developed to do the calculation of landscape index.
+** The inputs include :
+** 1. land use map(should be reclassifed to include intended sink
+** and source classes).
+** 2. dem : defines the elevation
+** 3. slope : calculated from the DEM
+** 4. distance : calculated with the path distance tool with
+** dem as surface factor in ArcGIS.
+**
+** Qingyu Feng
+** qingyufeng@outlook.com
+** Department of Agricultural & Biological Engineering
+** Purdue University
+** West Lafayette, Indiana
+**
+** Jan 2018
+**
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <typeinfo>
+#include <iostream>
+#include <vector>
+
+
+#include "app.h"
+#include "terrain.h"
+#include "locallwli.h"
+#include "luseries.h"
+#include "incremental.h"
+#include "batch.h"
+#include "distributed.h"
+#include "engine.h"
+#include "cdfindex.h"
+#include "server.h"
+#include "lwli.h"
+#include "uncertainty.h"
+#include "pyramid.h"
+#include "curvefile.h"
+#include "metrics.h"
+#include "trace.h"
+#include "message.h"
+
+App *theLWLIApp;
+
+
+/*
+** printUsage()
+**
+** Without arguments the program reads the files written by the
+** PySSLM toolbox from the working directory, as before.
+**
+*/
+void printUsage()
+{
+	fprintf(stdout, "Usage: SSLM [options]\n");
+	fprintf(stdout, "  -src file         source land use list (srclus.txt)\n");
+	fprintf(stdout, "  -sink file        sink land use list (sinklus.txt)\n");
+	fprintf(stdout, "  -lu file          land use grid (luws.txt)\n");
+	fprintf(stdout, "  -dem file         elevation grid (demws.txt)\n");
+	fprintf(stdout, "  -slope file       slope grid (slopews.txt)\n");
+	fprintf(stdout, "  -dist file        distance grid (distws.txt)\n");
+	fprintf(stdout, "  -factor name file another factor grid, its curves go to name_dataperc.txt\n");
+	fprintf(stdout, "                    (.npy with -curves npy, simplified with -simplify) and\n");
+	fprintf(stdout, "                    its areas to LurenzCurveAreas.txt (can be repeated)\n");
+	fprintf(stdout, "                    grids ending in .gz or .zst (or found only with that\n");
+	fprintf(stdout, "                    suffix) are decompressed while they are read\n");
+	fprintf(stdout, "  -outlet x y       fill the DEM, calculate D8 flow direction and\n");
+	fprintf(stdout, "                    accumulation, and only use the land use upstream\n");
+	fprintf(stdout, "                    of the outlet (the grids can then be unclipped)\n");
+	fprintf(stdout, "  -snap distance    snap distance of the outlet in map units (0)\n");
+	fprintf(stdout, "  -terrainout       write demfill.txt, flowdir.txt, flowacc.txt\n");
+	fprintf(stdout, "                    and watershed.txt\n");
+	fprintf(stdout, "  -window k         write maps of the lorenz curve areas in k x k\n");
+	fprintf(stdout, "                    windows instead of the watershed values\n");
+	fprintf(stdout, "  -quantum e d s    quantum of elevation, distance and slope for\n");
+	fprintf(stdout, "                    -window (0 for 65536 steps over the range)\n");
+	fprintf(stdout, "  -series file      land use time series: the terrain grids are read\n");
+	fprintf(stdout, "                    once and each land use grid listed in file\n");
+	fprintf(stdout, "                    (\"label lufile\" per line) gets its own\n");
+	fprintf(stdout, "                    <label>_LurenzCurveAreas.txt and <label>_luareaperc.txt\n");
+	fprintf(stdout, "  -jobs n           years of the series processed at the same time\n");
+	fprintf(stdout, "  -scenarios file   land use edit scenarios (\"label editfile\" per line,\n");
+	fprintf(stdout, "                    edit files with \"row col oldlu newlu\" lines): each is\n");
+	fprintf(stdout, "                    applied to the land use grid incrementally and gets\n");
+	fprintf(stdout, "                    <label>_LurenzCurveAreas.txt and <label>_luareaperc.txt\n");
+	fprintf(stdout, "  -curves npy       write the curves to elev_, dist_ and slp_dataperc.npy\n");
+	fprintf(stdout, "                    with an index in dataperc_index.json instead of the\n");
+	fprintf(stdout, "                    text files (also for -batch)\n");
+	fprintf(stdout, "  -simplify error e simplify the curves so that they are at most e percent\n");
+	fprintf(stdout, "                    above or below every point, or\n");
+	fprintf(stdout, "  -simplify percentiles n\n");
+	fprintf(stdout, "                    to n + 1 evenly spaced percentages; the errors and\n");
+	fprintf(stdout, "                    areas go to curve_simplification.txt\n");
+	fprintf(stdout, "  -numbers shortest write the text curves with full precision instead\n");
+	fprintf(stdout, "                    of 6 decimals (-numbers fixed)\n");
+	fprintf(stdout, "  -compress gzip|zstd\n");
+	fprintf(stdout, "                    compress the text curves to .txt.gz or .txt.zst\n");
+	fprintf(stdout, "  -batch file       run every input directory listed in file (\"indir [outdir]\"\n");
+	fprintf(stdout, "                    per line) with the default file names, -jobs sets\n");
+	fprintf(stdout, "                    the threads shared by the jobs\n");
+	fprintf(stdout, "  -memory mb        memory budget of -batch or -serve in megabytes\n");
+	fprintf(stdout, "                    (no limit)\n");
+	fprintf(stdout, "  -summary file     summary table of -batch (batch_summary.txt)\n");
+	fprintf(stdout, "  -band k n         distributed worker: read band k of n bands of rows\n");
+	fprintf(stdout, "                    and send its partial result to the coordinator\n");
+	fprintf(stdout, "  -coordinate n     distributed coordinator: merge the partials of n\n");
+	fprintf(stdout, "                    bands and write the output files, see distributed.h\n");
+	fprintf(stdout, "  -distributed n    run a coordinator and n local worker processes\n");
+	fprintf(stdout, "  -transport spec   dir:path (shared directory, dir:sslm_partials)\n");
+	fprintf(stdout, "                    or tcp:host:port for the partials\n");
+	fprintf(stdout, "  -timeout s        seconds to wait for the partials or the coordinator\n");
+	fprintf(stdout, "                    (3600, 0 for no limit)\n");
+	fprintf(stdout, "  -query file answers\n");
+	fprintf(stdout, "                    answer the \"cdf luno factor x ...\" and \"quantile luno\n");
+	fprintf(stdout, "                    factor q ...\" lines of file (factor elev, dist or slp,\n");
+	fprintf(stdout, "                    q from 0 to 1) from the curves of the grids, one line\n");
+	fprintf(stdout, "                    of answers each, see cdfindex.h\n");
+	fprintf(stdout, "  -serve socket     keep running and answer requests on a Unix domain\n");
+	fprintf(stdout, "                    socket, see server.h; -jobs sets the clients served\n");
+	fprintf(stdout, "                    at once (64)\n");
+	fprintf(stdout, "  -client socket request\n");
+	fprintf(stdout, "                    send one request (\"areas dir 1,2,3 5,7\", \"stats\",\n");
+	fprintf(stdout, "                    \"drop dir\" or \"shutdown\") to a server and print\n");
+	fprintf(stdout, "                    the answer\n");
+	fprintf(stdout, "  -lwli srcweights sinkweights\n");
+	fprintf(stdout, "                    weight files of the land uses (srclus_withweights.txt,\n");
+	fprintf(stdout, "                    sinklus_withweights.txt), writes finallwlis.txt\n");
+	fprintf(stdout, "  -weightsets file  weight sets (a header of land use numbers, then one\n");
+	fprintf(stdout, "                    set per line), writes the LWLI of every set to\n");
+	fprintf(stdout, "                    lwlisets.txt\n");
+	fprintf(stdout, "  -uncertainty n    draw n bootstrap replicates of the cells of each land\n");
+	fprintf(stdout, "                    use and write the distribution of the areas (and of\n");
+	fprintf(stdout, "                    the LWLI with -lwli) to uncertainty_*.txt\n");
+	fprintf(stdout, "  -perturb e d s    perturbed replicates instead: normal errors with these\n");
+	fprintf(stdout, "                    standard deviations added to the terrain values\n");
+	fprintf(stdout, "  -seed n           seed of the replicates (1)\n");
+	fprintf(stdout, "  -level p          percentile interval of the replicates in percent (95)\n");
+	fprintf(stdout, "  -pyramid tol      preview: the areas (and the LWLI with -lwli) of the grids\n");
+	fprintf(stdout, "                    downsampled 8x, 4x and 2x, then of the full grid, to\n");
+	fprintf(stdout, "                    pyramid_areas.txt; stops when a level is within tol\n");
+	fprintf(stdout, "                    percent of the one before (0 for all levels)\n");
+	fprintf(stdout, "  -histogram e d s  quantum of the values of elevation, distance and slope\n");
+	fprintf(stdout, "                    (0.01 for centimeters, 0 sorts that factor): the\n");
+	fprintf(stdout, "                    curves and areas are counted in histograms instead of\n");
+	fprintf(stdout, "                    sorted, a value off the quantum is an error\n");
+	fprintf(stdout, "  -checkpoint dir   write checkpoints of the scatter, sort and dedup stages\n");
+	fprintf(stdout, "                    to dir while the run goes on, and resume from the last\n");
+	fprintf(stdout, "                    one of the same inputs (default run only)\n");
+	fprintf(stdout, "  -metrics file     write the time, CPU time, bytes read and written, cells\n");
+	fprintf(stdout, "                    and memory of each stage to a JSON file, see metrics.h\n");
+	fprintf(stdout, "  -metricsline      print the metrics of the stages on one line\n");
+	fprintf(stdout, "  -trace file       write the steps of each thread as Chrome trace events,\n");
+	fprintf(stdout, "                    with hardware counters where perf_event_open is\n");
+	fprintf(stdout, "                    allowed (default run and -batch), see trace.h\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+
+	// The first part is to set the start time of
+	// the program.
+	char buf[1024];
+	double elapsed_time;
+	time_t start, finish;
+
+	// Get the start time:
+	time(&start);
+	snprintf(buf, sizeof buf, "Starting the program %s\n", __DATE__);
+
+	// Define the new app class
+	theLWLIApp = new App();
+
+	// Process the command line
+	bool useOutlet = false;
+	bool terrainOut = false;
+	double outletX = 0.0;
+	double outletY = 0.0;
+	double snapDist = 0.0;
+	LocalLorenz *theLocalLorenz = NULL;
+	const char *seriesFile = NULL;
+	const char *scenarioFile = NULL;
+	const char *batchFile = NULL;
+	const char *summaryFile = "batch_summary.txt";
+	const char *serveSocket = NULL;
+	const char *clientSocket = NULL;
+	const char *clientRequest = NULL;
+	const char *srcWeightFile = NULL;
+	const char *sinkWeightFile = NULL;
+	const char *weightSetFile = NULL;
+	LorenzUncertainty *theUncertainty = NULL;
+	LorenzPyramid *thePyramid = NULL;
+	double histogramQuantum[NUM_FACTORS] = { 0.0, 0.0, 0.0 };
+	bool useHistogram = false;
+	double memoryMb = 0;
+	int njobs = 0;
+	RunMetrics theMetrics;
+	const char *metricsFile = NULL;
+	const char *checkpointDir = NULL;
+	bool metricsLine = false;
+	const char *traceFile = NULL;
+	DistributedRun theDistributed;
+	int band = -1;
+	int nbands = 0;
+	int ncoordinate = 0;
+	int nlocal = 0;
+	const char *queryFile = NULL;
+	const char *answerFile = NULL;
+
+	for (int argi = 1; argi < argc; argi++)
+	{
+		const char *opt = argv[argi];
+		bool hasValue = (argi + 1 < argc);
+
+		if (!strcmp(opt, "-src") && hasValue) { theLWLIApp->srcluFile = argv[++argi]; }
+		else if (!strcmp(opt, "-sink") && hasValue) { theLWLIApp->sinkluFile = argv[++argi]; }
+		else if (!strcmp(opt, "-lu") && hasValue) { theLWLIApp->luFile = argv[++argi]; }
+		else if (!strcmp(opt, "-dem") && hasValue) { theLWLIApp->demFile = argv[++argi]; }
+		else if (!strcmp(opt, "-slope") && hasValue) { theLWLIApp->slopeFile = argv[++argi]; }
+		else if (!strcmp(opt, "-dist") && hasValue) { theLWLIApp->distFile = argv[++argi]; }
+		else if (!strcmp(opt, "-factor") && argi + 2 < argc)
+		{
+			const char *name = argv[++argi];
+			theLWLIApp->addFactor(name, argv[++argi]);
+		}
+		else if (!strcmp(opt, "-outlet") && argi + 2 < argc)
+		{
+			outletX = atof(argv[++argi]);
+			outletY = atof(argv[++argi]);
+			useOutlet = true;
+		}
+		else if (!strcmp(opt, "-snap") && hasValue) { snapDist = atof(argv[++argi]); }
+		else if (!strcmp(opt, "-terrainout")) { terrainOut = true; }
+		else if (!strcmp(opt, "-series") && hasValue) { seriesFile = argv[++argi]; }
+		else if (!strcmp(opt, "-jobs") && hasValue) { njobs = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-scenarios") && hasValue) { scenarioFile = argv[++argi]; }
+		else if (!strcmp(opt, "-curves") && hasValue)
+		{
+			const char *format = argv[++argi];
+			if (!strcmp(format, "npy")) { theLWLIApp->curveFormat = CURVES_NPY; }
+			else if (!strcmp(format, "text")) { theLWLIApp->curveFormat = CURVES_TEXT; }
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-simplify") && argi + 2 < argc)
+		{
+			const char *mode = argv[++argi];
+			double amount = atof(argv[++argi]);
+			if (!strcmp(mode, "error") && amount > 0)
+			{
+				theLWLIApp->simplify.mode = SIMPLIFY_ERROR;
+				theLWLIApp->simplify.tolerance = amount;
+			}
+			else if (!strcmp(mode, "percentiles") && amount >= 1)
+			{
+				theLWLIApp->simplify.mode = SIMPLIFY_PERCENTILES;
+				theLWLIApp->simplify.npoints = (int)amount;
+			}
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-numbers") && hasValue)
+		{
+			const char *numbers = argv[++argi];
+			if (!strcmp(numbers, "shortest")) { theLWLIApp->curveText.numbers = NUMBERS_SHORTEST; }
+			else if (!strcmp(numbers, "fixed")) { theLWLIApp->curveText.numbers = NUMBERS_FIXED; }
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		else if (!strcmp(opt, "-compress") && hasValue)
+		{
+			const char *method = argv[++argi];
+			if (!strcmp(method, "gzip")) { theLWLIApp->curveText.compression = COMPRESS_GZIP; }
+			else if (!strcmp(method, "zstd")) { theLWLIApp->curveText.compression = COMPRESS_ZSTD; }
+			else if (!strcmp(method, "none")) { theLWLIApp->curveText.compression = COMPRESS_NONE; }
+			else
+			{
+				printUsage();
+				return 1;
+			}
+			if (!compressionAvailable(theLWLIApp->curveText.compression))
+			{
+				fatalError("The program was built without this compression (SSLM_WITH_ZLIB, SSLM_WITH_ZSTD)\n");
+			}
+		}
+		else if (!strcmp(opt, "-batch") && hasValue) { batchFile = argv[++argi]; }
+		else if (!strcmp(opt, "-memory") && hasValue) { memoryMb = atof(argv[++argi]); }
+		else if (!strcmp(opt, "-summary") && hasValue) { summaryFile = argv[++argi]; }
+		else if (!strcmp(opt, "-band") && argi + 2 < argc)
+		{
+			band = atoi(argv[++argi]);
+			nbands = atoi(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-coordinate") && hasValue) { ncoordinate = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-distributed") && hasValue) { nlocal = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-transport") && hasValue) { theDistributed.transport = argv[++argi]; }
+		else if (!strcmp(opt, "-timeout") && hasValue) { theDistributed.timeout = atof(argv[++argi]); }
+		else if (!strcmp(opt, "-query") && argi + 2 < argc)
+		{
+			queryFile = argv[++argi];
+			answerFile = argv[++argi];
+		}
+		else if (!strcmp(opt, "-serve") && hasValue) { serveSocket = argv[++argi]; }
+		else if (!strcmp(opt, "-client") && argi + 2 < argc)
+		{
+			clientSocket = argv[++argi];
+			clientRequest = argv[++argi];
+		}
+		else if (!strcmp(opt, "-lwli") && argi + 2 < argc)
+		{
+			srcWeightFile = argv[++argi];
+			sinkWeightFile = argv[++argi];
+		}
+		else if (!strcmp(opt, "-weightsets") && hasValue) { weightSetFile = argv[++argi]; }
+		else if (!strcmp(opt, "-uncertainty") && hasValue)
+		{
+			if (!theUncertainty) theUncertainty = new LorenzUncertainty();
+			theUncertainty->nreplicates = atoi(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-perturb") && argi + 3 < argc)
+		{
+			if (!theUncertainty) theUncertainty = new LorenzUncertainty();
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				theUncertainty->sigma[f] = atof(argv[++argi]);
+			}
+		}
+		else if (!strcmp(opt, "-seed") && hasValue)
+		{
+			if (!theUncertainty) theUncertainty = new LorenzUncertainty();
+			theUncertainty->seed = strtoull(argv[++argi], NULL, 10);
+		}
+		else if (!strcmp(opt, "-level") && hasValue)
+		{
+			if (!theUncertainty) theUncertainty = new LorenzUncertainty();
+			theUncertainty->level = atof(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-pyramid") && hasValue)
+		{
+			thePyramid = new LorenzPyramid();
+			thePyramid->tolerance = atof(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-histogram") && argi + 3 < argc)
+		{
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				histogramQuantum[f] = atof(argv[++argi]);
+			}
+			useHistogram = true;
+		}
+		else if (!strcmp(opt, "-metrics") && hasValue) { metricsFile = argv[++argi]; }
+		else if (!strcmp(opt, "-checkpoint") && hasValue) { checkpointDir = argv[++argi]; }
+		else if (!strcmp(opt, "-metricsline")) { metricsLine = true; }
+		else if (!strcmp(opt, "-trace") && hasValue) { traceFile = argv[++argi]; }
+		else if (!strcmp(opt, "-window") && hasValue)
+		{
+			if (theLocalLorenz == NULL) { theLocalLorenz = new LocalLorenz(); }
+			theLocalLorenz->window = atoi(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-quantum") && argi + 3 < argc)
+		{
+			if (theLocalLorenz == NULL) { theLocalLorenz = new LocalLorenz(); }
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				theLocalLorenz->quantum[f] = atof(argv[++argi]);
+			}
+		}
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (traceFile) { startTrace(true); }
+
+	// Client of a server: one request
+	if (clientSocket)
+	{
+		int rc = sendRequest(clientSocket, clientRequest);
+		delete theLWLIApp;
+		return rc;
+	}
+
+	// Server mode: requests on a socket until shutdown
+	if (serveSocket)
+	{
+		LorenzServer *theServer = new LorenzServer();
+		theServer->cache.budget = memoryMb*1024.0*1024.0;
+		if (njobs > 0) { theServer->maxClients = njobs; }
+		theServer->serve(serveSocket);
+		delete theServer;
+		delete theLWLIApp;
+		return 0;
+	}
+
+	// Batch mode: each job has its own input directory
+	if (batchFile)
+	{
+		BatchRunner *theBatch = new BatchRunner();
+		theBatch->nthreads = njobs;
+		theBatch->memoryBudget = memoryMb*1024.0*1024.0;
+		theBatch->curveFormat = theLWLIApp->curveFormat;
+		theBatch->simplify = theLWLIApp->simplify;
+		theBatch->curveText = theLWLIApp->curveText;
+		int nfailed = theBatch->runBatch(batchFile, summaryFile);
+		if (traceFile) { writeTrace(traceFile); }
+		delete theBatch;
+		delete theLWLIApp;
+		return (nfailed > 0) ? 2 : 0;
+	}
+
+	// Distributed mode: bands of rows in worker processes
+	if (nbands > 0 || ncoordinate > 0 || nlocal > 0)
+	{
+		int rc = 0;
+		theDistributed.nthreads = njobs;
+		if (nbands > 0) { theDistributed.runBand(theLWLIApp, band, nbands); }
+		else if (ncoordinate > 0) { theDistributed.runCoordinator(theLWLIApp, ncoordinate); }
+		else { rc = theDistributed.runLocal(theLWLIApp, argv[0], nlocal); }
+		if (traceFile) { writeTrace(traceFile); }
+		delete theLWLIApp;
+		return rc;
+	}
+
+	// Query mode: CDF and quantiles of the curves, nothing else is written
+	if (queryFile)
+	{
+		std::vector<int> srclus;
+		std::vector<int> sinklus;
+		readLuList(theLWLIApp->srcluFile, srclus);
+		readLuList(theLWLIApp->sinkluFile, sinklus);
+
+		LorenzEngine *theEngine = new LorenzEngine();
+		theEngine->nthreads = njobs;
+		for (int f = 0; f < NUM_FACTORS; f++) { theEngine->quantum[f] = histogramQuantum[f]; }
+		theEngine->setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+		theEngine->readGrids(theLWLIApp->luFile, theLWLIApp->demFile, theLWLIApp->distFile, theLWLIApp->slopeFile);
+		theEngine->compute();
+		answerQueryFile(*theEngine, queryFile, answerFile);
+		if (traceFile) { writeTrace(traceFile); }
+		delete theEngine;
+		delete theLWLIApp;
+		return 0;
+	}
+
+	// Uncertainty mode: replicates of the cells of each land use
+	if (theUncertainty)
+	{
+		theUncertainty->nthreads = njobs;
+		theUncertainty->runUncertainty(theLWLIApp, srcWeightFile, sinkWeightFile);
+		delete theUncertainty;
+		delete theLWLIApp;
+		return 0;
+	}
+
+	// Pyramid mode: coarse estimates first, then the full grid
+	if (thePyramid)
+	{
+		thePyramid->nthreads = njobs;
+		thePyramid->runPyramid(theLWLIApp, srcWeightFile, sinkWeightFile);
+		if (traceFile) { writeTrace(traceFile); }
+		delete thePyramid;
+		delete theLWLIApp;
+		return 0;
+	}
+
+	// Histogram mode: the grids are streamed into the engine and the
+	// quantized factors are counted instead of sorted
+	if (useHistogram)
+	{
+		std::vector<int> srclus;
+		std::vector<int> sinklus;
+		readLuList(theLWLIApp->srcluFile, srclus);
+		readLuList(theLWLIApp->sinkluFile, sinklus);
+
+		LorenzEngine *theEngine = new LorenzEngine();
+		theEngine->nthreads = njobs;
+		theEngine->curveFormat = theLWLIApp->curveFormat;
+		theEngine->simplify = theLWLIApp->simplify;
+		theEngine->curveText = theLWLIApp->curveText;
+		for (int f = 0; f < NUM_FACTORS; f++) { theEngine->quantum[f] = histogramQuantum[f]; }
+		theEngine->setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+		theEngine->readGrids(theLWLIApp->luFile, theLWLIApp->demFile, theLWLIApp->distFile, theLWLIApp->slopeFile);
+		theEngine->compute();
+		theEngine->writeOutputs("");
+
+		if (srcWeightFile)
+		{
+			std::vector<double> weights;
+			lwliWeights(theEngine->results.data(), theEngine->nsrclus, theEngine->nsinklus, srcWeightFile, sinkWeightFile, weights);
+
+			std::vector<int> isSource(theEngine->results.size());
+			for (size_t luidx = 0; luidx < isSource.size(); luidx++) { isSource[luidx] = ((int)luidx < theEngine->nsrclus) ? 1 : 0; }
+			std::vector<double> coef;
+			lwliCoefficients(theEngine->results.data(), (int)theEngine->results.size(), coef);
+
+			double lwli[NUM_LWLI];
+			calLwliSets((int)theEngine->results.size(), isSource.data(), coef.data(), weights.data(), 1, lwli, 1);
+			writeFinalLwli("finallwlis.txt", lwli);
+		}
+		if (traceFile) { writeTrace(traceFile); }
+		delete theEngine;
+		delete theLWLIApp;
+		return 0;
+	}
+
+	// Terrain preprocessing: the watershed upstream of the outlet
+	// replaces the watershed grid made with ArcGIS.
+	Terrain *theTerrain = NULL;
+	if (useOutlet)
+	{
+		theTerrain = new Terrain();
+		theTerrain->processTerrain(theLWLIApp->demFile, outletX, outletY, snapDist);
+		if (terrainOut)
+		{
+			theTerrain->writeOutputs("demfill.txt", "flowdir.txt", "flowacc.txt", "watershed.txt");
+		}
+
+		theLWLIApp->setWatershedMask(theTerrain->wsmask,
+			theTerrain->dem->rows, theTerrain->dem->cols);
+
+		// Only the mask is needed from here on
+		delete[] theTerrain->flowacc;
+		theTerrain->flowacc = NULL;
+		delete[] theTerrain->dem->data;
+		theTerrain->dem->data = NULL;
+	}
+
+	// Time series mode: the terrain is shared by the years
+	if (seriesFile)
+	{
+		LuSeries *theSeries = new LuSeries();
+		theSeries->njobs = njobs;
+		theSeries->runSeries(theLWLIApp, seriesFile);
+		delete theSeries;
+		theLWLIApp->cleanMemory();
+		if (theTerrain) delete theTerrain;
+		return 0;
+	}
+
+	// Scenario mode: edits of the land use are applied incrementally
+	if (scenarioFile)
+	{
+		IncrementalLorenz *theIncremental = new IncrementalLorenz();
+		theIncremental->runScenarios(theLWLIApp, scenarioFile);
+		delete theIncremental;
+		theLWLIApp->cleanMemory();
+		if (theTerrain) delete theTerrain;
+		return 0;
+	}
+
+	// Moving window mode: only the maps are written
+	if (theLocalLorenz && theLocalLorenz->window > 0)
+	{
+		theLWLIApp->readInputGrids();
+		theLocalLorenz->calLocalLorenz(theLWLIApp);
+		delete theLocalLorenz;
+		theLWLIApp->cleanMemory();
+		if (theTerrain) delete theTerrain;
+		return 0;
+	}
+
+	theMetrics.enabled = (metricsFile != NULL || metricsLine);
+
+	// Read in the ascii input file, or resume from a checkpoint
+	theLWLIApp->checkpointDir = checkpointDir;
+	theMetrics.beginStage("readGisAsciiFiles");
+	theLWLIApp->readGisAsciiFiles();
+	double ncells = (double)theLWLIApp->getRows()*theLWLIApp->getCols();
+	double nvalues = theMetrics.enabled ? theLWLIApp->getValueCount(false) : 0.0;
+	theMetrics.endStage(ncells, nvalues);
+
+	// Processing the values for Lorenz curve generation.
+	// Lorenz curve needs two columns:
+	// Column 1: value in decreasing order.
+	// Column 2: percent of ranks (order value/total number)
+	theMetrics.beginStage("SortCalpercent");
+	theLWLIApp->SortCalpercent();
+	theMetrics.endStage(ncells, nvalues);
+
+
+	// After processing the data, the next step is to 
+	// calculate the Trapezoidal area of the data.
+	// The equation is:
+	// f(x) = delta x/2(y0 + 2*y1 + 2*y2 + ... + 2*yn-1 + yn)
+	// C++ does not have a function to make the graphs.
+	// I will use python to create the graphs.
+	theMetrics.beginStage("CalLWLI");
+	theLWLIApp->CalLWLI();
+	theMetrics.endStage(ncells, theMetrics.enabled ? theLWLIApp->getValueCount(true) : 0.0);
+
+	theMetrics.beginStage("calAreaPercOverws");
+	theLWLIApp->calAreaPercOverws();
+	theMetrics.endStage(ncells, nvalues);
+
+	// Final LWLI from the areas, for one or many weight sets
+	if (srcWeightFile || weightSetFile)
+	{
+		std::vector<LuResult> results;
+		int nsrclus = theLWLIApp->getLuResults(results);
+		int nsinklus = (int)results.size() - nsrclus;
+
+		if (srcWeightFile)
+		{
+			std::vector<double> weights;
+			lwliWeights(results.data(), nsrclus, nsinklus, srcWeightFile, sinkWeightFile, weights);
+
+			std::vector<int> isSource(results.size());
+			for (size_t luidx = 0; luidx < results.size(); luidx++) { isSource[luidx] = ((int)luidx < nsrclus) ? 1 : 0; }
+			std::vector<double> coef;
+			lwliCoefficients(results.data(), (int)results.size(), coef);
+
+			double lwli[NUM_LWLI];
+			calLwliSets((int)results.size(), isSource.data(), coef.data(), weights.data(), 1, lwli, 1);
+			writeFinalLwli("finallwlis.txt", lwli);
+		}
+		if (weightSetFile)
+		{
+			runLwliSets(results.data(), nsrclus, nsinklus, weightSetFile, "lwlisets.txt");
+		}
+	}
+
+	if (metricsFile) { theMetrics.writeJson(metricsFile); }
+	if (traceFile) { writeTrace(traceFile); }
+	if (metricsLine) { theMetrics.printSummary(stdout); }
+
+	theLWLIApp->cleanMemory();
+	if (theTerrain) delete theTerrain;
+
+	time(&finish);
+	elapsed_time = difftime(finish, start);
+
+	long elapMin, elapSec, elapHour;
+
+	elapHour = (long)(elapsed_time / 3600);
+	elapMin = (long)((elapsed_time - (elapHour * 3600)) / 60);
+	elapSec = (long)(elapsed_time - (elapHour * 3600) - (elapMin * 60));
+
+	fprintf(stdout, "Runtime: %d:%02d:%02d  (Hours:Minutes:Seconds)\n", elapHour, elapMin, elapSec);
+
+	return 0;
+}
+
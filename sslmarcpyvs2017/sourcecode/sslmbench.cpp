@@ -0,0 +1,444 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Benchmarks of the steps of the program. The App steps are timed
+** one by one (readArcviewInt, readArcviewFloat, asc2ludata,
+** sortludata, calperludata, removeDuplicates, callwli and the
+** writers), then the steps of LorenzEngine (readGrids, compute and
+** writeOutputs). Each step is run -reps times on the inputs of -dir,
+** which -size first fills with a synthetic watershed (synthetic.h).
+** With -quantum the engine steps are timed again in the "histogram"
+** group, counting the values on the quantum (histogram.h).
+**
+** The results go to a JSON file for tracking regressions:
+**
+**   {"version": 1, "date": "...", "compiler": "...", "threads": 8,
+**    "input": {"dir": "...", "rows": 1000, "cols": 1000,
+**              "landuses": 6, "grid_bytes": 12345678},
+**    "repetitions": 3, "skipped": [],
+**    "stages": [{"group": "app", "name": "readArcviewInt",
+**                "seconds": [...], "min": ..., "median": ...,
+**                "mean": ..., "bytes": ...}, ...]}
+**
+** "bytes" is the size of the files read or written by the step
+** (0 if it does neither). The App keeps every cell of every land use
+** in memory, -memory skips its steps when that would be more than
+** the budget so the large grids can still time the engine.
+**
+** The outputs of the writers go to the working directory, those of
+** the engine with an engine_ (histogram_) prefix.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "app.h"
+#include "ascgrid.h"
+#include "engine.h"
+#include "synthetic.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+// Times of one step over the repetitions
+typedef struct StageTimes
+{
+	string group;
+	string name;
+	vector<double> seconds;
+	double bytes;
+} StageTimes;
+
+static vector<StageTimes> stages;
+
+
+static double fileBytes(const string &file)
+{
+	struct stat st;
+	return (stat(file.c_str(), &st) == 0) ? (double)st.st_size : 0.0;
+}
+
+
+/*
+** timeStage()
+**
+** Runs step and adds its time to the stage of that name.
+**
+*/
+static void timeStage(const char *group, const char *name, double bytes, const function<void()> &step)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	step();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		if (stages[k].group == group && stages[k].name == name)
+		{
+			stages[k].seconds.push_back(seconds);
+			return;
+		}
+	}
+	StageTimes stage;
+	stage.group = group;
+	stage.name = name;
+	stage.seconds.push_back(seconds);
+	stage.bytes = bytes;
+	stages.push_back(stage);
+}
+
+
+/*
+** AppBenchmark
+**
+** Friend of App, calls its private steps in the order of main().
+**
+*/
+class AppBenchmark
+{
+public:
+	static void run(const string &dir);
+
+private:
+	static void freeLudata(App *app, App::Ludata *data, bool single);
+};
+
+
+void AppBenchmark::freeLudata(App *app, App::Ludata *data, bool single)
+{
+	if (data == NULL) { return; }
+	for (int luidx = 0; luidx < MAX_LUIDS && app->allsrcsinklus[luidx] != 0; luidx++)
+	{
+		for (int f = 0; f < app->getNumFactors(); f++)
+		{
+			if (single) { delete data->factorarray[f][luidx]; }
+			else { delete[] data->factorarray[f][luidx]; }
+		}
+	}
+}
+
+
+void AppBenchmark::run(const string &dir)
+{
+	string files[6] = { dir + "srclus.txt", dir + "sinklus.txt", dir + "luws.txt",
+		dir + "demws.txt", dir + "slopews.txt", dir + "distws.txt" };
+
+	App *app = new App();
+	app->srcluFile = files[0].c_str();
+	app->sinkluFile = files[1].c_str();
+	app->luFile = files[2].c_str();
+	app->demFile = files[3].c_str();
+	app->slopeFile = files[4].c_str();
+	app->distFile = files[5].c_str();
+
+	// readInputGrids() step by step
+	for (int i = 0; i < MAX_ROWS; i++) { app->validRows[i] = 1; }
+	app->readLuLists();
+
+	timeStage("app", "readArcviewInt", fileBytes(files[2]), [&]() { app->asclu = app->readArcviewInt(app->luFile); });
+	timeStage("app", "readArcviewFloat", fileBytes(files[3]) + fileBytes(files[4]) + fileBytes(files[5]), [&]()
+	{
+		app->ascfactors[0] = app->readArcviewFloat(app->demFile);
+		app->ascfactors[2] = app->readArcviewFloat(app->slopeFile);
+		app->ascfactors[1] = app->readArcviewFloat(app->distFile);
+	});
+	timeStage("app", "asc2ludata", 0, [&]() { app->rawludata = app->asc2ludata(); });
+	timeStage("app", "sortludata", 0, [&]() { app->sortludata(); });
+	timeStage("app", "calperludata", 0, [&]() { app->perludata = app->calperludata(); });
+	timeStage("app", "removeDuplicates", 0, [&]() { app->removeDuplicates(); });
+	timeStage("app", "callwli", 0, [&]() { app->lwlis = app->callwli(); });
+	timeStage("app", "writeElevData", 0, [&]() { app->writeFactorData(0, "elev_dataperc.txt"); });
+	timeStage("app", "writeDistData", 0, [&]() { app->writeFactorData(1, "dist_dataperc.txt"); });
+	timeStage("app", "writeSlpData", 0, [&]() { app->writeFactorData(2, "slp_dataperc.txt"); });
+	timeStage("app", "writeLwliData", 0, [&]() { app->writeLwliData("LurenzCurveAreas.txt"); });
+	timeStage("app", "calAreaPercOverws", 0, [&]() { app->calAreaPercOverws(); });
+
+	// cleanMemory() only frees the structures, not the arrays
+	freeLudata(app, app->rawludata, false);
+	freeLudata(app, app->perludata, false);
+	freeLudata(app, app->lwlis, true);
+	app->cleanMemory();
+	delete app;
+}
+
+
+static void runEngine(const string &dir, int nthreads, const char *group, double quantum)
+{
+	vector<int> srclus, sinklus;
+	readLuList((dir + "srclus.txt").c_str(), srclus);
+	readLuList((dir + "sinklus.txt").c_str(), sinklus);
+
+	LorenzEngine *engine = new LorenzEngine();
+	engine->nthreads = nthreads;
+	for (int f = 0; f < NUM_FACTORS; f++) { engine->quantum[f] = quantum; }
+	engine->setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+
+	double bytes = fileBytes(dir + "luws.txt") + fileBytes(dir + "demws.txt") +
+		fileBytes(dir + "distws.txt") + fileBytes(dir + "slopews.txt");
+	string prefix = string(group) + "_";
+	timeStage(group, "readGrids", bytes, [&]()
+	{
+		engine->readGrids((dir + "luws.txt").c_str(), (dir + "demws.txt").c_str(),
+			(dir + "distws.txt").c_str(), (dir + "slopews.txt").c_str());
+	});
+	timeStage(group, "compute", 0, [&]() { engine->compute(); });
+	timeStage(group, "writeOutputs", 0, [&]() { engine->writeOutputs(prefix.c_str()); });
+	delete engine;
+}
+
+
+// Bytes written by the writers, known after the first run
+static void setOutputBytes()
+{
+	const char *names[4][2] = { { "writeElevData", "elev_dataperc.txt" }, { "writeDistData", "dist_dataperc.txt" },
+		{ "writeSlpData", "slp_dataperc.txt" }, { "writeLwliData", "LurenzCurveAreas.txt" } };
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		for (int n = 0; n < 4; n++)
+		{
+			if (stages[k].group == "app" && stages[k].name == names[n][0]) { stages[k].bytes = fileBytes(names[n][1]); }
+		}
+		if (stages[k].name == "writeOutputs")
+		{
+			stages[k].bytes = fileBytes("engine_elev_dataperc.txt") + fileBytes("engine_dist_dataperc.txt") +
+				fileBytes("engine_slp_dataperc.txt");
+		}
+	}
+}
+
+
+static string jsonString(const string &s)
+{
+	string out = "\"";
+	for (size_t k = 0; k < s.size(); k++)
+	{
+		if (s[k] == '"' || s[k] == '\\') { out += '\\'; }
+		out += s[k];
+	}
+	return out + "\"";
+}
+
+
+static void writeJson(const char *file, const string &dir, int rows, int cols, int nlus, int reps,
+	int nthreads, const vector<string> &skipped)
+{
+	char buf2[512];
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	char date[64];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+#if defined(_MSC_VER)
+	sprintf(buf2, "MSVC %d", _MSC_VER);
+#elif defined(__VERSION__)
+	sprintf(buf2, "%s", __VERSION__);
+#else
+	sprintf(buf2, "unknown");
+#endif
+
+	double gridBytes = fileBytes(dir + "luws.txt") + fileBytes(dir + "demws.txt") +
+		fileBytes(dir + "distws.txt") + fileBytes(dir + "slopews.txt");
+
+	fprintf(fp, "{\"version\": 1, \"date\": \"%s\", \"compiler\": %s, \"threads\": %d,\n",
+		date, jsonString(buf2).c_str(), nthreads);
+	fprintf(fp, " \"input\": {\"dir\": %s, \"rows\": %d, \"cols\": %d, \"landuses\": %d, \"grid_bytes\": %.0f},\n",
+		jsonString(dir.empty() ? "." : dir).c_str(), rows, cols, nlus, gridBytes);
+	fprintf(fp, " \"repetitions\": %d, \"skipped\": [", reps);
+	for (size_t k = 0; k < skipped.size(); k++)
+	{
+		fprintf(fp, "%s%s", (k > 0) ? ", " : "", jsonString(skipped[k]).c_str());
+	}
+	fprintf(fp, "],\n \"stages\": [");
+
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		vector<double> sorted = stages[k].seconds;
+		sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		double median = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+		double mean = 0.0;
+		for (size_t r = 0; r < n; r++) { mean += sorted[r] / (double)n; }
+
+		fprintf(fp, "%s\n  {\"group\": \"%s\", \"name\": \"%s\", \"seconds\": [", (k > 0) ? "," : "",
+			stages[k].group.c_str(), stages[k].name.c_str());
+		for (size_t r = 0; r < n; r++)
+		{
+			fprintf(fp, "%s%.6f", (r > 0) ? ", " : "", stages[k].seconds[r]);
+		}
+		fprintf(fp, "], \"min\": %.6f, \"median\": %.6f, \"mean\": %.6f, \"bytes\": %.0f}",
+			sorted[0], median, mean, stages[k].bytes);
+	}
+	fprintf(fp, "\n ]}\n");
+	fclose(fp);
+}
+
+
+static void dropMessage(const char *, void *)
+{
+}
+
+
+static void makeDir(const string &dir)
+{
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+}
+
+
+void printUsage()
+{
+	fprintf(stdout, "Usage: sslmbench [options]\n");
+	fprintf(stdout, "  -dir path         directory of the inputs (working directory)\n");
+	fprintf(stdout, "  -size rows cols   first write a synthetic watershed of this size to -dir\n");
+	fprintf(stdout, "  -seed n           seed of the synthetic watershed (1)\n");
+	fprintf(stdout, "  -classes k        land use classes, half sources and half sinks (6)\n");
+	fprintf(stdout, "  -decimals d       digits after the point of the DEM, slope and\n");
+	fprintf(stdout, "                    distance, fewer give more ties (2)\n");
+	fprintf(stdout, "  -generateonly     only write the synthetic watershed\n");
+	fprintf(stdout, "  -stages app|engine|all\n");
+	fprintf(stdout, "                    steps to time (all)\n");
+	fprintf(stdout, "  -reps n           repetitions of each step (3)\n");
+	fprintf(stdout, "  -quantum q        also time the engine counting the terrain values\n");
+	fprintf(stdout, "                    on the quantum q, e.g. 0.01 for -decimals 2\n");
+	fprintf(stdout, "  -threads n        threads of the engine and the generator (all cores)\n");
+	fprintf(stdout, "  -memory mb        skip the App steps if they need more memory (no limit)\n");
+	fprintf(stdout, "  -json file        results (sslmbench.json)\n");
+	fprintf(stdout, "  -verbose          show the messages of the steps\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+	char buf2[512];
+	SyntheticOptions synth = defaultSyntheticOptions();
+	string dir;
+	bool generate = false;
+	bool generateOnly = false;
+	bool verbose = false;
+	const char *stageGroups = "all";
+	const char *jsonFile = "sslmbench.json";
+	int reps = 3;
+	int nthreads = 0;
+	double memoryMb = 0.0;
+	double quantum = 0.0;
+
+	for (int argi = 1; argi < argc; argi++)
+	{
+		const char *opt = argv[argi];
+		bool hasValue = (argi + 1 < argc);
+		if (!strcmp(opt, "-dir") && hasValue) { dir = argv[++argi]; }
+		else if (!strcmp(opt, "-size") && argi + 2 < argc)
+		{
+			synth.rows = atoi(argv[++argi]);
+			synth.cols = atoi(argv[++argi]);
+			generate = true;
+		}
+		else if (!strcmp(opt, "-seed") && hasValue) { synth.seed = strtoull(argv[++argi], NULL, 10); }
+		else if (!strcmp(opt, "-classes") && hasValue) { synth.nclasses = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-decimals") && hasValue) { synth.decimals = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-generateonly")) { generateOnly = true; }
+		else if (!strcmp(opt, "-stages") && hasValue) { stageGroups = argv[++argi]; }
+		else if (!strcmp(opt, "-reps") && hasValue) { reps = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-quantum") && hasValue) { quantum = atof(argv[++argi]); }
+		else if (!strcmp(opt, "-threads") && hasValue) { nthreads = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-memory") && hasValue) { memoryMb = atof(argv[++argi]); }
+		else if (!strcmp(opt, "-json") && hasValue) { jsonFile = argv[++argi]; }
+		else if (!strcmp(opt, "-verbose")) { verbose = true; }
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	bool runApp = !strcmp(stageGroups, "all") || !strcmp(stageGroups, "app");
+	bool runEngineSteps = !strcmp(stageGroups, "all") || !strcmp(stageGroups, "engine");
+	if (reps < 1 || (!runApp && !runEngineSteps) || (generateOnly && !generate))
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (!dir.empty() && dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != '\\') { dir += '/'; }
+	if (nthreads <= 0) { nthreads = numWorkers(); }
+
+	if (generate)
+	{
+		if (!dir.empty()) { makeDir(dir); }
+		synth.nthreads = nthreads;
+		timeStage("synthetic", "generate", 0, [&]() { writeSyntheticWatershed(dir.c_str(), synth); });
+		if (generateOnly) { return 0; }
+	}
+	if (!verbose) { setMessageCallback(dropMessage, NULL); }
+
+	AscGrid *header = readAscHeader((dir + "luws.txt").c_str());
+	int rows = header->rows, cols = header->cols;
+	freeAscGrid(header);
+
+	vector<int> srclus, sinklus;
+	readLuList((dir + "srclus.txt").c_str(), srclus);
+	readLuList((dir + "sinklus.txt").c_str(), sinklus);
+	int nlus = (int)(srclus.size() + sinklus.size());
+
+	// The grids and a value of each factor for every cell and land
+	// use, see App::asc2ludata()
+	vector<string> skipped;
+	double appBytes = (double)rows*cols*(16.0 + 24.0*nlus);
+	if (runApp && memoryMb > 0 && appBytes > memoryMb*1024.0*1024.0)
+	{
+		sprintf(buf2, "Skipping the App steps, they need about %.0f MB\n", appBytes / (1024.0*1024.0));
+		fprintf(stdout, "%s", buf2);
+		skipped.push_back("app");
+		runApp = false;
+	}
+
+	for (int r = 0; r < reps; r++)
+	{
+		fprintf(stdout, "Repetition %d of %d\n", r + 1, reps);
+		fflush(stdout);
+		if (runApp) { AppBenchmark::run(dir); }
+		if (runEngineSteps) { runEngine(dir, nthreads, "engine", 0.0); }
+		if (runEngineSteps && quantum > 0) { runEngine(dir, nthreads, "histogram", quantum); }
+	}
+	setOutputBytes();
+
+	writeJson(jsonFile, dir, rows, cols, nlus, reps, nthreads, skipped);
+	for (size_t k = 0; k < stages.size(); k++)
+	{
+		double best = *min_element(stages[k].seconds.begin(), stages[k].seconds.end());
+		fprintf(stdout, "%-10s %-20s %10.4f s\n", stages[k].group.c_str(), stages[k].name.c_str(), best);
+	}
+	fprintf(stdout, "Results in %s\n", jsonFile);
+	return 0;
+}
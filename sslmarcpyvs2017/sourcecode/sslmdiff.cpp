@@ -0,0 +1,1081 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Differential check of App and the optimized engines against the
+** App pipeline of the first version, frozen in appref.h as the
+** reference, so a change of App is checked as well. Random small
+** watersheds are written to -dir, each engine writes its outputs
+** next to the ones of the reference with its name as prefix, and
+** the files are compared with the tolerance of the engine:
+**
+**   app          App as sslmarcpy runs it               identical
+**   engine       LorenzEngine on one thread             identical
+**   parallel     LorenzEngine on all threads            identical
+**   streaming    the C API (sslmapi.h), rows pushed in  identical
+**                blocks of random size, on a handle
+**                used for other classes first
+**   shortest     LorenzEngine with -numbers shortest    curves within
+**                                                       the 6 decimals
+**   histogram    LorenzEngine counting the values on    identical
+**                the quantum 1e-6 (histogram.h)
+**   batch        BatchRunner on one thread, the case    identical
+**                after two jobs of other classes
+**   distributed  3 bands run one after the other and    identical
+**                merged (dir: transport)
+**   pyramid      the full level of LorenzPyramid        identical
+**   series       LuSeries on the cell store             identical
+**   incremental  IncrementalLorenz trees, after a       identical
+**                scenario is applied and reverted
+**   server       the watershed cache of -serve          1e-9 relative
+**
+** The rasters have heavy ties (a few distinct values), runs of
+** NODATA, classes of a single cell, listed classes without cells,
+** unlisted classes, extreme values and cells of listed land uses
+** with NODATA in all three terrain grids (App keeps them with the
+** NODATA values, so must every engine).
+**
+** A failing case stays in its directory and can be run again with
+** -seed and -case, the others are deleted. Then a synthetic
+** watershed of -speedsize (synthetic.h) is compared as well and
+** timed: every engine slower than the reference is reported, the
+** ones marked faster fail then.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+#include "app.h"
+#include "appref.h"
+#include "ascgrid.h"
+#include "batch.h"
+#include "distributed.h"
+#include "engine.h"
+#include "textout.h"
+#include "luseries.h"
+#include "pyramid.h"
+#include "incremental.h"
+#include "server.h"
+#include "sslmapi.h"
+#include "synthetic.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+#define DIFF_NODATA -9999
+
+static const char *inputFiles[] = { "srclus.txt", "sinklus.txt", "luws.txt", "demws.txt", "distws.txt", "slopews.txt", "series.txt" };
+static const char *curveFiles[NUM_FACTORS] = { "elev_dataperc.txt", "dist_dataperc.txt", "slp_dataperc.txt" };
+static const char *resultFiles[2] = { "LurenzCurveAreas.txt", "luareaperc.txt" };
+
+// Random numbers of the case being run, also used by the engines
+static mt19937_64 caseRng;
+
+
+// With the comparison and the cases below
+static bool readWholeFile(const string &file, string &text);
+static void splitTokens(const string &text, vector<string> &tokens);
+static void writeListFile(const char *file, const vector<int> &lunos);
+static void enterDir(const string &dir);
+
+
+/*
+** runInSubdir()
+**
+** For the runs that write their outputs to the working directory:
+** run is called in the directory prefix + "run" with the inputs of
+** the case as ../ plus the name, and the outputs are then moved to
+** the names with prefix.
+**
+*/
+static void runInSubdir(const char *prefix, void (*run)(App *app))
+{
+	static const char *inputs[6] = { "../srclus.txt", "../sinklus.txt", "../luws.txt", "../demws.txt", "../distws.txt", "../slopews.txt" };
+	string dir = string(prefix) + "run";
+	enterDir(dir);
+
+	App *app = new App();
+	app->srcluFile = inputs[0];
+	app->sinkluFile = inputs[1];
+	app->luFile = inputs[2];
+	app->demFile = inputs[3];
+	app->distFile = inputs[4];
+	app->slopeFile = inputs[5];
+	bool failed = false;
+	string why;
+	try
+	{
+		run(app);
+	}
+	catch (const exception &e)
+	{
+		failed = true;
+		why = e.what();
+	}
+	delete app;
+
+	if (chdir("..") != 0) { fatalError("Can't leave the directory of the run\n"); }
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		rename((dir + "/" + curveFiles[f]).c_str(), (string(prefix) + curveFiles[f]).c_str());
+	}
+	for (int r = 0; r < 2; r++)
+	{
+		rename((dir + "/" + resultFiles[r]).c_str(), (string(prefix) + resultFiles[r]).c_str());
+	}
+	rmdir(dir.c_str());
+	if (failed) { throw runtime_error(why); }
+}
+
+
+/*
+** AppUnderTest
+**
+** Friend of App, runs the steps of main() and frees the arrays that
+** cleanMemory() leaves.
+**
+*/
+class AppUnderTest
+{
+public:
+	static void run(App *app);
+
+private:
+	static void freeLudata(App *app, App::Ludata *data, bool single);
+};
+
+
+void AppUnderTest::freeLudata(App *app, App::Ludata *data, bool single)
+{
+	if (data == NULL) { return; }
+	for (int luidx = 0; luidx < MAX_LUIDS && app->allsrcsinklus[luidx] != 0; luidx++)
+	{
+		for (int f = 0; f < app->getNumFactors(); f++)
+		{
+			if (single) { delete data->factorarray[f][luidx]; }
+			else { delete[] data->factorarray[f][luidx]; }
+		}
+	}
+}
+
+
+void AppUnderTest::run(App *app)
+{
+	app->readGisAsciiFiles();
+	app->SortCalpercent();
+	app->CalLWLI();
+	app->calAreaPercOverws();
+
+	freeLudata(app, app->rawludata, false);
+	freeLudata(app, app->perludata, false);
+	freeLudata(app, app->lwlis, true);
+	app->cleanMemory();
+}
+
+
+static void runApp(const char *prefix) { runInSubdir(prefix, AppUnderTest::run); }
+
+
+// Bands of the distributed run, the small cases have empty bands
+#define DIFF_BANDS 3
+
+static void runDistributedBands(App *app)
+{
+	DistributedRun run;
+	run.transport = "dir:parts";
+	for (int band = 0; band < DIFF_BANDS; band++) { run.runBand(app, band, DIFF_BANDS); }
+	run.runCoordinator(app, DIFF_BANDS);
+	rmdir("parts");
+}
+
+
+static void runPyramidLevels(App *app)
+{
+	LorenzPyramid pyramid;
+	pyramid.runPyramid(app, NULL, NULL);
+	remove("pyramid_areas.txt");
+}
+
+
+static void runDistributed(const char *prefix) { runInSubdir(prefix, runDistributedBands); }
+static void runPyramid(const char *prefix) { runInSubdir(prefix, runPyramidLevels); }
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Engines under test, they read the default files of the working
+// directory and write their outputs with prefix
+
+static void runLorenzEngine(const char *prefix, int nthreads, int numbers, double quantum)
+{
+	vector<int> srclus, sinklus;
+	readLuList("srclus.txt", srclus);
+	readLuList("sinklus.txt", sinklus);
+
+	LorenzEngine engine;
+	engine.nthreads = nthreads;
+	engine.curveText.numbers = numbers;
+	for (int f = 0; f < NUM_FACTORS; f++) { engine.quantum[f] = quantum; }
+	engine.setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+	engine.readGrids("luws.txt", "demws.txt", "distws.txt", "slopews.txt");
+	engine.compute();
+	engine.writeOutputs(prefix);
+}
+
+
+static void runSerial(const char *prefix) { runLorenzEngine(prefix, 1, NUMBERS_FIXED, 0.0); }
+static void runParallel(const char *prefix) { runLorenzEngine(prefix, max(2, numWorkers()), NUMBERS_FIXED, 0.0); }
+static void runShortest(const char *prefix) { runLorenzEngine(prefix, 0, NUMBERS_SHORTEST, 0.0); }
+
+// The values of the cases have at most 3 decimals, the extremes
+// include 1e-6
+static void runHistogram(const char *prefix) { runLorenzEngine(prefix, 0, NUMBERS_FIXED, 1e-6); }
+
+
+static void throwFatal(const char *msg)
+{
+	throw runtime_error(msg);
+}
+
+
+static void dropMessage(const char *, void *)
+{
+}
+
+
+// sslm_create() installs the handlers of the library
+static void installHandlers(bool verbose)
+{
+	setFatalErrorHandler(throwFatal);
+	setMessageCallback(verbose ? NULL : dropMessage, NULL);
+}
+
+static bool verboseMessages = false;
+
+
+static void runStreaming(const char *prefix)
+{
+	vector<int> srclus, sinklus;
+	readLuList("srclus.txt", srclus);
+	readLuList("sinklus.txt", sinklus);
+
+	const char *names[NUM_FACTORS + 1] = { "luws.txt", "demws.txt", "distws.txt", "slopews.txt" };
+	AscGrid *grids[NUM_FACTORS + 1];
+	for (int g = 0; g < NUM_FACTORS + 1; g++) { grids[g] = readAscGrid(names[g]); }
+	int rows = grids[0]->rows, cols = grids[0]->cols;
+	vector<int> lu((size_t)rows*cols);
+	for (size_t k = 0; k < lu.size(); k++) { lu[k] = (int)grids[0]->data[k]; }
+
+	// The handle is used for other classes first (the listed land
+	// uses in reverse, one fewer), it must not keep anything of them
+	vector<int> decoy(srclus);
+	decoy.insert(decoy.end(), sinklus.begin(), sinklus.end());
+	reverse(decoy.begin(), decoy.end());
+	if (decoy.size() > 1) { decoy.pop_back(); }
+
+	sslm_handle h = sslm_create();
+	installHandlers(verboseMessages);
+	bool ok = sslm_set_classes(h, decoy.data(), (int)decoy.size(), NULL, 0) == SSLM_OK &&
+		sslm_set_grid(h, rows, cols) == SSLM_OK &&
+		sslm_push_rows(h, rows, lu.data(), grids[1]->data, grids[2]->data, grids[3]->data) == SSLM_OK;
+	ok = ok && sslm_set_classes(h, srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size()) == SSLM_OK &&
+		sslm_set_grid(h, rows, cols) == SSLM_OK;
+	for (int i = 0; ok && i < rows;)
+	{
+		int n = 1 + (int)(caseRng() % (unsigned long long)(rows - i));
+		size_t offset = (size_t)i*cols;
+		ok = sslm_push_rows(h, n, &lu[offset], grids[1]->data + offset, grids[2]->data + offset, grids[3]->data + offset) == SSLM_OK;
+		i += n;
+	}
+	ok = ok && sslm_compute(h) == SSLM_OK && sslm_write_outputs(h, prefix) == SSLM_OK;
+
+	string error = ok ? "" : sslm_last_error(h);
+	sslm_destroy(h);
+	for (int g = 0; g < NUM_FACTORS + 1; g++) { freeAscGrid(grids[g]); }
+	if (!ok) { fatalError(error.c_str()); }
+}
+
+
+static void runSeries(const char *prefix)
+{
+	// The label is the prefix without its "_"
+	string label = prefix;
+	label.erase(label.size() - 1);
+	FILE *fp = fopen("series.txt", "w");
+	if (fp == NULL) { fatalError("Can't open series.txt for writing\n"); }
+	fprintf(fp, "%s luws.txt\n", label.c_str());
+	fclose(fp);
+
+	App *app = new App();
+	LuSeries *series = new LuSeries();
+	series->njobs = 1;
+	series->runSeries(app, "series.txt");
+	delete series;
+	app->cleanMemory();
+	delete app;
+}
+
+
+/*
+** runIncremental()
+**
+** A scenario moving about a third of the cells to other land uses
+** is applied and reverted first, so the areas written are the ones
+** summed again over the changed trees.
+**
+*/
+static void runIncremental(const char *prefix)
+{
+	string text;
+	vector<string> tokens, srclus, sinklus;
+	readWholeFile("luws.txt", text);
+	splitTokens(text, tokens);
+	readWholeFile("srclus.txt", text);
+	splitTokens(text, srclus);
+	readWholeFile("sinklus.txt", text);
+	splitTokens(text, sinklus);
+	srclus.insert(srclus.end(), sinklus.begin(), sinklus.end());
+	srclus.push_back("0");
+
+	int cols = atoi(tokens[1].c_str());
+	mt19937_64 rng(tokens.size());
+	FILE *fp = fopen("incremental_edits.txt", "w");
+	for (size_t k = 12; k < tokens.size() && !srclus.empty(); k++)
+	{
+		if (rng() % 3 != 0) { continue; }
+		int p = (int)(k - 12);
+		fprintf(fp, "%d %d %s %s\n", p / cols, p % cols, tokens[k].c_str(), srclus[rng() % srclus.size()].c_str());
+	}
+	fclose(fp);
+	fp = fopen("incremental_scenarios.txt", "w");
+	fprintf(fp, "incremental_scratch incremental_edits.txt\n");
+	fclose(fp);
+
+	App *app = new App();
+	IncrementalLorenz *incremental = new IncrementalLorenz();
+	incremental->runScenarios(app, "incremental_scenarios.txt");
+	incremental->writeResults(prefix);
+	delete incremental;
+	app->cleanMemory();
+	delete app;
+
+	remove("incremental_edits.txt");
+	remove("incremental_scenarios.txt");
+	for (int i = 0; i < 2; i++) { remove((string("incremental_scratch_") + resultFiles[i]).c_str()); }
+}
+
+
+static void runServer(const char *prefix)
+{
+	vector<int> lunos, sinklus;
+	readLuList("srclus.txt", lunos);
+	int nsrclus = (int)lunos.size();
+	readLuList("sinklus.txt", sinklus);
+	lunos.insert(lunos.end(), sinklus.begin(), sinklus.end());
+
+	WatershedCache cache;
+	shared_ptr<const Watershed> ws = cache.get(".");
+	vector<LuResult> results(lunos.size());
+	for (size_t i = 0; i < lunos.size(); i++)
+	{
+		results[i].luno = lunos[i];
+		results[i].ncells = 0;
+		for (int f = 0; f < NUM_FACTORS; f++) { results[i].area[f] = 0.0; }
+		for (size_t c = 0; c < ws->classes.size(); c++)
+		{
+			if (ws->classes[c].luno != lunos[i]) { continue; }
+			results[i].ncells = ws->classes[c].ncells;
+			for (int f = 0; f < NUM_FACTORS; f++) { results[i].area[f] = ws->classes[c].area[f]; }
+		}
+	}
+	writeLorenzAreas((string(prefix) + resultFiles[0]).c_str(), results.data(), (int)results.size());
+	writeAreaPerc((string(prefix) + resultFiles[1]).c_str(), results.data(), nsrclus, (int)lunos.size() - nsrclus);
+}
+
+
+// Copies of the grids with other classes, in dir
+static void writeDecoyJob(const string &dir, const vector<int> &srclus, const vector<int> &sinklus)
+{
+	if (!makeDirs(dir)) { fatalError("Can't make the batch directory\n"); }
+	for (int g = 2; g < 6; g++)
+	{
+		string text;
+		string copy = dir + "/" + inputFiles[g];
+		FILE *fp = readWholeFile(inputFiles[g], text) ? fopen(copy.c_str(), "wb") : NULL;
+		if (fp == NULL || fwrite(text.data(), 1, text.size(), fp) != text.size() || fclose(fp) != 0)
+		{
+			char buf2[512];
+			sprintf(buf2, "Can't copy %s to %s\n", inputFiles[g], dir.c_str());
+			fatalError(buf2);
+		}
+	}
+	writeListFile((dir + "/srclus.txt").c_str(), srclus);
+	writeListFile((dir + "/sinklus.txt").c_str(), sinklus);
+}
+
+
+static void removeJobDir(const string &dir)
+{
+	for (int g = 0; g < 6; g++) { remove((dir + "/" + inputFiles[g]).c_str()); }
+	for (int f = 0; f < NUM_FACTORS; f++) { remove((dir + "/" + curveFiles[f]).c_str()); }
+	for (int r = 0; r < 2; r++) { remove((dir + "/" + resultFiles[r]).c_str()); }
+	rmdir(dir.c_str());
+}
+
+
+/*
+** runBatch()
+**
+** The jobs have the same size, so they run in the order of the
+** manifest, and on one thread they share one engine: the case comes
+** after jobs of the listed land uses in reverse (one fewer) and of
+** the sources and sinks swapped. Its outputs go to a directory and
+** are then moved to the names with prefix.
+**
+*/
+static void runBatch(const char *prefix)
+{
+	vector<int> srclus, sinklus;
+	readLuList("srclus.txt", srclus);
+	readLuList("sinklus.txt", sinklus);
+
+	vector<int> reversed(srclus);
+	reversed.insert(reversed.end(), sinklus.begin(), sinklus.end());
+	reverse(reversed.begin(), reversed.end());
+	if (reversed.size() > 1) { reversed.pop_back(); }
+	string outdir = string(prefix) + "out";
+	writeDecoyJob("batch_reversed", reversed, vector<int>());
+	writeDecoyJob("batch_swapped", sinklus, srclus);
+
+	FILE *fp = fopen("batch.txt", "w");
+	if (fp == NULL) { fatalError("Can't open batch.txt for writing\n"); }
+	fprintf(fp, "batch_reversed\nbatch_swapped\n. %s\n", outdir.c_str());
+	fclose(fp);
+
+	BatchRunner runner;
+	runner.nthreads = 1;
+	int nfailed = runner.runBatch("batch.txt", "batch_summary.txt");
+	installHandlers(verboseMessages);
+
+	removeJobDir("batch_reversed");
+	removeJobDir("batch_swapped");
+	remove("batch.txt");
+	remove("batch_summary.txt");
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		rename((outdir + "/" + curveFiles[f]).c_str(), (string(prefix) + curveFiles[f]).c_str());
+	}
+	for (int r = 0; r < 2; r++)
+	{
+		rename((outdir + "/" + resultFiles[r]).c_str(), (string(prefix) + resultFiles[r]).c_str());
+	}
+	rmdir(outdir.c_str());
+	if (nfailed > 0) { fatalError("A job of the batch failed\n"); }
+}
+
+
+typedef struct DiffEngine
+{
+	const char *name;
+	void (*run)(const char *prefix);
+
+	// Writes the curve files
+	bool curves;
+
+	// The numbers of the files may differ by absTol + relTol times
+	// the larger one, with both 0 the files must be identical
+	double absTol;
+	double relTol;
+
+	// Must take less time than the reference
+	bool faster;
+} DiffEngine;
+
+// "%f" rounds to 6 decimals
+static DiffEngine engines[] = {
+	{ "app", runApp, true, 0.0, 0.0, false },
+	{ "engine", runSerial, true, 0.0, 0.0, true },
+	{ "parallel", runParallel, true, 0.0, 0.0, true },
+	{ "streaming", runStreaming, true, 0.0, 0.0, false },
+	{ "shortest", runShortest, true, 5.0000001e-7, 1e-15, false },
+	{ "histogram", runHistogram, true, 0.0, 0.0, false },
+	{ "batch", runBatch, true, 0.0, 0.0, false },
+	{ "distributed", runDistributed, true, 0.0, 0.0, false },
+	{ "pyramid", runPyramid, true, 0.0, 0.0, false },
+	{ "series", runSeries, false, 0.0, 0.0, true },
+	{ "incremental", runIncremental, false, 0.0, 0.0, false },
+	{ "server", runServer, false, 1e-9, 1e-9, true },
+};
+static const int NUM_ENGINES = (int)(sizeof(engines) / sizeof(engines[0]));
+
+
+// Results of an engine over all cases
+typedef struct DiffResult
+{
+	int passed;
+	int failed;
+	double maxAbs;
+	double maxRel;
+} DiffResult;
+
+static DiffResult results[NUM_ENGINES];
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Comparison of the files
+
+static bool readWholeFile(const string &file, string &text)
+{
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (fp == NULL) { return false; }
+	text.clear();
+	char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof buf, fp)) > 0) { text.append(buf, n); }
+	fclose(fp);
+	return true;
+}
+
+
+// The curve files separate the numbers with commas
+static bool isSeparator(char c)
+{
+	return c == ',' || isspace((unsigned char)c);
+}
+
+
+static void splitTokens(const string &text, vector<string> &tokens)
+{
+	tokens.clear();
+	size_t k = 0;
+	while (k < text.size())
+	{
+		while (k < text.size() && isSeparator(text[k])) { k++; }
+		size_t start = k;
+		while (k < text.size() && !isSeparator(text[k])) { k++; }
+		if (k > start) { tokens.push_back(text.substr(start, k - start)); }
+	}
+}
+
+
+static bool parseNumber(const string &token, double &value)
+{
+	char *end;
+	value = strtod(token.c_str(), &end);
+	return end != token.c_str() && *end == '\0';
+}
+
+
+/*
+** compareFiles()
+**
+** Empty if test matches ref within the tolerance of engine, else
+** what differs. Text that is not a number must be the same. The
+** largest differences are kept in result.
+**
+*/
+static string compareFiles(const string &ref, const string &test, const DiffEngine &engine, DiffResult &result)
+{
+	char why[512];
+	string reftext, testtext;
+	if (!readWholeFile(ref, reftext)) { return "missing " + ref; }
+	if (!readWholeFile(test, testtext)) { return "missing " + test; }
+
+	if (engine.absTol == 0.0 && engine.relTol == 0.0)
+	{
+		if (reftext == testtext) { return ""; }
+		size_t k = 0;
+		while (k < reftext.size() && k < testtext.size() && reftext[k] == testtext[k]) { k++; }
+		sprintf(why, "%s differs from %s at byte %lld", test.c_str(), ref.c_str(), (long long)k);
+		return why;
+	}
+
+	vector<string> reftokens, testtokens;
+	splitTokens(reftext, reftokens);
+	splitTokens(testtext, testtokens);
+	if (reftokens.size() != testtokens.size())
+	{
+		sprintf(why, "%s has %lld numbers, %s %lld", test.c_str(), (long long)testtokens.size(),
+			ref.c_str(), (long long)reftokens.size());
+		return why;
+	}
+
+	for (size_t k = 0; k < reftokens.size(); k++)
+	{
+		double a, b;
+		if (!parseNumber(reftokens[k], a) || !parseNumber(testtokens[k], b))
+		{
+			if (reftokens[k] == testtokens[k]) { continue; }
+			sprintf(why, "%s has %.64s where %s has %.64s", test.c_str(), testtokens[k].c_str(),
+				ref.c_str(), reftokens[k].c_str());
+			return why;
+		}
+		if (a == b || (a != a && b != b)) { continue; }
+
+		double diff = fabs(a - b);
+		double larger = max(fabs(a), fabs(b));
+		result.maxAbs = max(result.maxAbs, diff);
+		if (larger > 0) { result.maxRel = max(result.maxRel, diff / larger); }
+		if (!(diff <= engine.absTol + engine.relTol*larger))
+		{
+			sprintf(why, "%s has %.17g where %s has %.17g", test.c_str(), b, ref.c_str(), a);
+			return why;
+		}
+	}
+	return "";
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Random cases
+
+static void writeListFile(const char *file, const vector<int> &lunos)
+{
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+	for (size_t k = 0; k < lunos.size(); k++) { fprintf(fp, "%d\n", lunos[k]); }
+	fclose(fp);
+}
+
+
+// Floats are written with 9 digits so they read back the same
+static void writeGridFile(const char *file, int rows, int cols, const vector<float> &data, bool integer)
+{
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+	AscGrid header;
+	header.rows = rows;
+	header.cols = cols;
+	header.xllcorner = 500000.0;
+	header.yllcorner = 4000000.0;
+	header.cellsize = 30.0;
+	header.noData = DIFF_NODATA;
+	header.data = NULL;
+	writeAscGridHeader(fp, &header);
+
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+		{
+			float v = data[(size_t)i*cols + j];
+			if (integer) { fprintf(fp, (j > 0) ? " %d" : "%d", (int)v); }
+			else { fprintf(fp, (j > 0) ? " %.9g" : "%.9g", v); }
+		}
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+
+static int randomInt(int lo, int hi)
+{
+	return lo + (int)(caseRng() % (unsigned long long)(hi - lo + 1));
+}
+
+
+static double randomUnit()
+{
+	return (double)(caseRng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Sets runs of NODATA, at most fraction of the cells
+static void addNodataRuns(vector<float> &data, int cols, double fraction)
+{
+	long long ncells = (long long)data.size();
+	long long budget = (long long)(fraction*(double)ncells);
+	while (budget > 0)
+	{
+		long long start = (long long)(caseRng() % (unsigned long long)ncells);
+		long long len = min(budget, (long long)randomInt(1, max(1, cols * 2)));
+		for (long long k = start; k < start + len && k < ncells; k++) { data[k] = DIFF_NODATA; }
+		budget -= len;
+	}
+}
+
+
+/*
+** makeFactor()
+**
+** Values of one terrain grid in one of three styles: a few distinct
+** values (ties everywhere), values rounded to 0 to 3 decimals, or
+** values with extremes mixed in.
+**
+*/
+static void makeFactor(vector<float> &data)
+{
+	int style = randomInt(0, 2);
+	vector<float> pool(randomInt(1, 4));
+	for (size_t k = 0; k < pool.size(); k++) { pool[k] = (float)randomInt(-50, 500); }
+	double scale = pow(10.0, randomInt(0, 3));
+	double lo = randomInt(-100, 100), span = randomInt(1, 5000);
+	const float extremes[6] = { 1e9f, -1e9f, 1e-6f, 0.0f, -5000.5f, 3.0e7f };
+
+	for (size_t k = 0; k < data.size(); k++)
+	{
+		if (style == 0) { data[k] = pool[caseRng() % pool.size()]; }
+		else
+		{
+			data[k] = (float)(floor((lo + span*randomUnit())*scale + 0.5) / scale);
+			if (style == 2 && caseRng() % 8 == 0) { data[k] = extremes[caseRng() % 6]; }
+		}
+	}
+}
+
+
+/*
+** writeRandomCase()
+**
+** Up to three sources and three sinks from the codes 1 to 9,
+** unlisted codes 10 to 12. One listed code may have no cells and
+** one a single cell.
+**
+*/
+static void writeRandomCase(int maxsize, string &summary)
+{
+	char text[256];
+	int rows = randomInt(1, maxsize), cols = randomInt(1, maxsize);
+	long long ncells = (long long)rows*cols;
+
+	vector<int> codes;
+	for (int c = 1; c <= 9; c++) { codes.push_back(c); }
+	shuffle(codes.begin(), codes.end(), caseRng);
+	int nsrc = randomInt(1, 3), nsink = randomInt(1, 3);
+	vector<int> srclus(codes.begin(), codes.begin() + nsrc);
+	vector<int> sinklus(codes.begin() + nsrc, codes.begin() + nsrc + nsink);
+	vector<int> listed(codes.begin(), codes.begin() + nsrc + nsink);
+
+	int emptyCode = (caseRng() % 3 == 0) ? listed[caseRng() % listed.size()] : 0;
+	int singleCode = (caseRng() % 3 == 0) ? listed[caseRng() % listed.size()] : 0;
+	if (singleCode == emptyCode) { singleCode = 0; }
+
+	vector<int> drawn;
+	for (size_t k = 0; k < listed.size(); k++)
+	{
+		if (listed[k] != emptyCode && listed[k] != singleCode) { drawn.push_back(listed[k]); }
+	}
+	int nunlisted = randomInt(0, 3);
+	for (int c = 0; c < nunlisted; c++) { drawn.push_back(10 + c); }
+	if (drawn.empty()) { drawn.push_back(10); }
+
+	vector<float> lu(ncells);
+	for (long long k = 0; k < ncells; k++) { lu[k] = (float)drawn[caseRng() % drawn.size()]; }
+	if (caseRng() % 2 == 0) { addNodataRuns(lu, cols, 0.3*randomUnit()); }
+	if (singleCode != 0) { lu[caseRng() % ncells] = (float)singleCode; }
+
+	// At least one cell of a listed land use
+	bool anyListed = false;
+	for (long long k = 0; k < ncells && !anyListed; k++)
+	{
+		anyListed = find(listed.begin(), listed.end(), (int)lu[k]) != listed.end() && (int)lu[k] != emptyCode;
+	}
+	if (!anyListed) { lu[0] = (float)((listed[0] != emptyCode) ? listed[0] : listed[1 % listed.size()]); }
+	if ((int)lu[0] == emptyCode) { lu[0] = (float)DIFF_NODATA; }
+
+	vector<float> terrain[NUM_FACTORS];
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		terrain[f].resize(ncells);
+		makeFactor(terrain[f]);
+		if (caseRng() % 2 == 0) { addNodataRuns(terrain[f], cols, 0.3*randomUnit()); }
+	}
+
+	// Cells of listed land uses without terrain
+	vector<long long> listedCells;
+	for (long long k = 0; k < ncells; k++)
+	{
+		if (find(listed.begin(), listed.end(), (int)lu[k]) != listed.end()) { listedCells.push_back(k); }
+	}
+	if (!listedCells.empty() && caseRng() % 2 == 0)
+	{
+		int nbare = randomInt(1, 5);
+		for (int b = 0; b < nbare; b++)
+		{
+			long long k = listedCells[caseRng() % listedCells.size()];
+			for (int f = 0; f < NUM_FACTORS; f++) { terrain[f][k] = (float)DIFF_NODATA; }
+		}
+	}
+
+	writeListFile("srclus.txt", srclus);
+	writeListFile("sinklus.txt", sinklus);
+	writeGridFile("luws.txt", rows, cols, lu, true);
+	writeGridFile("demws.txt", rows, cols, terrain[0], false);
+	writeGridFile("distws.txt", rows, cols, terrain[1], false);
+	writeGridFile("slopews.txt", rows, cols, terrain[2], false);
+
+	sprintf(text, "%d x %d, %d sources, %d sinks, empty %d, single %d", rows, cols, nsrc, nsink, emptyCode, singleCode);
+	summary = text;
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Running the engines
+
+static double timeRun(void (*run)(const char *), const char *prefix)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (run) { run(prefix); }
+	else
+	{
+		AppReference *reference = new AppReference();
+		reference->run();
+		delete reference;
+	}
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+/*
+** checkEngines()
+**
+** Runs the reference and the engines in the working directory.
+** Returns the number of engines that failed, and the times of the
+** runs in seconds (the reference first).
+**
+*/
+static int checkEngines(const string &label, vector<double> &seconds)
+{
+	seconds.assign(NUM_ENGINES + 1, 0.0);
+	try
+	{
+		seconds[0] = timeRun(NULL, "");
+	}
+	catch (const exception &e)
+	{
+		fprintf(stdout, "%s: the reference failed: %s\n", label.c_str(), e.what());
+		return NUM_ENGINES;
+	}
+
+	int nfailed = 0;
+	for (int e = 0; e < NUM_ENGINES; e++)
+	{
+		const DiffEngine &engine = engines[e];
+		DiffResult &result = results[e];
+		string prefix = string(engine.name) + "_";
+		string why;
+		try
+		{
+			seconds[e + 1] = timeRun(engine.run, prefix.c_str());
+			installHandlers(verboseMessages);
+			for (int f = 0; f < NUM_FACTORS && engine.curves && why.empty(); f++)
+			{
+				why = compareFiles(curveFiles[f], prefix + curveFiles[f], engine, result);
+			}
+			for (int r = 0; r < 2 && why.empty(); r++)
+			{
+				why = compareFiles(resultFiles[r], prefix + resultFiles[r], engine, result);
+			}
+		}
+		catch (const exception &ex)
+		{
+			installHandlers(verboseMessages);
+			why = string("failed: ") + ex.what();
+		}
+
+		if (why.empty()) { result.passed++; }
+		else
+		{
+			result.failed++;
+			nfailed++;
+			fprintf(stdout, "%s: %s: %s\n", label.c_str(), engine.name, why.c_str());
+		}
+	}
+	return nfailed;
+}
+
+
+static void removeCaseFiles()
+{
+	for (size_t k = 0; k < sizeof(inputFiles) / sizeof(inputFiles[0]); k++) { remove(inputFiles[k]); }
+	for (int e = -1; e < NUM_ENGINES; e++)
+	{
+		string prefix = (e < 0) ? "" : string(engines[e].name) + "_";
+		for (int f = 0; f < NUM_FACTORS; f++) { remove((prefix + curveFiles[f]).c_str()); }
+		for (int r = 0; r < 2; r++) { remove((prefix + resultFiles[r]).c_str()); }
+	}
+}
+
+
+static void enterDir(const string &dir)
+{
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+	if (chdir(dir.c_str()) != 0)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't enter the directory %s\n", dir.c_str());
+		fatalError(buf2);
+	}
+}
+
+
+void printUsage()
+{
+	fprintf(stdout, "Usage: sslmdiff [options]\n");
+	fprintf(stdout, "  -cases n          random cases (200)\n");
+	fprintf(stdout, "  -seed n           seed of the cases (1)\n");
+	fprintf(stdout, "  -case k           only run case k of the seed\n");
+	fprintf(stdout, "  -maxsize n        most rows and columns of a case (40)\n");
+	fprintf(stdout, "  -dir path         directory of the cases (sslmdiff_cases)\n");
+	fprintf(stdout, "  -speedsize r c    size of the timed watershed (400 400)\n");
+	fprintf(stdout, "  -nospeed          skip the timed watershed\n");
+	fprintf(stdout, "  -keep             keep the files of the cases that pass\n");
+	fprintf(stdout, "  -verbose          show the messages of the engines\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+	int ncases = 200;
+	unsigned long long seed = 1;
+	int onlyCase = -1;
+	int maxsize = 40;
+	string dir = "sslmdiff_cases";
+	SyntheticOptions synth = defaultSyntheticOptions();
+	synth.rows = synth.cols = 400;
+	bool speed = true;
+	bool keep = false;
+
+	for (int argi = 1; argi < argc; argi++)
+	{
+		const char *opt = argv[argi];
+		bool hasValue = (argi + 1 < argc);
+		if (!strcmp(opt, "-cases") && hasValue) { ncases = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-seed") && hasValue) { seed = strtoull(argv[++argi], NULL, 10); }
+		else if (!strcmp(opt, "-case") && hasValue) { onlyCase = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-maxsize") && hasValue) { maxsize = atoi(argv[++argi]); }
+		else if (!strcmp(opt, "-dir") && hasValue) { dir = argv[++argi]; }
+		else if (!strcmp(opt, "-speedsize") && argi + 2 < argc)
+		{
+			synth.rows = atoi(argv[++argi]);
+			synth.cols = atoi(argv[++argi]);
+		}
+		else if (!strcmp(opt, "-nospeed")) { speed = false; }
+		else if (!strcmp(opt, "-keep")) { keep = true; }
+		else if (!strcmp(opt, "-verbose")) { verboseMessages = true; }
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (ncases < 0 || maxsize < 1 || synth.rows < 1 || synth.cols < 1)
+	{
+		printUsage();
+		return 1;
+	}
+
+	installHandlers(verboseMessages);
+
+	enterDir(dir);
+	int firstCase = (onlyCase >= 0) ? onlyCase : 0;
+	int lastCase = (onlyCase >= 0) ? onlyCase + 1 : ncases;
+	int casesFailed = 0;
+	vector<double> seconds;
+	for (int c = firstCase; c < lastCase; c++)
+	{
+		char name[64];
+		sprintf(name, "case%d", c);
+		enterDir(name);
+
+		caseRng.seed(seed*1000003ULL + (unsigned long long)c);
+		string summary, label = name;
+		int nfailed = NUM_ENGINES;
+		try
+		{
+			writeRandomCase(maxsize, summary);
+			label += " (" + summary + ")";
+			nfailed = checkEngines(label, seconds);
+		}
+		catch (const exception &e)
+		{
+			fprintf(stdout, "%s: can't write the case: %s\n", name, e.what());
+		}
+
+		if (nfailed == 0 && !keep) { removeCaseFiles(); }
+		if (chdir("..") != 0) { fatalError("Can't leave the case directory\n"); }
+		if (nfailed == 0 && !keep) { rmdir(name); }
+		if (nfailed > 0)
+		{
+			casesFailed++;
+			fprintf(stdout, "%s kept in %s/%s, run it with -seed %llu -case %d\n", name, dir.c_str(), name, seed, c);
+		}
+	}
+
+	// The timed watershed is compared as well. Every engine slower
+	// than the reference is counted, the ones marked faster fail.
+	int nslower = 0;
+	int speedFailed = 0;
+	if (speed)
+	{
+		enterDir("speed");
+		synth.nthreads = numWorkers();
+		writeSyntheticWatershed("", synth);
+		installHandlers(verboseMessages);
+		int nfailed = checkEngines("speed", seconds);
+		fprintf(stdout, "\nTimes on %d x %d cells (reference %.3f s):\n", synth.rows, synth.cols, seconds[0]);
+		for (int e = 0; e < NUM_ENGINES; e++)
+		{
+			bool slower = seconds[e + 1] >= seconds[0];
+			bool fails = slower && engines[e].faster;
+			fprintf(stdout, "  %-12s %8.3f s  %6.2fx%s\n", engines[e].name, seconds[e + 1],
+				seconds[0] / max(seconds[e + 1], 1e-9),
+				fails ? "  slower than the reference, failed" : (slower ? "  slower than the reference" : ""));
+			if (slower) { nslower++; }
+			if (fails) { speedFailed++; }
+		}
+		if (nfailed == 0 && !keep) { removeCaseFiles(); }
+		if (chdir("..") != 0) { fatalError("Can't leave the speed directory\n"); }
+		if (nfailed == 0 && !keep) { rmdir("speed"); }
+		if (nfailed > 0) { casesFailed++; }
+	}
+
+	fprintf(stdout, "\n%-12s %6s %6s %12s %12s\n", "engine", "passed", "failed", "max abs", "max rel");
+	for (int e = 0; e < NUM_ENGINES; e++)
+	{
+		fprintf(stdout, "%-12s %6d %6d %12.3g %12.3g\n", engines[e].name, results[e].passed, results[e].failed,
+			results[e].maxAbs, results[e].maxRel);
+	}
+	fprintf(stdout, "%d of %d cases failed, %d engines slower than the reference (%d of them failed)\n",
+		casesFailed, lastCase - firstCase + (speed ? 1 : 0), nslower, speedFailed);
+	return (casesFailed > 0 || speedFailed > 0) ? 1 : 0;
+}
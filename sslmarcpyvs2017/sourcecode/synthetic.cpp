@@ -0,0 +1,350 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Generator of synthetic watersheds for the benchmarks.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "synthetic.h"
+#include "ascgrid.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+// Rows made by a thread at a time
+#define BAND_ROWS 32
+
+#define SYNTHETIC_NODATA -9999
+
+// Buffer of the grid files
+#define GRID_BUFFER (4 << 20)
+
+// Land use, DEM, slope and distance
+#define NUM_GRIDS 4
+static const char *gridNames[NUM_GRIDS] = { "luws.txt", "demws.txt", "slopews.txt", "distws.txt" };
+
+
+SyntheticOptions defaultSyntheticOptions()
+{
+	SyntheticOptions options;
+	options.rows = 1000;
+	options.cols = 1000;
+	options.seed = 1;
+	options.nclasses = 6;
+	options.decimals = 2;
+	options.cellsize = 30.0;
+	options.nthreads = 0;
+	return options;
+}
+
+
+/*
+** latticeValue()
+**
+** Value in [0, 1) of a lattice point, a hash of its position.
+**
+*/
+static inline double latticeValue(long long x, long long y, unsigned long long salt)
+{
+	unsigned long long h = salt ^ ((unsigned long long)x * 0x9E3779B97F4A7C15ULL) ^ ((unsigned long long)y * 0xC2B2AE3D27D4EB4FULL);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return (double)(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Value noise of wavelength 1, smoothstep between the lattice points
+static double valueNoise(double x, double y, unsigned long long salt)
+{
+	double fx = floor(x), fy = floor(y);
+	long long ix = (long long)fx, iy = (long long)fy;
+	double tx = x - fx, ty = y - fy;
+	tx = tx*tx*(3.0 - 2.0*tx);
+	ty = ty*ty*(3.0 - 2.0*ty);
+
+	double a = latticeValue(ix, iy, salt), b = latticeValue(ix + 1, iy, salt);
+	double c = latticeValue(ix, iy + 1, salt), d = latticeValue(ix + 1, iy + 1, salt);
+	return (a + (b - a)*tx) + ((c + (d - c)*tx) - (a + (b - a)*tx))*ty;
+}
+
+
+// Octaves of value noise from wavelength down, each half as strong,
+// scaled back to [0, 1)
+static double fractalNoise(double x, double y, double wavelength, int octaves, unsigned long long salt)
+{
+	double sum = 0.0, amp = 1.0, total = 0.0;
+	for (int o = 0; o < octaves; o++)
+	{
+		sum += amp*valueNoise(x / wavelength, y / wavelength, salt + (unsigned long long)o*0x632BE59BD9B4E019ULL);
+		total += amp;
+		amp *= 0.5;
+		wavelength *= 0.5;
+	}
+	return sum / total;
+}
+
+
+class SyntheticWatershed
+{
+public:
+	SyntheticWatershed(const SyntheticOptions &options);
+
+	// Values of the grids of rows begin to end - 1, appended to text
+	void makeBand(int begin, int end, string text[NUM_GRIDS]);
+
+private:
+	double elevation(int i, int j);
+	bool inside(int i, int j);
+	void appendFixed(string &text, double value, int decimals);
+
+	SyntheticOptions opt;
+	double wavelength;
+	int octaves;
+	double outletRow, outletCol, maxDist;
+	unsigned long long salt[4];
+};
+
+
+SyntheticWatershed::SyntheticWatershed(const SyntheticOptions &options)
+{
+	opt = options;
+
+	// Octaves from half the grid down to about two cells
+	wavelength = max(opt.rows, opt.cols) / 2.0;
+	octaves = 1;
+	while (wavelength / (double)(1 << octaves) >= 2.0 && octaves < 24) { octaves++; }
+
+	outletRow = opt.rows - 1;
+	outletCol = opt.cols / 2;
+	maxDist = hypot((double)opt.rows, opt.cols / 2.0 + 1.0)*opt.cellsize;
+
+	for (int k = 0; k < 4; k++)
+	{
+		salt[k] = (opt.seed + 1)*0xD1B54A32D192ED03ULL + (unsigned long long)k*0x8CB92BA72F3D8DD7ULL;
+	}
+}
+
+
+double SyntheticWatershed::elevation(int i, int j)
+{
+	double d = hypot(i - outletRow, j - outletCol)*opt.cellsize;
+	return 100.0 + 300.0*d / maxDist + 400.0*fractalNoise(j, i, wavelength, octaves, salt[0]);
+}
+
+
+bool SyntheticWatershed::inside(int i, int j)
+{
+	double u = (j - opt.cols / 2.0) / (opt.cols / 2.0);
+	double v = (i - opt.rows / 2.0) / (opt.rows / 2.0);
+	return hypot(u, v) < 0.75 + 0.3*fractalNoise(j, i, wavelength / 2.0, 3, salt[1]);
+}
+
+
+/*
+** appendFixed()
+**
+** The value rounded to decimals digits, faster than "%.*f" for the
+** billions of values of the large grids.
+**
+*/
+void SyntheticWatershed::appendFixed(string &text, double value, int decimals)
+{
+	long long scale = 1;
+	for (int k = 0; k < decimals; k++) { scale *= 10; }
+	long long q = llround(value*(double)scale);
+	if (q < 0)
+	{
+		text += '-';
+		q = -q;
+	}
+
+	char digits[32];
+	int n = 0;
+	long long ip = q / scale, fp = q % scale;
+	do
+	{
+		digits[n++] = (char)('0' + ip % 10);
+		ip /= 10;
+	} while (ip > 0);
+	while (n > 0) { text += digits[--n]; }
+
+	if (decimals > 0)
+	{
+		text += '.';
+		for (int k = decimals - 1; k >= 0; k--)
+		{
+			digits[k] = (char)('0' + fp % 10);
+			fp /= 10;
+		}
+		text.append(digits, decimals);
+	}
+}
+
+
+/*
+** makeBand()
+**
+** The slope needs the elevation of the rows above and below, so
+** the band is computed with one more row on each side.
+**
+*/
+void SyntheticWatershed::makeBand(int begin, int end, string text[NUM_GRIDS])
+{
+	int cols = opt.cols;
+	int first = max(0, begin - 1), last = min(opt.rows - 1, end);
+	vector<double> elev((size_t)(last - first + 1)*cols);
+	for (int i = first; i <= last; i++)
+	{
+		for (int j = 0; j < cols; j++) { elev[(size_t)(i - first)*cols + j] = elevation(i, j); }
+	}
+
+	int nclasses = max(1, opt.nclasses);
+	for (int i = begin; i < end; i++)
+	{
+		const double *row = &elev[(size_t)(i - first)*cols];
+		const double *up = &elev[(size_t)(max(i - 1, first) - first)*cols];
+		const double *down = &elev[(size_t)(min(i + 1, last) - first)*cols];
+		double dy = (min(i + 1, last) - max(i - 1, first))*opt.cellsize;
+
+		for (int j = 0; j < cols; j++)
+		{
+			if (j > 0)
+			{
+				for (int g = 0; g < NUM_GRIDS; g++) { text[g] += ' '; }
+			}
+			if (!inside(i, j))
+			{
+				for (int g = 0; g < NUM_GRIDS; g++) { appendFixed(text[g], SYNTHETIC_NODATA, 0); }
+				continue;
+			}
+
+			// Patches of low frequency noise, stretched so that
+			// the classes have similar shares
+			double n = 0.5 + 2.5*(fractalNoise(j, i, wavelength / 4.0, 4, salt[2]) - 0.5);
+			int lu = 1 + min(nclasses - 1, max(0, (int)(n*nclasses)));
+			appendFixed(text[0], lu, 0);
+
+			appendFixed(text[1], row[j], opt.decimals);
+
+			int jl = max(j - 1, 0), jr = min(j + 1, cols - 1);
+			double dzdx = (jr > jl) ? (row[jr] - row[jl]) / ((jr - jl)*opt.cellsize) : 0.0;
+			double dzdy = (dy > 0) ? (down[j] - up[j]) / dy : 0.0;
+			appendFixed(text[2], 100.0*sqrt(dzdx*dzdx + dzdy*dzdy), opt.decimals);
+
+			double d = hypot(i - outletRow, j - outletCol)*opt.cellsize;
+			appendFixed(text[3], d*(1.0 + 0.5*fractalNoise(j, i, wavelength / 4.0, 2, salt[3])), opt.decimals);
+		}
+		for (int g = 0; g < NUM_GRIDS; g++) { text[g] += '\n'; }
+	}
+}
+
+
+static FILE *openSyntheticFile(const string &name)
+{
+	FILE *fp = fopen(name.c_str(), "w");
+	if (fp == NULL)
+	{
+		char buf2[512];
+		sprintf(buf2, "Can't open %s for writing\n", name.c_str());
+		fatalError(buf2);
+	}
+	return fp;
+}
+
+
+/*
+** writeSyntheticWatershed()
+**
+** Bands are made in rounds of a few per thread and written in
+** order, like writeItems() in textout.h.
+**
+*/
+void writeSyntheticWatershed(const char *dir, const SyntheticOptions &options)
+{
+	char buf2[512];
+	string base = (dir != NULL) ? dir : "";
+	if (options.rows <= 0 || options.cols <= 0 || options.nclasses < 2 || options.decimals < 0 || options.decimals > 9)
+	{
+		fatalError("Bad size, classes (at least 2) or decimals (0 to 9) of the synthetic watershed\n");
+	}
+
+	sprintf(buf2, "Writing a synthetic watershed of %d x %d cells to %s\n", options.rows, options.cols,
+		base.empty() ? "the working directory" : base.c_str());
+	DisplayMessage(buf2);
+
+	AscGrid header;
+	header.rows = options.rows;
+	header.cols = options.cols;
+	header.xllcorner = 500000.0;
+	header.yllcorner = 4000000.0;
+	header.cellsize = options.cellsize;
+	header.noData = SYNTHETIC_NODATA;
+	header.data = NULL;
+
+	FILE *fps[NUM_GRIDS];
+	for (int g = 0; g < NUM_GRIDS; g++)
+	{
+		fps[g] = openSyntheticFile(base + gridNames[g]);
+		setvbuf(fps[g], NULL, _IOFBF, GRID_BUFFER);
+		writeAscGridHeader(fps[g], &header);
+	}
+
+	SyntheticWatershed shed(options);
+	int nworkers = (options.nthreads > 0) ? options.nthreads : numWorkers();
+	int nbands = (options.rows + BAND_ROWS - 1) / BAND_ROWS;
+	int perRound = nworkers * 2;
+	vector<vector<string> > texts(perRound, vector<string>(NUM_GRIDS));
+
+	for (int firstBand = 0; firstBand < nbands; firstBand += perRound)
+	{
+		int nround = min(perRound, nbands - firstBand);
+		parallelBands(nround, nworkers, [&](int begin, int end, int)
+		{
+			for (int b = begin; b < end; b++)
+			{
+				for (int g = 0; g < NUM_GRIDS; g++) { texts[b][g].clear(); }
+				int row = (firstBand + b)*BAND_ROWS;
+				shed.makeBand(row, min(row + BAND_ROWS, options.rows), &texts[b][0]);
+			}
+		});
+
+		for (int b = 0; b < nround; b++)
+		{
+			for (int g = 0; g < NUM_GRIDS; g++)
+			{
+				if (fwrite(texts[b][g].data(), 1, texts[b][g].size(), fps[g]) != texts[b][g].size())
+				{
+					sprintf(buf2, "Can't write %s%s\n", base.c_str(), gridNames[g]);
+					fatalError(buf2);
+				}
+			}
+		}
+	}
+	for (int g = 0; g < NUM_GRIDS; g++) { fclose(fps[g]); }
+
+	// The first half of the classes are sources
+	FILE *fp = openSyntheticFile(base + "srclus.txt");
+	for (int k = 1; k <= options.nclasses / 2; k++) { fprintf(fp, "%d\n", k); }
+	fclose(fp);
+	fp = openSyntheticFile(base + "sinklus.txt");
+	for (int k = options.nclasses / 2 + 1; k <= options.nclasses; k++) { fprintf(fp, "%d\n", k); }
+	fclose(fp);
+}
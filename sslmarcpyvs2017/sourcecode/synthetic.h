@@ -0,0 +1,60 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Synthetic watersheds for the benchmarks. The grids are written in
+** the layout of the PySSLM toolbox (luws.txt, demws.txt, slopews.txt,
+** distws.txt, srclus.txt and sinklus.txt) at any size:
+**
+**   DEM        fractal noise (octaves of value noise down to the
+**              cell size) on a plane falling towards the outlet in
+**              the middle of the bottom row.
+**   slope      percent slope of the DEM from central differences.
+**   distance   distance to the outlet, stretched by a smooth noise
+**              so that it is not a simple function of position.
+**   land use   classes 1..nclasses from a patchy low frequency
+**              noise; the first half are sources, the rest sinks.
+**
+** Cells outside an irregular watershed boundary are NODATA. The
+** values are written with decimals digits after the point, fewer
+** digits give more ties (equal values) in the curves.
+**
+** Every cell is a function of its position and the seed, so the
+** grids are made a band of rows at a time on all threads and never
+** held in memory: 40000 x 40000 grids need a few megabytes.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+typedef struct SyntheticOptions
+{
+	int rows;
+	int cols;
+	unsigned long long seed;
+
+	// Number of land use classes
+	int nclasses;
+
+	// Digits after the point of the DEM, slope and distance
+	int decimals;
+
+	double cellsize;
+
+	// Threads, 0 uses numWorkers()
+	int nthreads;
+} SyntheticOptions;
+
+// 1000 x 1000 cells of 30 m, seed 1, 6 classes, 2 decimals
+SyntheticOptions defaultSyntheticOptions();
+
+// Writes the six input files into dir ("" for the working
+// directory, else ending in a path separator)
+void writeSyntheticWatershed(const char *dir, const SyntheticOptions &options);
+
+#endif
@@ -0,0 +1,530 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Priority-flood depression filling, D8 flow direction and
+** accumulation and watershed delineation.
+**
+** The filling follows the Priority-Flood+Epsilon method of
+** Barnes et al. (2014): cells are processed from the edge of
+** the DEM inwards in order of elevation, and cells in a pit
+** or on a flat are raised to the next representable float
+** above the cell they drain to. After the filling every cell
+** has a lower neighbour, so that D8 flow directions exist
+** everywhere and no separate flat resolution is needed.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <cstdlib>
+#include <string.h>
+#include <math.h>
+#include <cfloat>
+#include <queue>
+#include <vector>
+#include <functional>
+
+#include "terrain.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+
+// Neighbour offsets ordered by the ESRI direction codes.
+// Neighbour k and neighbour (k + 4) % 8 are opposite.
+static const int d8row[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int d8col[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const unsigned char d8code[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+
+
+// Element of the priority queue used by the filling.
+typedef struct FloodCell
+{
+	float z;
+	long long index;
+
+	// The priority queue returns the lowest cell first,
+	// ties are broken by the index so the result is deterministic.
+	bool operator>(const FloodCell &other) const
+	{
+		if (z != other.z) { return z > other.z; }
+		return index > other.index;
+	}
+} FloodCell;
+
+
+/*
+** Terrain()
+** Constructor for the terrain object.
+*/
+Terrain::Terrain()
+{
+	dem = NULL;
+	flowdir = NULL;
+	flowacc = NULL;
+	wsmask = NULL;
+	rows = cols = 0;
+	outletRow = outletCol = -1;
+}
+
+
+/*
+** ~Terrain()
+**
+** Destrcutor for the terrain object. Main task is to free the memory.
+*/
+Terrain::~Terrain()
+{
+	cleanMemory();
+}
+
+
+/*
+** cleanMemory()
+**
+** Free all the dynamically allocated memory that was used.
+**
+*/
+void Terrain::cleanMemory()
+{
+	if (dem) freeAscGrid(dem);
+	if (flowdir) delete[] flowdir;
+	if (flowacc) delete[] flowacc;
+	if (wsmask) delete[] wsmask;
+
+	dem = NULL;
+	flowdir = NULL;
+	flowacc = NULL;
+	wsmask = NULL;
+}
+
+
+bool Terrain::isNoData(long long index)
+{
+	return dem->data[index] == (float)dem->noData;
+}
+
+
+/*
+** loadDem()
+**
+** Reads the raw (not filled, not clipped) DEM.
+**
+*/
+void Terrain::loadDem(const char *file)
+{
+	dem = readAscGrid(file);
+	rows = dem->rows;
+	cols = dem->cols;
+}
+
+
+/*
+** fillDepressions()
+**
+** Priority-flood filling of the DEM. The cells on the edge of the
+** grid and next to nodata cells are the seeds, since water can leave
+** the DEM there. This part is sequential by nature, the queue
+** always has to hand out the lowest open cell.
+**
+*/
+void Terrain::fillDepressions()
+{
+	char buf2[512];
+	sprintf(buf2, "Filling depressions of the DEM!!\n");
+	DisplayMessage(buf2);
+
+	long long ncells = (long long)rows*cols;
+	float *z = dem->data;
+
+	unsigned char *closed = new unsigned char[ncells];
+	if (closed == NULL)
+	{
+		fatalError("Out of memory in fillDepressions()");
+	}
+	memset(closed, 0, sizeof(unsigned char)*ncells);
+
+	priority_queue<FloodCell, vector<FloodCell>, greater<FloodCell> > open;
+	queue<long long> pit;
+	FloodCell fc;
+
+	// Put the seeds into the queue
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+		{
+			long long index = (long long)i*cols + j;
+			if (isNoData(index)) { continue; }
+
+			bool edge = (i == 0 || j == 0 || i == rows - 1 || j == cols - 1);
+			for (int k = 0; k < 8 && !edge; k++)
+			{
+				if (isNoData(index + (long long)d8row[k] * cols + d8col[k])) { edge = true; }
+			}
+			if (edge)
+			{
+				fc.z = z[index];
+				fc.index = index;
+				open.push(fc);
+				closed[index] = 1;
+			}
+		}
+	}
+
+	long long nraised = 0;
+	while (!open.empty() || !pit.empty())
+	{
+		long long c;
+		if (!pit.empty())
+		{
+			c = pit.front();
+			pit.pop();
+		}
+		else
+		{
+			c = open.top().index;
+			open.pop();
+		}
+
+		int ci = (int)(c / cols);
+		int cj = (int)(c % cols);
+		float zup = nextafterf(z[c], FLT_MAX);
+
+		for (int k = 0; k < 8; k++)
+		{
+			int ni = ci + d8row[k];
+			int nj = cj + d8col[k];
+			if (ni < 0 || nj < 0 || ni >= rows || nj >= cols) { continue; }
+
+			long long n = (long long)ni*cols + nj;
+			if (closed[n] || isNoData(n)) { continue; }
+			closed[n] = 1;
+
+			if (z[n] <= z[c])
+			{
+				// In a pit or on a flat: raise the cell just above c
+				// so that it drains to c.
+				z[n] = zup;
+				pit.push(n);
+				nraised++;
+			}
+			else
+			{
+				fc.z = z[n];
+				fc.index = n;
+				open.push(fc);
+			}
+		}
+	}
+
+	delete[] closed;
+
+	sprintf(buf2, "Finished filling depressions, %lld cells raised!!\n", nraised);
+	DisplayMessage(buf2);
+}
+
+
+/*
+** calFlowDirection()
+**
+** D8 flow direction on the filled DEM: each cell drains to the
+** neighbour with the steepest drop. Every cell only reads its
+** neighbours, so the rows are split into bands over the threads.
+**
+*/
+void Terrain::calFlowDirection()
+{
+	char buf2[512];
+	sprintf(buf2, "Calculating D8 flow direction!!\n");
+	DisplayMessage(buf2);
+
+	long long ncells = (long long)rows*cols;
+	flowdir = new unsigned char[ncells];
+	if (flowdir == NULL)
+	{
+		fatalError("Out of memory in calFlowDirection()");
+	}
+
+	double dist[8];
+	for (int k = 0; k < 8; k++)
+	{
+		dist[k] = (d8row[k] != 0 && d8col[k] != 0) ? sqrt(2.0) : 1.0;
+	}
+
+	parallelBands(rows, numWorkers(), [&](int begin, int end, int)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			for (int j = 0; j < cols; j++)
+			{
+				long long index = (long long)i*cols + j;
+				flowdir[index] = 0;
+				if (isNoData(index)) { continue; }
+
+				double maxdrop = 0.0;
+				for (int k = 0; k < 8; k++)
+				{
+					int ni = i + d8row[k];
+					int nj = j + d8col[k];
+					if (ni < 0 || nj < 0 || ni >= rows || nj >= cols) { continue; }
+
+					long long n = (long long)ni*cols + nj;
+					if (isNoData(n)) { continue; }
+
+					double drop = ((double)dem->data[index] - (double)dem->data[n]) / dist[k];
+					if (drop > maxdrop)
+					{
+						maxdrop = drop;
+						flowdir[index] = d8code[k];
+					}
+				}
+			}
+		}
+	});
+
+	sprintf(buf2, "Finished calculating D8 flow direction!!\n");
+	DisplayMessage(buf2);
+}
+
+
+/*
+** calFlowAccumulation()
+**
+** Counts the upstream cells of each cell. The number of cells draining
+** into each cell is counted in parallel, then the cells are visited
+** in topological order starting from the ridges.
+**
+*/
+void Terrain::calFlowAccumulation()
+{
+	char buf2[512];
+	sprintf(buf2, "Calculating flow accumulation!!\n");
+	DisplayMessage(buf2);
+
+	long long ncells = (long long)rows*cols;
+	flowacc = new int[ncells];
+	unsigned char *indegree = new unsigned char[ncells];
+	if (flowacc == NULL || indegree == NULL)
+	{
+		fatalError("Out of memory in calFlowAccumulation()");
+	}
+	memset(flowacc, 0, sizeof(int)*ncells);
+
+	parallelBands(rows, numWorkers(), [&](int begin, int end, int)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			for (int j = 0; j < cols; j++)
+			{
+				long long index = (long long)i*cols + j;
+				unsigned char ctr = 0;
+				for (int k = 0; k < 8; k++)
+				{
+					int ni = i + d8row[k];
+					int nj = j + d8col[k];
+					if (ni < 0 || nj < 0 || ni >= rows || nj >= cols) { continue; }
+
+					// The neighbour drains to this cell if it points back
+					if (flowdir[(long long)ni*cols + nj] == d8code[(k + 4) % 8]) { ctr++; }
+				}
+				indegree[index] = ctr;
+			}
+		}
+	});
+
+	vector<long long> stack;
+	for (long long index = 0; index < ncells; index++)
+	{
+		if (indegree[index] == 0 && !isNoData(index)) { stack.push_back(index); }
+	}
+
+	while (!stack.empty())
+	{
+		long long c = stack.back();
+		stack.pop_back();
+		if (flowdir[c] == 0) { continue; }
+
+		int k = 0;
+		while (d8code[k] != flowdir[c]) { k++; }
+		long long n = c + (long long)d8row[k] * cols + d8col[k];
+
+		flowacc[n] += flowacc[c] + 1;
+		if (--indegree[n] == 0) { stack.push_back(n); }
+	}
+
+	delete[] indegree;
+
+	sprintf(buf2, "Finished calculating flow accumulation!!\n");
+	DisplayMessage(buf2);
+}
+
+
+/*
+** delineateWatershed()
+**
+** Marks the cells upstream of the outlet at map coordinate (x, y).
+** Like SnapPourPoint, the outlet is moved to the cell with the highest
+** flow accumulation within snapdist (map units).
+**
+*/
+void Terrain::delineateWatershed(double x, double y, double snapdist)
+{
+	char buf2[512];
+	sprintf(buf2, "Delineating watershed!!\n");
+	DisplayMessage(buf2);
+
+	int ocol = (int)floor((x - dem->xllcorner) / dem->cellsize);
+	int orow = rows - 1 - (int)floor((y - dem->yllcorner) / dem->cellsize);
+	if (orow < 0 || ocol < 0 || orow >= rows || ocol >= cols)
+	{
+		sprintf(buf2, "Outlet %f, %f is outside of the DEM\n", x, y);
+		fatalError(buf2);
+	}
+
+	// Snap the outlet
+	int radius = (int)ceil(snapdist / dem->cellsize);
+	int bestacc = -1;
+	outletRow = orow;
+	outletCol = ocol;
+	for (int i = orow - radius; i <= orow + radius; i++)
+	{
+		for (int j = ocol - radius; j <= ocol + radius; j++)
+		{
+			if (i < 0 || j < 0 || i >= rows || j >= cols) { continue; }
+			long long index = (long long)i*cols + j;
+			if (isNoData(index)) { continue; }
+			if (flowacc[index] > bestacc)
+			{
+				bestacc = flowacc[index];
+				outletRow = i;
+				outletCol = j;
+			}
+		}
+	}
+	if (bestacc < 0)
+	{
+		sprintf(buf2, "No valid DEM cell near outlet %f, %f\n", x, y);
+		fatalError(buf2);
+	}
+
+	long long ncells = (long long)rows*cols;
+	wsmask = new unsigned char[ncells];
+	if (wsmask == NULL)
+	{
+		fatalError("Out of memory in delineateWatershed()");
+	}
+	memset(wsmask, 0, sizeof(unsigned char)*ncells);
+
+	// Walk upstream from the outlet
+	vector<long long> stack;
+	long long outlet = (long long)outletRow*cols + outletCol;
+	long long wscells = 1;
+	wsmask[outlet] = 1;
+	stack.push_back(outlet);
+
+	while (!stack.empty())
+	{
+		long long c = stack.back();
+		stack.pop_back();
+		int ci = (int)(c / cols);
+		int cj = (int)(c % cols);
+
+		for (int k = 0; k < 8; k++)
+		{
+			int ni = ci + d8row[k];
+			int nj = cj + d8col[k];
+			if (ni < 0 || nj < 0 || ni >= rows || nj >= cols) { continue; }
+
+			long long n = (long long)ni*cols + nj;
+			if (!wsmask[n] && flowdir[n] == d8code[(k + 4) % 8])
+			{
+				wsmask[n] = 1;
+				wscells++;
+				stack.push_back(n);
+			}
+		}
+	}
+
+	sprintf(buf2, "Finished delineating watershed: outlet at row %d col %d, %lld cells!!\n",
+		outletRow, outletCol, wscells);
+	DisplayMessage(buf2);
+}
+
+
+/*
+** processTerrain()
+**
+** Runs the terrain preprocessing from the raw DEM to the watershed mask.
+**
+*/
+void Terrain::processTerrain(const char *demfile, double x, double y, double snapdist)
+{
+	loadDem(demfile);
+	fillDepressions();
+	calFlowDirection();
+	calFlowAccumulation();
+	delineateWatershed(x, y, snapdist);
+}
+
+
+/*
+** writeOutputs()
+**
+** Write the filled DEM, flow direction, flow accumulation and
+** watershed grids. Any of the file names can be NULL.
+**
+*/
+void Terrain::writeOutputs(const char *fillfile, const char *fdrfile,
+	const char *accfile, const char *wsfile)
+{
+	long long ncells = (long long)rows*cols;
+	int nodata = (int)dem->noData;
+
+	if (fillfile)
+	{
+		writeAscGrid(fillfile, dem, dem->data);
+	}
+
+	int *temp = new int[ncells];
+	if (temp == NULL)
+	{
+		fatalError("Out of memory in Terrain::writeOutputs()");
+	}
+
+	if (fdrfile && flowdir)
+	{
+		for (long long index = 0; index < ncells; index++)
+		{
+			temp[index] = isNoData(index) ? nodata : flowdir[index];
+		}
+		writeAscGridInt(fdrfile, dem, temp);
+	}
+
+	if (accfile && flowacc)
+	{
+		for (long long index = 0; index < ncells; index++)
+		{
+			temp[index] = isNoData(index) ? nodata : flowacc[index];
+		}
+		writeAscGridInt(accfile, dem, temp);
+	}
+
+	if (wsfile && wsmask)
+	{
+		for (long long index = 0; index < ncells; index++)
+		{
+			temp[index] = wsmask[index] ? 1 : nodata;
+		}
+		writeAscGridInt(wsfile, dem, temp);
+	}
+
+	delete[] temp;
+}
@@ -0,0 +1,75 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** The terrain class does the preprocessing that was done with
+** the ArcGIS tools in step 1 to 4 of the PySSLM toolbox:
+** 1. fill the depressions of the DEM (priority-flood),
+** 2. calculate D8 flow direction and flow accumulation,
+** 3. delineate the watershed upstream of an outlet.
+** The watershed mask is then used by the App class to mask
+** the land use grid, so that raw (not clipped) grids can be
+** used as inputs.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "ascgrid.h"
+
+// Define class
+class Terrain
+{
+public:
+	// Constructor and distructor
+	// of the terrain for manage memories
+	Terrain();
+	~Terrain();
+
+	// The DEM, the values are filled in place
+	AscGrid *dem;
+
+	// D8 flow direction with the ESRI encoding
+	// (1 E, 2 SE, 4 S, 8 SW, 16 W, 32 NW, 64 N, 128 NE),
+	// 0 for nodata cells and cells draining out of the grid.
+	unsigned char *flowdir;
+
+	// Number of upstream cells (the cell itself is not counted)
+	int *flowacc;
+
+	// 1 for cells upstream of the outlet, 0 otherwise
+	unsigned char *wsmask;
+
+	// Row and column of the (snapped) outlet
+	int outletRow;
+	int outletCol;
+
+	void loadDem(const char *file);
+	void fillDepressions();
+	void calFlowDirection();
+	void calFlowAccumulation();
+	void delineateWatershed(double x, double y, double snapdist);
+
+	// Runs all of the steps above
+	void processTerrain(const char *demfile, double x, double y, double snapdist);
+
+	void writeOutputs(const char *fillfile, const char *fdrfile,
+		const char *accfile, const char *wsfile);
+
+	// Clean memory after running
+	void cleanMemory();
+
+private:
+
+	bool isNoData(long long index);
+
+	int rows;
+	int cols;
+};
+
+#endif
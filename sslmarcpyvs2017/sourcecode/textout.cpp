@@ -0,0 +1,662 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Parallel formatting and compressed writing of text files.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#ifdef SSLM_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SSLM_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "textout.h"
+#include "parallel.h"
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+// Items formatted into one buffer
+#define CHUNK_ITEMS (1 << 16)
+
+// Buffer of the file writes
+#define WRITE_BUFFER (4 << 20)
+
+
+TextOptions defaultTextOptions()
+{
+	TextOptions options;
+	options.numbers = NUMBERS_FIXED;
+	options.compression = COMPRESS_NONE;
+	options.nthreads = 0;
+	return options;
+}
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Shortest digits of a double (Ryu, Ulf Adams, PLDI 2018). The
+// tables of 128 bit powers of 5 are made once from exact integers.
+
+#define RYU_POW5_BITCOUNT 125
+#define RYU_POW5_INV_BITCOUNT 125
+#define RYU_POW5_TABLE 326
+#define RYU_POW5_INV_TABLE 342
+
+typedef unsigned long long u64;
+
+static u64 pow5Split[RYU_POW5_TABLE][2];
+static u64 pow5InvSplit[RYU_POW5_INV_TABLE][2];
+static once_flag ryuTablesMade;
+
+// Bits of 5^e, log10(2^e) and log10(5^e), rounded as Ryu needs them
+static int pow5bits(int e) { return (int)(((unsigned)e * 1217359u) >> 19) + 1; }
+static int log10Pow2(int e) { return (int)(((unsigned)e * 78913u) >> 18); }
+static int log10Pow5(int e) { return (int)(((unsigned)e * 732923u) >> 20); }
+
+
+// Bit k of a little endian big integer
+static int bigBit(const vector<unsigned int> &a, int k)
+{
+	return (k >= 0 && k / 32 < (int)a.size()) ? (int)((a[k / 32] >> (k % 32)) & 1) : 0;
+}
+
+
+/*
+** makeRyuTables()
+**
+** pow5Split[i] is 5^i shifted to RYU_POW5_BITCOUNT bits, and
+** pow5InvSplit[i] is 2^(pow5bits(i) - 1 + RYU_POW5_INV_BITCOUNT) / 5^i
+** rounded down, plus 1. The quotient is found by long division one
+** bit at a time, it has at most 126 bits.
+**
+*/
+static void makeRyuTables()
+{
+	vector<unsigned int> p(1, 1);
+	for (int i = 0; i < RYU_POW5_INV_TABLE; i++)
+	{
+		int bits = pow5bits(i);
+		if (i < RYU_POW5_TABLE)
+		{
+			int shift = bits - RYU_POW5_BITCOUNT;
+			u64 w[2] = { 0, 0 };
+			for (int k = 0; k < 128; k++)
+			{
+				if (bigBit(p, k + shift)) { w[k / 64] |= 1ULL << (k % 64); }
+			}
+			pow5Split[i][0] = w[0];
+			pow5Split[i][1] = w[1];
+		}
+
+		int n = bits - 1 + RYU_POW5_INV_BITCOUNT;
+		u64 q[2] = { 0, 0 };
+		if (i == 0)
+		{
+			q[n / 64] = 1ULL << (n % 64);
+		}
+		else
+		{
+			// r = 2^(bits - 1) < 5^i after the top bits of 2^n
+			vector<unsigned int> r(p.size() + 1, 0);
+			r[(bits - 1) / 32] = 1u << ((bits - 1) % 32);
+			for (int step = n - bits + 1; step > 0; step--)
+			{
+				unsigned int carry = 0;
+				for (size_t w = 0; w < r.size(); w++)
+				{
+					unsigned int next = r[w] >> 31;
+					r[w] = (r[w] << 1) | carry;
+					carry = next;
+				}
+				q[1] = (q[1] << 1) | (q[0] >> 63);
+				q[0] <<= 1;
+
+				bool ge = true;
+				for (size_t w = r.size(); w > 0; w--)
+				{
+					unsigned int d = (w - 1 < p.size()) ? p[w - 1] : 0;
+					if (r[w - 1] != d) { ge = r[w - 1] > d; break; }
+				}
+				if (!ge) { continue; }
+				u64 borrow = 0;
+				for (size_t w = 0; w < r.size(); w++)
+				{
+					u64 d = (w < p.size()) ? p[w] : 0;
+					u64 diff = (u64)r[w] - d - borrow;
+					r[w] = (unsigned int)diff;
+					borrow = (diff >> 63) & 1;
+				}
+				q[0] |= 1;
+			}
+		}
+		q[0]++;
+		if (q[0] == 0) { q[1]++; }
+		pow5InvSplit[i][0] = q[0];
+		pow5InvSplit[i][1] = q[1];
+
+		// p *= 5
+		u64 carry = 0;
+		for (size_t w = 0; w < p.size(); w++)
+		{
+			u64 v = (u64)p[w] * 5 + carry;
+			p[w] = (unsigned int)v;
+			carry = v >> 32;
+		}
+		if (carry) { p.push_back((unsigned int)carry); }
+	}
+}
+
+
+// 64 x 64 bit product, the high half goes to hi
+static u64 umul128(u64 a, u64 b, u64 *hi)
+{
+	u64 aLo = a & 0xffffffffULL, aHi = a >> 32;
+	u64 bLo = b & 0xffffffffULL, bHi = b >> 32;
+	u64 b00 = aLo*bLo, b01 = aLo*bHi, b10 = aHi*bLo, b11 = aHi*bHi;
+	u64 mid1 = b10 + (b00 >> 32);
+	u64 mid2 = b01 + (mid1 & 0xffffffffULL);
+	*hi = b11 + (mid1 >> 32) + (mid2 >> 32);
+	return (mid2 << 32) | (b00 & 0xffffffffULL);
+}
+
+
+// (m * mul) >> j of a 128 bit mul, 64 < j < 128
+static u64 mulShift64(u64 m, const u64 *mul, int j)
+{
+	u64 high1;
+	u64 low1 = umul128(m, mul[1], &high1);
+	u64 high0;
+	umul128(m, mul[0], &high0);
+	u64 sum = high0 + low1;
+	if (sum < high0) { high1++; }
+	int dist = j - 64;
+	return (high1 << (64 - dist)) | (sum >> dist);
+}
+
+
+static bool multipleOfPowerOf5(u64 value, int p)
+{
+	int count = 0;
+	while (value > 0 && value % 5 == 0) { value /= 5; count++; }
+	return count >= p;
+}
+
+
+static bool multipleOfPowerOf2(u64 value, int p)
+{
+	return (value & ((1ULL << p) - 1)) == 0;
+}
+
+
+/*
+** shortestDigits()
+**
+** Decimal digits and exponent (value = digits*10^exp10) of a finite,
+** non zero double: the fewest digits that read back to it, the one
+** nearest to it of those.
+**
+*/
+static void shortestDigits(double value, u64 &digits, int &exp10)
+{
+	u64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	u64 mantissa = bits & ((1ULL << 52) - 1);
+	int exponent = (int)((bits >> 52) & 0x7ff);
+
+	int e2;
+	u64 m2;
+	if (exponent == 0)
+	{
+		e2 = 1 - 1023 - 52 - 2;
+		m2 = mantissa;
+	}
+	else
+	{
+		e2 = exponent - 1023 - 52 - 2;
+		m2 = (1ULL << 52) | mantissa;
+	}
+	bool acceptBounds = (m2 & 1) == 0;
+
+	// The interval of the decimals that read back, times 4
+	u64 mv = 4 * m2;
+	u64 mmShift = (mantissa != 0 || exponent <= 1) ? 1 : 0;
+
+	u64 vr, vp, vm;
+	int e10;
+	bool vmIsTrailingZeros = false;
+	bool vrIsTrailingZeros = false;
+	if (e2 >= 0)
+	{
+		int q = log10Pow2(e2) - (e2 > 3 ? 1 : 0);
+		e10 = q;
+		int k = RYU_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+		int i = -e2 + q + k;
+		vr = mulShift64(4 * m2, pow5InvSplit[q], i);
+		vp = mulShift64(4 * m2 + 2, pow5InvSplit[q], i);
+		vm = mulShift64(4 * m2 - 1 - mmShift, pow5InvSplit[q], i);
+		if (q <= 21)
+		{
+			if (mv % 5 == 0) { vrIsTrailingZeros = multipleOfPowerOf5(mv, q); }
+			else if (acceptBounds) { vmIsTrailingZeros = multipleOfPowerOf5(mv - 1 - mmShift, q); }
+			else { vp -= multipleOfPowerOf5(mv + 2, q) ? 1 : 0; }
+		}
+	}
+	else
+	{
+		int q = log10Pow5(-e2) - (-e2 > 1 ? 1 : 0);
+		e10 = q + e2;
+		int i = -e2 - q;
+		int k = pow5bits(i) - RYU_POW5_BITCOUNT;
+		int j = q - k;
+		vr = mulShift64(4 * m2, pow5Split[i], j);
+		vp = mulShift64(4 * m2 + 2, pow5Split[i], j);
+		vm = mulShift64(4 * m2 - 1 - mmShift, pow5Split[i], j);
+		if (q <= 1)
+		{
+			vrIsTrailingZeros = true;
+			if (acceptBounds) { vmIsTrailingZeros = (mmShift == 1); }
+			else { vp--; }
+		}
+		else if (q < 63)
+		{
+			vrIsTrailingZeros = multipleOfPowerOf2(mv, q);
+		}
+	}
+
+	// Remove the digits the interval does not need
+	int removed = 0;
+	int lastRemovedDigit = 0;
+	u64 output;
+	if (vmIsTrailingZeros || vrIsTrailingZeros)
+	{
+		while (vp / 10 > vm / 10)
+		{
+			vmIsTrailingZeros &= (vm % 10 == 0);
+			vrIsTrailingZeros &= (lastRemovedDigit == 0);
+			lastRemovedDigit = (int)(vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		if (vmIsTrailingZeros)
+		{
+			while (vm % 10 == 0)
+			{
+				vrIsTrailingZeros &= (lastRemovedDigit == 0);
+				lastRemovedDigit = (int)(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed++;
+			}
+		}
+		// Halfway between two decimals: round to even
+		if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) { lastRemovedDigit = 4; }
+		output = vr + (((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5) ? 1 : 0);
+	}
+	else
+	{
+		bool roundUp = false;
+		if (vp / 100 > vm / 100)
+		{
+			roundUp = (vr % 100 >= 50);
+			vr /= 100;
+			vp /= 100;
+			vm /= 100;
+			removed += 2;
+		}
+		while (vp / 10 > vm / 10)
+		{
+			roundUp = (vr % 10 >= 5);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		output = vr + ((vr == vm || roundUp) ? 1 : 0);
+	}
+
+	while (output % 10 == 0)
+	{
+		output /= 10;
+		removed++;
+	}
+	digits = output;
+	exp10 = e10 + removed;
+}
+
+
+/*
+** formatShortest()
+**
+** The shortest digits laid out as "%.*g" with at least 15 digits
+** would be: an exponent (e+XX) below 1e-4 and from 10^precision on.
+** Returns the number of characters, buf needs 32.
+**
+*/
+static int formatShortest(double value, char *buf)
+{
+	if (value != value || value - value != 0.0)
+	{
+		return snprintf(buf, 32, "%g", value);
+	}
+	char *out = buf;
+	if (signbit(value)) { *out++ = '-'; }
+	if (value == 0.0)
+	{
+		*out++ = '0';
+		return (int)(out - buf);
+	}
+
+	call_once(ryuTablesMade, makeRyuTables);
+	u64 digits;
+	int exp10;
+	shortestDigits(value, digits, exp10);
+
+	// Digits written from the end of the buffer
+	char dbuf[20];
+	char *d = dbuf + sizeof(dbuf);
+	for (u64 v = digits; v > 0; v /= 10) { *--d = (char)('0' + v % 10); }
+	int nd = (int)(dbuf + sizeof(dbuf) - d);
+
+	int x = exp10 + nd - 1;
+	int precision = max(15, nd);
+	if (x < -4 || x >= precision)
+	{
+		*out++ = d[0];
+		if (nd > 1)
+		{
+			*out++ = '.';
+			memcpy(out, d + 1, nd - 1);
+			out += nd - 1;
+		}
+		out += sprintf(out, "e%c%02d", (x < 0) ? '-' : '+', abs(x));
+	}
+	else if (x < 0)
+	{
+		*out++ = '0';
+		*out++ = '.';
+		for (int z = 0; z < -x - 1; z++) { *out++ = '0'; }
+		memcpy(out, d, nd);
+		out += nd;
+	}
+	else
+	{
+		for (int k = 0; k <= x || k < nd; k++)
+		{
+			if (k == x + 1) { *out++ = '.'; }
+			*out++ = (k < nd) ? d[k] : '0';
+		}
+	}
+	return (int)(out - buf);
+}
+
+
+/*
+** number()
+**
+** "%f" can need more than 300 characters for large values.
+**
+*/
+void TextBuffer::number(double value)
+{
+	char buf[400];
+
+	if (numbers == NUMBERS_SHORTEST)
+	{
+		text.append(buf, formatShortest(value, buf));
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "%f", value);
+		text += buf;
+	}
+}
+
+
+void TextBuffer::integer(long long value)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%lld", value);
+	text += buf;
+}
+
+
+static void failWrite(const string &name)
+{
+	char buf2[512];
+	sprintf(buf2, "Can't write %s\n", name.c_str());
+	fatalError(buf2);
+}
+
+
+class PlainSink : public TextSink
+{
+public:
+	PlainSink(const string &name, FILE *fp) : name(name), fp(fp) {}
+	~PlainSink() { if (fp) fclose(fp); }
+
+	void write(const char *data, size_t size)
+	{
+		if (size > 0 && fwrite(data, 1, size, fp) != size) { failWrite(name); }
+	}
+
+	void close()
+	{
+		FILE *f = fp;
+		fp = NULL;
+		if (fclose(f) != 0) { failWrite(name); }
+	}
+
+private:
+	string name;
+	FILE *fp;
+};
+
+
+#ifdef SSLM_WITH_ZLIB
+class GzipSink : public TextSink
+{
+public:
+	GzipSink(const string &name, gzFile gz) : name(name), gz(gz) {}
+	~GzipSink() { if (gz) gzclose(gz); }
+
+	void write(const char *data, size_t size)
+	{
+		while (size > 0)
+		{
+			unsigned part = (unsigned)min(size, (size_t)1 << 30);
+			if (gzwrite(gz, data, part) != (int)part) { failWrite(name); }
+			data += part;
+			size -= part;
+		}
+	}
+
+	void close()
+	{
+		gzFile g = gz;
+		gz = NULL;
+		if (gzclose(g) != Z_OK) { failWrite(name); }
+	}
+
+private:
+	string name;
+	gzFile gz;
+};
+#endif
+
+
+#ifdef SSLM_WITH_ZSTD
+class ZstdSink : public TextSink
+{
+public:
+	ZstdSink(const string &name, FILE *fp) : name(name), fp(fp)
+	{
+		stream = ZSTD_createCStream();
+		ZSTD_initCStream(stream, 3);
+		out.resize(ZSTD_CStreamOutSize());
+	}
+	~ZstdSink()
+	{
+		ZSTD_freeCStream(stream);
+		if (fp) fclose(fp);
+	}
+
+	void write(const char *data, size_t size)
+	{
+		ZSTD_inBuffer in = { data, size, 0 };
+		while (in.pos < in.size)
+		{
+			ZSTD_outBuffer o = { out.data(), out.size(), 0 };
+			if (ZSTD_isError(ZSTD_compressStream(stream, &o, &in))) { failWrite(name); }
+			flushOut(o.pos);
+		}
+	}
+
+	void close()
+	{
+		size_t left;
+		do
+		{
+			ZSTD_outBuffer o = { out.data(), out.size(), 0 };
+			left = ZSTD_endStream(stream, &o);
+			if (ZSTD_isError(left)) { failWrite(name); }
+			flushOut(o.pos);
+		} while (left > 0);
+
+		FILE *f = fp;
+		fp = NULL;
+		if (fclose(f) != 0) { failWrite(name); }
+	}
+
+private:
+	void flushOut(size_t size)
+	{
+		if (size > 0 && fwrite(out.data(), 1, size, fp) != size) { failWrite(name); }
+	}
+
+	string name;
+	FILE *fp;
+	ZSTD_CStream *stream;
+	vector<char> out;
+};
+#endif
+
+
+bool compressionAvailable(int compression)
+{
+#ifndef SSLM_WITH_ZLIB
+	if (compression == COMPRESS_GZIP) { return false; }
+#endif
+#ifndef SSLM_WITH_ZSTD
+	if (compression == COMPRESS_ZSTD) { return false; }
+#endif
+	return compression >= COMPRESS_NONE && compression <= COMPRESS_ZSTD;
+}
+
+
+TextSink *openTextSink(const string &name, int compression)
+{
+	char buf2[512];
+	string file = name;
+	if (compression == COMPRESS_GZIP) { file += ".gz"; }
+	else if (compression == COMPRESS_ZSTD) { file += ".zst"; }
+
+#ifndef SSLM_WITH_ZLIB
+	if (compression == COMPRESS_GZIP) { fatalError("The program was built without gzip output (SSLM_WITH_ZLIB)\n"); }
+#endif
+#ifndef SSLM_WITH_ZSTD
+	if (compression == COMPRESS_ZSTD) { fatalError("The program was built without zstd output (SSLM_WITH_ZSTD)\n"); }
+#endif
+
+#ifdef SSLM_WITH_ZLIB
+	if (compression == COMPRESS_GZIP)
+	{
+		gzFile gz = gzopen(file.c_str(), "wb6");
+		if (gz == NULL)
+		{
+			sprintf(buf2, "Can't open %s for writing\n", file.c_str());
+			fatalError(buf2);
+		}
+		gzbuffer(gz, 1 << 20);
+		return new GzipSink(file, gz);
+	}
+#endif
+
+	FILE *fp = fopen(file.c_str(), (compression == COMPRESS_NONE) ? "w" : "wb");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file.c_str());
+		fatalError(buf2);
+	}
+	setvbuf(fp, NULL, _IOFBF, WRITE_BUFFER);
+
+#ifdef SSLM_WITH_ZSTD
+	if (compression == COMPRESS_ZSTD) { return new ZstdSink(file, fp); }
+#endif
+	return new PlainSink(file, fp);
+}
+
+
+/*
+** writeItems()
+**
+** The chunks are formatted a round at a time, a few per thread, so
+** only the text of one round is in memory.
+**
+*/
+void writeItems(TextSink *sink, long long count, const TextOptions &options,
+	const function<void(long long, long long, TextBuffer &)> &format)
+{
+	int nworkers = (options.nthreads > 0) ? options.nthreads : numWorkers();
+	long long nchunks = (count + CHUNK_ITEMS - 1) / CHUNK_ITEMS;
+
+	// A single chunk is formatted on this thread
+	int perRound = (nchunks > 1) ? nworkers * 4 : 1;
+	vector<TextBuffer> buffers(perRound, TextBuffer(options.numbers));
+
+	for (long long first = 0; first < nchunks; first += perRound)
+	{
+		int nround = (int)min((long long)perRound, nchunks - first);
+		parallelBands(nround, nworkers, [&](int begin, int end, int)
+		{
+			for (int c = begin; c < end; c++)
+			{
+				TraceSpan span("text", "format");
+				long long b = (first + c) * CHUNK_ITEMS;
+				span.arg("item", (double)b);
+				buffers[c].text.clear();
+				format(b, min(b + CHUNK_ITEMS, count), buffers[c]);
+			}
+		});
+
+		TraceSpan span("text", "write");
+		double bytes = 0;
+		for (int c = 0; c < nround; c++)
+		{
+			sink->write(buffers[c].text.data(), buffers[c].text.size());
+			bytes += (double)buffers[c].text.size();
+		}
+		span.arg("bytes", bytes);
+	}
+}
@@ -0,0 +1,97 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Text output of large files. The numbers are formatted into
+** buffers by all threads, a chunk of items per buffer, and the
+** buffers are written in order with one large write each, so the
+** file is the same as with one fprintf() per number.
+**
+** Numbers are formatted like "%f" (the default, the same bytes as
+** the C library) or as the shortest text that reads back to the
+** same double, laid out like "%.17g" (at least 15 digits before an
+** exponent is used). The shortest digits come from Ryu (Adams 2018),
+** which needs no round trip through strtod().
+**
+** The output can be compressed while it is written: gzip when the
+** program is built with SSLM_WITH_ZLIB (and linked with zlib), zstd
+** with SSLM_WITH_ZSTD (and libzstd). ".gz" or ".zst" is appended to
+** the name of the file.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef TEXTOUT_H
+#define TEXTOUT_H
+
+#include <functional>
+#include <string>
+
+// Number formats
+#define NUMBERS_FIXED 0
+#define NUMBERS_SHORTEST 1
+
+// Compression of text files
+#define COMPRESS_NONE 0
+#define COMPRESS_GZIP 1
+#define COMPRESS_ZSTD 2
+
+typedef struct TextOptions
+{
+	int numbers;
+	int compression;
+
+	// Threads formatting the numbers, 0 uses numWorkers()
+	int nthreads;
+} TextOptions;
+
+// NUMBERS_FIXED, COMPRESS_NONE, all threads
+TextOptions defaultTextOptions();
+
+
+// Text of a chunk of items
+class TextBuffer
+{
+public:
+	TextBuffer(int numbers) : numbers(numbers) {}
+
+	std::string text;
+
+	// A number in the format of the buffer
+	void number(double value);
+	void integer(long long value);
+	void append(const char *s) { text += s; }
+	void append(char c) { text += c; }
+
+private:
+	int numbers;
+};
+
+
+// File the text goes to, compressed or not
+class TextSink
+{
+public:
+	virtual ~TextSink() {}
+	virtual void write(const char *data, size_t size) = 0;
+
+	// Flushes and closes the file, errors end the program
+	virtual void close() = 0;
+};
+
+// False if the program was built without the compression
+bool compressionAvailable(int compression);
+
+// Opens name (with the suffix of the compression) for writing
+TextSink *openTextSink(const std::string &name, int compression);
+
+// Formats count items into buffers in parallel and writes them in
+// order. format(begin, end, buffer) appends the text of the items
+// from begin to end - 1.
+void writeItems(TextSink *sink, long long count, const TextOptions &options,
+	const std::function<void(long long, long long, TextBuffer &)> &format);
+
+#endif
@@ -0,0 +1,304 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Tracer of the steps of the pipeline, see trace.h.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "trace.h"
+#include "message.h"
+
+using namespace std;
+
+std::atomic<bool> traceActive(false);
+
+static const char *counterNames[TRACE_COUNTERS] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+typedef struct TraceEvent
+{
+	const char *cat;
+	const char *name;
+	double start;
+	double dur;
+	int nargs;
+	const char *argKeys[TRACE_MAX_ARGS];
+	double argValues[TRACE_MAX_ARGS];
+	bool counted;
+	unsigned long long counters[TRACE_COUNTERS];
+} TraceEvent;
+
+// Spans of one track, a thread at a time
+typedef struct TraceTrack
+{
+	vector<TraceEvent> events;
+	bool used;
+} TraceTrack;
+
+static mutex traceLock;
+static vector<TraceTrack *> tracks;
+static chrono::steady_clock::time_point traceStart;
+static bool traceCounters = false;
+static string counterNote;
+
+
+/*
+** ThreadTrace
+**
+** The track and the counters of a thread, given back when the
+** thread ends.
+**
+*/
+class ThreadTrace
+{
+public:
+	ThreadTrace() : track(-1), current(NULL), opened(false)
+	{
+		for (int c = 0; c < TRACE_COUNTERS; c++) { fds[c] = -1; }
+	}
+	~ThreadTrace();
+
+	TraceTrack *getTrack();
+	bool readCounters(unsigned long long *values);
+
+private:
+	void openCounters();
+
+	int track;
+	TraceTrack *current;
+	bool opened;
+	int fds[TRACE_COUNTERS];
+};
+
+static thread_local ThreadTrace threadTrace;
+
+
+ThreadTrace::~ThreadTrace()
+{
+#ifdef __linux__
+	for (int c = TRACE_COUNTERS - 1; c >= 0; c--)
+	{
+		if (fds[c] >= 0) { close(fds[c]); }
+	}
+#endif
+	if (track >= 0)
+	{
+		lock_guard<mutex> guard(traceLock);
+		current->used = false;
+	}
+}
+
+
+TraceTrack *ThreadTrace::getTrack()
+{
+	if (track < 0)
+	{
+		lock_guard<mutex> guard(traceLock);
+		for (size_t t = 0; t < tracks.size() && track < 0; t++)
+		{
+			if (!tracks[t]->used) { track = (int)t; }
+		}
+		if (track < 0)
+		{
+			tracks.push_back(new TraceTrack);
+			track = (int)tracks.size() - 1;
+		}
+		tracks[track]->used = true;
+		current = tracks[track];
+	}
+	return current;
+}
+
+
+/*
+** openCounters()
+**
+** One group led by the cycles, so that the four are read together
+** with a single read().
+**
+*/
+void ThreadTrace::openCounters()
+{
+	opened = true;
+#ifdef __linux__
+	const unsigned long long configs[TRACE_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+	for (int c = 0; c < TRACE_COUNTERS; c++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[c];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fds[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, (c == 0) ? -1 : fds[0], 0);
+		if (fds[c] < 0)
+		{
+			int err = errno;
+			for (int k = c - 1; k >= 0; k--)
+			{
+				close(fds[k]);
+				fds[k] = -1;
+			}
+			lock_guard<mutex> guard(traceLock);
+			if (counterNote.empty()) { counterNote = string("perf_event_open failed: ") + strerror(err); }
+			return;
+		}
+	}
+#endif
+}
+
+
+bool ThreadTrace::readCounters(unsigned long long *values)
+{
+	if (!traceCounters) { return false; }
+	if (!opened) { openCounters(); }
+#ifdef __linux__
+	if (fds[0] < 0) { return false; }
+
+	// nr, then the values of the group
+	unsigned long long group[1 + TRACE_COUNTERS];
+	if (read(fds[0], group, sizeof(group)) != (ssize_t)sizeof(group)) { return false; }
+	for (int c = 0; c < TRACE_COUNTERS; c++) { values[c] = group[1 + c]; }
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+static double traceMicros()
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - traceStart).count();
+}
+
+
+void startTrace(bool counters)
+{
+	{
+		lock_guard<mutex> guard(traceLock);
+		for (size_t t = 0; t < tracks.size(); t++) { tracks[t]->events.clear(); }
+		traceStart = chrono::steady_clock::now();
+		traceCounters = counters;
+		counterNote.clear();
+#ifndef __linux__
+		if (counters) { counterNote = "hardware counters need perf_event_open (Linux)"; }
+#endif
+	}
+
+	// The calling thread gets the first free track
+	threadTrace.getTrack();
+	traceActive = true;
+}
+
+
+void TraceSpan::begin(const char *category, const char *name)
+{
+	cat = category;
+	spanName = name;
+	counted = threadTrace.readCounters(counters);
+	start = traceMicros();
+}
+
+
+void TraceSpan::end()
+{
+	TraceEvent event;
+	event.dur = traceMicros() - start;
+	event.counted = counted && threadTrace.readCounters(event.counters);
+	if (event.counted)
+	{
+		for (int c = 0; c < TRACE_COUNTERS; c++) { event.counters[c] -= counters[c]; }
+	}
+	event.cat = cat;
+	event.name = spanName;
+	event.start = start;
+	event.nargs = nargs;
+	for (int a = 0; a < nargs; a++)
+	{
+		event.argKeys[a] = argKeys[a];
+		event.argValues[a] = argValues[a];
+	}
+	threadTrace.getTrack()->events.push_back(event);
+}
+
+
+/*
+** writeTrace()
+**
+** Complete events ("ph": "X") in microseconds, with a thread name
+** event per track.
+**
+*/
+void writeTrace(const char *file)
+{
+	char buf2[512];
+	traceActive = false;
+
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	lock_guard<mutex> guard(traceLock);
+	long long nevents = 0;
+	fprintf(fp, "{\"traceEvents\": [\n");
+	fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"SSLM\"}}");
+	for (size_t t = 0; t < tracks.size(); t++)
+	{
+		fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+			(int)t, (t == 0) ? "main" : "worker", (int)t);
+
+		const vector<TraceEvent> &events = tracks[t]->events;
+		for (size_t e = 0; e < events.size(); e++)
+		{
+			const TraceEvent &ev = events[e];
+			fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {",
+				ev.name, ev.cat, ev.start, ev.dur, (int)t);
+			for (int a = 0; a < ev.nargs; a++)
+			{
+				fprintf(fp, "%s\"%s\": %.15g", (a > 0) ? ", " : "", ev.argKeys[a], ev.argValues[a]);
+			}
+			if (ev.counted)
+			{
+				for (int c = 0; c < TRACE_COUNTERS; c++)
+				{
+					fprintf(fp, "%s\"%s\": %llu", (ev.nargs > 0 || c > 0) ? ", " : "", counterNames[c], ev.counters[c]);
+				}
+			}
+			fprintf(fp, "}}");
+		}
+		nevents += (long long)events.size();
+	}
+	fprintf(fp, "\n],\n\"displayTimeUnit\": \"ms\",\n\"otherData\": {\"counters\": \"%s\"}}\n",
+		!traceCounters ? "off" : (counterNote.empty() ? "cycles, instructions, cache_misses, branch_misses" : counterNote.c_str()));
+	fclose(fp);
+
+	sprintf(buf2, "%lld trace events written to %s\n", nevents, file);
+	DisplayMessage(buf2);
+}
@@ -0,0 +1,89 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Tracer of the steps of the pipeline per thread, written as Chrome
+** trace events (chrome://tracing, ui.perfetto.dev) to see where the
+** threads wait and which sort is on the critical path.
+**
+** A TraceSpan is a step from its construction to its destruction:
+**
+**   {
+**       TraceSpan span("engine", "sort");
+**       span.arg("lu", luno);
+**       ...
+**   }
+**
+** Spans are kept in a buffer per thread and written by writeTrace().
+** With counters set and where perf_event_open() allows it (Linux,
+** perf_event_paranoid 2 or lower) each span also gets the cycles,
+** instructions, cache misses and branch misses of its thread in user
+** space. Nested spans count their inner spans too.
+**
+** Until startTrace() a span only tests a flag. The threads of
+** parallelBands() are new on each call, so they reuse the lowest
+** free track of the trace instead of getting one each.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+
+#define TRACE_MAX_ARGS 4
+#define TRACE_COUNTERS 4
+
+extern std::atomic<bool> traceActive;
+
+inline bool traceEnabled() { return traceActive.load(std::memory_order_relaxed); }
+
+// Starts recording, with hardware counters if counters is set
+void startTrace(bool counters);
+
+// Writes the spans recorded so far to file and stops recording
+void writeTrace(const char *file);
+
+class TraceSpan
+{
+public:
+	// category and name must be string constants
+	TraceSpan(const char *category, const char *name) : active(traceEnabled()), nargs(0)
+	{
+		if (active) { begin(category, name); }
+	}
+	~TraceSpan()
+	{
+		if (active) { end(); }
+	}
+
+	// A number shown with the span, key must be a string constant
+	void arg(const char *key, double value)
+	{
+		if (active && nargs < TRACE_MAX_ARGS)
+		{
+			argKeys[nargs] = key;
+			argValues[nargs++] = value;
+		}
+	}
+
+private:
+	void begin(const char *category, const char *name);
+	void end();
+
+	bool active;
+	const char *cat;
+	const char *spanName;
+	double start;
+	bool counted;
+	unsigned long long counters[TRACE_COUNTERS];
+	int nargs;
+	const char *argKeys[TRACE_MAX_ARGS];
+	double argValues[TRACE_MAX_ARGS];
+};
+
+#endif
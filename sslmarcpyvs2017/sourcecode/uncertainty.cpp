@@ -0,0 +1,505 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Bootstrap and Monte Carlo uncertainty of the lorenz curve areas.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+
+// ------------------------------------------------------------------------------------------------------------
+// Including standard and customized header files:
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include "uncertainty.h"
+#include "app.h"
+#include "engine.h"
+#include "lwli.h"
+#include "parallel.h"
+#include "message.h"
+
+using namespace std;
+
+// Replicates of one land use per task
+#define REPLICATE_BLOCK 16
+
+static const char *factorNames[NUM_FACTORS] = { "Elevation", "Distance", "Slope" };
+
+
+static unsigned long long splitMix(unsigned long long &x)
+{
+	unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+// xoshiro256** stream of one replicate of one land use. The normal
+// values are made here as well, the distributions of <random> are
+// not the same with every compiler.
+class RandomStream
+{
+public:
+	RandomStream(unsigned long long seed, int luidx, int rep)
+	{
+		unsigned long long x = seed;
+		x = splitMix(x) ^ (unsigned long long)luidx;
+		x = splitMix(x) ^ (unsigned long long)rep;
+		for (int k = 0; k < 4; k++) { s[k] = splitMix(x); }
+		spare = 0.0;
+		hasSpare = false;
+	}
+
+	unsigned long long next()
+	{
+		unsigned long long result = rotl(s[1] * 5, 7) * 9;
+		unsigned long long t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	// Index in [0, n), n below 2^32
+	long long index(long long n)
+	{
+		return (long long)(((next() >> 32) * (unsigned long long)n) >> 32);
+	}
+
+	// Standard normal value (Box-Muller)
+	double normal()
+	{
+		if (hasSpare) { hasSpare = false; return spare; }
+
+		double u1 = ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+		double u2 = (next() >> 11) * (1.0 / 9007199254740992.0);
+		double r = sqrt(-2.0 * log(u1));
+		spare = r * sin(6.283185307179586 * u2);
+		hasSpare = true;
+		return r * cos(6.283185307179586 * u2);
+	}
+
+private:
+	static unsigned long long rotl(unsigned long long x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	unsigned long long s[4];
+	double spare;
+	bool hasSpare;
+};
+
+
+// Area of the values of sorted taken counts[i] times each.
+// Equal values are next to each other in sorted, so the sums of
+// lorenz.h are collected in one pass in rank order.
+static double areaFromCounts(const float *sorted, const int *counts, long long n)
+{
+	double sum = 0.0, gapsum = 0.0;
+	double umin = 0.0, umax = 0.0;
+	bool first = true;
+
+	long long i = 0;
+	while (i < n)
+	{
+		float u = sorted[i];
+		long long cnt = 0;
+		for (; i < n && sorted[i] == u; i++) { cnt += counts[i]; }
+		if (cnt == 0) { continue; }
+
+		sum += (double)cnt * u;
+		if (first) { umin = u; first = false; }
+		else { gapsum += (double)cnt * ((double)u - umax); }
+		umax = u;
+	}
+	return lorenzAreaFromSums((double)n, umin, umax, sum, gapsum);
+}
+
+
+// Percentile p of sorted values, interpolated between ranks
+static double percentile(const vector<double> &sorted, double p)
+{
+	if (sorted.empty()) { return 0.0; }
+	double pos = p / 100.0 * (double)(sorted.size() - 1);
+	size_t lo = (size_t)pos;
+	if (lo + 1 >= sorted.size()) { return sorted.back(); }
+	return sorted[lo] + (pos - (double)lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+
+// Mean, standard deviation and interval of values, values is sorted
+static void summarize(vector<double> &values, double level, double *stats)
+{
+	sort(values.begin(), values.end());
+
+	double n = (double)values.size();
+	double mean = 0.0, var = 0.0;
+	for (size_t i = 0; i < values.size(); i++) { mean += values[i]; }
+	mean /= n;
+	for (size_t i = 0; i < values.size(); i++) { var += (values[i] - mean)*(values[i] - mean); }
+
+	stats[0] = mean;
+	stats[1] = (values.size() > 1) ? sqrt(var / (n - 1.0)) : 0.0;
+	stats[2] = percentile(values, (100.0 - level) / 2.0);
+	stats[3] = percentile(values, 50.0);
+	stats[4] = percentile(values, 100.0 - (100.0 - level) / 2.0);
+}
+
+
+LorenzUncertainty::LorenzUncertainty()
+{
+	nreplicates = 1000;
+	seed = 1;
+	for (int f = 0; f < NUM_FACTORS; f++) { sigma[f] = 0.0; }
+	level = 95.0;
+	nthreads = 0;
+	nsrclus = 0;
+	nsinklus = 0;
+}
+
+
+LorenzUncertainty::~LorenzUncertainty()
+{
+}
+
+
+/*
+** loadSamples()
+**
+** Reads the grids through a LorenzEngine, which keeps the values
+** of each land use in the order of the cells. The cells are ordered
+** by the value of each factor, which gives the rank of every cell,
+** and the area of the unchanged values is calculated on the way.
+**
+*/
+void LorenzUncertainty::loadSamples(App *app)
+{
+	vector<int> srclus, sinklus;
+	readLuList(app->srcluFile, srclus);
+	readLuList(app->sinkluFile, sinklus);
+
+	LorenzEngine engine;
+	engine.setClasses(srclus.data(), (int)srclus.size(), sinklus.data(), (int)sinklus.size());
+	engine.readGrids(app->luFile, app->demFile, app->distFile, app->slopeFile);
+
+	results = engine.results;
+	nsrclus = engine.nsrclus;
+	nsinklus = engine.nsinklus;
+	int nlus = nsrclus + nsinklus;
+	samples.resize(nlus);
+
+	char buf2[512];
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		if (results[luidx].ncells >= 0x7fffffffLL)
+		{
+			sprintf(buf2, "Land use %d has too many cells for the uncertainty mode\n", results[luidx].luno);
+			fatalError(buf2);
+		}
+	}
+
+	int ntasks = nlus*NUM_FACTORS;
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		vector<int> order;
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			vector<double> &values = engine.curveValues[t];
+			int n = (int)values.size();
+			LuSample &sample = samples[t / NUM_FACTORS];
+			int f = t % NUM_FACTORS;
+
+			order.resize(n);
+			iota(order.begin(), order.end(), 0);
+			sort(order.begin(), order.end(), [&](int a, int b) { return values[a] < values[b]; });
+
+			sample.sorted[f].resize(n);
+			sample.rank[f].resize(n);
+			vector<double> sorted(n);
+			for (int r = 0; r < n; r++)
+			{
+				sorted[r] = values[order[r]];
+				sample.sorted[f][r] = (float)sorted[r];
+				sample.rank[f][order[r]] = r;
+			}
+			results[t / NUM_FACTORS].area[f] = lorenzAreaSorted(sorted.data(), n);
+
+			vector<double>().swap(values);
+		}
+	});
+}
+
+
+/*
+** bootstrapLu()
+**
+** Draws the cells of one replicate and counts the draws of each
+** rank, the same cell gives the rank it has in each factor.
+**
+*/
+void LorenzUncertainty::bootstrapLu(int luidx, int rep, vector<int> *counts)
+{
+	const LuSample &sample = samples[luidx];
+	long long n = results[luidx].ncells;
+	double *area = &replicates[((size_t)rep*results.size() + luidx)*NUM_FACTORS];
+
+	for (int f = 0; f < NUM_FACTORS; f++) { counts[f].assign(n, 0); }
+
+	RandomStream rng(seed, luidx, rep);
+	for (long long i = 0; i < n; i++)
+	{
+		long long cell = rng.index(n);
+		for (int f = 0; f < NUM_FACTORS; f++) { counts[f][sample.rank[f][cell]]++; }
+	}
+
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		area[f] = (n > 0) ? areaFromCounts(sample.sorted[f].data(), counts[f].data(), n) : 0.0;
+	}
+}
+
+
+/*
+** perturbLu()
+**
+** Adds the errors to all the values of one replicate. With distinct
+** values the gap sum of lorenz.h is umax - umin.
+**
+*/
+void LorenzUncertainty::perturbLu(int luidx, int rep)
+{
+	const LuSample &sample = samples[luidx];
+	long long n = results[luidx].ncells;
+	double *area = &replicates[((size_t)rep*results.size() + luidx)*NUM_FACTORS];
+
+	RandomStream rng(seed, luidx, rep);
+	for (int f = 0; f < NUM_FACTORS; f++)
+	{
+		if (sigma[f] <= 0.0 || n == 0)
+		{
+			area[f] = results[luidx].area[f];
+			continue;
+		}
+
+		const float *values = sample.sorted[f].data();
+		double sum = 0.0;
+		double umin = HUGE_VAL, umax = -HUGE_VAL;
+		for (long long i = 0; i < n; i++)
+		{
+			double u = values[i] + sigma[f] * rng.normal();
+			sum += u;
+			umin = min(umin, u);
+			umax = max(umax, u);
+		}
+		area[f] = lorenzAreaFromSums((double)n, umin, umax, sum, umax - umin);
+	}
+}
+
+
+/*
+** writeAreas()
+**
+** Area of the unchanged values and the distribution of the
+** replicates for each land use and factor.
+**
+*/
+void LorenzUncertainty::writeAreas(const char *file)
+{
+	char buf2[512];
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	double lo = (100.0 - level) / 2.0;
+	int nlus = (int)results.size();
+
+	fprintf(fp, "Uncertainty of the area under lorenz curve, %d %s replicates, seed %llu\n",
+		nreplicates, (sigma[0] > 0 || sigma[1] > 0 || sigma[2] > 0) ? "perturbed" : "bootstrap", seed);
+	fprintf(fp, "Landuse, Factor, Area, Mean, Std, P%g, P50, P%g\n", lo, 100.0 - lo);
+
+	vector<double> values(nreplicates);
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			for (int rep = 0; rep < nreplicates; rep++)
+			{
+				values[rep] = replicates[((size_t)rep*nlus + luidx)*NUM_FACTORS + f];
+			}
+			double stats[5];
+			summarize(values, level, stats);
+			fprintf(fp, "Landuse_%d, %s, %f, %f, %f, %f, %f, %f\n", results[luidx].luno, factorNames[f],
+				results[luidx].area[f], stats[0], stats[1], stats[2], stats[3], stats[4]);
+		}
+	}
+	fclose(fp);
+}
+
+
+void LorenzUncertainty::writeReplicates(const char *file)
+{
+	char buf2[512];
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	int nlus = (int)results.size();
+	fprintf(fp, "Replicate");
+	for (int luidx = 0; luidx < nlus; luidx++)
+	{
+		for (int f = 0; f < NUM_FACTORS; f++)
+		{
+			fprintf(fp, ", Landuse_%d_%s", results[luidx].luno, factorNames[f]);
+		}
+	}
+	fprintf(fp, "\n");
+
+	for (int rep = 0; rep < nreplicates; rep++)
+	{
+		fprintf(fp, "%d", rep + 1);
+		const double *area = &replicates[(size_t)rep*nlus*NUM_FACTORS];
+		for (int t = 0; t < nlus*NUM_FACTORS; t++) { fprintf(fp, ", %f", area[t]); }
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+
+/*
+** writeLwli()
+**
+** LWLI of every replicate with the weights of the land uses.
+**
+*/
+void LorenzUncertainty::writeLwli(const char *file, const vector<double> &weights)
+{
+	char buf2[512];
+	int nlus = (int)results.size();
+
+	vector<int> isSource(nlus);
+	for (int luidx = 0; luidx < nlus; luidx++) { isSource[luidx] = (luidx < nsrclus) ? 1 : 0; }
+
+	vector<double> coef;
+	double point[NUM_LWLI];
+	lwliCoefficients(results.data(), nlus, coef);
+	calLwliSets(nlus, isSource.data(), coef.data(), weights.data(), 1, point, 1);
+
+	vector<LuResult> replicate(results);
+	vector<vector<double> > values(NUM_LWLI, vector<double>(nreplicates));
+	for (int rep = 0; rep < nreplicates; rep++)
+	{
+		for (int luidx = 0; luidx < nlus; luidx++)
+		{
+			for (int f = 0; f < NUM_FACTORS; f++)
+			{
+				replicate[luidx].area[f] = replicates[((size_t)rep*nlus + luidx)*NUM_FACTORS + f];
+			}
+		}
+		double lwli[NUM_LWLI];
+		lwliCoefficients(replicate.data(), nlus, coef);
+		calLwliSets(nlus, isSource.data(), coef.data(), weights.data(), 1, lwli, 1);
+		for (int k = 0; k < NUM_LWLI; k++) { values[k][rep] = lwli[k]; }
+	}
+
+	FILE *fp = fopen(file, "w");
+	if (fp == NULL)
+	{
+		sprintf(buf2, "Can't open %s for writing\n", file);
+		fatalError(buf2);
+	}
+
+	double lo = (100.0 - level) / 2.0;
+	static const char *names[NUM_LWLI] = { "Elevation", "Distance", "Slope", "Combined" };
+	fprintf(fp, "Uncertainty of the LWLI, %d replicates\n", nreplicates);
+	fprintf(fp, "Index, LWLI, Mean, Std, P%g, P50, P%g\n", lo, 100.0 - lo);
+	for (int k = 0; k < NUM_LWLI; k++)
+	{
+		double stats[5];
+		summarize(values[k], level, stats);
+		fprintf(fp, "%s, %f, %f, %f, %f, %f, %f\n", names[k], point[k],
+			stats[0], stats[1], stats[2], stats[3], stats[4]);
+	}
+	fclose(fp);
+}
+
+
+/*
+** runUncertainty()
+**
+** The replicates of all land uses are spread over the threads in
+** blocks of REPLICATE_BLOCK.
+**
+*/
+void LorenzUncertainty::runUncertainty(App *app, const char *srcWeightFile, const char *sinkWeightFile)
+{
+	char buf2[512];
+	if (nreplicates < 1 || level <= 0.0 || level >= 100.0)
+	{
+		fatalError("The number of replicates must be positive and the level between 0 and 100\n");
+	}
+
+	loadSamples(app);
+
+	int nlus = (int)results.size();
+	bool perturb = (sigma[0] > 0 || sigma[1] > 0 || sigma[2] > 0);
+	sprintf(buf2, "Drawing %d %s replicates of %d land uses!!\n",
+		nreplicates, perturb ? "perturbed" : "bootstrap", nlus);
+	DisplayMessage(buf2);
+
+	replicates.assign((size_t)nreplicates*nlus*NUM_FACTORS, 0.0);
+
+	int nblocks = (nreplicates + REPLICATE_BLOCK - 1) / REPLICATE_BLOCK;
+	int ntasks = nlus*nblocks;
+	int nworkers = (nthreads > 0) ? nthreads : numWorkers();
+	atomic<int> nextTask(0);
+
+	parallelBands(nworkers, nworkers, [&](int, int, int)
+	{
+		vector<int> counts[NUM_FACTORS];
+		for (int t = nextTask++; t < ntasks; t = nextTask++)
+		{
+			int luidx = t / nblocks;
+			int rep0 = (t % nblocks)*REPLICATE_BLOCK;
+			int rep1 = min(rep0 + REPLICATE_BLOCK, nreplicates);
+			for (int rep = rep0; rep < rep1; rep++)
+			{
+				if (perturb) { perturbLu(luidx, rep); }
+				else { bootstrapLu(luidx, rep, counts); }
+			}
+		}
+	});
+
+	writeAreas("uncertainty_areas.txt");
+	writeReplicates("uncertainty_replicates.txt");
+	if (srcWeightFile)
+	{
+		vector<double> weights;
+		lwliWeights(results.data(), nsrclus, nsinklus, srcWeightFile, sinkWeightFile, weights);
+		writeLwli("uncertainty_lwli.txt", weights);
+	}
+
+	sprintf(buf2, "Finished writing the uncertainty of the lorenz curve areas!!\n");
+	DisplayMessage(buf2);
+}
@@ -0,0 +1,102 @@
+/*
+-------------------------------------------------------------------------------------------------------------
+**
+** Location weighted landscape index calculation program.
+**
+-------------------------------------------------------------------------------------------------------------
+** File statement:
+** Uncertainty of the lorenz curve areas. The grids are read once,
+** then many replicates of the cells of each land use are drawn and
+** the areas of every replicate are calculated:
+**
+**   bootstrap   the cells of a land use are resampled with
+**               replacement. The values of each factor are sorted
+**               once and the rank of every cell is kept, so a
+**               replicate only counts how often each rank is drawn
+**               and the area follows from the counts in rank order
+**               (see lorenz.h) without sorting again.
+**   perturb     normal errors with the given standard deviations
+**               are added to the values of every cell. The errors
+**               make the values distinct, then the area only needs
+**               the sum, the minimum and the maximum.
+**
+** Every replicate of a land use has its own random stream derived
+** from the seed, the land use and the replicate number, so the
+** results do not depend on the number of threads.
+**
+** The mean, standard deviation and percentile interval of the area
+** of each land use and factor are written to uncertainty_areas.txt,
+** the areas of all replicates to uncertainty_replicates.txt and,
+** with the weights of the land uses, the interval of the LWLI to
+** uncertainty_lwli.txt.
+**
+-------------------------------------------------------------------------------------------------------------
+*/
+
+#ifndef UNCERTAINTY_H
+#define UNCERTAINTY_H
+
+#include <vector>
+
+#include "lorenz.h"
+
+class App;
+
+// Define class
+class LorenzUncertainty
+{
+public:
+	LorenzUncertainty();
+	~LorenzUncertainty();
+
+	// Number of replicates (1000)
+	int nreplicates;
+
+	// Seed of the random streams (1)
+	unsigned long long seed;
+
+	// Standard deviations of the errors of elevation, distance
+	// and slope. The replicates are bootstrap resamples when all
+	// are 0 (the default).
+	double sigma[NUM_FACTORS];
+
+	// Width of the percentile interval in percent (95)
+	double level;
+
+	// Number of threads, 0 uses numWorkers()
+	int nthreads;
+
+	// Reads the input files named in app and writes the results.
+	// The weight files are optional (NULL).
+	void runUncertainty(App *app, const char *srcWeightFile, const char *sinkWeightFile);
+
+private:
+	// Values of the cells of one land use
+	typedef struct LuSample
+	{
+		// Sorted values of each factor
+		std::vector<float> sorted[NUM_FACTORS];
+
+		// Rank of each cell in sorted, for the bootstrap
+		std::vector<int> rank[NUM_FACTORS];
+	} LuSample;
+
+	void loadSamples(App *app);
+	void bootstrapLu(int luidx, int rep, std::vector<int> *counts);
+	void perturbLu(int luidx, int rep);
+
+	void writeAreas(const char *file);
+	void writeReplicates(const char *file);
+	void writeLwli(const char *file, const std::vector<double> &weights);
+
+	std::vector<LuResult> results;
+	int nsrclus;
+	int nsinklus;
+	std::vector<LuSample> samples;
+
+	// Area of replicate rep, land use luidx and factor f at
+	// (rep*nlus + luidx)*NUM_FACTORS + f
+	std::vector<double> replicates;
+};
+
+#endif